@@ -8,17 +8,24 @@
 #include <cnoid/IdPair>
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshExtractor>
-#include <cnoid/ThreadPool>
+#include <cnoid/BoundingBox>
+#include <cnoid/ParallelScheduler>
 #include <algorithm>
-#include <random>
+#include <atomic>
+#include <memory>
 #include <set>
+#include <unordered_map>
 
 using namespace std;
 using namespace cnoid;
 
 namespace {
 
-const bool ENABLE_SHUFFLE = false;
+// Margin added to the bounding boxes to absorb the difference of the float precision used in OPCODE
+const double BoundingBoxMargin = 1.0e-5;
+
+// The model pairs whose bounding boxes have not overlapped in this number of detections are released
+const int ModelPairPruningInterval = 1000;
 
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
@@ -43,9 +50,27 @@ public:
     ReferencedPtr object;
     bool isStatic;
     stdx::optional<Isometry3> localPosition;
-    ColdetModelExPtr sibling;
+
+    // The bounding box of the vertices in the model local coordinate
+    Vector3 localBboxCenter;
+    Vector3 localBboxHalfSize;
+
+    int index;
+    stdx::optional<Isometry3> lastPosition;
+    bool isPositionUpdated;
+    // The bounding box in the world coordinate
+    Vector3 bboxMin;
+    Vector3 bboxMax;
     
-    ColdetModelEx() : isStatic(false) { }
+    ColdetModelEx() : isStatic(false), index(-1), isPositionUpdated(true) { }
+
+    void initializeBoundingBox();
+    void updatePosition(const Isometry3& position);
+    void updateBoundingBox(const Isometry3& T);
+    bool isBoundingBoxOverlapping(ColdetModelEx* model) const {
+        return (bboxMin.array() <= model->bboxMax.array()).all() &&
+            (model->bboxMin.array() <= bboxMax.array()).all();
+    }
 };
 
 class ColdetModelPairEx;
@@ -63,31 +88,85 @@ GeometryHandle getHandle(ColdetModelEx* model)
 
 class ColdetModelPairEx : public ColdetModelPair
 {
-    ColdetModelPairEx(){ }
-    
 public:
     ColdetModelPairEx(ColdetModelEx* model1, ColdetModelEx* model2)
-        : ColdetModelPair(model1, model2)
+        : ColdetModelPair(model1, model2),
+          hasValidCollisionPair(false),
+          lastOverlapDetectionCount(-1)
     {
-        ColdetModelPairEx* last = this;
-        for(auto sibling1 = model1->sibling; sibling1; sibling1 = sibling1->sibling){
-            for(auto sibling2 = model2->sibling; sibling2; sibling2 = sibling2->sibling){
-                last->sibling = new ColdetModelPairEx;
-                last->sibling->set(sibling1, sibling2);
-                last = last->sibling->sibling;
-            }
-        }
+        estimatedCost = model1->getNumTriangles() + model2->getNumTriangles();
     }
 
     ColdetModelEx* model(int which) {
         return static_cast<ColdetModelEx*>(ColdetModelPair::model(which));
     }
 
-    ColdetModelPairExPtr sibling;
+    // The result of the last detection, which is reused while both the models stay at the same positions
+    CollisionPair collisionPair;
+    bool hasValidCollisionPair;
+    // The count of the last detection in which the bounding boxes of the models overlap
+    int lastOverlapDetectionCount;
+    // Relative cost of the narrow phase used to schedule the parallel detection
+    int estimatedCost;
+
+    bool isUpdateNeeded() {
+        return !hasValidCollisionPair || model(0)->isPositionUpdated || model(1)->isPositionUpdated;
+    }
+    void updateCollisionPair();
 };
 
 
-bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& destPair, bool doReserve = false)
+/**
+   The position update is skipped when the position is the same as the previous one
+   so that the pairs of the unmoved models can reuse the previous detection results.
+*/
+void ColdetModelEx::updatePosition(const Isometry3& position)
+{
+    if(lastPosition && lastPosition->matrix() == position.matrix()){
+        return;
+    }
+    lastPosition = position;
+    isPositionUpdated = true;
+
+    if(localPosition){
+        Isometry3 T = position * (*localPosition);
+        setPosition(T);
+        updateBoundingBox(T);
+    } else {
+        setPosition(position);
+        updateBoundingBox(position);
+    }
+}
+
+
+void ColdetModelEx::initializeBoundingBox()
+{
+    BoundingBox bbox;
+    const int n = getNumVertices();
+    for(int i=0; i < n; ++i){
+        float x, y, z;
+        getVertex(i, x, y, z);
+        bbox.expandBy(x, y, z);
+    }
+    localBboxCenter = (bbox.min() + bbox.max()) / 2.0;
+    localBboxHalfSize = (bbox.max() - bbox.min()) / 2.0;
+
+    // The initial position of the model is the identity
+    updateBoundingBox(Isometry3::Identity());
+}
+
+
+//! The bounding box in the world coordinate is updated by the local bounding box placed at T.
+void ColdetModelEx::updateBoundingBox(const Isometry3& T)
+{
+    const Vector3 c = T * localBboxCenter;
+    const Vector3 h = T.linear().cwiseAbs() * localBboxHalfSize + Vector3::Constant(BoundingBoxMargin);
+    bboxMin = c - h;
+    bboxMax = c + h;
+}
+
+
+bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& destPair)
 {
     vector<Collision>& collisions = destPair.collisions();
 
@@ -102,10 +181,6 @@ bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& dest
     const std::vector<collision_data>& cdata = srcPair->collisions();
     const int n = cdata.size();
 
-    if(doReserve){
-        collisions.reserve(n);
-    }
-
     for(int j=0; j < n; ++j){
         const collision_data& cd = cdata[j];
         for(int k=0; k < cd.num_of_i_points; ++k){
@@ -123,6 +198,16 @@ bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& dest
     return !collisions.empty();
 }
 
+
+void ColdetModelPairEx::updateCollisionPair()
+{
+    collisionPair.collisions().clear();
+    if(!detectCollisions().empty()){
+        copyCollisionPairCollisions(this, collisionPair);
+    }
+    hasValidCollisionPair = true;
+}
+
 }
 
 namespace cnoid {
@@ -131,11 +216,23 @@ class AISTCollisionDetectorImpl
 {
 public:
     vector<ColdetModelExPtr> models;
-    vector<ColdetModelPairExPtr> modelPairs;
     int maxNumThreads;
     set<IdPair<GeometryHandle>> ignoredPairs;
     MeshExtractor* meshExtractor;
     bool isReady;
+
+    // The built models are shared by the geometries with the same shape
+    unordered_multimap<size_t, ColdetModelExPtr> builtModelMap;
+
+    // for the broad phase
+    vector<ColdetModelEx*> sweepModels;
+    int sweepAxis;
+    unordered_map<uint64_t, ColdetModelPairExPtr> modelPairMap;
+    vector<ColdetModelPairEx*> overlappingPairs;
+    int detectionCount;
+
+    // for the narrow phase
+    vector<ColdetModelPairEx*> pairsToUpdate;
         
     AISTCollisionDetectorImpl();
     ~AISTCollisionDetectorImpl();
@@ -143,18 +240,22 @@ public:
     void addMesh(ColdetModelEx* model);
     void makeReady();
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
-    void detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback);
+    void updateSweepAxis();
+    void sortSweepModels();
+    void findOverlappingPairs();
+    ColdetModelPairEx* getOrCreateModelPair(ColdetModelEx* model1, ColdetModelEx* model2);
+    void pruneModelPairs();
+    void updateCollisionPairsInParallel();
+    void dispatchCollisionPairs(std::function<void(const CollisionPair&)> callback);
 
     // for multithread version
     int numThreads;
-    unique_ptr<ThreadPool> threadPool;
-    vector<int> shuffledPairIndices;
-    vector<vector<CollisionPair>> collisionPairArrays;
-    mt19937 randomEngine;
+    // Created when the parallel detection is first executed
+    unique_ptr<ParallelTaskGroup> taskGroup;
+    std::atomic<int> nextPairIndex;
     
-    void extractCollisionsOfAssignedPairs(
-        int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs);    
-    void dispatchCollisionsInCollisionPairArrays(std::function<void(const CollisionPair&)> callback);    
+    void updateCollisionPairs(int pairIndexBegin, int pairIndexEnd);
+    void updateCollisionPairsInChunks(int chunkSize);
 };
 
 }
@@ -171,12 +272,9 @@ AISTCollisionDetectorImpl::AISTCollisionDetectorImpl()
     isReady = false;
     maxNumThreads = 0;
     numThreads = 0;
+    sweepAxis = 0;
+    detectionCount = 0;
     meshExtractor = new MeshExtractor;
-
-    if(ENABLE_SHUFFLE){
-        random_device seed;
-        randomEngine.seed(seed());
-    }
 }
 
 
@@ -214,8 +312,12 @@ void AISTCollisionDetector::setNumThreads(int n)
 void AISTCollisionDetector::clearGeometries()
 {
     impl->models.clear();
-    impl->modelPairs.clear();
+    impl->sweepModels.clear();
+    impl->modelPairMap.clear();
+    impl->overlappingPairs.clear();
+    impl->pairsToUpdate.clear();
     impl->ignoredPairs.clear();
+    impl->builtModelMap.clear();
     impl->isReady = false;
 }
 
@@ -238,8 +340,25 @@ stdx::optional<GeometryHandle> AISTCollisionDetectorImpl::addGeometry(SgNode* ge
         ColdetModelExPtr model = new ColdetModelEx;
         if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
             model->setName(geometry->name());
-            model->build();
+            const size_t hash = model->getShapeHash();
+            ColdetModelEx* builtModel = nullptr;
+            auto range = builtModelMap.equal_range(hash);
+            for(auto p = range.first; p != range.second; ++p){
+                if(model->hasSameShape(*p->second)){
+                    builtModel = p->second;
+                    break;
+                }
+            }
+            if(builtModel){
+                model->shareInternalModel(*builtModel);
+            } else {
+                model->build();
+                if(model->isValid()){
+                    builtModelMap.emplace(hash, model);
+                }
+            }
             if(model->isValid()){
+                model->initializeBoundingBox();
                 models.push_back(model);
                 isReady = false;
                 return getHandle(model);
@@ -313,39 +432,28 @@ bool AISTCollisionDetector::makeReady()
 }
 
 
+/**
+   The model pairs are not enumerated here. They are created in the broad phase
+   when the bounding boxes of the models overlap for the first time.
+*/
 void AISTCollisionDetectorImpl::makeReady()
 {
-    modelPairs.clear();
     const int n = models.size();
+    sweepModels.resize(n);
     for(int i=0; i < n; ++i){
-        ColdetModelEx* model1 = models[i];
-        for(int j = i + 1; j < n; ++j){
-            ColdetModelEx* model2 = models[j];
-            if(!model1->isStatic || !model2->isStatic){
-                IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
-                if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
-                    modelPairs.push_back(new ColdetModelPairEx(model1, model2));
-                }
-            }
-        }
+        models[i]->index = i;
+        sweepModels[i] = models[i];
     }
+    sortSweepModels();
 
-    const int numPairs = modelPairs.size();
+    modelPairMap.clear();
+    overlappingPairs.clear();
+    pairsToUpdate.clear();
 
     if(maxNumThreads <= 0){
         numThreads = 0;
-        threadPool.reset();
-        collisionPairArrays.clear();
     } else {
-        numThreads = (maxNumThreads > numPairs) ? numPairs : maxNumThreads;
-        threadPool.reset(new ThreadPool(numThreads));
-        if(ENABLE_SHUFFLE){
-            shuffledPairIndices.resize(modelPairs.size());
-            for(size_t i=0; i < shuffledPairIndices.size(); ++i){
-                shuffledPairIndices[i] = i;
-            }
-        }
-        collisionPairArrays.resize(numThreads);
+        numThreads = std::min(maxNumThreads, ParallelScheduler::instance()->concurrency());
     }
 
     isReady = true;
@@ -354,34 +462,17 @@ void AISTCollisionDetectorImpl::makeReady()
 
 void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Isometry3& position)
 {
-    auto model = getColdetModel(geometry);
-    do {
-        if(model->localPosition){
-            Isometry3 T = position * (*model->localPosition);
-            model->setPosition(T);
-        } else {
-            model->setPosition(position);
-        }
-        model = model->sibling;
-    } while(model);
+    getColdetModel(geometry)->updatePosition(position);
 }
 
 
 void AISTCollisionDetector::updatePositions
 (std::function<void(Referenced* object, Isometry3*& out_Position)> positionQuery)
 {
-    for(ColdetModelEx* model : impl->models){ // Do not use auto&
-        do {
-            Isometry3* T;
-            positionQuery(model->object, T);
-            if(model->localPosition){
-                Isometry3 T2 = (*T) * (*model->localPosition);
-                model->setPosition(T2);
-            } else {
-                model->setPosition(*T);
-            }
-            model = model->sibling; // Elements in models are overridden here if auto& is used
-        } while(model);
+    for(auto& model : impl->models){
+        Isometry3* T;
+        positionQuery(model->object, T);
+        model->updatePosition(*T);
     }
 }
 
@@ -391,105 +482,232 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
     if(!impl->isReady){
         impl->makeReady();
     }
-    if(impl->numThreads > 0){
-        impl->detectCollisionsInParallel(callback);
-    } else {
-        impl->detectCollisions(callback);
-    }
+    impl->detectCollisions(callback);
 } 
 
 
 /**
-   \todo Remeber which geometry positions are updated after the last collision detection
-   and do the actual collision detection only for the updated geometry pairs.
+   The broad phase finds the model pairs whose bounding boxes overlap by the sweep and prune method.
+   The actual collision detection is then only done for the overlapping pairs including a model whose
+   position has been updated after the last collision detection. The other pairs reuse the previous results.
 */
 void AISTCollisionDetectorImpl::detectCollisions(std::function<void(const CollisionPair&)> callback)
 {
-    CollisionPair collisionPair;
-    auto& collisions = collisionPair.collisions();
-    
-    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
-        collisions.clear();
-        do {
-            if(!modelPair->detectCollisions().empty()){
-                copyCollisionPairCollisions(modelPair, collisionPair);
-            }
-            modelPair = modelPair->sibling;  // Elements in models are overridden here if auto& is used
-        } while(modelPair);
+    ++detectionCount;
 
-        if(!collisions.empty()){
-            callback(collisionPair);
+    findOverlappingPairs();
+
+    pairsToUpdate.clear();
+    for(auto& modelPair : overlappingPairs){
+        if(modelPair->isUpdateNeeded()){
+            pairsToUpdate.push_back(modelPair);
         }
     }
+
+    if(numThreads > 0 && pairsToUpdate.size() > 1){
+        updateCollisionPairsInParallel();
+    } else {
+        updateCollisionPairs(0, pairsToUpdate.size());
+    }
+
+    dispatchCollisionPairs(callback);
+
+    if(detectionCount % ModelPairPruningInterval == 0){
+        pruneModelPairs();
+    }
 }
 
 
-void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback)
+/**
+   The axis with the largest variance of the bounding box centers is used as the sweep axis.
+   The axis is only switched when the variance is clearly larger than that of the current axis
+   because switching the axis requires the full sort of the models.
+*/
+void AISTCollisionDetectorImpl::updateSweepAxis()
 {
-    if(ENABLE_SHUFFLE){
-        std::shuffle(shuffledPairIndices.begin(), shuffledPairIndices.end(), randomEngine);
+    const int n = sweepModels.size();
+    if(n < 2){
+        return;
+    }
+    Vector3 sum = Vector3::Zero();
+    Vector3 sum2 = Vector3::Zero();
+    for(auto& model : sweepModels){
+        const Vector3 c = model->bboxMin + model->bboxMax;
+        sum += c;
+        sum2 += c.cwiseProduct(c);
     }
+    const Vector3 variance = sum2 - sum.cwiseProduct(sum) / n;
+    int axis;
+    variance.maxCoeff(&axis);
+    if(axis != sweepAxis && variance[axis] > 1.5 * variance[sweepAxis]){
+        sweepAxis = axis;
+        sortSweepModels();
+    }
+}
+
+
+void AISTCollisionDetectorImpl::sortSweepModels()
+{
+    const int a = sweepAxis;
+    std::sort(sweepModels.begin(), sweepModels.end(),
+              [a](ColdetModelEx* model1, ColdetModelEx* model2){
+                  return model1->bboxMin[a] < model2->bboxMin[a]; });
+}
 
-    const int numPairs = modelPairs.size();
-    const int minSize = numPairs / numThreads;
-    int remainder = numPairs % numThreads;
-    int index = 0;
-    for(int i=0; i < numThreads; ++i){
-        int size = minSize;
-        if(remainder > 0){
-            ++size;
-            --remainder;
+
+void AISTCollisionDetectorImpl::findOverlappingPairs()
+{
+    updateSweepAxis();
+    
+    const int a = sweepAxis;
+    const int n = sweepModels.size();
+
+    // Insertion sort is used because the order rarely changes between the detections
+    for(int i=1; i < n; ++i){
+        auto model = sweepModels[i];
+        const double key = model->bboxMin[a];
+        int j = i;
+        while(j > 0 && sweepModels[j - 1]->bboxMin[a] > key){
+            sweepModels[j] = sweepModels[j - 1];
+            --j;
         }
-        if(size == 0){
-            break;
+        sweepModels[j] = model;
+    }
+
+    overlappingPairs.clear();
+    
+    for(int i=0; i < n; ++i){
+        auto model1 = sweepModels[i];
+        const double max1 = model1->bboxMax[a];
+        for(int j = i + 1; j < n; ++j){
+            auto model2 = sweepModels[j];
+            if(model2->bboxMin[a] > max1){
+                break;
+            }
+            if((model1->isStatic && model2->isStatic) || !model1->isBoundingBoxOverlapping(model2)){
+                continue;
+            }
+            if(auto modelPair = getOrCreateModelPair(model1, model2)){
+                // The previous result is invalid if the bounding boxes did not overlap in the last detection
+                if(modelPair->lastOverlapDetectionCount != detectionCount - 1){
+                    modelPair->hasValidCollisionPair = false;
+                }
+                modelPair->lastOverlapDetectionCount = detectionCount;
+                overlappingPairs.push_back(modelPair);
+            }
         }
-        threadPool->start([this, i, index, size](){
-                extractCollisionsOfAssignedPairs(index, index + size, collisionPairArrays[i]); });
-        index += size;
     }
-    threadPool->waitLoop();
-    //threadPool->wait();
 
-    dispatchCollisionsInCollisionPairArrays(callback);
+    // Keep the order of the pairs independent of the sweep order
+    std::sort(overlappingPairs.begin(), overlappingPairs.end(),
+              [](ColdetModelPairEx* pair1, ColdetModelPairEx* pair2){
+                  const int i1 = pair1->model(0)->index;
+                  const int i2 = pair2->model(0)->index;
+                  return (i1 < i2) || (i1 == i2 && pair1->model(1)->index < pair2->model(1)->index);
+              });
 }
 
 
-void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
-(int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs)
+/**
+   \return nullptr if the pair is ignored
+*/
+ColdetModelPairEx* AISTCollisionDetectorImpl::getOrCreateModelPair(ColdetModelEx* model1, ColdetModelEx* model2)
 {
-    collisionPairs.clear();
+    if(model1->index > model2->index){
+        std::swap(model1, model2);
+    }
+    const uint64_t key = (static_cast<uint64_t>(model1->index) << 32) | static_cast<uint64_t>(model2->index);
+    auto inserted = modelPairMap.emplace(key, nullptr);
+    auto& modelPair = inserted.first->second;
+    if(inserted.second){
+        IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
+        if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
+            modelPair = new ColdetModelPairEx(model1, model2);
+        }
+    }
+    return modelPair;
+}
 
-    for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
-        ColdetModelPairEx* modelPair;
-        if(ENABLE_SHUFFLE){
-            modelPair = modelPairs[shuffledPairIndices[i]];
+
+/**
+   The pairs created for the models that once approached each other are kept in the map while
+   the models stay close, but the pairs of the models that have been apart for a long time are
+   released so that the map does not keep growing when the models move around in a large world.
+   The null entries of the ignored pairs are also released, and they are created again by
+   checking the ignored pairs when the models approach each other next time.
+*/
+void AISTCollisionDetectorImpl::pruneModelPairs()
+{
+    auto p = modelPairMap.begin();
+    while(p != modelPairMap.end()){
+        auto& modelPair = p->second;
+        if(!modelPair || detectionCount - modelPair->lastOverlapDetectionCount >= ModelPairPruningInterval){
+            p = modelPairMap.erase(p);
         } else {
-            modelPair = modelPairs[i];
+            ++p;
         }
+    }
+}
 
-        collisionPairs.push_back(CollisionPair());
-        CollisionPair& collisionPair = collisionPairs.back();
-        do {
-            if(!modelPair->detectCollisions().empty()){
-                copyCollisionPairCollisions(modelPair, collisionPair, true);
-            }
-            modelPair = modelPair->sibling;
-        } while(modelPair);
 
-        if(collisionPair.empty()){
-            collisionPairs.pop_back();
+void AISTCollisionDetectorImpl::dispatchCollisionPairs(std::function<void(const CollisionPair&)> callback)
+{
+    for(auto& modelPair : overlappingPairs){
+        if(!modelPair->collisionPair.empty()){
+            callback(modelPair->collisionPair);
         }
     }
+    for(auto& model : models){
+        model->isPositionUpdated = false;
+    }
 }
 
-void AISTCollisionDetectorImpl::dispatchCollisionsInCollisionPairArrays
-(std::function<void(const CollisionPair&)> callback)
+
+/**
+   The pairs are sorted in the descending order of the estimated cost, and each thread repeatedly
+   takes the next chunk of the pairs with the atomic index until all the pairs are processed.
+   The expensive pairs are processed first and the cheap pairs fill the gaps at the end,
+   so that the threads finish at nearly the same time even if the pair costs vary widely.
+*/
+void AISTCollisionDetectorImpl::updateCollisionPairsInParallel()
 {
-    for(int i=0; i < numThreads; ++i){
-        const vector<CollisionPair>& collisionPairs = collisionPairArrays[i];
-        for(size_t j=0; j < collisionPairs.size(); ++j){
-            callback(collisionPairs[j]);
+    std::sort(pairsToUpdate.begin(), pairsToUpdate.end(),
+              [](ColdetModelPairEx* pair1, ColdetModelPairEx* pair2){
+                  return pair1->estimatedCost > pair2->estimatedCost; });
+
+    const int numPairs = pairsToUpdate.size();
+    const int numTasks = std::min(numThreads, numPairs);
+    const int chunkSize = std::max(1, numPairs / (numTasks * 8));
+
+    if(!taskGroup){
+        taskGroup.reset(new ParallelTaskGroup);
+    }
+    nextPairIndex.store(0, std::memory_order_relaxed);
+    for(int i=1; i < numTasks; ++i){
+        taskGroup->run([this, chunkSize](){ updateCollisionPairsInChunks(chunkSize); });
+    }
+    updateCollisionPairsInChunks(chunkSize);
+    taskGroup->wait();
+}
+
+
+void AISTCollisionDetectorImpl::updateCollisionPairsInChunks(int chunkSize)
+{
+    const int numPairs = pairsToUpdate.size();
+    while(true){
+        const int begin = nextPairIndex.fetch_add(chunkSize, std::memory_order_relaxed);
+        if(begin >= numPairs){
+            break;
         }
+        updateCollisionPairs(begin, std::min(begin + chunkSize, numPairs));
+    }
+}
+
+
+void AISTCollisionDetectorImpl::updateCollisionPairs(int pairIndexBegin, int pairIndexEnd)
+{
+    for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
+        pairsToUpdate[i]->updateCollisionPair();
     }
 }
 
@@ -7,6 +7,7 @@
 #include "Opcode/Opcode.h"
 #include <map>
 #include <iostream>
+#include <cstring>
 
 using namespace std;
 using namespace cnoid;
@@ -97,6 +98,80 @@ void ColdetModel::cloneInternalModel()
 }
 
 
+void ColdetModel::shareInternalModel(const ColdetModel& org)
+{
+    if(org.internalModel == internalModel){
+        return;
+    }
+    org.internalModel->refCounter++;
+    if(--internalModel->refCounter <= 0){
+        delete internalModel;
+    }
+    internalModel = org.internalModel;
+    isValid_ = org.isValid_;
+}
+
+
+size_t ColdetModel::getShapeHash() const
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto hashBytes = [&hash](const void* data, size_t size){
+        auto bytes = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+    };
+    const auto& vertices = internalModel->vertices;
+    const auto& triangles = internalModel->triangles;
+    const auto& params = internalModel->pParams;
+    size_t sizes[] = { static_cast<size_t>(internalModel->pType), params.size(), vertices.size(), triangles.size() };
+    hashBytes(sizes, sizeof(sizes));
+    if(!params.empty()){
+        hashBytes(&params[0], params.size() * sizeof(params[0]));
+    }
+    if(!vertices.empty()){
+        hashBytes(&vertices[0], vertices.size() * sizeof(vertices[0]));
+    }
+    if(!triangles.empty()){
+        hashBytes(&triangles[0], triangles.size() * sizeof(triangles[0]));
+    }
+    return hash;
+}
+
+
+bool ColdetModel::hasSameShape(const ColdetModel& model) const
+{
+    if(model.internalModel == internalModel){
+        return true;
+    }
+    if(internalModel->pType != model.internalModel->pType ||
+       internalModel->pParams != model.internalModel->pParams){
+        return false;
+    }
+    const auto& vertices1 = internalModel->vertices;
+    const auto& vertices2 = model.internalModel->vertices;
+    const auto& triangles1 = internalModel->triangles;
+    const auto& triangles2 = model.internalModel->triangles;
+    if(vertices1.size() != vertices2.size() || triangles1.size() != triangles2.size()){
+        return false;
+    }
+    for(size_t i=0; i < vertices1.size(); ++i){
+        const auto& v1 = vertices1[i];
+        const auto& v2 = vertices2[i];
+        if(v1.x != v2.x || v1.y != v2.y || v1.z != v2.z){
+            return false;
+        }
+    }
+    for(size_t i=0; i < triangles1.size(); ++i){
+        if(memcmp(triangles1[i].mVRef, triangles2[i].mVRef, sizeof(triangles1[i].mVRef)) != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+
 ColdetModelInternalModel::ColdetModelInternalModel()
 {
     refCounter = 0;
@@ -45,6 +45,25 @@ public:
 
     void cloneInternalModel();
 
+    /**
+       @brief share the internal model including the tree of bounding boxes with another model
+       @param org the model which has been built
+
+       The vertices and triangles of this model are replaced with the ones of org.
+    */
+    void shareInternalModel(const ColdetModel& org);
+
+    /**
+       @brief get the hash value of the primitive type, the primitive parameters, the vertices and triangles
+       @return the value used to find the models with the same shape
+    */
+    size_t getShapeHash() const;
+
+    /**
+       @brief check if the model has the same primitive, vertices and triangles as another model
+    */
+    bool hasSameShape(const ColdetModel& model) const;
+
     /**
      * @brief set name of this model
      * @param name name of this model 
@@ -7,6 +7,9 @@
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -35,6 +38,12 @@ public:
     std::ostream* os;
     MessageView* mv;
     std::string errorMessage;
+    struct PreloadedData {
+        ReferencedPtr data;
+        int numRemainingUses;
+    };
+    std::unordered_map<std::string, PreloadedData> preloadedDataMap;
+    std::mutex preloadedDataMutex;
 
     // This variable actualy points a instance of the ClassInfo class defined in ItemManager.cpp
     mutable weak_ref_ptr<Referenced> itemClassInfo;
@@ -352,6 +361,53 @@ void ItemFileIO::setActuallyLoadedItem(Item* item)
 }
 
 
+Referenced* ItemFileIO::preload(const std::string& /* filename */)
+{
+    return nullptr;
+}
+
+
+void ItemFileIO::storePreloadedData(const std::string& filename, Referenced* data, int numUses)
+{
+    std::lock_guard<std::mutex> lock(impl->preloadedDataMutex);
+    auto& preloaded = impl->preloadedDataMap[filename];
+    preloaded.data = data;
+    preloaded.numRemainingUses = std::max(1, numUses);
+}
+
+
+void ItemFileIO::clearPreloadedData()
+{
+    std::lock_guard<std::mutex> lock(impl->preloadedDataMutex);
+    impl->preloadedDataMap.clear();
+}
+
+
+/**
+   The data is released when it is taken by the last item of the uses given to storePreloadedData.
+*/
+ReferencedPtr ItemFileIO::takePreloadedData(const std::string& filename, bool* out_isShared)
+{
+    ReferencedPtr data;
+    bool isShared = false;
+    std::lock_guard<std::mutex> lock(impl->preloadedDataMutex);
+    auto p = impl->preloadedDataMap.find(filename);
+    if(p != impl->preloadedDataMap.end()){
+        auto& preloaded = p->second;
+        data = preloaded.data;
+        if(--preloaded.numRemainingUses > 0){
+            isShared = true;
+        } else {
+            impl->preloadedDataMap.erase(p);
+        }
+    }
+    if(out_isShared){
+        *out_isShared = isShared;
+    }
+    return data;
+}
+
+
 bool ItemFileIO::saveItem(Item* item, const std::string& filename, const Mapping* options)
 {
     bool saved = impl->saveItem(item, filename, options);
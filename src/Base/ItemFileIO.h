@@ -26,6 +26,7 @@ public:
         OptionPanelForLoading = 1 << 2,
         Save = 1 << 3,
         OptionPanelForSaving = 1 << 4,
+        Preload = 1 << 5
     };
     enum InterfaceLevel { Standard, Conversion, Internal };
     enum InvocationType { Direct, Dialog, DragAndDrop };
@@ -104,6 +105,20 @@ public:
     virtual QWidget* getOptionPanelForSaving(Item* item);
     virtual void fetchOptionPanelForSaving();
 
+    // Preload API
+    /**
+       This function reads the file in advance of loading it to an item. The function must not
+       access any item, GUI object or option of the file IO because it is executed on a worker thread
+       while the project is being restored. The returned data is stored by the storePreloadedData
+       function and the load function can take it with the takePreloadedData function.
+       Null is returned if the file cannot be preloaded. Then the load function loads the file as usual.
+    */
+    virtual Referenced* preload(const std::string& filename);
+
+    //! \param numUses The number of the items that load the file with the data
+    void storePreloadedData(const std::string& filename, Referenced* data, int numUses = 1);
+    void clearPreloadedData();
+
     Item* parentItem();
     int invocationType() const;
 
@@ -126,6 +141,13 @@ protected:
        the following function must be called with the corresponding item.
     */
     void setActuallyLoadedItem(Item* item);
+
+    /**
+       Null is returned if the file has not been preloaded.
+       \param out_isShared True is set if the data will also be taken by another item.
+       Then the data must be copied before it is used by the item.
+    */
+    ReferencedPtr takePreloadedData(const std::string& filename, bool* out_isShared = nullptr);
     
 private:
     Impl* impl;
@@ -142,6 +142,8 @@ public:
     static vector<ItemFileIO*> getFileIOs(Item* item, function<bool(ItemFileIO* fileIO)> pred, bool includeSuperClassIos);
     static ItemFileIO* findMatchedFileIO(
         const type_info& type, const string& filename, const string& formatId, int ioTypeFlag);
+    static ItemFileIO* findMatchedFileIO(
+        ClassInfo* classInfo, const string& filename, const string& formatId, int ioTypeFlag);
     static void onLoadOrImportItemsActivated(const vector<ItemFileIO*>& fileIOs);
     static void onReloadSelectedItemsActivated();
     static void onSaveSelectedItemsAsActivated();
@@ -923,18 +925,38 @@ ItemFileIO* ItemManager::findFileIO(const std::type_info& type, const std::strin
 ItemFileIO* ItemManager::Impl::findMatchedFileIO
 (const type_info& type, const string& filename, const string& formatId, int ioTypeFlag)
 {
-    ItemFileIO* targetFileIO = nullptr;
-    
     auto p = itemClassIdToInfoMap.find(itemClassRegistry->classId(type));
     if(p == itemClassIdToInfoMap.end()){
         messageView->putln(
             format(_("\"{0}\" cannot be accessed because the specified item type \"{1}\" is not registered."),
                    filename, type.name()),
             MessageView::Error);
-        return targetFileIO;;
+        return nullptr;
     }
     
-    ClassInfoPtr& classInfo = p->second;
+    ItemFileIO* targetFileIO = findMatchedFileIO(p->second, filename, formatId, ioTypeFlag);
+
+    if(!targetFileIO){
+        if(formatId.empty()){
+            messageView->putln(
+                format(_("The file format for accessing \"{0}\" cannot be determined."), filename),
+                MessageView::Error);
+        } else {
+            messageView->putln(
+                format(_("Unknown file format \"{0}\" is specified in accessing \"{1}\"."),
+                       formatId, filename),
+                MessageView::Error);
+        }
+    }
+
+    return targetFileIO;
+}
+
+
+ItemFileIO* ItemManager::Impl::findMatchedFileIO
+(ClassInfo* classInfo, const string& filename, const string& formatId, int ioTypeFlag)
+{
+    ItemFileIO* targetFileIO = nullptr;
     auto& fileIOs = classInfo->fileIOs;
 
     if(!formatId.empty() || filename.empty()){
@@ -967,20 +989,28 @@ ItemFileIO* ItemManager::Impl::findMatchedFileIO
         }
     }
 
-    if(!targetFileIO){
-        if(formatId.empty()){
-            messageView->putln(
-                format(_("The file format for accessing \"{0}\" cannot be determined."), filename),
-                MessageView::Error);
-        } else {
-            messageView->putln(
-                format(_("Unknown file format \"{0}\" is specified in accessing \"{1}\"."),
-                       formatId, filename),
-                MessageView::Error);
+    return targetFileIO;
+}
+
+
+ItemFileIO* ItemManager::findFileIOForLoading
+(const std::string& moduleName, const std::string& itemClassName,
+ const std::string& filename, const std::string& formatId)
+{
+    auto p = moduleNameToItemManagerImplMap.find(moduleName);
+    if(p == moduleNameToItemManagerImplMap.end()){
+        if(auto alias = PluginManager::instance()->guessActualPluginName(moduleName)){
+            p = moduleNameToItemManagerImplMap.find(alias);
         }
     }
-
-    return targetFileIO;
+    if(p != moduleNameToItemManagerImplMap.end()){
+        auto& itemClassNameToInfoMap = p->second->itemClassNameToInfoMap;
+        auto q = itemClassNameToInfoMap.find(itemClassName);
+        if(q != itemClassNameToInfoMap.end()){
+            return Impl::findMatchedFileIO(q->second, filename, formatId, ItemFileIO::Load);
+        }
+    }
+    return nullptr;
 }
 
 
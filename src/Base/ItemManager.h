@@ -181,6 +181,15 @@ public:
 
     static ItemFileIO* findFileIO(const std::type_info& type, const std::string& formatId);
 
+    /**
+       This function returns the file IO used to load the file to the item of the specified class.
+       The file IO is determined by the format ID or by the file extension if the format ID is empty.
+       No message is output if the file IO is not found.
+    */
+    static ItemFileIO* findFileIOForLoading(
+        const std::string& moduleName, const std::string& itemClassName,
+        const std::string& filename, const std::string& formatId);
+
     template <class ItemType>
     ItemManager& addLoader(
         const std::string& caption, const std::string& formatId, const std::string& extensions, 
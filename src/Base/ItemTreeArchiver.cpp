@@ -7,11 +7,15 @@
 #include "RootItem.h"
 #include "SubProjectItem.h"
 #include "ItemManager.h"
+#include "ItemFileIO.h"
 #include "MessageView.h"
 #include "Archive.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/ParallelScheduler>
+#include <cnoid/FilePathVariableProcessor>
 #include <set>
+#include <map>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -30,12 +34,16 @@ public:
     int numArchivedItems;
     int numRestoredItems;
     const std::set<std::string>* pOptionalPlugins;
+    // The value is the number of the items that load the file
+    std::map<std::pair<ItemFileIOPtr, std::string>, int> preloadedFiles;
 
     Impl();
     ArchivePtr store(Archive& parentArchive, Item* item);
     ArchivePtr storeIter(Archive& parentArchive, Item* item, bool& isComplete);
     void storeAddons(Archive& archive, Item* item);
     ItemList<> restore(Archive& archive, Item* parentItem, const std::set<std::string>& optionalPlugins);
+    void preloadFiles(Archive& archive);
+    void collectPreloadableFiles(Archive& archive);
     void restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& restoredItems);
     ItemPtr restoreItem(
         Archive& archive, Item* parentItem, ItemList<>& restoredItems, string& out_itemName, bool& io_isOptional);
@@ -248,17 +256,95 @@ ItemList<> ItemTreeArchiver::Impl::restore
 
     archive.setCurrentParentItem(nullptr);
     try {
+        preloadFiles(archive);
         restoreItemIter(archive, parentItem, restoredItems);
     } catch (const ValueNode::Exception& ex){
         mv->putln(ex.message(), MessageView::Error);
     }
     archive.setCurrentParentItem(nullptr);
 
+    // Release the data which has not been used by the items
+    for(auto& file : preloadedFiles){
+        file.first.first->clearPreloadedData();
+    }
+    preloadedFiles.clear();
+
     numRestoredItems = restoredItems.size();
     return restoredItems;
 }
 
 
+/**
+   The files of the items whose file IOs support the preload API are read on the worker threads
+   before the item tree is restored. The items are then restored in the original order on the
+   main thread with the preloaded data. A file loaded by multiple items is read only once.
+*/
+void ItemTreeArchiver::Impl::preloadFiles(Archive& archive)
+{
+    collectPreloadableFiles(archive);
+
+    int numUses = 0;
+    for(auto& file : preloadedFiles){
+        numUses += file.second;
+    }
+    if(numUses >= 2){
+        mv->putln(format(_("Preloading {0} files in parallel ..."), preloadedFiles.size()));
+        mv->flush();
+
+        ParallelTaskGroup tasks;
+        for(auto& file : preloadedFiles){
+            auto fileIO = file.first.first.get();
+            auto& filename = file.first.second;
+            int numUses = file.second;
+            tasks.run([fileIO, &filename, numUses](){
+                if(auto data = fileIO->preload(filename)){
+                    fileIO->storePreloadedData(filename, data, numUses);
+                }
+            });
+        }
+        tasks.wait();
+    }
+}
+
+
+void ItemTreeArchiver::Impl::collectPreloadableFiles(Archive& archive)
+{
+    string pluginName;
+    string className;
+    if(!archive.get("isSubItem", false) &&
+       archive.read("plugin", pluginName) && archive.read("class", className)){
+
+        auto dataArchive = dynamic_cast<Archive*>(archive.findMapping("data"));
+        if(dataArchive && dataArchive->isValid()){
+            dataArchive->inheritSharedInfoFrom(archive);
+            string filename = dataArchive->readItemFilePath();
+            if(!filename.empty()){
+                // The same expansion as the one applied in loading the item
+                filename = FilePathVariableProcessor::systemInstance()->expand(filename, true);
+            }
+            if(!filename.empty()){
+                string format;
+                dataArchive->read("format", format);
+                auto fileIO = ItemManager::findFileIOForLoading(pluginName, className, filename, format);
+                if(fileIO && fileIO->hasApi(ItemFileIO::Preload)){
+                    ++preloadedFiles[make_pair(fileIO, filename)];
+                }
+            }
+        }
+    }
+
+    ListingPtr children = archive.findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            if(auto childArchive = dynamic_cast<Archive*>(children->at(i)->toMapping())){
+                childArchive->inheritSharedInfoFrom(archive);
+                collectPreloadableFiles(*childArchive);
+            }
+        }
+    }
+}
+
+
 void ItemTreeArchiver::Impl::restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& restoredItems)
 {
     ItemPtr item;
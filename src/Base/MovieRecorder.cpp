@@ -28,7 +28,6 @@
 #include <cnoid/ConnectionSet>
 #include <cnoid/Selection>
 #include <cnoid/UTF8>
-#include <cnoid/stdx/variant>
 #include <cnoid/stdx/filesystem>
 #include <QPainter>
 #include <QDialogButtonBox>
@@ -39,9 +38,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <cstdio>
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
 #ifdef Q_OS_LINUX
 #include <QX11Info>
 #include <X11/extensions/Xfixes.h>
@@ -61,6 +65,16 @@ namespace {
 
 enum RecordinMode { OFFLINE_MODE, ONLINE_MODE, DIRECT_MODE, N_RECORDING_MODES };
 
+enum OutputFormat { PNG_FORMAT, FAST_PNG_FORMAT, JPEG_FORMAT, BMP_FORMAT, ENCODER_PIPE, N_OUTPUT_FORMATS };
+
+/*
+  The raw frames are written to the standard input of the encoder command in the byte order of
+  QImage::Format_RGB32, which is "bgra" on little endian machines.
+*/
+const char* defaultEncoderCommand =
+    "ffmpeg -y -f rawvideo -pix_fmt bgra -s {width}x{height} -r {fps} -i - "
+    "-c:v libx264 -pix_fmt yuv420p \"{directory}/{basename}.mp4\"";
+
 MovieRecorder* movieRecorder = nullptr;
 
 class MovieRecorderBar : public ToolBar
@@ -109,6 +123,9 @@ public:
     LineEdit directoryEntry;
     PushButton directoryButton;
     LineEdit basenameEntry;
+    ComboBox outputFormatCombo;
+    SpinBox qualitySpin;
+    LineEdit encoderCommandEntry;
     CheckBox startTimeCheck;
     DoubleSpinBox startTimeSpin;
     CheckBox finishTimeCheck;
@@ -155,6 +172,7 @@ public:
     void updateViewCombo();
     void onTargetViewIndexChanged(int index);
     void onRecordingModeRadioClicked(int mode);
+    void onOutputFormatComboChanged(int index);
     void showDirectorySelectionDialog();
     bool store(Mapping& archive);
     void restore(const Mapping& archive);
@@ -208,21 +226,41 @@ public:
     
     Timer flashTimer;
 
-    typedef stdx::variant<QPixmap, QImage> ImageVariant;
+    Selection outputFormat;
 
     class CapturedImage : public Referenced {
     public:
-        ImageVariant image;
+        QImage image;
         int frame;
     };
     typedef ref_ptr<CapturedImage> CapturedImagePtr;
 
+    /*
+      The captured images are encoded by the dedicated image output threads, or written to the
+      pipe of the encoder process by a thread in the order of the frames. The encoding does not
+      use ParallelScheduler so that a waiting parallel task group of the simulation never runs it.
+      The capture waits while the number of the images in the queue and in the output reaches
+      maxNumPendingImages so that the memory usage does not grow when the capture is faster than
+      the output.
+    */
     deque<CapturedImagePtr> capturedImages;
+    int numImagesInOutput;
+    int maxNumPendingImages;
+    bool isImageOutputActive;
+    bool isImageOutputFailed;
     vector<quint32> tmpImageBuf;
-    std::thread imageOutputThread;
+    int numImageOutputThreads;
+    vector<std::thread> imageOutputThreads;
+    std::thread pipeOutputThread;
     std::mutex imageQueueMutex;
     std::condition_variable imageQueueCondition;
     string filenameFormat;
+    const char* imageFileFormat;
+    int imageQuality;
+    string encoderCommand;
+    string outputDirectory;
+    string outputBasename;
+    double outputFrameRate;
     
     MovieRecorderImpl(ExtensionManager* ext);
     ~MovieRecorderImpl();
@@ -241,12 +279,17 @@ public:
     void onPlaybackStopped(bool isStoppedManually);
     void startDirectModeRecording();
     void onDirectModeTimerTimeout();
-    void captureViewImage(bool waitForPrevOutput);
+    void captureViewImage();
     void drawMouseCursorImage(QPainter& painter);
     void captureSceneWidgets(QWidget* widget, QPixmap& pixmap);
     void startImageOutput();
     void outputImages();
+    void outputImagesToPipe();
+    void writeImageToPipe(FILE* pipe, const QImage& image);
+    void notifyImageOutputFailure(const std::string& message);
     void onImageOutputFailed(std::string message);
+    int numPendingImages() const { return capturedImages.size() + numImagesInOutput; }
+    void finishImageOutput();
     void stopRecording(bool isFinished);
     void onViewMarkerToggled(bool on);
     bool showViewMarker();
@@ -287,12 +330,25 @@ MovieRecorder::MovieRecorder(ExtensionManager* ext)
 
 MovieRecorderImpl::MovieRecorderImpl(ExtensionManager* ext)
     : recordingMode(N_RECORDING_MODES, CNOID_GETTEXT_DOMAIN_NAME),
-      mv(MessageView::instance())
+      mv(MessageView::instance()),
+      outputFormat(N_OUTPUT_FORMATS, CNOID_GETTEXT_DOMAIN_NAME)
 
 {
     recordingMode.setSymbol(OFFLINE_MODE, N_("Offline"));
     recordingMode.setSymbol(ONLINE_MODE, N_("Online"));
     recordingMode.setSymbol(DIRECT_MODE, N_("Direct"));
+
+    outputFormat.setSymbol(PNG_FORMAT, N_("PNG"));
+    outputFormat.setSymbol(FAST_PNG_FORMAT, N_("PNG (Fast)"));
+    outputFormat.setSymbol(JPEG_FORMAT, N_("JPEG"));
+    outputFormat.setSymbol(BMP_FORMAT, N_("BMP"));
+    outputFormat.setSymbol(ENCODER_PIPE, N_("Encoder pipe"));
+
+    numImagesInOutput = 0;
+    numImageOutputThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    maxNumPendingImages = std::max(4, numImageOutputThreads * 2);
+    isImageOutputActive = false;
+    isImageOutputFailed = false;
     
     dialog = new ConfigDialog(this);
     toolBar = new MovieRecorderBar(this);
@@ -382,6 +438,32 @@ ConfigDialog::ConfigDialog(MovieRecorderImpl* recorder)
     hbox->addStretch();
     vbox->addLayout(hbox);
 
+    hbox = new QHBoxLayout();
+    hbox->addWidget(new QLabel(_("Output format")));
+    for(int i=0; i < N_OUTPUT_FORMATS; ++i){
+        outputFormatCombo.addItem(recorder->outputFormat.label(i));
+    }
+    outputFormatCombo.sigCurrentIndexChanged().connect(
+        [&](int index){ onOutputFormatComboChanged(index); });
+    hbox->addWidget(&outputFormatCombo);
+    hbox->addSpacing(4);
+    hbox->addWidget(new QLabel(_("Quality")));
+    qualitySpin.setRange(0, 100);
+    qualitySpin.setValue(95);
+    hbox->addWidget(&qualitySpin);
+    hbox->addStretch();
+    vbox->addLayout(hbox);
+
+    hbox = new QHBoxLayout();
+    hbox->addWidget(new QLabel(_("Encoder command")));
+    encoderCommandEntry.setText(defaultEncoderCommand);
+    encoderCommandEntry.setToolTip(
+        _("The command which reads raw frames from the standard input. "
+          "{width}, {height}, {fps}, {directory} and {basename} are replaced with the recording settings."));
+    hbox->addWidget(&encoderCommandEntry);
+    vbox->addLayout(hbox);
+    onOutputFormatComboChanged(outputFormatCombo.currentIndex());
+
     hbox = new QHBoxLayout();
     hbox->addWidget(new QLabel(_("Frame rate")));
     fpsSpin.setDecimals(1);
@@ -475,11 +557,7 @@ MovieRecorder::~MovieRecorder()
 
 MovieRecorderImpl::~MovieRecorderImpl()
 {
-    if(imageOutputThread.joinable()){
-        requestStopRecording = true;
-        imageQueueCondition.notify_all();
-        imageOutputThread.join();
-    }
+    finishImageOutput();
     
     timeBarConnections.disconnect();
     store(*AppConfig::archive()->openMapping("MovieRecorder"));
@@ -640,6 +718,14 @@ void ConfigDialog::onRecordingModeRadioClicked(int mode)
 }
 
 
+void ConfigDialog::onOutputFormatComboChanged(int index)
+{
+    recorder->outputFormat.select(index);
+    qualitySpin.setEnabled(index == JPEG_FORMAT);
+    encoderCommandEntry.setEnabled(index == ENCODER_PIPE);
+}
+
+
 void ConfigDialog::showDirectorySelectionDialog()
 {
     QString directory =
@@ -711,8 +797,33 @@ bool MovieRecorderImpl::setupViewAndFilenameFormat()
         return false;
     }
 
+    const char* extension;
+    switch(outputFormat.which()){
+    case JPEG_FORMAT:
+        imageFileFormat = "JPEG";
+        extension = "jpg";
+        imageQuality = dialog->qualitySpin.value();
+        break;
+    case BMP_FORMAT:
+        imageFileFormat = "BMP";
+        extension = "bmp";
+        imageQuality = -1;
+        break;
+    case FAST_PNG_FORMAT:
+        // This quality corresponds to the zlib compression level 1 in the PNG writer of Qt
+        imageFileFormat = "PNG";
+        extension = "png";
+        imageQuality = 80;
+        break;
+    default:
+        imageFileFormat = "PNG";
+        extension = "png";
+        imageQuality = -1;
+        break;
+    }
+
     filesystem::path directory(fromUTF8(dialog->directoryEntry.string()));
-    filesystem::path basename(fromUTF8(dialog->basenameEntry.string() + "{:08d}.png"));
+    filesystem::path basename(fromUTF8(dialog->basenameEntry.string() + "{:08d}." + extension));
 
     if(directory.empty()){
         showWarningDialog(_("Please set a directory to output image files."));
@@ -730,6 +841,15 @@ bool MovieRecorderImpl::setupViewAndFilenameFormat()
     }
 
     filenameFormat = toUTF8((directory / basename).string());
+    outputDirectory = dialog->directoryEntry.string();
+    outputBasename = dialog->basenameEntry.string();
+    outputFrameRate = dialog->frameRate();
+    encoderCommand = dialog->encoderCommandEntry.string();
+
+    if(outputFormat.is(ENCODER_PIPE) && encoderCommand.empty()){
+        showWarningDialog(_("Please set the encoder command."));
+        return false;
+    }
 
     if(dialog->imageSizeCheck.isChecked()){
         int width = dialog->imageWidthSpin.value();
@@ -769,7 +889,7 @@ bool MovieRecorderImpl::doOfflineModeRecording()
             break;
         }
 
-        captureViewImage(true);
+        captureViewImage();
 
         time += timeStep;
         frame++;
@@ -834,7 +954,7 @@ bool MovieRecorderImpl::onTimeChanged(double time)
             stopRecording(true);
         } else {
             while(time >= nextFrameTime){
-                captureViewImage(false);
+                captureViewImage();
                 ++frame;
                 nextFrameTime += timeStep;
             }
@@ -864,12 +984,12 @@ void MovieRecorderImpl::startDirectModeRecording()
 
 void MovieRecorderImpl::onDirectModeTimerTimeout()
 {
-    captureViewImage(false);
+    captureViewImage();
     ++frame;
 }
 
 
-void MovieRecorderImpl::captureViewImage(bool waitForPrevOutput)
+void MovieRecorderImpl::captureViewImage()
 {
     CapturedImagePtr captured = new CapturedImage();
     captured->frame = frame;
@@ -877,26 +997,28 @@ void MovieRecorderImpl::captureViewImage(bool waitForPrevOutput)
     if(SceneView* sceneView = dynamic_cast<SceneView*>(targetView)){
         captured->image = sceneView->sceneWidget()->getImage();
         if(dialog->mouseCursorCheck.isChecked()){
-            QPainter painter(&stdx::get<QImage>(captured->image));
+            QPainter painter(&captured->image);
             drawMouseCursorImage(painter);
         }
     } else {
-        captured->image = targetView->grab();
-        QPixmap& pixmap = stdx::get<QPixmap>(captured->image);
+        QPixmap pixmap = targetView->grab();
         captureSceneWidgets(targetView, pixmap);
 
         if(dialog->mouseCursorCheck.isChecked()){
             QPainter painter(&pixmap);
             drawMouseCursorImage(painter);
         }
+        // QPixmap can only be used in the GUI thread
+        captured->image = pixmap.toImage();
     }
 
     {
         std::unique_lock<std::mutex> lock(imageQueueMutex);
-        if(waitForPrevOutput){
-            while(!capturedImages.empty()){
-                imageQueueCondition.wait(lock);
-            }
+        while(!isImageOutputFailed && numPendingImages() >= maxNumPendingImages){
+            imageQueueCondition.wait(lock);
+        }
+        if(isImageOutputFailed){
+            return;
         }
         capturedImages.push_back(captured);
     }
@@ -953,9 +1075,19 @@ void MovieRecorderImpl::captureSceneWidgets(QWidget* widget, QPixmap& pixmap)
 
 void MovieRecorderImpl::startImageOutput()
 {
-    if(!imageOutputThread.joinable()){
-        imageOutputThread = std::thread(
-            [&](){ outputImages(); });
+    {
+        std::lock_guard<std::mutex> lock(imageQueueMutex);
+        isImageOutputActive = true;
+        isImageOutputFailed = false;
+    }
+    if(outputFormat.is(ENCODER_PIPE)){
+        if(!pipeOutputThread.joinable()){
+            pipeOutputThread = std::thread([&](){ outputImagesToPipe(); });
+        }
+    } else if(imageOutputThreads.empty()){
+        for(int i=0; i < numImageOutputThreads; ++i){
+            imageOutputThreads.emplace_back([&](){ outputImages(); });
+        }
     }
 }
 
@@ -966,39 +1098,163 @@ void MovieRecorderImpl::outputImages()
         CapturedImagePtr captured;
         {
             std::unique_lock<std::mutex> lock(imageQueueMutex);
-            while(isRecording && capturedImages.empty()){
+            while(isImageOutputActive && capturedImages.empty()){
                 imageQueueCondition.wait(lock);
             }
-            if(capturedImages.empty() && !isRecording){
+            if(capturedImages.empty()){
                 break;
             }
             captured = capturedImages.front();
             capturedImages.pop_front();
+            ++numImagesInOutput;
         }
-        imageQueueCondition.notify_all();
-        
-        bool saved = false;
 
         string filename = format(filenameFormat, captured->frame);
-        
-        if(stdx::get_variant_index(captured->image) == 0){
-            QPixmap& pixmap = stdx::get<QPixmap>(captured->image);
-            saved = pixmap.save(filename.c_str());
-        } else {
-            QImage& image = stdx::get<QImage>(captured->image);
-            saved = image.save(filename.c_str());
-        }
+        bool saved = captured->image.save(filename.c_str(), imageFileFormat, imageQuality);
+        captured.reset();
 
+        {
+            std::lock_guard<std::mutex> lock(imageQueueMutex);
+            --numImagesInOutput;
+        }
         if(!saved){
-            string message = format(_("Saving an image to \"{}\" failed."), filename);
-            callLater([this, message](){ onImageOutputFailed(message); });
-            {
-                std::lock_guard<std::mutex> lock(imageQueueMutex);
-                capturedImages.clear();
+            notifyImageOutputFailure(format(_("Saving an image to \"{}\" failed."), filename));
+        }
+        imageQueueCondition.notify_all();
+    }
+}
+
+
+void MovieRecorderImpl::outputImagesToPipe()
+{
+#ifndef _WIN32
+    // A broken pipe is detected by the error of fwrite instead of terminating the process
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+
+    FILE* pipe = nullptr;
+    QSize frameSize;
+    
+    while(true){
+        CapturedImagePtr captured;
+        {
+            std::unique_lock<std::mutex> lock(imageQueueMutex);
+            while(isImageOutputActive && capturedImages.empty()){
+                imageQueueCondition.wait(lock);
+            }
+            if(capturedImages.empty()){
+                break;
+            }
+            captured = capturedImages.front();
+            capturedImages.pop_front();
+            ++numImagesInOutput;
+        }
+
+        QImage& image = captured->image;
+        string message;
+        if(!pipe){
+            frameSize = image.size();
+            string command;
+            try {
+                command = format(encoderCommand,
+                                 fmt::arg("width", frameSize.width()),
+                                 fmt::arg("height", frameSize.height()),
+                                 fmt::arg("fps", outputFrameRate),
+                                 fmt::arg("directory", outputDirectory),
+                                 fmt::arg("basename", outputBasename));
+            } catch(const fmt::format_error& ex){
+                message = format(_("The encoder command \"{0}\" is invalid: {1}"), encoderCommand, ex.what());
             }
+            if(message.empty()){
+#ifdef _WIN32
+                pipe = _popen(fromUTF8(command).c_str(), "wb");
+#else
+                pipe = popen(fromUTF8(command).c_str(), "w");
+#endif
+                if(!pipe){
+                    message = format(_("The encoder command \"{}\" cannot be executed."), command);
+                }
+            }
+        }
+        if(pipe){
+            // The size of the raw frames must be constant
+            if(image.size() != frameSize){
+                image = image.scaled(frameSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+            writeImageToPipe(pipe, image);
+            if(ferror(pipe)){
+                message = _("Writing an image to the encoder process failed.");
+            }
+        }
+        captured.reset();
+
+        {
+            std::lock_guard<std::mutex> lock(imageQueueMutex);
+            --numImagesInOutput;
+        }
+        if(!message.empty()){
+            notifyImageOutputFailure(message);
             imageQueueCondition.notify_all();
             break;
         }
+        imageQueueCondition.notify_all();
+    }
+
+    if(pipe){
+        // This waits for the encoder process to finish
+#ifdef _WIN32
+        _pclose(pipe);
+#else
+        pclose(pipe);
+#endif
+    }
+}
+
+
+void MovieRecorderImpl::writeImageToPipe(FILE* pipe, const QImage& image)
+{
+    QImage converted;
+    const QImage* frameImage = &image;
+    if(image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32){
+        converted = image.convertToFormat(QImage::Format_RGB32);
+        frameImage = &converted;
+    }
+    const size_t lineSize = frameImage->width() * 4;
+    for(int y=0; y < frameImage->height(); ++y){
+        if(fwrite(frameImage->constScanLine(y), 1, lineSize, pipe) != lineSize){
+            break;
+        }
+    }
+}
+
+
+void MovieRecorderImpl::notifyImageOutputFailure(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(imageQueueMutex);
+    if(!isImageOutputFailed){
+        isImageOutputFailed = true;
+        capturedImages.clear();
+        callLater([this, message](){ onImageOutputFailed(message); });
+    }
+}
+
+
+void MovieRecorderImpl::finishImageOutput()
+{
+    {
+        std::lock_guard<std::mutex> lock(imageQueueMutex);
+        isImageOutputActive = false;
+    }
+    imageQueueCondition.notify_all();
+    for(auto& thread : imageOutputThreads){
+        thread.join();
+    }
+    imageOutputThreads.clear();
+    if(pipeOutputThread.joinable()){
+        pipeOutputThread.join();
     }
 }
 
@@ -1021,7 +1277,7 @@ void MovieRecorderImpl::stopRecording(bool isFinished)
         int numRemainingImages = 0;
         {
             std::lock_guard<std::mutex> lock(imageQueueMutex);
-            numRemainingImages = capturedImages.size();
+            numRemainingImages = numPendingImages();
         }
         if(numRemainingImages > 1){
             QProgressDialog progress(_("Outputting sequential image files..."), _("Abort Output"), 0, numRemainingImages, MainWindow::instance());
@@ -1031,7 +1287,7 @@ void MovieRecorderImpl::stopRecording(bool isFinished)
                 int index;
                 {
                     std::lock_guard<std::mutex> lock(imageQueueMutex);
-                    index = numRemainingImages - capturedImages.size();
+                    index = numRemainingImages - numPendingImages();
                 }
                 progress.setValue(index);
 
@@ -1050,8 +1306,7 @@ void MovieRecorderImpl::stopRecording(bool isFinished)
 
         isRecording = false;
         requestStopRecording = true;
-        imageQueueCondition.notify_all();
-        imageOutputThread.join();
+        finishImageOutput();
 
         if(isFinished){
             mv->putln(format(_("Recording of {} has been finished."), targetView->name()));
@@ -1175,6 +1430,7 @@ bool MovieRecorderImpl::store(Mapping& archive)
         archive.write("target", targetView->name());
     }
     archive.write("recordingMode", recordingMode.selectedSymbol());
+    archive.write("outputFormat", outputFormat.selectedSymbol());
     return dialog->store(archive);
 }
 
@@ -1184,6 +1440,8 @@ bool ConfigDialog::store(Mapping& archive)
     archive.write("showViewMarker", viewMarkerCheck.isChecked());
     archive.write("directory", directoryEntry.string());
     archive.write("basename", basenameEntry.string());
+    archive.write("quality", qualitySpin.value());
+    archive.write("encoderCommand", encoderCommandEntry.string());
     archive.write("checkStartTime", startTimeCheck.isChecked());
     archive.write("startTime", startTimeSpin.value());
     archive.write("checkFinishTime", finishTimeCheck.isChecked());
@@ -1206,6 +1464,11 @@ void MovieRecorderImpl::restore(const Mapping& archive)
     if(archive.read("recordingMode", symbol)){
         setRecordingMode(symbol);
     }
+    if(archive.read("outputFormat", symbol)){
+        if(outputFormat.select(symbol)){
+            dialog->outputFormatCombo.setCurrentIndex(outputFormat.which());
+        }
+    }
     dialog->restore(archive);
 }
 
@@ -1215,6 +1478,8 @@ void ConfigDialog::restore(const Mapping& archive)
     viewMarkerCheck.setChecked(archive.get("showViewMarker", viewMarkerCheck.isChecked()));
     directoryEntry.setText(archive.get("directory", directoryEntry.string()));
     basenameEntry.setText(archive.get("basename", basenameEntry.string()));
+    qualitySpin.setValue(archive.get("quality", qualitySpin.value()));
+    encoderCommandEntry.setText(archive.get("encoderCommand", encoderCommandEntry.string()));
     startTimeCheck.setChecked(archive.get("checkStartTime", startTimeCheck.isChecked()));
     startTimeSpin.setValue(archive.get("startTime", startTimeSpin.value()));
     finishTimeCheck.setChecked(archive.get("checkFinishTime", finishTimeCheck.isChecked()));
@@ -8,6 +8,7 @@
 #include <QBoxLayout>
 #include <QLabel>
 #include <fmt/format.h>
+#include <sstream>
 #include "gettext.h"
 
 using namespace std;
@@ -19,6 +20,14 @@ namespace {
 enum LengthUnit { Meter, Millimeter, Inch, NumLengthUnitIds };
 enum UpperAxis { Z_Upper, Y_Upper, NumUpperAxisIds };
 
+class PreloadedScene : public Referenced
+{
+public:
+    SgNodePtr scene;
+    bool isSupported;
+    string messages;
+};
+
 }
 
 namespace cnoid {
@@ -65,7 +74,7 @@ SceneItemFileIO::SceneItemFileIO(int api)
 
 
 SceneItemFileIO::SceneItemFileIO()
-    : SceneItemFileIO(Load | Options | OptionPanelForLoading)
+    : SceneItemFileIO(Load | Options | OptionPanelForLoading | Preload)
 {
 
 }
@@ -111,6 +120,23 @@ SgNode* SceneItemFileIO::loadScene(const std::string& filename)
 }
 
 
+/**
+   The scene is loaded without the length unit and upper axis options, which are applied
+   by the loadScene function.
+*/
+Referenced* SceneItemFileIO::preload(const std::string& filename)
+{
+    auto preloaded = new PreloadedScene;
+    preloaded->isSupported = false;
+    ostringstream os;
+    SceneLoader sceneLoader;
+    sceneLoader.setMessageSink(os);
+    preloaded->scene = sceneLoader.load(filename, preloaded->isSupported);
+    preloaded->messages = os.str();
+    return preloaded;
+}
+
+
 SgNode* SceneItemFileIO::Impl::loadScene(SceneItemFileIO* self, const std::string& filename)
 {
     if(!sceneLoader){
@@ -119,7 +145,14 @@ SgNode* SceneItemFileIO::Impl::loadScene(SceneItemFileIO* self, const std::strin
     }
 
     bool isSupported;
-    SgNode* scene = sceneLoader->load(filename, isSupported);
+    SgNodePtr scene;
+    if(auto preloaded = dynamic_pointer_cast<PreloadedScene>(self->takePreloadedData(filename))){
+        self->os() << preloaded->messages;
+        scene = preloaded->scene;
+        isSupported = preloaded->isSupported;
+    } else {
+        scene = sceneLoader->load(filename, isSupported);
+    }
 
     if(!scene){
         if(!isSupported){
@@ -129,7 +162,7 @@ SgNode* SceneItemFileIO::Impl::loadScene(SceneItemFileIO* self, const std::strin
         return nullptr;
     }
 
-    SgNodePtr topNode = scene;
+    SgNodePtr topNode = scene.retn();
     /**
        \note Modifying the vertex positions might be better than
        inserting the transform nodes.
@@ -17,6 +17,8 @@ public:
 
 protected:
     SgNode* loadScene(const std::string& filename);
+
+    virtual Referenced* preload(const std::string& filename) override;
     
     virtual void resetOptions() override;
     virtual void storeOptions(Mapping* archive) override;
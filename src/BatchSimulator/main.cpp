@@ -0,0 +1,182 @@
+/*
+  This file is part of Choreonoid, an extensible graphical robotics application suite.
+  Copyright (c) 2019-2020 Choreonoid Inc.
+  Released under the MIT license. See 'LICENSE' for more information.
+*/
+
+#include <cnoid/BatchSimulator>
+#include <cnoid/ParallelScheduler>
+#include <cnoid/YAMLReader>
+#include <cnoid/ValueTree>
+#include <fmt/format.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+void putUsage()
+{
+    cout <<
+        "Usage: choreonoid-batch-simulator [options] <project file (.cnoid) | body files>\n"
+        "Options:\n"
+        "  --simulator <name>  The name of the AIST simulator item in the project\n"
+        "  --runs <file>       YAML file of the list of the parameter mappings of the runs.\n"
+        "                      The \"log\" key of each mapping gives the log file of the run.\n"
+        "  --log <pattern>     Log file pattern of the runs. \"{}\" is replaced with the run index.\n"
+        "                      Otherwise the index is inserted before the extension for multiple runs.\n"
+        "  --time <seconds>    Time length of the simulation. This overrides the time range of\n"
+        "                      the project, and it is required when no project is given.\n"
+        "  --timestep <sec>    Time step of the simulation\n"
+        "  --repeat <n>        Number of the runs when no runs file is given\n"
+        "  --threads <n>       Maximum number of the threads\n"
+        "  --help              Show this message\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    string simulatorName;
+    string runsFile;
+    string logPattern;
+    double timeLength = -1.0;
+    double timeStep = -1.0;
+    int numRepeats = 1;
+    int numThreads = 0;
+
+    for(int i=1; i < argc; ++i){
+        string arg(argv[i]);
+        auto getValue = [&]() -> string {
+            if(i + 1 >= argc){
+                cerr << format("Option {} requires a value.", arg) << endl;
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if(arg == "--help" || arg == "-h"){
+            putUsage();
+            return 0;
+        } else if(arg == "--simulator"){
+            simulatorName = getValue();
+        } else if(arg == "--runs"){
+            runsFile = getValue();
+        } else if(arg == "--log"){
+            logPattern = getValue();
+        } else if(arg == "--time"){
+            timeLength = std::stod(getValue());
+        } else if(arg == "--timestep"){
+            timeStep = std::stod(getValue());
+        } else if(arg == "--repeat"){
+            numRepeats = std::max(1, std::stoi(getValue()));
+        } else if(arg == "--threads"){
+            numThreads = std::stoi(getValue());
+        } else if(!arg.empty() && arg[0] == '-'){
+            cerr << format("Unknown option {}.", arg) << endl;
+            putUsage();
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if(files.empty()){
+        putUsage();
+        return 1;
+    }
+
+    if(numThreads > 0){
+        ParallelScheduler::setMaxNumThreads(numThreads);
+    }
+
+    BatchSimulator simulator;
+
+    bool isProjectLoaded = false;
+    for(auto& file : files){
+        auto dot = file.rfind('.');
+        if(dot != string::npos && file.substr(dot) == ".cnoid"){
+            if(!simulator.loadProject(file, simulatorName)){
+                return 1;
+            }
+            isProjectLoaded = true;
+        } else if(!simulator.addBody(file)){
+            return 1;
+        }
+    }
+
+    if(!isProjectLoaded && timeLength < 0.0){
+        cerr << "The time length must be given by --time when no project is given." << endl;
+        return 1;
+    }
+
+    auto parameters = simulator.parameters();
+    if(timeLength >= 0.0){
+        parameters->write("timeLength", timeLength);
+        parameters->write("timeRangeMode", "Specified time");
+    }
+    if(timeStep > 0.0){
+        parameters->write("timeStep", timeStep);
+    }
+
+    auto getLogFile = [&](int index){
+        if(logPattern.empty()){
+            return string();
+        }
+        string filename = logPattern;
+        auto pos = filename.find("{}");
+        if(pos != string::npos){
+            return filename.replace(pos, 2, std::to_string(index));
+        }
+        if(numRepeats > 1 || !runsFile.empty()){
+            // The index is inserted before the extension
+            auto dot = filename.rfind('.');
+            if(dot == string::npos || filename.find_first_of("/\\", dot) != string::npos){
+                dot = filename.size();
+            }
+            filename.insert(dot, format("-{}", index));
+        }
+        return filename;
+    };
+
+    if(runsFile.empty()){
+        for(int i=0; i < numRepeats; ++i){
+            simulator.addRun(nullptr, getLogFile(i));
+        }
+    } else {
+        YAMLReader reader;
+        try {
+            auto runs = reader.loadDocument(runsFile)->toListing();
+            for(int i=0; i < runs->size(); ++i){
+                auto run = runs->at(i)->toMapping();
+                string logFile;
+                if(!run->read("log", logFile)){
+                    logFile = getLogFile(i);
+                }
+                simulator.addRun(run, logFile);
+            }
+        } catch(const ValueNode::Exception& ex){
+            cerr << ex.message() << endl;
+            return 1;
+        }
+    }
+
+    bool result = simulator.run();
+
+    double totalSimulationTime = 0.0;
+    double totalComputationTime = 0.0;
+    for(int i=0; i < simulator.numRuns(); ++i){
+        auto& r = simulator.result(i);
+        totalSimulationTime += r.simulationTime;
+        totalComputationTime += r.computationTime;
+    }
+    cout << format("{0} runs, {1:.3f} [s] simulated in {2:.3f} [s] of the total computation time.",
+                   simulator.numRuns(), totalSimulationTime, totalComputationTime) << endl;
+
+    return result ? 0 : 1;
+}
@@ -50,6 +50,8 @@ typedef BasicSensorSimulationHelperImpl Impl;
 BasicSensorSimulationHelper::BasicSensorSimulationHelper()
 {
     isActive_ = false;
+    isStateChangeNotificationDeferred = false;
+    hasPendingStateChanges = false;
     impl = new BasicSensorSimulationHelperImpl(this);
 }
 
@@ -163,11 +165,15 @@ void Impl::initialize(Body* body, double timeStep, const Vector3& gravityAcceler
 
 void BasicSensorSimulationHelper::updateGyroAndAccelerationSensors()
 {
+    hasPendingStateChanges = isStateChangeNotificationDeferred;
+
     for(size_t i=0; i < rateGyroSensors_.size(); ++i){
         RateGyroSensor* gyro = rateGyroSensors_[i];
         const Link* link = gyro->link();
         gyro->w() = gyro->R_local().transpose() * link->R().transpose() * link->w();
-        gyro->notifyStateChange();
+        if(!isStateChangeNotificationDeferred){
+            gyro->notifyStateChange();
+        }
     }
 
     if(!impl->isOldAccelSensorCalcMode){
@@ -175,7 +181,9 @@ void BasicSensorSimulationHelper::updateGyroAndAccelerationSensors()
             AccelerationSensor* sensor = accelerationSensors_[i];
             const Link* link = sensor->link();
             sensor->dv() = sensor->R_local().transpose() * link->R().transpose() * (link->dv() - impl->g);
-            sensor->notifyStateChange();
+            if(!isStateChangeNotificationDeferred){
+                sensor->notifyStateChange();
+            }
         }
 
     } else if(!accelerationSensors_.empty()){
@@ -198,7 +206,24 @@ void BasicSensorSimulationHelper::updateGyroAndAccelerationSensors()
             o_Agsens -= impl->g;
             
             sensor->dv() = sensor->R_local().transpose() * link->R().transpose() * o_Agsens;
-            sensor->notifyStateChange();
+            if(!isStateChangeNotificationDeferred){
+                sensor->notifyStateChange();
+            }
         }
     }
 }
+
+
+void BasicSensorSimulationHelper::notifyStateChanges()
+{
+    if(!hasPendingStateChanges){
+        return;
+    }
+    hasPendingStateChanges = false;
+    for(auto& gyro : rateGyroSensors_){
+        gyro->notifyStateChange();
+    }
+    for(auto& sensor : accelerationSensors_){
+        sensor->notifyStateChange();
+    }
+}
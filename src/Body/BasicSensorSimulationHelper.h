@@ -36,9 +36,18 @@ public:
         
     void updateGyroAndAccelerationSensors();
 
+    /**
+       When this is enabled, updateGyroAndAccelerationSensors does not notify the state changes
+       of the sensors, and notifyStateChanges must be called to notify the updated sensors later.
+    */
+    void setStateChangeNotificationDeferred(bool on) { isStateChangeNotificationDeferred = on; }
+    void notifyStateChanges();
+
 private:
     BasicSensorSimulationHelperImpl* impl;
     bool isActive_;
+    bool isStateChangeNotificationDeferred;
+    bool hasPendingStateChanges;
     DeviceList<ForceSensor> forceSensors_;
     DeviceList<RateGyroSensor> rateGyroSensors_;
     DeviceList<AccelerationSensor> accelerationSensors_;
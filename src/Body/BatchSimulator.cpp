@@ -0,0 +1,1402 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "BatchSimulator.h"
+#include "DyWorld.h"
+#include "ConstraintForceSolver.h"
+#include "BodyLoader.h"
+#include "MaterialTable.h"
+#include "SimpleController.h"
+#include "SimpleControllerIOTransfer.h"
+#include "SimulationStepSequence.h"
+#include "WorldLogFileWriter.h"
+#include "RaycastVisionSimulator.h"
+#include "RangeSensor.h"
+#include "Camera.h"
+#include <cnoid/YAMLReader>
+#include <cnoid/EigenArchive>
+#include <cnoid/FilePathVariableProcessor>
+#include <cnoid/ExecutablePath>
+#include <cnoid/ParallelScheduler>
+#include <cnoid/CloneMap>
+#include <cnoid/UTF8>
+#include <cnoid/ConnectionSet>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <unordered_map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <chrono>
+#include <iostream>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <dlfcn.h>
+#endif
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
+
+#ifdef _WIN32
+typedef HINSTANCE DllHandle;
+DllHandle loadDll(const char* filename) { return LoadLibrary(filename); }
+void* resolveDllSymbol(DllHandle handle, const char* symbol) { return GetProcAddress(handle, symbol); }
+#else
+typedef void* DllHandle;
+DllHandle loadDll(const char* filename) { return dlopen(filename, RTLD_LAZY); }
+void* resolveDllSymbol(DllHandle handle, const char* symbol) { return dlsym(handle, symbol); }
+#endif
+
+struct ControllerSpec
+{
+    string name;
+    string moduleFile;
+    string optionString;
+    bool isNoDelayMode;
+    SimpleController::Factory factory;
+};
+
+struct BodySpec
+{
+    BodyPtr body;
+    bool isCollisionDetectionEnabled;
+    bool isSelfCollisionDetectionEnabled;
+    vector<ControllerSpec> controllers;
+};
+
+//! The simulation world shared by the runs
+struct WorldSpec
+{
+    vector<BodySpec> bodySpecs;
+    MaterialTablePtr materialTable;
+    // The data of RaycastVisionSimulatorItem, which is null if the item is not used
+    MappingPtr visionSimulatorParameters;
+    // The time bar settings of the project, which are used in the "Time bar range" mode
+    double timeBarMaxTime;
+    double timeBarFrameRate;
+    mutex setupMutex;
+};
+
+class SimulationRun;
+
+/**
+   This class provides a simple controller with the interface to the simulation body in the same
+   way as SimpleControllerItem. The controller accesses the I/O body that is a copy of the
+   simulation body, and the enabled states are transferred by the input and output functions.
+*/
+class ControllerHost : public SimulationSimpleControllerIO, public SimulationStepSequence::Controller
+{
+public:
+    SimulationRun* run;
+    const ControllerSpec& spec;
+    Body* simulationBody;
+    BodyPtr ioBody;
+    SimpleController* controller;
+    bool isNoDelayMode_;
+    SimpleControllerIOTransfer ioTransfer;
+    vector<bool> inputEnabledDeviceFlag;
+    vector<bool> inputDeviceStateChangeFlag;
+    vector<bool> outputDeviceStateChangeFlag;
+    ScopedConnectionSet inputDeviceStateConnections;
+    ScopedConnectionSet outputDeviceStateConnections;
+
+    ControllerHost(SimulationRun* run, const ControllerSpec& spec, Body* simulationBody);
+    ~ControllerHost();
+    bool initialize();
+
+    // virtual functions of SimulationStepSequence::Controller
+    virtual void input() override;
+    virtual bool control() override;
+    virtual void output() override;
+
+    virtual std::string controllerName() const override;
+    virtual Body* body() override;
+    virtual std::string optionString() const override;
+    virtual std::ostream& os() const override;
+    virtual double timeStep() const override;
+    virtual double currentTime() const override;
+    virtual bool isNoDelayMode() const override;
+    virtual bool setNoDelayMode(bool on) override;
+    virtual bool isImmediateMode() const override;
+    virtual void setImmediateMode(bool on) override;
+    virtual void enableIO(Link* link) override;
+    virtual void enableInput(Link* link) override;
+    virtual void enableInput(Link* link, int stateFlags) override;
+    virtual void enableOutput(Link* link) override;
+    virtual void enableOutput(Link* link, int stateFlags) override;
+    virtual void enableInput(Device* device) override;
+};
+
+typedef unique_ptr<ControllerHost> ControllerHostPtr;
+
+
+struct SimBody
+{
+    DyBodyPtr body;
+    bool isDynamic;
+    vector<ControllerHostPtr> controllers;
+    vector<SE3> linkPositions;
+    vector<double> jointPositions;
+    vector<DeviceStatePtr> deviceStates;
+    vector<bool> deviceStateChangeFlag;
+    ScopedConnectionSet deviceStateConnections;
+};
+
+
+class SimulationRun
+{
+public:
+    WorldSpec* worldSpec;
+    MappingPtr parameters;
+    string logFile;
+    BatchSimulator::Result result;
+    ostringstream os;
+
+    DyWorld<ConstraintForceSolver> world;
+    vector<unique_ptr<SimBody>> simBodies;
+    vector<SimBody*> recordedSimBodies;
+    vector<ControllerHost*> controllers;
+    SimulationStepSequence stepSequence;
+    double timeStep;
+    int maxFrame;
+    bool doStopWhenNoActiveControllers;
+    bool isAllLinkPositionOutputMode;
+    bool isDeviceStateOutputEnabled;
+    string controllerOptionString;
+    unique_ptr<RaycastVisionSimulator> visionSimulator;
+    WorldLogFileWriter logWriter;
+    int nextLogFrame;
+    double nextLogTime;
+    double logTimeStep;
+
+    SimulationRun(WorldSpec* worldSpec, MappingPtr parameters, const string& logFile);
+    void initializeTimeRange();
+    bool isTimeRangeUnlimited() const;
+    bool initialize();
+    void applyParameters(const Mapping& param);
+    bool addBody(const BodySpec& spec, const Mapping* bodyParameters);
+    void initializeVisionSimulator();
+    void initializeRecording();
+    void initializeStepSequence();
+    void execute();
+    void outputLogFrame(double time);
+};
+
+}
+
+namespace cnoid {
+
+class BatchSimulator::Impl : public WorldSpec
+{
+public:
+    MappingPtr parameters;
+    vector<unique_ptr<SimulationRun>> runs;
+    int maxNumConcurrentRuns;
+    unordered_map<string, DllHandle> controllerModules;
+    ostream* os;
+    mutex messageMutex;
+
+    Impl();
+    BodySpec* findBodySpec(Body* body);
+    bool loadProject(const string& filename, const string& simulatorName);
+    bool loadProjectItems(
+        Mapping* item, bool isInWorld, const string& simulatorName,
+        FilePathVariableProcessor* pathProcessor, bool& io_isSimulatorFound);
+    bool loadBodyItem(Mapping* item, FilePathVariableProcessor* pathProcessor);
+    void findVisionSimulatorItem(Mapping* simulatorItem);
+    Body* addBody(const string& filename);
+    bool addSimpleController(
+        BodySpec& spec, const string& name, const string& module, const string& options, bool isNoDelayMode);
+    SimpleController::Factory loadControllerFactory(const string& moduleFile);
+    bool setMaterialTableFile(const string& filename);
+    bool run();
+    void putMessage(const string& message);
+};
+
+}
+
+
+BatchSimulator::BatchSimulator()
+{
+    impl = new Impl;
+}
+
+
+BatchSimulator::Impl::Impl()
+{
+    parameters = new Mapping;
+    timeBarMaxTime = -1.0;
+    timeBarFrameRate = 0.0;
+    maxNumConcurrentRuns = 0;
+    os = &cout;
+}
+
+
+BatchSimulator::~BatchSimulator()
+{
+    delete impl;
+}
+
+
+void BatchSimulator::setMessageSink(std::ostream& os)
+{
+    impl->os = &os;
+}
+
+
+void BatchSimulator::Impl::putMessage(const string& message)
+{
+    std::lock_guard<std::mutex> lock(messageMutex);
+    (*os) << message;
+    os->flush();
+}
+
+
+void BatchSimulator::clearWorld()
+{
+    impl->bodySpecs.clear();
+    impl->materialTable.reset();
+    impl->visionSimulatorParameters.reset();
+    impl->timeBarMaxTime = -1.0;
+    impl->timeBarFrameRate = 0.0;
+    impl->parameters = new Mapping;
+    impl->runs.clear();
+}
+
+
+bool BatchSimulator::loadProject(const std::string& filename, const std::string& simulatorName)
+{
+    return impl->loadProject(filename, simulatorName);
+}
+
+
+bool BatchSimulator::Impl::loadProject(const string& filename, const string& simulatorName)
+{
+    YAMLReader reader;
+    Mapping* items = nullptr;
+    try {
+        if(reader.load(filename)){
+            if(auto topNode = reader.document()){
+                if(topNode->isMapping()){
+                    auto project = topNode->toMapping();
+                    items = project->findMapping("items");
+                    auto toolBars = project->findMapping("toolbars");
+                    if(toolBars->isValid()){
+                        auto timeBar = toolBars->findMapping("TimeBar");
+                        if(timeBar->isValid()){
+                            timeBar->read("maxTime", timeBarMaxTime);
+                            timeBar->read("frameRate", timeBarFrameRate);
+                        }
+                    }
+                }
+            }
+        }
+    } catch(const ValueNode::Exception& ex){
+        (*os) << ex.message() << endl;
+        return false;
+    }
+    if(!items || !items->isValid()){
+        (*os) << format(_("\"{}\" is not a valid project file."), filename) << endl;
+        return false;
+    }
+
+    FilePathVariableProcessorPtr pathProcessor = new FilePathVariableProcessor;
+    pathProcessor->setSystemVariablesEnabled(true);
+    auto projectDir = toUTF8(filesystem::absolute(fromUTF8(filename)).parent_path().string());
+    pathProcessor->setBaseDirectory(projectDir);
+    pathProcessor->setProjectDirectory(projectDir);
+
+    bool isSimulatorFound = false;
+    bool result;
+    try {
+        result = loadProjectItems(items, false, simulatorName, pathProcessor, isSimulatorFound);
+    } catch(const ValueNode::Exception& ex){
+        (*os) << ex.message() << endl;
+        result = false;
+    }
+    if(result && !isSimulatorFound){
+        if(simulatorName.empty()){
+            (*os) << format(_("AISTSimulatorItem is not found in \"{}\". The default parameters are used."),
+                            filename) << endl;
+        } else {
+            (*os) << format(_("Simulator item \"{0}\" is not found in \"{1}\"."), simulatorName, filename) << endl;
+            result = false;
+        }
+    }
+    return result;
+}
+
+
+bool BatchSimulator::Impl::loadProjectItems
+(Mapping* item, bool isInWorld, const string& simulatorName,
+ FilePathVariableProcessor* pathProcessor, bool& io_isSimulatorFound)
+{
+    string className = item->get("class", "");
+    string name = item->get("name", "");
+    auto data = item->findMapping("data");
+
+    if(className == "WorldItem"){
+        if(isInWorld){
+            return true; // nested worlds are not supported
+        }
+        isInWorld = true;
+        string materialTableFile;
+        if(data->isValid() && data->read("materialTableFile", materialTableFile)){
+            if(!setMaterialTableFile(pathProcessor->expand(materialTableFile, true))){
+                return false;
+            }
+        }
+    } else if(isInWorld){
+        if(className == "BodyItem"){
+            return loadBodyItem(item, pathProcessor);
+
+        } else if(className == "AISTSimulatorItem" && !io_isSimulatorFound){
+            if(simulatorName.empty() || name == simulatorName){
+                if(data->isValid()){
+                    parameters->insert(data);
+                }
+                io_isSimulatorFound = true;
+                findVisionSimulatorItem(item);
+            }
+        }
+    }
+
+    auto children = item->findListing("children");
+    for(int i=0; i < children->size(); ++i){
+        auto child = children->at(i);
+        if(child->isMapping()){
+            if(!loadProjectItems(child->toMapping(), isInWorld, simulatorName, pathProcessor, io_isSimulatorFound)){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+//! The range sensors are simulated by ray casting if the simulator item has RaycastVisionSimulatorItem.
+void BatchSimulator::Impl::findVisionSimulatorItem(Mapping* simulatorItem)
+{
+    auto children = simulatorItem->findListing("children");
+    for(int i=0; i < children->size(); ++i){
+        auto child = children->at(i);
+        if(child->isMapping() && child->toMapping()->get("class", "") == "RaycastVisionSimulatorItem"){
+            auto data = child->toMapping()->findMapping("data");
+            visionSimulatorParameters = data->isValid() ? data : new Mapping;
+            break;
+        }
+    }
+}
+
+
+bool BatchSimulator::Impl::loadBodyItem(Mapping* item, FilePathVariableProcessor* pathProcessor)
+{
+    auto data = item->findMapping("data");
+    if(!data->isValid()){
+        return true;
+    }
+    string file;
+    if(!data->read("file", file) && !data->read("filename", file)){
+        data->read("modelFile", file);
+    }
+    if(file.empty()){
+        return true;
+    }
+    Body* body = addBody(pathProcessor->expand(file, true));
+    if(!body){
+        return false;
+    }
+    string name;
+    if(item->read("name", name)){
+        body->setName(name);
+    }
+    auto& spec = bodySpecs.back();
+
+    // The simulation is started from the initial state of the body item
+    Vector3 p;
+    Matrix3 R;
+    if(read(data, "initialRootPosition", p) || read(data, "rootPosition", p)){
+        body->rootLink()->p() = p;
+    }
+    if(read(data, "initialRootAttitude", R) || read(data, "rootAttitude", R)){
+        body->rootLink()->R() = R;
+    }
+    const int nj = body->numAllJoints();
+    Listing* qs = data->findListing("initialJointDisplacements");
+    if(!qs->isValid()){
+        qs = data->findListing("jointDisplacements");
+    }
+    if(qs->isValid()){
+        for(int i=0; i < std::min(qs->size(), nj); ++i){
+            body->joint(i)->q() = radian(qs->at(i)->toDouble());
+        }
+    } else {
+        qs = data->findListing("initialJointPositions");
+        if(!qs->isValid()){
+            qs = data->findListing("jointPositions");
+        }
+        for(int i=0; i < std::min(qs->size(), nj); ++i){
+            body->joint(i)->q() = qs->at(i)->toDouble();
+        }
+    }
+    body->calcForwardKinematics();
+
+    data->read("collisionDetection", spec.isCollisionDetectionEnabled);
+    data->read("selfCollisionDetection", spec.isSelfCollisionDetectionEnabled);
+
+    auto children = item->findListing("children");
+    for(int i=0; i < children->size(); ++i){
+        auto child = children->at(i);
+        if(!child->isMapping()){
+            continue;
+        }
+        auto childItem = child->toMapping();
+        if(childItem->get("class", "") != "SimpleControllerItem"){
+            continue;
+        }
+        auto childData = childItem->findMapping("data");
+        string module;
+        if(!childData->isValid() || !childData->read("controller", module)){
+            continue;
+        }
+        module = pathProcessor->expand(module, false);
+        filesystem::path modulePath(fromUTF8(module));
+        if(!modulePath.is_absolute() &&
+           childData->get("baseDirectory", "Controller directory") == "Project directory"){
+            modulePath = pathProcessor->baseDirPath() / modulePath;
+        }
+        if(!addSimpleController(
+               spec, childItem->get("name", ""), toUTF8(modulePath.string()),
+               childData->get("controllerOptions", ""), childData->get("isNoDelayMode", false))){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+Body* BatchSimulator::addBody(const std::string& filename)
+{
+    return impl->addBody(filename);
+}
+
+
+Body* BatchSimulator::Impl::addBody(const string& filename)
+{
+    BodyLoader loader;
+    loader.setMessageSink(*os);
+    // The meshes are never modified in the batch runs
+    loader.setMeshSharingEnabled(true);
+    BodyPtr body = loader.load(filename);
+    if(!body){
+        (*os) << format(_("Body file \"{}\" cannot be loaded."), filename) << endl;
+        return nullptr;
+    }
+    if(!body->isStaticModel() && body->mass() <= 0.0){
+        (*os) << format(_("The mass of {0} is {1}, which cannot be simulated."), body->name(), body->mass()) << endl;
+        return nullptr;
+    }
+    BodySpec spec;
+    spec.body = body;
+    spec.isCollisionDetectionEnabled = true;
+    spec.isSelfCollisionDetectionEnabled = false;
+    bodySpecs.push_back(spec);
+    return body;
+}
+
+
+BodySpec* BatchSimulator::Impl::findBodySpec(Body* body)
+{
+    for(auto& spec : bodySpecs){
+        if(spec.body == body){
+            return &spec;
+        }
+    }
+    return nullptr;
+}
+
+
+bool BatchSimulator::addSimpleController(Body* body, const std::string& module, const std::string& options)
+{
+    if(auto spec = impl->findBodySpec(body)){
+        auto name = toUTF8(filesystem::path(fromUTF8(module)).stem().string());
+        return impl->addSimpleController(*spec, name, module, options, false);
+    }
+    return false;
+}
+
+
+bool BatchSimulator::Impl::addSimpleController
+(BodySpec& spec, const string& name, const string& module, const string& options, bool isNoDelayMode)
+{
+    filesystem::path modulePath(fromUTF8(module));
+    if(!modulePath.is_absolute()){
+        modulePath = pluginDirPath() / "simplecontroller" / modulePath;
+    }
+    if(!modulePath.has_extension()){
+#ifdef _WIN32
+        modulePath += ".dll";
+#else
+        modulePath += ".so";
+#endif
+    }
+    ControllerSpec controller;
+    controller.name = name;
+    controller.moduleFile = toUTF8(modulePath.make_preferred().string());
+    controller.optionString = options;
+    controller.isNoDelayMode = isNoDelayMode;
+    controller.factory = loadControllerFactory(controller.moduleFile);
+    if(!controller.factory){
+        return false;
+    }
+    spec.controllers.push_back(controller);
+    return true;
+}
+
+
+/**
+   The controller modules are not unloaded until the process exits because the objects
+   created in the module may be alive in the results of the runs.
+*/
+SimpleController::Factory BatchSimulator::Impl::loadControllerFactory(const string& moduleFile)
+{
+    DllHandle module;
+    auto p = controllerModules.find(moduleFile);
+    if(p != controllerModules.end()){
+        module = p->second;
+    } else {
+        module = loadDll(fromUTF8(moduleFile).c_str());
+        if(!module){
+            (*os) << format(_("Controller module \"{}\" cannot be loaded."), moduleFile) << endl;
+#ifndef _WIN32
+            (*os) << dlerror() << endl;
+#endif
+            return nullptr;
+        }
+        controllerModules[moduleFile] = module;
+    }
+    auto factory = (SimpleController::Factory)resolveDllSymbol(module, "createSimpleController");
+    if(!factory){
+        (*os) << format(_("The factory function \"createSimpleController()\" is not found in \"{}\"."),
+                        moduleFile) << endl;
+    }
+    return factory;
+}
+
+
+void BatchSimulator::setCollisionDetectionEnabled(Body* body, bool on)
+{
+    if(auto spec = impl->findBodySpec(body)){
+        spec->isCollisionDetectionEnabled = on;
+    }
+}
+
+
+void BatchSimulator::setSelfCollisionDetectionEnabled(Body* body, bool on)
+{
+    if(auto spec = impl->findBodySpec(body)){
+        spec->isSelfCollisionDetectionEnabled = on;
+    }
+}
+
+
+bool BatchSimulator::setMaterialTableFile(const std::string& filename)
+{
+    return impl->setMaterialTableFile(filename);
+}
+
+
+bool BatchSimulator::Impl::setMaterialTableFile(const string& filename)
+{
+    MaterialTablePtr table = new MaterialTable;
+    if(!table->load(filename, *os)){
+        (*os) << format(_("Material table \"{}\" cannot be loaded."), filename) << endl;
+        return false;
+    }
+    materialTable = table;
+    return true;
+}
+
+
+int BatchSimulator::numBodies() const
+{
+    return impl->bodySpecs.size();
+}
+
+
+Body* BatchSimulator::body(int index)
+{
+    return impl->bodySpecs[index].body;
+}
+
+
+Body* BatchSimulator::findBody(const std::string& name)
+{
+    for(auto& spec : impl->bodySpecs){
+        if(spec.body->name() == name){
+            return spec.body;
+        }
+    }
+    return nullptr;
+}
+
+
+Mapping* BatchSimulator::parameters()
+{
+    return impl->parameters;
+}
+
+
+int BatchSimulator::addRun(const Mapping* parameters, const std::string& logFile)
+{
+    MappingPtr merged = impl->parameters->cloneMapping();
+    if(parameters){
+        for(auto& kv : *parameters){
+            merged->insert(kv.first, kv.second);
+        }
+    }
+    int index = impl->runs.size();
+    impl->runs.emplace_back(new SimulationRun(impl, merged, logFile));
+    return index;
+}
+
+
+void BatchSimulator::clearRuns()
+{
+    impl->runs.clear();
+}
+
+
+int BatchSimulator::numRuns() const
+{
+    return impl->runs.size();
+}
+
+
+void BatchSimulator::setMaxNumConcurrentRuns(int n)
+{
+    impl->maxNumConcurrentRuns = std::max(0, n);
+}
+
+
+const BatchSimulator::Result& BatchSimulator::result(int runIndex) const
+{
+    return impl->runs[runIndex]->result;
+}
+
+
+bool BatchSimulator::run()
+{
+    return impl->run();
+}
+
+
+/**
+   Each thread takes the next run when it finishes a run so that the runs of different simulation
+   lengths are balanced among the threads. The runs are executed by the dedicated threads instead of
+   the tasks of ParallelScheduler because a task group waiting in the step of a run may execute the
+   other pending tasks, which would run the whole other runs inside the step.
+*/
+bool BatchSimulator::Impl::run()
+{
+    const int numRuns = runs.size();
+    int numThreads = ParallelScheduler::instance()->concurrency();
+    if(maxNumConcurrentRuns > 0){
+        numThreads = std::min(numThreads, maxNumConcurrentRuns);
+    }
+    numThreads = std::max(1, std::min(numThreads, numRuns));
+
+    bool isTimeRangeValid = true;
+    for(int i=0; i < numRuns; ++i){
+        if(runs[i]->isTimeRangeUnlimited()){
+            putMessage(format(_("Run {}: The unlimited time range cannot be used in batch runs.\n"), i));
+            isTimeRangeValid = false;
+        }
+    }
+    if(!isTimeRangeValid){
+        return false;
+    }
+
+    std::atomic<int> nextRunIndex(0);
+    auto processRuns = [&](){
+        while(true){
+            int index = nextRunIndex.fetch_add(1);
+            if(index >= numRuns){
+                break;
+            }
+            auto& run = runs[index];
+            run->execute();
+            putMessage(format(_("Run {0}: {1}, {2:.3f} [s] simulated in {3:.3f} [s].\n"),
+                              index, run->result.isSucceeded ? _("finished") : _("failed"),
+                              run->result.simulationTime, run->result.computationTime) + run->os.str());
+            run->os.str(string());
+        }
+    };
+
+    vector<std::thread> threads;
+    for(int i=1; i < numThreads; ++i){
+        threads.emplace_back(processRuns);
+    }
+    processRuns();
+    for(auto& thread : threads){
+        thread.join();
+    }
+
+    bool succeeded = true;
+    for(auto& run : runs){
+        if(!run->result.isSucceeded){
+            succeeded = false;
+        }
+    }
+    return succeeded;
+}
+
+
+SimulationRun::SimulationRun(WorldSpec* worldSpec, MappingPtr parameters, const string& logFile)
+    : worldSpec(worldSpec),
+      parameters(parameters),
+      logFile(logFile)
+{
+    result.isSucceeded = false;
+    result.numFrames = 0;
+    result.simulationTime = 0.0;
+    result.computationTime = 0.0;
+
+    initializeTimeRange();
+}
+
+
+/**
+   The time step and the time range are given in the same way as SimulatorItem except that the
+   "Specified time" mode is used when the mode is not given. The "Unlimited" mode is rejected
+   because a run in the mode never finishes without the user interface to stop it.
+*/
+void SimulationRun::initializeTimeRange()
+{
+    const Mapping& param = *parameters;
+
+    timeStep = 0.001;
+    if(!param.read("timeStep", timeStep) && !param.read("timestep", timeStep)){
+        double frameRate;
+        if(param.read("frameRate", frameRate) || param.read("framerate", frameRate)){
+            timeStep = 1.0 / frameRate;
+        } else if(worldSpec->timeBarFrameRate > 0.0){
+            timeStep = 1.0 / worldSpec->timeBarFrameRate;
+        }
+    }
+
+    string mode;
+    if(param.get("onlyActiveControlPeriod", false)){
+        mode = "Active control period";
+    } else if(!param.read("timeRangeMode", mode)){
+        mode = "Specified time";
+    }
+    const double timeLength = param.get("timeLength", 180.0);
+
+    maxFrame = std::numeric_limits<int>::max();
+    doStopWhenNoActiveControllers = false;
+    if(mode == "Active control period"){
+        doStopWhenNoActiveControllers = true;
+    } else if(mode == "Specified time" || mode == "Specified period"){
+        maxFrame = static_cast<int>(timeLength / timeStep + 0.5);
+    } else if(mode == "Time bar range" || mode == "TimeBar range"){
+        if(worldSpec->timeBarMaxTime >= 0.0){
+            maxFrame = static_cast<int>(worldSpec->timeBarMaxTime / timeStep + 0.5);
+        } else {
+            os << _("The time bar range is not given. The specified time length is used.") << endl;
+            maxFrame = static_cast<int>(timeLength / timeStep + 0.5);
+        }
+    }
+}
+
+
+bool SimulationRun::isTimeRangeUnlimited() const
+{
+    return maxFrame == std::numeric_limits<int>::max() && !doStopWhenNoActiveControllers;
+}
+
+
+void SimulationRun::execute()
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool initialized;
+    {
+        // The body models and the controller modules shared by the runs are accessed in the initialization
+        std::lock_guard<std::mutex> lock(worldSpec->setupMutex);
+        try {
+            initialized = initialize();
+        } catch(const ValueNode::Exception& ex){
+            os << ex.message() << endl;
+            initialized = false;
+        }
+    }
+
+    if(initialized){
+        for(auto& controller : controllers){
+            controller->controller->start();
+        }
+        int frame = 0;
+        while(frame < maxFrame){
+            ++frame;
+            if(!stepSequence.step()){
+                break;
+            }
+        }
+        for(auto& controller : controllers){
+            controller->controller->stop();
+        }
+        result.isSucceeded = true;
+        result.numFrames = frame;
+        result.simulationTime = world.currentTime();
+    }
+
+    visionSimulator.reset();
+    logWriter.close();
+    controllers.clear();
+    simBodies.clear();
+    world.clearBodies();
+
+    result.computationTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+bool SimulationRun::initialize()
+{
+    const Mapping& param = *parameters;
+
+    applyParameters(param);
+
+    const Mapping* bodyParameters = param.findMapping("bodies");
+    for(auto& spec : worldSpec->bodySpecs){
+        if(!addBody(spec, bodyParameters->isValid() ? bodyParameters : nullptr)){
+            return false;
+        }
+    }
+
+    world.initialize();
+
+    for(auto& simBody : simBodies){
+        for(auto& controller : simBody->controllers){
+            controllers.push_back(controller.get());
+        }
+    }
+    for(auto& controller : controllers){
+        if(!controller->initialize()){
+            os << format(_("The initialization of controller {0} failed."), controller->spec.name) << endl;
+            return false;
+        }
+    }
+    doStopWhenNoActiveControllers = doStopWhenNoActiveControllers && !controllers.empty();
+
+    if(worldSpec->visionSimulatorParameters){
+        initializeVisionSimulator();
+    }
+
+    initializeRecording();
+
+    initializeStepSequence();
+
+    return true;
+}
+
+
+void SimulationRun::applyParameters(const Mapping& param)
+{
+    isAllLinkPositionOutputMode = param.get("allLinkPositionOutputMode", false);
+    isDeviceStateOutputEnabled = param.get("deviceStateOutput", true);
+    controllerOptionString = param.get("controllerOptions", "");
+
+    string dynamicsMode;
+    if(param.read("dynamicsMode", dynamicsMode) && dynamicsMode != "Forward dynamics"){
+        os << format(_("Dynamics mode \"{}\" is not supported. The forward dynamics mode is used."),
+                     dynamicsMode) << endl;
+    }
+    if(param.get("integrationMode", "Runge Kutta") == "Euler"){
+        world.setEulerMethod();
+    } else {
+        world.setRungeKuttaMethod();
+    }
+    Vector3 gravity(0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION);
+    read(param, "gravity", gravity);
+    world.setGravityAcceleration(gravity);
+    world.enableSensors(true);
+    world.setOldAccelSensorCalcMode(param.get("oldAccelSensorMode", false));
+    world.setNumThreads(param.get("dynamicsThreads", 1));
+    world.setTimeStep(timeStep);
+    world.setCurrentTime(0.0);
+
+    ConstraintForceSolver& cfs = world.constraintForceSolver;
+    if(worldSpec->materialTable){
+        cfs.setMaterialTable(worldSpec->materialTable);
+    }
+    cfs.setGaussSeidelErrorCriterion(param.get("errorCriterion", cfs.gaussSeidelErrorCriterion()));
+    cfs.setGaussSeidelMaxNumIterations(param.get("maxNumIterations", cfs.gaussSeidelMaxNumIterations()));
+    cfs.setGaussSeidelRelaxationFactor(param.get("relaxationFactor", cfs.gaussSeidelRelaxationFactor()));
+    cfs.setContactDepthCorrection(
+        param.get("contactCorrectionDepth", cfs.contactCorrectionDepth()),
+        param.get("contactCorrectionVelocityRatio", cfs.contactCorrectionVelocityRatio()));
+    cfs.setFrictionCoefficientRange(
+        param.get("min_friction_coefficient", cfs.minFrictionCoefficient()),
+        param.get("max_friction_coefficient", cfs.maxFrictionCoefficient()));
+    cfs.setContactCullingDistance(param.get("cullingThresh", cfs.contactCullingDistance()));
+    cfs.setContactCullingDepth(param.get("contactCullingDepth", cfs.contactCullingDepth()));
+    if(param.get("2Dmode", false)){
+        cfs.set2Dmode(true);
+    }
+}
+
+
+bool SimulationRun::addBody(const BodySpec& spec, const Mapping* bodyParameters)
+{
+    auto simBody = new SimBody;
+    simBodies.emplace_back(simBody);
+
+    CloneMap cloneMap;
+    DyBody* body = new DyBody;
+    cloneMap.setClone(spec.body, body);
+    body->copyFrom(spec.body, &cloneMap);
+    cloneMap.replacePendingObjects();
+    simBody->body = body;
+    simBody->isDynamic = !body->isStaticModel();
+
+    if(bodyParameters){
+        if(auto state = bodyParameters->findMapping(body->name())){
+            if(state->isValid()){
+                Vector3 p;
+                Matrix3 R;
+                if(read(state, "rootPosition", p)){
+                    body->rootLink()->p() = p;
+                }
+                if(read(state, "rootAttitude", R)){
+                    body->rootLink()->R() = R;
+                }
+                const int nj = body->numAllJoints();
+                Listing* qs = state->findListing("jointDisplacements");
+                if(qs->isValid()){
+                    for(int i=0; i < std::min(qs->size(), nj); ++i){
+                        body->joint(i)->q() = radian(qs->at(i)->toDouble());
+                    }
+                } else {
+                    qs = state->findListing("jointPositions");
+                    for(int i=0; i < std::min(qs->size(), nj); ++i){
+                        body->joint(i)->q() = qs->at(i)->toDouble();
+                    }
+                }
+            }
+        }
+    }
+
+    body->setCurrentTimeFunction([this](){ return world.currentTime(); });
+    body->initializeState();
+
+    for(auto& controllerSpec : spec.controllers){
+        simBody->controllers.emplace_back(new ControllerHost(this, controllerSpec, body));
+    }
+
+    for(auto& link : body->links()){
+        int mode = link->actuationMode() & ~Link::LinkExtWrench;
+        if(mode == Link::DeprecatedJointSurfaceVelocity && link->isFixedJoint()){
+            link->setJointType(Link::PseudoContinuousTrackJoint);
+        }
+    }
+
+    int bodyIndex = world.addBody(body);
+    world.constraintForceSolver.setBodyCollisionDetectionMode(
+        bodyIndex, spec.isCollisionDetectionEnabled, spec.isSelfCollisionDetectionEnabled);
+
+    if(simBody->isDynamic || body->numDevices() > 0){
+        recordedSimBodies.push_back(simBody);
+    }
+
+    return true;
+}
+
+
+void SimulationRun::initializeVisionSimulator()
+{
+    const Mapping& param = *worldSpec->visionSimulatorParameters;
+    std::set<string> bodyNames;
+    std::set<string> sensorNames;
+    auto bodyNameList = param.findListing("targetBodies");
+    for(int i=0; i < bodyNameList->size(); ++i){
+        bodyNames.insert(bodyNameList->at(i)->toString());
+    }
+    auto sensorNameList = param.findListing("targetSensors");
+    for(int i=0; i < sensorNameList->size(); ++i){
+        sensorNames.insert(sensorNameList->at(i)->toString());
+    }
+    const bool isVisionDataRecordingEnabled = param.get("recordVisionData", false);
+
+    visionSimulator.reset(new RaycastVisionSimulator);
+    visionSimulator->setMaxFrameRate(param.get("maxFrameRate", 1000.0));
+    visionSimulator->setMaxLatency(param.get("maxLatency", 1.0));
+    visionSimulator->setBestEffortMode(param.get("bestEffort", false));
+    visionSimulator->setDepthError(param.get("depthError", 0.0));
+
+    for(auto& simBody : simBodies){
+        Body* body = simBody->body;
+        visionSimulator->addBody(body);
+        if(!bodyNames.empty() && bodyNames.find(body->name()) == bodyNames.end()){
+            continue;
+        }
+        for(auto& device : body->devices()){
+            if(!sensorNames.empty() && sensorNames.find(device->name()) == sensorNames.end()){
+                continue;
+            }
+            if(visionSimulator->addSensor(device)){
+                if(isVisionDataRecordingEnabled){
+                    if(auto rangeSensor = dynamic_cast<RangeSensor*>(device.get())){
+                        rangeSensor->setRangeDataStateClonable(true);
+                    } else if(auto camera = dynamic_cast<Camera*>(device.get())){
+                        camera->setImageStateClonable(true);
+                    }
+                }
+            }
+        }
+    }
+
+    if(visionSimulator->numSensors() == 0){
+        visionSimulator.reset();
+    } else {
+        visionSimulator->initialize(timeStep);
+    }
+}
+
+
+void SimulationRun::initializeRecording()
+{
+    if(logFile.empty()){
+        return;
+    }
+
+    logWriter.setFormatVersion(parameters->get("compressedFormat", false) ? 2 : 1);
+    logWriter.setKeyframeInterval(parameters->get("keyframeInterval", 100));
+    logWriter.setQuantizationPrecision(
+        parameters->get("positionPrecision", 0.0), parameters->get("anglePrecision", 0.0));
+    
+    if(!logWriter.open(logFile)){
+        os << format(_("Log file \"{}\" cannot be opened."), logFile) << endl;
+        return;
+    }
+
+    logWriter.beginHeaderOutput();
+    for(auto& simBody : recordedSimBodies){
+        Body* body = simBody->body;
+        logWriter.outputBodyHeader(body);
+
+        int numLinksToRecord = 0;
+        if(simBody->isDynamic){
+            numLinksToRecord = isAllLinkPositionOutputMode ? body->numLinks() : 1;
+        }
+        simBody->linkPositions.resize(numLinksToRecord);
+        simBody->jointPositions.resize(body->numAllJoints());
+
+        const auto& devices = body->devices();
+        simBody->deviceStateConnections.disconnect();
+        simBody->deviceStates.clear();
+        if(isDeviceStateOutputEnabled && !devices.empty()){
+            simBody->deviceStates.resize(devices.size());
+            simBody->deviceStateChangeFlag.clear();
+            simBody->deviceStateChangeFlag.resize(devices.size(), true); // store the initial states
+            for(size_t i=0; i < devices.size(); ++i){
+                simBody->deviceStateConnections.add(
+                    devices[i]->sigStateChanged().connect(
+                        [simBody, i](){ simBody->deviceStateChangeFlag[i] = true; }));
+            }
+        }
+    }
+    logWriter.endHeaderOutput();
+
+    double r = parameters->get("recordingFrameRate", 0.0);
+    if(r <= 0.0){
+        r = 1.0 / timeStep;
+    }
+    logTimeStep = 1.0 / r;
+    nextLogFrame = 0;
+    nextLogTime = 0.0;
+
+    outputLogFrame(0.0); // put the initial state
+}
+
+
+void SimulationRun::outputLogFrame(double time)
+{
+    // The frame nearest to the recording time is recorded
+    const double halfTimeStep = timeStep * 0.5;
+    if(!logWriter.isOpen() || time + halfTimeStep < nextLogTime){
+        return;
+    }
+
+    for(auto& simBody : recordedSimBodies){
+        Body* body = simBody->body;
+        for(size_t i=0; i < simBody->linkPositions.size(); ++i){
+            Link* link = body->link(i);
+            simBody->linkPositions[i].set(link->p(), link->R());
+        }
+        for(size_t i=0; i < simBody->jointPositions.size(); ++i){
+            simBody->jointPositions[i] = body->joint(i)->q();
+        }
+        auto& states = simBody->deviceStates;
+        for(size_t i=0; i < states.size(); ++i){
+            if(simBody->deviceStateChangeFlag[i]){
+                states[i] = body->device(i)->cloneState();
+                simBody->deviceStateChangeFlag[i] = false;
+            }
+        }
+    }
+
+    while(time + halfTimeStep >= nextLogTime){
+        logWriter.beginFrameOutput(time);
+        for(auto& simBody : recordedSimBodies){
+            logWriter.beginBodyStateOutput();
+            if(!simBody->linkPositions.empty()){
+                logWriter.outputLinkPositions(&simBody->linkPositions.front(), simBody->linkPositions.size());
+            }
+            if(!simBody->jointPositions.empty()){
+                logWriter.outputJointPositions(&simBody->jointPositions.front(), simBody->jointPositions.size());
+            }
+            if(!simBody->deviceStates.empty()){
+                logWriter.beginDeviceStateOutput();
+                for(auto& state : simBody->deviceStates){
+                    logWriter.outputDeviceState(state);
+                }
+                logWriter.endDeviceStateOutput();
+            }
+            logWriter.endBodyStateOutput();
+        }
+        logWriter.endFrameOutput();
+        nextLogTime = ++nextLogFrame * logTimeStep;
+    }
+}
+
+
+void SimulationRun::initializeStepSequence()
+{
+    stepSequence.clearControllers();
+    for(auto& controller : controllers){
+        stepSequence.addController(controller);
+    }
+    stepSequence.setStopWhenNoActiveControllers(doStopWhenNoActiveControllers);
+
+    if(visionSimulator){
+        stepSequence.setPreDynamicsFunction(
+            [this](){ visionSimulator->onPreDynamics(world.currentTime()); });
+        stepSequence.setPostDynamicsFunction(
+            [this](){ visionSimulator->onPostDynamics(); });
+    }
+
+    // The same step as AISTSimulatorItem in the forward dynamics mode
+    stepSequence.setDynamicsFunction(
+        [this](){
+            world.updateAllStateHighGainLinks();
+            world.calcNextState();
+            world.constraintForceSolver.clearExternalForces();
+        });
+
+    stepSequence.setRecordingFunction(
+        [this](){ outputLogFrame(world.currentTime()); });
+}
+
+
+ControllerHost::ControllerHost(SimulationRun* run, const ControllerSpec& spec, Body* simulationBody)
+    : run(run),
+      spec(spec),
+      simulationBody(simulationBody)
+{
+    controller = nullptr;
+    isNoDelayMode_ = spec.isNoDelayMode;
+}
+
+
+ControllerHost::~ControllerHost()
+{
+    inputDeviceStateConnections.disconnect();
+    outputDeviceStateConnections.disconnect();
+    ioBody.reset();
+    delete controller;
+}
+
+
+bool ControllerHost::initialize()
+{
+    controller = spec.factory();
+    if(!controller){
+        return false;
+    }
+
+    ioBody = simulationBody->clone();
+
+    SimpleControllerConfig config(this);
+    if(!controller->configure(&config)){
+        return false;
+    }
+    if(!controller->initialize(this)){
+        return false;
+    }
+
+    ioTransfer.updateIOStateTypes(simulationBody, ioBody);
+
+    const auto& devices = simulationBody->devices();
+    const auto& ioDevices = ioBody->devices();
+    inputEnabledDeviceFlag.resize(devices.size(), false);
+    inputDeviceStateChangeFlag.clear();
+    inputDeviceStateChangeFlag.resize(devices.size(), false);
+    outputDeviceStateChangeFlag.clear();
+    outputDeviceStateChangeFlag.resize(ioDevices.size(), false);
+    for(size_t i=0; i < devices.size(); ++i){
+        if(inputEnabledDeviceFlag[i]){
+            inputDeviceStateConnections.add(
+                devices[i]->sigStateChanged().connect(
+                    [this, i](){ inputDeviceStateChangeFlag[i] = true; }));
+        } else {
+            inputDeviceStateConnections.add(Connection()); // null connection
+        }
+        outputDeviceStateConnections.add(
+            ioDevices[i]->sigStateChanged().connect(
+                [this, i](){ outputDeviceStateChangeFlag[i] = true; }));
+    }
+
+    output();
+
+    return true;
+}
+
+
+void ControllerHost::input()
+{
+    ioTransfer.inputLinkStates();
+    SimpleControllerIOTransfer::transferDeviceStates(
+        simulationBody->devices(), ioBody->devices(), inputDeviceStateChangeFlag, outputDeviceStateConnections);
+}
+
+
+bool ControllerHost::control()
+{
+    return controller->control();
+}
+
+
+void ControllerHost::output()
+{
+    ioTransfer.outputLinkStates();
+    SimpleControllerIOTransfer::transferDeviceStates(
+        ioBody->devices(), simulationBody->devices(), outputDeviceStateChangeFlag, inputDeviceStateConnections);
+}
+
+
+std::string ControllerHost::controllerName() const
+{
+    return spec.name;
+}
+
+
+Body* ControllerHost::body()
+{
+    return ioBody;
+}
+
+
+std::string ControllerHost::optionString() const
+{
+    return getIntegratedOptionString(run->controllerOptionString, spec.optionString);
+}
+
+
+std::ostream& ControllerHost::os() const
+{
+    return run->os;
+}
+
+
+double ControllerHost::timeStep() const
+{
+    return run->timeStep;
+}
+
+
+double ControllerHost::currentTime() const
+{
+    return run->world.currentTime();
+}
+
+
+bool ControllerHost::isNoDelayMode() const
+{
+    return isNoDelayMode_;
+}
+
+
+bool ControllerHost::setNoDelayMode(bool on)
+{
+    isNoDelayMode_ = on;
+    return on;
+}
+
+
+bool ControllerHost::isImmediateMode() const
+{
+    return isNoDelayMode_;
+}
+
+
+void ControllerHost::setImmediateMode(bool on)
+{
+    isNoDelayMode_ = on;
+}
+
+
+void ControllerHost::enableIO(Link* link)
+{
+    enableInput(link);
+    enableOutput(link);
+}
+
+
+void ControllerHost::enableInput(Link* link)
+{
+    ioTransfer.enableInput(link);
+}
+
+
+void ControllerHost::enableInput(Link* link, int stateFlags)
+{
+    ioTransfer.enableInput(link, stateFlags);
+}
+
+
+void ControllerHost::enableOutput(Link* link)
+{
+    ioTransfer.enableOutput(link);
+}
+
+
+void ControllerHost::enableOutput(Link* link, int stateFlags)
+{
+    ioTransfer.enableOutput(link, stateFlags);
+}
+
+
+void ControllerHost::enableInput(Device* device)
+{
+    if(device->index() >= static_cast<int>(inputEnabledDeviceFlag.size())){
+        inputEnabledDeviceFlag.resize(device->index() + 1, false);
+    }
+    inputEnabledDeviceFlag[device->index()] = true;
+}
@@ -0,0 +1,120 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_BATCH_SIMULATOR_H
+#define CNOID_BODY_BATCH_SIMULATOR_H
+
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class Mapping;
+
+/**
+   This class runs the simulations with the AIST dynamics engine without the GUI.
+   The simulation world is given by a project file or by body files, and the runs with different
+   parameters are executed in parallel. The result of each run can be recorded in a world log file,
+   which can be played back with WorldLogFileItem.
+
+   The parameters are given in the same format as the project data of AISTSimulatorItem.
+   The following keys are supported:
+   timeStep, frameRate, timeRangeMode, timeLength, gravity, integrationMode, min_friction_coefficient,
+   max_friction_coefficient, cullingThresh, contactCullingDepth, errorCriterion, maxNumIterations,
+   relaxationFactor, contactCorrectionDepth, contactCorrectionVelocityRatio, 2Dmode, oldAccelSensorMode,
+   dynamicsThreads, allLinkPositionOutputMode, deviceStateOutput, controllerOptions and
+   recordingFrameRate. The compressed format of the log file is specified with compressedFormat,
+   keyframeInterval, positionPrecision and anglePrecision. In addition, the "bodies" mapping can give the initial state of each body
+   by the mapping of the body name with rootPosition, rootAttitude and jointDisplacements (degree)
+   or jointPositions (radian).
+
+   The time range is given by timeRangeMode in the same way as SimulatorItem. The time length is
+   given by the "Specified time" mode with timeLength, which is the default mode, and the "Time bar
+   range" mode uses the time bar range stored in the project. The "Unlimited" mode cannot be used
+   because the run would never finish, and the runs are not executed if a run has the mode.
+
+   If the simulator item of the project has RaycastVisionSimulatorItem, the range sensors and
+   the range cameras are simulated by RaycastVisionSimulator with the parameters of the item.
+*/
+class CNOID_EXPORT BatchSimulator
+{
+public:
+    BatchSimulator();
+    ~BatchSimulator();
+    BatchSimulator(const BatchSimulator&) = delete;
+    BatchSimulator& operator=(const BatchSimulator&) = delete;
+
+    void setMessageSink(std::ostream& os);
+
+    void clearWorld();
+
+    /**
+       The bodies in the first world of the project, their simple controllers, the material table
+       of the world and the parameters of the AIST simulator item are loaded.
+       \param simulatorName The name of the simulator item whose parameters are used.
+       The first AIST simulator item is used if it is empty.
+    */
+    bool loadProject(const std::string& filename, const std::string& simulatorName = std::string());
+
+    Body* addBody(const std::string& filename);
+
+    /**
+       \param module The file of the simple controller module. A relative path is resolved from the
+       simple controller directory of the installation.
+    */
+    bool addSimpleController(Body* body, const std::string& module, const std::string& options = std::string());
+
+    void setCollisionDetectionEnabled(Body* body, bool on);
+    void setSelfCollisionDetectionEnabled(Body* body, bool on);
+    bool setMaterialTableFile(const std::string& filename);
+
+    int numBodies() const;
+    Body* body(int index);
+    Body* findBody(const std::string& name);
+
+    //! The common parameters of the runs
+    Mapping* parameters();
+
+    /**
+       \param parameters The parameters overriding the common ones. Null can be given.
+       \param logFile The world log file to record the result. The result is not recorded if it is empty.
+       \return The index of the run
+    */
+    int addRun(const Mapping* parameters, const std::string& logFile = std::string());
+    void clearRuns();
+    int numRuns() const;
+
+    /**
+       The maximum number of the runs executed concurrently.
+       The concurrency of the ParallelScheduler is used when it is zero, which is the default.
+    */
+    void setMaxNumConcurrentRuns(int n);
+
+    /**
+       This function executes all the runs and returns after they finish.
+       \return True if all the runs succeed.
+    */
+    bool run();
+
+    struct Result
+    {
+        bool isSucceeded;
+        int numFrames;
+        double simulationTime;
+        double computationTime;
+    };
+
+    const Result& result(int runIndex) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
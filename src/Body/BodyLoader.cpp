@@ -8,6 +8,7 @@
 #include "VRMLBodyLoader.h"
 #include "Body.h"
 #include <cnoid/SceneLoader>
+#include <cnoid/MeshPool>
 #include <cnoid/ValueTree>
 #include <cnoid/Exception>
 #include <cnoid/NullOut>
@@ -142,6 +143,7 @@ public:
     shared_ptr<SceneLoaderAdapter> loaderAdapter;
     bool isVerbose;
     bool isShapeLoadingEnabled;
+    bool isMeshSharingEnabled;
     int defaultDivisionNumber;
     double defaultCreaseAngle;
     BodyLoader::LengthUnit lengthUnitHint;
@@ -167,6 +169,7 @@ BodyLoaderImpl::BodyLoaderImpl()
     os = &nullout();
     isVerbose = false;
     isShapeLoadingEnabled = true;
+    isMeshSharingEnabled = false;
     defaultDivisionNumber = -1;
     defaultCreaseAngle = -1.0;
 }
@@ -221,6 +224,12 @@ void BodyLoader::setMeshImportHint(LengthUnit unit, UpperAxis upperAxis)
 }
 
 
+void BodyLoader::setMeshSharingEnabled(bool on)
+{
+    impl->isMeshSharingEnabled = on;
+}
+
+
 bool BodyLoader::load(Body* body, const std::string& filename)
 {
     body->info()->clear();    
@@ -290,6 +299,14 @@ bool BodyLoaderImpl::load(Body* body, const std::string& filename)
         (*os) << ex.what();
     }
     os->flush();
+
+    if(result && isMeshSharingEnabled && isShapeLoadingEnabled){
+        auto pool = MeshPool::instance();
+        for(auto& link : body->links()){
+            pool->shareMeshes(link->visualShape());
+            pool->shareMeshes(link->collisionShape());
+        }
+    }
     
     return result;
 }
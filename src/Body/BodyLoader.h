@@ -30,6 +30,14 @@ public:
     enum LengthUnit { Meter, Millimeter, Inch, NumLengthUnitIds };
     enum UpperAxis { Z, Y, NumUpperAxisIds };
     void setMeshImportHint(LengthUnit unit, UpperAxis axis);
+
+    /**
+       When this is enabled, the meshes of the loaded body are shared with the meshes of the same
+       content in the other bodies by MeshPool. This is disabled by default because the shared
+       meshes must not be modified in place. Enable it only when the meshes of the loaded bodies
+       are not edited or they are cloned before editing.
+    */
+    void setMeshSharingEnabled(bool on);
     
     virtual bool load(Body* body, const std::string& filename);
     Body* load(const std::string& filename);
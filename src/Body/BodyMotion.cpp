@@ -10,7 +10,11 @@
 #include <cnoid/Vector3Seq>
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/MappedFile>
+#include <cnoid/UTF8>
 #include <fmt/format.h>
+#include <fstream>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -19,6 +23,166 @@ using fmt::format;
 
 namespace {
 //bool TRACE_FUNCTIONS = false;
+
+/*
+  The binary format consists of the following parts.
+  Header: magic "CBMS", int32 version, int32 number of seqs, double frame rate, double offset time
+  Seq entries: int32 kind, int32 value size (4 or 8), int32 number of frames, int32 number of parts,
+  int32 flags, string content, int32 number of labels, label strings, int64 data position
+  Data blocks: The values of each seq arranged part by part, aligned to eight bytes.
+  A string is stored as int32 length and characters.
+*/
+const char binaryMagic[] = { 'C', 'B', 'M', 'S' };
+const int32_t binaryFormatVersion = 1;
+
+enum BinarySeqKind { LinkPositionSeq = 1, JointDisplacementSeq = 2, ExtraVector3Seq = 3 };
+enum BinarySeqFlag { RootRelativeZMP = 1 };
+
+int numComponentsOfBinarySeq(int kind)
+{
+    switch(kind){
+    case LinkPositionSeq: return 7;
+    case JointDisplacementSeq: return 1;
+    case ExtraVector3Seq: return 3;
+    default: return 0;
+    }
+}
+
+struct BinarySeqEntry
+{
+    int32_t kind;
+    int32_t valueSize;
+    int32_t numFrames;
+    int32_t numParts;
+    int32_t flags;
+    string content;
+    vector<string> labels;
+    int64_t dataPos;
+    shared_ptr<AbstractSeq> seq;
+
+    size_t dataSize() const {
+        return static_cast<size_t>(numFrames) * numParts * numComponentsOfBinarySeq(kind) * valueSize;
+    }
+
+    // This must be used to check the sizes read from a file because dataSize() may overflow
+    bool isDataSizeWithin(size_t size) const {
+        const size_t frameSize = static_cast<size_t>(numParts) * numComponentsOfBinarySeq(kind) * valueSize;
+        return frameSize == 0 || static_cast<size_t>(numFrames) <= size / frameSize;
+    }
+};
+
+class BinaryWriteBuf
+{
+public:
+    vector<char> data;
+
+    template<class T> void write(T value){
+        const char* p = reinterpret_cast<const char*>(&value);
+        data.insert(data.end(), p, p + sizeof(T));
+    }
+    void writeString(const string& str){
+        write<int32_t>(str.size());
+        data.insert(data.end(), str.begin(), str.end());
+    }
+};
+
+class BinaryReadBuf
+{
+public:
+    const char* data;
+    size_t size;
+    size_t pos;
+    
+    BinaryReadBuf(const char* data, size_t size) : data(data), size(size), pos(0) { }
+
+    template<class T> bool read(T& out_value){
+        if(size - pos < sizeof(T)){
+            return false;
+        }
+        memcpy(&out_value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    bool readString(string& out_str){
+        int32_t length;
+        if(!read(length) || length < 0 || size - pos < static_cast<size_t>(length)){
+            return false;
+        }
+        out_str.assign(data + pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+void writeBinarySeqEntry(BinaryWriteBuf& buf, const BinarySeqEntry& entry)
+{
+    buf.write(entry.kind);
+    buf.write(entry.valueSize);
+    buf.write(entry.numFrames);
+    buf.write(entry.numParts);
+    buf.write(entry.flags);
+    buf.writeString(entry.content);
+    buf.write<int32_t>(entry.labels.size());
+    for(auto& label : entry.labels){
+        buf.writeString(label);
+    }
+    buf.write(entry.dataPos);
+}
+
+bool readBinarySeqEntry(BinaryReadBuf& buf, BinarySeqEntry& entry)
+{
+    int32_t numLabels;
+    if(!(buf.read(entry.kind) && buf.read(entry.valueSize) && buf.read(entry.numFrames) &&
+         buf.read(entry.numParts) && buf.read(entry.flags) && buf.readString(entry.content) &&
+         buf.read(numLabels)) || numLabels < 0){
+        return false;
+    }
+    entry.labels.resize(numLabels);
+    for(auto& label : entry.labels){
+        if(!buf.readString(label)){
+            return false;
+        }
+    }
+    return buf.read(entry.dataPos);
+}
+
+/**
+   The values of a part are given to the function as an array of the frames
+   each of which has the components of the element.
+*/
+template<class ValueType, class Function>
+void writeBinarySeqData(ofstream& ofs, const BinarySeqEntry& entry, Function getPartValues)
+{
+    const int nc = numComponentsOfBinarySeq(entry.kind);
+    vector<double> values(entry.numFrames * nc);
+    vector<ValueType> buf(values.size());
+    for(int i=0; i < entry.numParts; ++i){
+        getPartValues(i, values.data());
+        std::copy(values.begin(), values.end(), buf.begin());
+        ofs.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(ValueType));
+    }
+}
+
+template<class ValueType, class Function>
+void readBinarySeqData(const char* data, const BinarySeqEntry& entry, Function setFrameValues)
+{
+    const int nc = numComponentsOfBinarySeq(entry.kind);
+    const ValueType* block = reinterpret_cast<const ValueType*>(data);
+    const size_t partStride = static_cast<size_t>(entry.numFrames) * nc;
+    vector<double> values(entry.numParts * nc);
+    for(int i=0; i < entry.numFrames; ++i){
+        const ValueType* src = block + i * nc;
+        double* dest = values.data();
+        for(int j=0; j < entry.numParts; ++j){
+            for(int k=0; k < nc; ++k){
+                *dest++ = src[k];
+            }
+            src += partStride;
+        }
+        setFrameValues(i, values.data());
+    }
+}
+
 }
 
 
@@ -284,6 +448,10 @@ Body& operator<<(Body& body, BodyMotion::ConstFrame frame)
 
 bool BodyMotion::load(const std::string& filename, std::ostream& os)
 {
+    if(isBinaryFile(filename)){
+        return loadBinary(filename, os);
+    }
+    
     YAMLReader reader;
     reader.expectRegularMultiListing();
     bool result = false;
@@ -480,3 +648,239 @@ bool BodyMotion::save(const std::string& filename, double version, std::ostream&
 
     return writeSeq(writer);
 }
+
+
+bool BodyMotion::isBinaryFile(const std::string& filename)
+{
+    ifstream ifs(fromUTF8(filename).c_str(), ios::in | ios::binary);
+    char magic[sizeof(binaryMagic)];
+    ifs.read(magic, sizeof(magic));
+    return !ifs.fail() && memcmp(magic, binaryMagic, sizeof(magic)) == 0;
+}
+
+
+bool BodyMotion::saveBinary(const std::string& filename, bool useSinglePrecision, std::ostream& os)
+{
+    const int32_t valueSize = useSinglePrecision ? sizeof(float) : sizeof(double);
+    vector<BinarySeqEntry> entries;
+
+    auto addEntry = [&](int kind, shared_ptr<AbstractSeq> seq, int numParts, const string& content){
+        entries.emplace_back();
+        auto& entry = entries.back();
+        entry.kind = kind;
+        entry.valueSize = valueSize;
+        entry.numFrames = seq->getNumFrames();
+        entry.numParts = numParts;
+        entry.flags = 0;
+        entry.content = content;
+        entry.dataPos = 0;
+        entry.seq = seq;
+        if(auto multiSeq = dynamic_pointer_cast<AbstractMultiSeq>(seq)){
+            bool hasLabels = false;
+            vector<string> labels(numParts);
+            for(int i=0; i < numParts; ++i){
+                labels[i] = multiSeq->partLabel(i);
+                if(!labels[i].empty()){
+                    hasLabels = true;
+                }
+            }
+            if(hasLabels){
+                entry.labels = std::move(labels);
+            }
+        }
+        return &entry;
+    };
+
+    addEntry(LinkPositionSeq, linkPosSeq_, linkPosSeq_->numParts(), linkPosSeq_->seqContentName());
+    addEntry(JointDisplacementSeq, jointPosSeq_, jointPosSeq_->numParts(), jointPosSeq_->seqContentName());
+    for(auto& kv : extraSeqs){
+        if(auto vseq = dynamic_pointer_cast<Vector3Seq>(kv.second)){
+            auto entry = addEntry(ExtraVector3Seq, vseq, 1, kv.first);
+            auto zmpSeq = dynamic_pointer_cast<ZMPSeq>(vseq);
+            if(zmpSeq && zmpSeq->isRootRelative()){
+                entry->flags |= RootRelativeZMP;
+            }
+        } else {
+            os << format(_("Extra sequence \"{0}\" of type \"{1}\" cannot be stored in the binary format."),
+                         kv.first, kv.second->seqType()) << endl;
+        }
+    }
+
+    // The header is serialized twice because the data positions depend on its size
+    BinaryWriteBuf header;
+    for(int pass=0; pass < 2; ++pass){
+        header.data.clear();
+        header.data.insert(header.data.end(), binaryMagic, binaryMagic + sizeof(binaryMagic));
+        header.write(binaryFormatVersion);
+        header.write<int32_t>(entries.size());
+        header.write(frameRate());
+        header.write(getOffsetTime());
+        for(auto& entry : entries){
+            writeBinarySeqEntry(header, entry);
+        }
+        int64_t pos = (header.data.size() + 7) & ~7;
+        for(auto& entry : entries){
+            entry.dataPos = pos;
+            pos += (entry.dataSize() + 7) & ~7;
+        }
+    }
+
+    ofstream ofs(fromUTF8(filename).c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs.is_open()){
+        os << format(_("\"{}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+    ofs.write(header.data.data(), header.data.size());
+
+    for(auto& entry : entries){
+        ofs.seekp(entry.dataPos);
+        
+        std::function<void(int part, double* out_values)> getPartValues;
+        switch(entry.kind){
+        case LinkPositionSeq:
+            getPartValues = [&](int part, double* out_values){
+                auto seq = linkPosSeq_->part(part);
+                for(int i=0; i < entry.numFrames; ++i){
+                    const SE3& T = seq[i];
+                    const Vector3& p = T.translation();
+                    const Quaternion& q = T.rotation();
+                    *out_values++ = p.x();
+                    *out_values++ = p.y();
+                    *out_values++ = p.z();
+                    *out_values++ = q.w();
+                    *out_values++ = q.x();
+                    *out_values++ = q.y();
+                    *out_values++ = q.z();
+                }
+            };
+            break;
+        case JointDisplacementSeq:
+            getPartValues = [&](int part, double* out_values){
+                auto seq = jointPosSeq_->part(part);
+                std::copy(seq.begin(), seq.end(), out_values);
+            };
+            break;
+        case ExtraVector3Seq:
+            getPartValues = [&](int, double* out_values){
+                auto& seq = static_cast<Vector3Seq&>(*entry.seq);
+                for(int i=0; i < entry.numFrames; ++i){
+                    const Vector3& v = seq[i];
+                    *out_values++ = v.x();
+                    *out_values++ = v.y();
+                    *out_values++ = v.z();
+                }
+            };
+            break;
+        }
+        if(useSinglePrecision){
+            writeBinarySeqData<float>(ofs, entry, getPartValues);
+        } else {
+            writeBinarySeqData<double>(ofs, entry, getPartValues);
+        }
+    }
+
+    if(ofs.fail()){
+        os << format(_("Writing \"{}\" failed."), filename) << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool BodyMotion::loadBinary(const std::string& filename, std::ostream& os)
+{
+    MappedFile file;
+    if(!file.open(filename)){
+        os << format(_("\"{}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+
+    BinaryReadBuf buf(file.data(), file.size());
+    char magic[sizeof(binaryMagic)];
+    int32_t version;
+    int32_t numSeqs;
+    double frameRate;
+    double offsetTime;
+    bool isValid =
+        buf.read(magic) && memcmp(magic, binaryMagic, sizeof(magic)) == 0 &&
+        buf.read(version) && buf.read(numSeqs) && buf.read(frameRate) && buf.read(offsetTime);
+    if(isValid && version > binaryFormatVersion){
+        os << format(_("Format version {} is not supported"), version) << endl;
+        return false;
+    }
+
+    vector<BinarySeqEntry> entries;
+    for(int i=0; isValid && i < numSeqs; ++i){
+        entries.emplace_back();
+        auto& entry = entries.back();
+        isValid =
+            readBinarySeqEntry(buf, entry) &&
+            numComponentsOfBinarySeq(entry.kind) > 0 &&
+            (entry.valueSize == sizeof(float) || entry.valueSize == sizeof(double)) &&
+            entry.numFrames >= 0 && entry.numParts >= 0 &&
+            (entry.labels.empty() || static_cast<int>(entry.labels.size()) == entry.numParts) &&
+            entry.dataPos >= 0 && entry.dataPos % 8 == 0 &&
+            static_cast<uint64_t>(entry.dataPos) <= file.size() &&
+            entry.isDataSizeWithin(file.size() - entry.dataPos);
+    }
+    if(!isValid){
+        os << format(_("\"{}\" is not a valid binary body motion file."), filename) << endl;
+        return false;
+    }
+
+    setDimension(0, 1, 1);
+
+    for(auto& entry : entries){
+        const char* data = file.data() + entry.dataPos;
+        std::function<void(int frame, const double* values)> setFrameValues;
+        
+        switch(entry.kind){
+        case LinkPositionSeq:
+            linkPosSeq_->setDimension(entry.numFrames, entry.numParts);
+            linkPosSeq_->setPartLabels(entry.labels);
+            setFrameValues = [&](int frame, const double* v){
+                auto seq = linkPosSeq_->frame(frame);
+                for(int i=0; i < entry.numParts; ++i){
+                    seq[i].set(Vector3(v[0], v[1], v[2]), Quaternion(v[3], v[4], v[5], v[6]));
+                    v += 7;
+                }
+            };
+            break;
+        case JointDisplacementSeq:
+            jointPosSeq_->setDimension(entry.numFrames, entry.numParts);
+            jointPosSeq_->setPartLabels(entry.labels);
+            setFrameValues = [&](int frame, const double* v){
+                auto seq = jointPosSeq_->frame(frame);
+                std::copy(v, v + entry.numParts, seq.begin());
+            };
+            break;
+        case ExtraVector3Seq:
+        {
+            shared_ptr<Vector3Seq> seq;
+            if(entry.content == ZMPSeq::key()){
+                auto zmpSeq = getOrCreateZMPSeq(*this);
+                zmpSeq->setRootRelative(entry.flags & RootRelativeZMP);
+                seq = zmpSeq;
+            } else {
+                seq = getOrCreateExtraSeq<Vector3Seq>(entry.content);
+            }
+            seq->setNumFrames(entry.numFrames);
+            setFrameValues = [seq](int frame, const double* v){
+                (*seq)[frame] = Vector3(v[0], v[1], v[2]);
+            };
+            break;
+        }
+        }
+
+        if(entry.valueSize == sizeof(float)){
+            readBinarySeqData<float>(data, entry, setFrameValues);
+        } else {
+            readBinarySeqData<double>(data, entry, setFrameValues);
+        }
+    }
+
+    setFrameRate(frameRate);
+    setOffsetTime(offsetTime);
+
+    return true;
+}
@@ -95,10 +95,21 @@ public:
     Frame frame(int frame) { return Frame(*this, frame); }
     ConstFrame frame(int frame) const { return ConstFrame(*this, frame); }
 
+    //! The binary format is also loaded by this function.
     bool load(const std::string& filename, std::ostream& os = nullout());
     bool save(const std::string& filename, std::ostream& os = nullout());
     bool save(const std::string& filename, double version, std::ostream& os = nullout());
 
+    /**
+       The binary format stores the part labels and the values of each sequence as a column-major
+       block, which is read from the memory-mapped file without parsing the text.
+       The extra sequences of Vector3Seq are also stored.
+       \param useSinglePrecision The values are stored as float32 instead of float64 if true.
+    */
+    bool saveBinary(const std::string& filename, bool useSinglePrecision = false, std::ostream& os = nullout());
+    bool loadBinary(const std::string& filename, std::ostream& os = nullout());
+    static bool isBinaryFile(const std::string& filename);
+
     typedef std::map<std::string, std::shared_ptr<AbstractSeq>> ExtraSeqMap;
     typedef ExtraSeqMap::const_iterator ConstSeqIterator;
         
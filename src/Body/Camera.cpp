@@ -40,9 +40,19 @@ Camera::Camera(const Camera& org, bool copyStateOnly)
         isImageStateClonable_ = true;
     } else {
         isImageStateClonable_ = org.isImageStateClonable_;
+        imageStateEncoder_ = org.imageStateEncoder_;
     }
 
     copyCameraStateFrom(org);
+
+    if(copyStateOnly){
+        encodedImage_ = org.encodeImage();
+        if(encodedImage_){
+            image_ = std::make_shared<Image>();
+        }
+    } else if(org.encodedImage_){
+        image_ = org.encodedImage_->decode();
+    }
 }
 
 
@@ -58,7 +68,15 @@ void Camera::copyStateFrom(const DeviceState& other)
 void Camera::copyStateFrom(const Camera& other)
 {
     copyCameraStateFrom(other);
-    image_ = other.image_;
+
+    encodedImage_.reset();
+    if(other.encodedImage_){
+        image_ = other.encodedImage_->decode();
+        lastEncodedSourceImage_ = image_;
+        lastEncodedImage_ = other.encodedImage_;
+    } else {
+        image_ = other.image_;
+    }
 }
 
 
@@ -83,6 +101,22 @@ void Camera::copyCameraStateFrom(const Camera& other)
 }
 
 
+EncodedImagePtr Camera::encodeImage() const
+{
+    if(encodedImage_){
+        return encodedImage_;
+    }
+    if(!imageStateEncoder_ || !isImageStateClonable_ || image_->empty()){
+        return nullptr;
+    }
+    if(!lastEncodedImage_ || lastEncodedSourceImage_.lock() != image_){
+        lastEncodedImage_ = imageStateEncoder_->encodeImage(image_);
+        lastEncodedSourceImage_ = image_;
+    }
+    return lastEncodedImage_;
+}
+
+
 Referenced* Camera::doClone(CloneMap*) const
 {
     return new Camera(*this, false);
@@ -111,6 +145,7 @@ void Camera::clearState()
 
 void Camera::clearImage()
 {
+    encodedImage_.reset();
     if(image_.use_count() == 1){
         image_->clear();
     } else {
@@ -133,6 +168,12 @@ void Camera::on(bool on)
 
 Image& Camera::image()
 {
+    if(encodedImage_){
+        image_ = encodedImage_->decode();
+        encodedImage_.reset();
+    }
+    // The image may be modified, so it cannot be identified with the encoded one any more
+    lastEncodedImage_.reset();
     if(image_.use_count() > 1){
         image_ = std::make_shared<Image>(*image_);
     }
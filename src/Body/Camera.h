@@ -7,6 +7,7 @@
 #define CNOID_BODY_CAMERA_H
 
 #include "Device.h"
+#include "SensorDataEncoder.h"
 #include <cnoid/Image>
 #include <memory>
 #include "exportdecl.h"
@@ -29,6 +30,15 @@ public:
     void setImageStateClonable(bool on) { isImageStateClonable_ = on; }
     bool isImageStateClonable() const { return isImageStateClonable_; }
 
+    /**
+       When the encoder is set, the image of a state cloned by cloneState is encoded by the encoder
+       and the clone does not keep the raw image. The image is decoded when the state is copied
+       to a device by copyStateFrom. An image shared by the clones is only encoded once.
+       The encoder is also used for the point data of RangeCamera.
+    */
+    void setImageStateEncoder(SensorDataEncoder* encoder) { imageStateEncoder_ = encoder; }
+    SensorDataEncoder* imageStateEncoder() const { return imageStateEncoder_; }
+
     enum ImageType { NO_IMAGE, COLOR_IMAGE, GRAYSCALE_IMAGE };
     enum LensType { NORMAL_LENS, FISHEYE_LENS, DUAL_FISHEYE_LENS };
 
@@ -110,8 +120,13 @@ private:
     double frameRate_;
     double delay_;
     std::shared_ptr<Image> image_;
+    EncodedImagePtr encodedImage_;
+    SensorDataEncoderPtr imageStateEncoder_; // Non state variable
+    mutable std::weak_ptr<Image> lastEncodedSourceImage_;
+    mutable EncodedImagePtr lastEncodedImage_;
 
     void copyCameraStateFrom(const Camera& other);
+    EncodedImagePtr encodeImage() const;
 };
 
 typedef ref_ptr<Camera> CameraPtr;
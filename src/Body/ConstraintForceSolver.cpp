@@ -18,6 +18,7 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/AISTCollisionDetector>
 #include <cnoid/TimeMeasure>
+#include <cnoid/PhaseProfiler>
 #include <fmt/format.h>
 #include <random>
 #include <unordered_map>
@@ -73,6 +74,8 @@ static const double THRESH_TO_SWITCH_REL_ERROR = 1.0e-8;
 
 static const bool USE_PREVIOUS_LCP_SOLUTION = true;
 
+static const double DEFAULT_GAUSS_SEIDEL_RELAXATION_FACTOR = 1.0;
+
 static const bool ENABLE_CONTACT_DEPTH_CORRECTION = true;
 
 // normal setting
@@ -156,6 +159,7 @@ public:
         double normalProjectionOfRelVelocityOn0;
         double depth; // position error in the case of a connection point
         double mu;
+        unsigned long long featureId; // the id of the collision to find the previous force
         int globalFrictionIndex;
         int numFrictionVectors;
         Vector3 frictionVector[4][2];
@@ -182,15 +186,31 @@ public:
 
     BodyCollisionDetector bodyCollisionDetector;
 
+    /**
+       The constraint force of a constraint point solved in the previous step.
+       The forces are used as the initial solution of the next step for the constraint
+       points matched by the collision id and the position.
+    */
+    struct ForceCache
+    {
+        unsigned long long featureId;
+        Vector3 localPoint; // in the frame of link[0]
+        double normalForce;
+        Vector3 frictionForce; // applied to link[0]
+    };
+
     class LinkPair
     {
     public:
+        LinkPair() : forceCacheCounter(-1) { }
         virtual ~LinkPair() { }
         bool isBelongingToSameSubBody;
         DyLink* link[2];
         vector<ConstraintPoint> constraintPoints;
         ContactMaterialExPtr contactMaterial;
         bool isNonContactConstraint;
+        vector<ForceCache> forceCaches;
+        int forceCacheCounter; // the value of solveCounter when the caches were stored
     };
 
     unordered_map<IdPair<GeometryHandle>, LinkPair> geometryPairToLinkPairMap;
@@ -228,9 +248,6 @@ public:
     int globalNumContactNormalVectors;
     int globalNumFrictionVectors;
 
-    int prevGlobalNumConstraintVectors;
-    int prevGlobalNumFrictionVectors;
-
     bool areThereImpacts;
     int numUnconverged;
 
@@ -262,6 +279,10 @@ public:
     int  maxNumGaussSeidelIteration;
     int  numGaussSeidelInitialIteration;
     double gaussSeidelErrorCriterion;
+    double gaussSeidelRelaxationFactor;
+    int numGaussSeidelIterations;
+    vector<double> gaussSeidelErrors;
+    int solveCounter;
     double contactCorrectionDepth;
     double contactCorrectionVelocityRatio;
 
@@ -269,6 +290,45 @@ public:
     int numGaussSeidelTotalCalls;
     int numGaussSeidelTotalLoopsMax;
 
+    /**
+       A group of the constrained link pairs which are connected via non-static sub-bodies.
+       The MCP of each island is independent of the others and is solved separately.
+    */
+    struct Island
+    {
+        int rootNodeIndex;
+        int prevRootNodeIndex;
+        vector<LinkPair*> linkPairs;
+        vector<DySubBody*> subBodies;
+        int numConstraintVectors;
+        int numContactNormalVectors;
+        int numFrictionVectors;
+        int prevNumConstraintVectors;
+        int prevNumFrictionVectors;
+
+        // The buffers exchanged with the working buffers of the solver
+        MatrixX Mlcp;
+        VectorX an0;
+        VectorX at0;
+        VectorX b;
+        VectorX solution;
+        std::vector<int> frictionIndexToContactIndex;
+        VectorX contactIndexToMu;
+        VectorX mcpHi;
+
+        IslandInfo info;
+    };
+    vector<Island> islands;
+    int numIslands;
+    vector<int> islandNodeParents;
+    vector<int> islandNodeToIslandIndex;
+    std::vector<DySubBody*> constrainedSubBodies;
+    TimeMeasure islandSolveTimer;
+
+    PhaseProfiler* profiler;
+    int collisionPhase;
+    int matrixBuildPhase;
+    int pgsPhase;
 
     Impl(DyWorldBase& world);
     ~Impl();
@@ -281,6 +341,12 @@ public:
     void initializeContactMaterials();
     ContactMaterialEx* createContactMaterialFromMaterialPair(int material1, int material2);
     void solve();
+    void extractIslands();
+    int findIslandRootNode(int nodeIndex);
+    void uniteIslandNodes(int nodeIndex1, int nodeIndex2);
+    void solveIsland(Island& island);
+    void setIslandConstraintIndices(Island& island);
+    void swapIslandBuffers(Island& island);
     void setConstraintPoints();
     void extractConstraintPoints(const CollisionPair& collisionPair);
     bool setContactConstraintPoint(LinkPair& linkPair, const Collision& collision);
@@ -315,6 +381,9 @@ public:
     void setConstantVectorAndMuBlock();
     void addConstraintForceToLinks();
     void addConstraintForceToLink(LinkPair* linkPair, int ipair);
+    void setWarmStartSolution();
+    void storeForceCaches();
+    double projectedGaussSeidelValue(const MatrixX& M, const VectorX& b, const VectorX& x, int j);
     void solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x);
     void solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x);
     void solveMCPByProjectedGaussSeidelInitial(
@@ -384,11 +453,16 @@ ConstraintForceSolver::Impl::Impl(DyWorldBase& world)
     maxNumGaussSeidelIteration = DEFAULT_MAX_NUM_GAUSS_SEIDEL_ITERATION;
     numGaussSeidelInitialIteration = DEFAULT_NUM_GAUSS_SEIDEL_INITIAL_ITERATION;
     gaussSeidelErrorCriterion = DEFAULT_GAUSS_SEIDEL_ERROR_CRITERION;
+    gaussSeidelRelaxationFactor = DEFAULT_GAUSS_SEIDEL_RELAXATION_FACTOR;
+    numGaussSeidelIterations = 0;
+    solveCounter = 0;
     contactCorrectionDepth = DEFAULT_CONTACT_CORRECTION_DEPTH;
     contactCorrectionVelocityRatio = DEFAULT_CONTACT_CORRECTION_VELOCITY_RATIO;
 
     bodyIndexToCollisionDetectionModeMap.clear();
     is2Dmode = false;
+    numIslands = 0;
+    profiler = nullptr;
 }
 
 
@@ -417,6 +491,7 @@ void ConstraintForceSolver::Impl::initSubBody(DySubBody* subBody)
     subBody->hasConstrainedLinks = false;
     subBody->isTestForceBeingApplied = false;
     subBody->hasConstrainedLinks = false;
+    subBody->islandNodeIndex = -1;
     
     for(auto& link : subBody->links()){
         link->cfs.dw.setZero();
@@ -573,8 +648,15 @@ void ConstraintForceSolver::Impl::initialize(void)
 
     bodyCollisionDetector.makeReady();
 
-    prevGlobalNumConstraintVectors = 0;
-    prevGlobalNumFrictionVectors = 0;
+    const int numSubBodies = world.numSubBodies();
+    for(int i=0; i < numSubBodies; ++i){
+        world.subBody(i)->islandNodeIndex = i;
+    }
+    islandNodeParents.resize(numSubBodies);
+    islandNodeToIslandIndex.resize(numSubBodies);
+    islands.clear();
+    numIslands = 0;
+    
     numUnconverged = 0;
 
     if(ENABLE_RANDOM_STATIC_FRICTION_BASE){
@@ -644,6 +726,8 @@ void ConstraintForceSolver::Impl::solve()
         os << "Time: " << world.currentTime() << std::endl;
     }
 
+    ++solveCounter;
+
     for(auto& subBody : world.subBodies()){
         subBody->hasConstrainedLinks = false;
         if(subBody->hasContactStateSensingLinks){
@@ -653,6 +737,10 @@ void ConstraintForceSolver::Impl::solve()
         }
     }
 
+    if(profiler){
+        profiler->beginPhase(collisionPhase);
+    }
+
     bodyCollisionDetector.updatePositions();
 
     globalNumConstraintVectors = 0;
@@ -663,6 +751,10 @@ void ConstraintForceSolver::Impl::solve()
 
     setConstraintPoints();
 
+    if(profiler){
+        profiler->endPhase(collisionPhase);
+    }
+
     if(CFS_PUT_NUM_CONTACT_POINTS){
         cout << globalNumContactNormalVectors;
     }
@@ -674,65 +766,254 @@ void ConstraintForceSolver::Impl::solve()
         }
         if(CFS_DEBUG_VERBOSE) putContactPoints();
 
-        const bool constraintsSizeChanged = ((globalNumFrictionVectors   != prevGlobalNumFrictionVectors) ||
-                                             (globalNumConstraintVectors != prevGlobalNumConstraintVectors));
+        if(areThereImpacts){
+            solveImpactConstraints();
+        }
+
+        extractIslands();
 
-        if(constraintsSizeChanged){
-            initMatrices();
+        // The global numbers are temporarily replaced with the numbers of each island
+        const int numConstraintVectors = globalNumConstraintVectors;
+        const int numContactNormalVectors = globalNumContactNormalVectors;
+        const int numFrictionVectors = globalNumFrictionVectors;
+
+        for(int i=0; i < numIslands; ++i){
+            solveIsland(islands[i]);
         }
 
-        if(areThereImpacts){
-            solveImpactConstraints();
+        globalNumConstraintVectors = numConstraintVectors;
+        globalNumContactNormalVectors = numContactNormalVectors;
+        globalNumFrictionVectors = numFrictionVectors;
+
+    } else {
+        numIslands = 0;
+    }
+}
+
+
+void ConstraintForceSolver::Impl::extractIslands()
+{
+    const int numNodes = islandNodeParents.size();
+    for(int i=0; i < numNodes; ++i){
+        islandNodeParents[i] = i;
+        islandNodeToIslandIndex[i] = -1;
+    }
+
+    // Static sub-bodies do not connect link pairs because they are not affected by constraint forces
+    for(auto& linkPair : constrainedLinkPairs){
+        auto subBody0 = linkPair->link[0]->subBody();
+        auto subBody1 = linkPair->link[1]->subBody();
+        if(!subBody0->isStatic() && !subBody1->isStatic()){
+            uniteIslandNodes(subBody0->islandNodeIndex, subBody1->islandNodeIndex);
         }
+    }
 
-        if(SKIP_REDUNDANT_ACCEL_CALC){
-            setAccelCalcSkipInformation();
+    numIslands = 0;
+    
+    for(auto& linkPair : constrainedLinkPairs){
+        auto subBody = linkPair->link[0]->subBody();
+        if(subBody->isStatic() && !linkPair->link[1]->subBody()->isStatic()){
+            subBody = linkPair->link[1]->subBody();
+        }
+        int rootNodeIndex = findIslandRootNode(subBody->islandNodeIndex);
+        int& islandIndex = islandNodeToIslandIndex[rootNodeIndex];
+        if(islandIndex < 0){
+            islandIndex = numIslands++;
+            if(islandIndex >= static_cast<int>(islands.size())){
+                islands.emplace_back();
+                auto& island = islands.back();
+                island.prevRootNodeIndex = -1;
+                island.prevNumConstraintVectors = 0;
+                island.prevNumFrictionVectors = 0;
+            }
+            auto& island = islands[islandIndex];
+            island.rootNodeIndex = rootNodeIndex;
+            island.linkPairs.clear();
+            island.subBodies.clear();
         }
+        islands[islandIndex].linkPairs.push_back(linkPair);
+    }
+
+    for(auto& subBody : world.subBodies()){
+        if(subBody->hasConstrainedLinks && !subBody->isStatic()){
+            int islandIndex = islandNodeToIslandIndex[findIslandRootNode(subBody->islandNodeIndex)];
+            if(islandIndex >= 0){
+                islands[islandIndex].subBodies.push_back(subBody);
+            }
+        }
+    }
+}
+
+
+int ConstraintForceSolver::Impl::findIslandRootNode(int nodeIndex)
+{
+    while(islandNodeParents[nodeIndex] != nodeIndex){
+        int& parent = islandNodeParents[nodeIndex];
+        parent = islandNodeParents[parent];
+        nodeIndex = parent;
+    }
+    return nodeIndex;
+}
+
+
+void ConstraintForceSolver::Impl::uniteIslandNodes(int nodeIndex1, int nodeIndex2)
+{
+    // The node with the smaller index is used as the root to keep the island identities stable
+    int root1 = findIslandRootNode(nodeIndex1);
+    int root2 = findIslandRootNode(nodeIndex2);
+    if(root1 < root2){
+        islandNodeParents[root2] = root1;
+    } else if(root2 < root1){
+        islandNodeParents[root1] = root2;
+    }
+}
+
+
+void ConstraintForceSolver::Impl::solveIsland(Island& island)
+{
+    islandSolveTimer.begin();
+
+    if(profiler){
+        profiler->beginPhase(matrixBuildPhase);
+    }
+    
+    setIslandConstraintIndices(island);
+
+    globalNumConstraintVectors = island.numConstraintVectors;
+    globalNumContactNormalVectors = island.numContactNormalVectors;
+    globalNumFrictionVectors = island.numFrictionVectors;
+
+    swapIslandBuffers(island);
+
+    const bool constraintsSizeChanged = ((globalNumFrictionVectors   != island.prevNumFrictionVectors) ||
+                                         (globalNumConstraintVectors != island.prevNumConstraintVectors) ||
+                                         (island.rootNodeIndex != island.prevRootNodeIndex));
+    if(constraintsSizeChanged){
+        initMatrices();
+    }
+
+    if(SKIP_REDUNDANT_ACCEL_CALC){
+        setAccelCalcSkipInformation();
+    }
 
-        setDefaultAccelerationVector();
-        setAccelerationMatrix();
+    setDefaultAccelerationVector();
+    setAccelerationMatrix();
 
-        clearSingularPointConstraintsOfClosedLoopConnections();
+    clearSingularPointConstraintsOfClosedLoopConnections();
 		
-        setConstantVectorAndMuBlock();
+    setConstantVectorAndMuBlock();
 
-        if(CFS_DEBUG_VERBOSE){
-            debugPutVector(an0, "an0");
-            debugPutVector(at0, "at0");
-            debugPutMatrix(Mlcp, "Mlcp");
-            debugPutVector(b.head(globalNumConstraintVectors), "b1");
-            debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
-        }
+    if(CFS_DEBUG_VERBOSE){
+        debugPutVector(an0, "an0");
+        debugPutVector(at0, "at0");
+        debugPutMatrix(Mlcp, "Mlcp");
+        debugPutVector(b.head(globalNumConstraintVectors), "b1");
+        debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
+    }
 
-        bool isConverged;
+    if(profiler){
+        profiler->endPhase(matrixBuildPhase);
+        profiler->beginPhase(pgsPhase);
+    }
+
+    bool isConverged;
 #ifdef USE_PIVOTING_LCP
-        isConverged = callPathLCPSolver(Mlcp, b, solution);
+    isConverged = callPathLCPSolver(Mlcp, b, solution);
 #else
-        if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
-            solution.setZero();
-        }
-        solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
-        isConverged = true;
+    if(USE_PREVIOUS_LCP_SOLUTION){
+        setWarmStartSolution();
+    } else {
+        solution.setZero();
+    }
+    solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
+    isConverged = true;
 #endif
 
-        if(!isConverged){
-            ++numUnconverged;
-            if(CFS_DEBUG)
-                os << "LCP didn't converge" << numUnconverged << std::endl;
-        } else {
-            if(CFS_DEBUG)
-                os << "LCP converged" << std::endl;
-            if(CFS_DEBUG_LCPCHECK){
-                // checkLCPResult(Mlcp, b, solution);
-                checkMCPResult(Mlcp, b, solution);
-            }
+    if(profiler){
+        profiler->endPhase(pgsPhase);
+    }
+
+    if(!isConverged){
+        ++numUnconverged;
+        if(CFS_DEBUG)
+            os << "LCP didn't converge" << numUnconverged << std::endl;
+    } else {
+        if(CFS_DEBUG)
+            os << "LCP converged" << std::endl;
+        if(CFS_DEBUG_LCPCHECK){
+            // checkLCPResult(Mlcp, b, solution);
+            checkMCPResult(Mlcp, b, solution);
+        }
+
+        addConstraintForceToLinks();
 
-            addConstraintForceToLinks();
+        if(USE_PREVIOUS_LCP_SOLUTION){
+            storeForceCaches();
         }
     }
 
-    prevGlobalNumConstraintVectors = globalNumConstraintVectors;
-    prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+    swapIslandBuffers(island);
+
+    island.prevRootNodeIndex = island.rootNodeIndex;
+    island.prevNumConstraintVectors = island.numConstraintVectors;
+    island.prevNumFrictionVectors = island.numFrictionVectors;
+
+    auto& info = island.info;
+    info.numSubBodies = island.subBodies.size();
+    info.numLinkPairs = island.linkPairs.size();
+    info.numConstraints = island.numConstraintVectors;
+    info.mcpSize = island.numConstraintVectors + island.numFrictionVectors;
+    info.numIterations = numGaussSeidelIterations;
+    // The buffer of the previous errors of the island is reused by the next iterations
+    info.iterationErrors.swap(gaussSeidelErrors);
+    info.solveTime = islandSolveTimer.measure();
+}
+
+
+/**
+   The constraint indices are renumbered in the island.
+   The contact constraints must be placed before the other constraints,
+   which is satisfied because the contact link pairs are listed first in constrainedLinkPairs.
+*/
+void ConstraintForceSolver::Impl::setIslandConstraintIndices(Island& island)
+{
+    int index = 0;
+    int frictionIndex = 0;
+    island.numContactNormalVectors = 0;
+    
+    for(auto& linkPair : island.linkPairs){
+        for(auto& constraint : linkPair->constraintPoints){
+            constraint.globalIndex = index++;
+            if(!linkPair->isNonContactConstraint){
+                constraint.globalFrictionIndex = frictionIndex;
+                frictionIndex += constraint.numFrictionVectors;
+            }
+        }
+        if(!linkPair->isNonContactConstraint){
+            island.numContactNormalVectors = index;
+        }
+    }
+    island.numConstraintVectors = index;
+    island.numFrictionVectors = frictionIndex;
+}
+
+
+/**
+   The working buffers used in the solving functions are exchanged with the buffers of the island
+   so that the matrix sizes and the previous solution for the warm start are kept for each island.
+*/
+void ConstraintForceSolver::Impl::swapIslandBuffers(Island& island)
+{
+    constrainedLinkPairs.swap(island.linkPairs);
+    constrainedSubBodies.swap(island.subBodies);
+    Mlcp.swap(island.Mlcp);
+    an0.swap(island.an0);
+    at0.swap(island.at0);
+    b.swap(island.b);
+    solution.swap(island.solution);
+    frictionIndexToContactIndex.swap(island.frictionIndexToContactIndex);
+    contactIndexToMu.swap(island.contactIndexToMu);
+    mcpHi.swap(island.mcpHi);
 }
 
 
@@ -839,6 +1120,7 @@ bool ConstraintForceSolver::Impl::setContactConstraintPoint(LinkPair& linkPair,
     contact.normalTowardInside[1] = collision.normal;
     contact.normalTowardInside[0] = -contact.normalTowardInside[1];
     contact.depth = collision.depth;
+    contact.featureId = collision.id;
     contact.globalIndex = globalNumConstraintVectors++;
 
     // check velocities
@@ -1114,7 +1396,7 @@ void ConstraintForceSolver::Impl::initMatrices()
 void ConstraintForceSolver::Impl::setAccelCalcSkipInformation()
 {
     // clear skip check numbers
-    for(auto& subBody : world.subBodies()){
+    for(auto& subBody : constrainedSubBodies){
         if(subBody->hasConstrainedLinks){
             for(auto& link : subBody->links()){
                 link->cfs.numberToCheckAccelCalcSkip = numeric_limits<int>::max();
@@ -1147,7 +1429,7 @@ void ConstraintForceSolver::Impl::setAccelCalcSkipInformation()
 void ConstraintForceSolver::Impl::setDefaultAccelerationVector()
 {
     // calculate accelerations with no constraint force
-    for(auto& subBody : world.subBodies()){
+    for(auto& subBody : constrainedSubBodies){
         if(subBody->hasConstrainedLinks && !subBody->isStatic()){
             if(auto cbm = subBody->forwardDynamicsCBM()){
                 cbm->sumExternalForces();
@@ -1720,6 +2002,95 @@ void ConstraintForceSolver::Impl::addConstraintForceToLink(LinkPair* linkPair, i
 }
 
 
+/**
+   The initial solution of the iterative solver is given by the forces solved in the previous step.
+   A contact point takes over the force of the previous contact point of the same link pair which
+   has the same collision id and is the nearest within the culling distance in the link frame,
+   so that the warm start is available even if the set of the contact points changes.
+   The forces of the other constraints are taken over by the constraint order in the link pair.
+*/
+void ConstraintForceSolver::Impl::setWarmStartSolution()
+{
+    solution.setZero();
+
+    for(auto& linkPair : constrainedLinkPairs){
+        auto& caches = linkPair->forceCaches;
+        if(linkPair->forceCacheCounter != solveCounter - 1 || caches.empty()){
+            continue;
+        }
+        auto& constraintPoints = linkPair->constraintPoints;
+
+        if(linkPair->isNonContactConstraint){
+            const int n = std::min(constraintPoints.size(), caches.size());
+            for(int i=0; i < n; ++i){
+                solution(constraintPoints[i].globalIndex) = caches[i].normalForce;
+            }
+            continue;
+        }
+
+        const double maxDistance = linkPair->contactMaterial->cullingDistance;
+        const double maxDistance2 = std::max(maxDistance * maxDistance, 1.0e-12);
+        auto link0 = linkPair->link[0];
+        const Matrix3 Rt = link0->R().transpose();
+
+        for(auto& constraint : constraintPoints){
+            const Vector3 localPoint = Rt * (constraint.point - link0->p());
+            const ForceCache* matched = nullptr;
+            double minCost = std::numeric_limits<double>::max();
+            for(auto& cache : caches){
+                double distance2 = (cache.localPoint - localPoint).squaredNorm();
+                if(distance2 < maxDistance2){
+                    // The cache of the same collision feature is prioritized
+                    double cost = (cache.featureId == constraint.featureId) ? distance2 : (distance2 + maxDistance2);
+                    if(cost < minCost){
+                        minCost = cost;
+                        matched = &cache;
+                    }
+                }
+            }
+            if(matched){
+                solution(constraint.globalIndex) = matched->normalForce;
+                const int frictionTop = globalNumConstraintVectors + constraint.globalFrictionIndex;
+                for(int k=0; k < constraint.numFrictionVectors; ++k){
+                    double f = matched->frictionForce.dot(constraint.frictionVector[k][0]);
+                    if(!STATIC_FRICTION_BY_TWO_CONSTRAINTS && constraint.numFrictionVectors > 1 && f < 0.0){
+                        f = 0.0;
+                    }
+                    solution(frictionTop + k) = f;
+                }
+            }
+        }
+    }
+}
+
+
+void ConstraintForceSolver::Impl::storeForceCaches()
+{
+    for(auto& linkPair : constrainedLinkPairs){
+        auto& constraintPoints = linkPair->constraintPoints;
+        auto& caches = linkPair->forceCaches;
+        caches.resize(constraintPoints.size());
+        auto link0 = linkPair->link[0];
+        const Matrix3 Rt = link0->R().transpose();
+        for(size_t i=0; i < constraintPoints.size(); ++i){
+            auto& constraint = constraintPoints[i];
+            auto& cache = caches[i];
+            cache.normalForce = solution(constraint.globalIndex);
+            if(!linkPair->isNonContactConstraint){
+                cache.featureId = constraint.featureId;
+                cache.localPoint.noalias() = Rt * (constraint.point - link0->p());
+                cache.frictionForce.setZero();
+                const int frictionTop = globalNumConstraintVectors + constraint.globalFrictionIndex;
+                for(int k=0; k < constraint.numFrictionVectors; ++k){
+                    cache.frictionForce += solution(frictionTop + k) * constraint.frictionVector[k][0];
+                }
+            }
+        }
+        linkPair->forceCacheCounter = solveCounter;
+    }
+}
+
+
 void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x)
 {
     static const int loopBlockSize = DEFAULT_NUM_GAUSS_SEIDEL_ITERATION_BLOCK;
@@ -1739,6 +2110,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
 
     double error = 0.0;
     VectorXd x0;
+    gaussSeidelErrors.clear();
     int i = 0;
     while(i < numBlockLoops){
         i++;
@@ -1770,6 +2142,8 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
             }
         }
 
+        gaussSeidelErrors.push_back(error);
+
         if(error < gaussSeidelErrorCriterion){
             if(CFS_MCP_DEBUG_SHOW_ITERATION_STOP){
                 os << "stopped at " << (i * loopBlockSize) << ", error = " << error << endl;
@@ -1778,6 +2152,8 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
         }
     }
 
+    numGaussSeidelIterations = numGaussSeidelInitialIteration + i * loopBlockSize;
+
     if(CFS_MCP_DEBUG){
 
         if(i == numBlockLoops){
@@ -1795,22 +2171,34 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
 }
 
 
+/**
+   This function returns the Gauss-Seidel update of the j-th element of the solution before the projection.
+   The product of the matrix row and the solution is computed by the vectorized dot product of Eigen,
+   which uses the SIMD instructions enabled by the compiler options such as AVX2 and falls back to the
+   scalar operations otherwise. The update is over-relaxed when the relaxation factor is not one.
+*/
+inline double ConstraintForceSolver::Impl::projectedGaussSeidelValue
+(const MatrixX& M, const VectorX& b, const VectorX& x, int j)
+{
+    const double Mjj = M(j, j);
+    if(Mjj == numeric_limits<double>::max()){
+        return 0.0;
+    }
+    const double sum = M.row(j).dot(x) - Mjj * x(j);
+    double xx = (-b(j) - sum) / Mjj;
+    if(gaussSeidelRelaxationFactor != 1.0){
+        xx = x(j) + gaussSeidelRelaxationFactor * (xx - x(j));
+    }
+    return xx;
+}
+
+
 void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x)
 {
     const int size = globalNumConstraintVectors + globalNumFrictionVectors;
 
     for(int j=0; j < globalNumContactNormalVectors; ++j){
-
-        double xx;
-        if(M(j,j) == numeric_limits<double>::max()){
-            xx=0.0;
-        } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
-            xx = (-b(j) - sum) / M(j, j);
-        }
+        const double xx = projectedGaussSeidelValue(M, b, x, j);
         if(xx < 0.0){
             x(j) = 0.0;
         } else {
@@ -1820,48 +2208,20 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
     }
     
     for(int j=globalNumContactNormalVectors; j < globalNumConstraintVectors; ++j){
-        
-        if(M(j,j) == numeric_limits<double>::max()){
-            x(j)=0.0;
-        } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
-            x(j) = (-b(j) - sum) / M(j, j);
-        }
+        x(j) = projectedGaussSeidelValue(M, b, x, j);
     }
     
-    
     if(ENABLE_TRUE_FRICTION_CONE){
 
         int contactIndex = 0;
         for(int j=globalNumConstraintVectors; j < size; ++j, ++contactIndex){
             
-            double fx0;
-            if(M(j,j) == numeric_limits<double>::max()) {
-                fx0 = 0.0;
-            } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
-                fx0 = (-b(j) - sum) / M(j, j);
-            }
+            const double fx0 = projectedGaussSeidelValue(M, b, x, j);
             double& fx = x(j);
             
             ++j;
             
-            double fy0;
-            if(M(j,j) == numeric_limits<double>::max()) {
-                fy0=0.0;
-            } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
-                fy0 = (-b(j) - sum) / M(j, j);
-            }
+            const double fy0 = projectedGaussSeidelValue(M, b, x, j);
             double& fy = x(j);
             
             const double fmax = mcpHi[contactIndex];
@@ -1883,17 +2243,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
         int frictionIndex = 0;
         for(int j=globalNumConstraintVectors; j < size; ++j, ++frictionIndex){
 
-            double xx;
-            if(M(j,j) == numeric_limits<double>::max()) {
-                xx=0.0;
-            } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
-                xx = (-b(j) - sum) / M(j, j);
-            }
-            
+            const double xx = projectedGaussSeidelValue(M, b, x, j);
             const int contactIndex = frictionIndexToContactIndex[frictionIndex];
             const double fmax = mcpHi[contactIndex];
             const double fmin = (STATIC_FRICTION_BY_TWO_CONSTRAINTS ? -fmax : 0.0);
@@ -1926,10 +2276,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
             if(M(j,j)==numeric_limits<double>::max()){
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = M.row(j).dot(x) - M(j, j) * x(j);
                 xx = (-b(j) - sum) / M(j, j);
             }
             if(xx < 0.0){
@@ -1946,10 +2293,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
             if(M(j,j)==numeric_limits<double>::max()){
                 x(j) = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = M.row(j).dot(x) - M(j, j) * x(j);
                 x(j) = r * (-b(j) - sum) / M(j, j);
             }
             r += rstep;
@@ -1964,10 +2308,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fx0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = M.row(j).dot(x) - M(j, j) * x(j);
                     fx0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fx = x(j);
@@ -1978,10 +2319,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fy0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = M.row(j).dot(x) - M(j, j) * x(j);
                     fy0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fy = x(j);
@@ -2010,10 +2348,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     xx = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = M.row(j).dot(x) - M(j, j) * x(j);
                     xx = (-b(j) - sum) / M(j, j);
                 }
 
@@ -2202,6 +2537,17 @@ double ConstraintForceSolver::maxFrictionCoefficient() const
 }
 
 
+void ConstraintForceSolver::setProfiler(PhaseProfiler* profiler)
+{
+    impl->profiler = profiler;
+    if(profiler){
+        impl->collisionPhase = profiler->addPhase("ConstraintForceSolver: collision");
+        impl->matrixBuildPhase = profiler->addPhase("ConstraintForceSolver: matrix build");
+        impl->pgsPhase = profiler->addPhase("ConstraintForceSolver: PGS");
+    }
+}
+
+
 void ConstraintForceSolver::registerCollisionHandler(const std::string& name, CollisionHandler handler)
 {
     ConstraintForceSolver::Impl::CollisionHandlerInfoPtr info = new ConstraintForceSolver::Impl::CollisionHandlerInfo;;
@@ -2293,6 +2639,18 @@ int ConstraintForceSolver::gaussSeidelMaxNumIterations()
 }
 
 
+void ConstraintForceSolver::setGaussSeidelRelaxationFactor(double w)
+{
+    impl->gaussSeidelRelaxationFactor = w;
+}
+
+
+double ConstraintForceSolver::gaussSeidelRelaxationFactor() const
+{
+    return impl->gaussSeidelRelaxationFactor;
+}
+
+
 void ConstraintForceSolver::setContactDepthCorrection(double depth, double velocityRatio)
 {
     impl->contactCorrectionDepth = depth;
@@ -2344,6 +2702,18 @@ void ConstraintForceSolver::clearExternalForces()
 }
 
 
+int ConstraintForceSolver::numIslands() const
+{
+    return impl->numIslands;
+}
+
+
+const ConstraintForceSolver::IslandInfo& ConstraintForceSolver::islandInfo(int index) const
+{
+    return impl->islands[index].info;
+}
+
+
 shared_ptr<CollisionLinkPairList> ConstraintForceSolver::getCollisions()
 {
     return impl->getCollisions();
@@ -6,6 +6,7 @@
 #define CNOID_BODY_CONSTRAINT_FORCE_SOLVER_H
 
 #include <cnoid/CollisionSeq>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -15,6 +16,7 @@ class DyWorldBase;
 class CollisionDetector;
 class ContactMaterial;
 class MaterialTable;
+class PhaseProfiler;
 	
 class CNOID_EXPORT ConstraintForceSolver
 {
@@ -49,6 +51,13 @@ public:
     void setGaussSeidelMaxNumIterations(int n);
     int gaussSeidelMaxNumIterations();
 
+    /**
+       The relaxation factor of the successive over-relaxation applied to the Gauss-Seidel iterations.
+       The default value is one, which corresponds to the plain projected Gauss-Seidel method.
+    */
+    void setGaussSeidelRelaxationFactor(double w);
+    double gaussSeidelRelaxationFactor() const;
+
     void setContactDepthCorrection(double depth, double velocityRatio);
     double contactCorrectionDepth();
     double contactCorrectionVelocityRatio();
@@ -64,6 +73,32 @@ public:
 
     std::shared_ptr<CollisionLinkPairList> getCollisions();
 
+    /**
+       The constrained link pairs are divided into islands, which are groups of link pairs
+       connected via non-static sub-bodies, and the MCP is solved for each island separately.
+       The following functions give the information on the islands solved in the last step.
+       AISTSimulatorItem puts the statistics of them when the step profiling is enabled.
+    */
+    struct IslandInfo
+    {
+        int numSubBodies;
+        int numLinkPairs;
+        int numConstraints;
+        int mcpSize;
+        int numIterations;
+        //! The relative change of the solution in each iteration, which is used as the convergence error
+        std::vector<double> iterationErrors;
+        double solveTime;
+    };
+    int numIslands() const;
+    const IslandInfo& islandInfo(int index) const;
+
+    /**
+       The elapsed times of the collision detection, the matrix build and the PGS iterations
+       are recorded in the profiler as the sub phases of the step. Set nullptr to disable it.
+    */
+    void setProfiler(PhaseProfiler* profiler);
+
     // experimental functions
     typedef std::function<bool(Link* link1, Link* link2,
                                const CollisionArray& collisions,
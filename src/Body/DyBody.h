@@ -61,6 +61,7 @@ private:
     bool hasConstrainedLinks;
     bool hasContactStateSensingLinks;
     bool isTestForceBeingApplied;
+    int islandNodeIndex;
     Vector3 dpf;
     Vector3 dptau;
 
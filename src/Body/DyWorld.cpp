@@ -3,6 +3,7 @@
 */
 
 #include "DyWorld.h"
+#include <cnoid/ParallelScheduler>
 
 using namespace std;
 using namespace cnoid;
@@ -22,6 +23,7 @@ DyWorldBase::DyWorldBase()
     sensorsAreEnabled = false;
     isOldAccelSensorCalcMode = false;
     numRegisteredLinkPairs = 0;
+    numThreads_ = 1;
 }
 
 
@@ -71,6 +73,12 @@ void DyWorldBase::setOldAccelSensorCalcMode(bool on)
 }
 
 
+void DyWorldBase::setNumThreads(int n)
+{
+    numThreads_ = std::max(1, n);
+}
+
+
 void DyWorldBase::initialize()
 {
     for(auto& subBody : subBodies_){
@@ -86,6 +94,55 @@ void DyWorldBase::initialize()
         forwardDynamics->setOldAccelSensorCalcMode(isOldAccelSensorCalcMode);
         forwardDynamics->initialize();
     }
+
+    updateSubBodyGroups();
+
+    const bool isParallel = subBodyGroupOffsets.size() > 2;
+    for(auto& subBody : subBodies_){
+        subBody->forwardDynamics()->setSensorStateChangeNotificationDeferred(isParallel);
+    }
+}
+
+
+/**
+   The bodies are divided into contiguous groups so that each group has about the same number of
+   links of the non-static sub bodies, which approximates the computational cost of the group.
+*/
+void DyWorldBase::updateSubBodyGroups()
+{
+    subBodyGroupOffsets.clear();
+
+    const int numGroups = std::min(numThreads_, static_cast<int>(bodies_.size()));
+    if(numGroups <= 1){
+        return;
+    }
+
+    vector<int> bodyCosts;
+    bodyCosts.reserve(bodies_.size());
+    int totalCost = 0;
+    for(auto& body : bodies_){
+        int cost = 0;
+        for(auto& subBody : body->subBodies()){
+            cost += subBody->isStatic() ? 1 : subBody->numLinks();
+        }
+        bodyCosts.push_back(cost);
+        totalCost += cost;
+    }
+
+    subBodyGroupOffsets.push_back(0);
+    int subBodyIndex = 0;
+    int accumulatedCost = 0;
+    for(size_t i=0; i < bodies_.size(); ++i){
+        subBodyIndex += bodies_[i]->subBodies().size();
+        accumulatedCost += bodyCosts[i];
+        const int groupIndex = subBodyGroupOffsets.size();
+        if(groupIndex < numGroups && accumulatedCost * numGroups >= totalCost * groupIndex){
+            subBodyGroupOffsets.push_back(subBodyIndex);
+        }
+    }
+    if(subBodyGroupOffsets.back() != subBodyIndex){
+        subBodyGroupOffsets.push_back(subBodyIndex);
+    }
 }
 
 
@@ -99,8 +156,22 @@ void DyWorldBase::setVirtualJointForces()
 
 void DyWorldBase::calcNextState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->calcNextState();
+    if(subBodyGroupOffsets.size() > 2){
+        parallelFor(
+            0, subBodyGroupOffsets.size() - 1, 1,
+            [this](int groupBegin, int groupEnd){
+                for(int i = subBodyGroupOffsets[groupBegin]; i < subBodyGroupOffsets[groupEnd]; ++i){
+                    subBodies_[i]->forwardDynamics()->calcNextState();
+                }
+            });
+        // The signals of the sensors are emitted in the calling thread
+        for(auto& subBody : subBodies_){
+            subBody->forwardDynamics()->notifySensorStateChanges();
+        }
+    } else {
+        for(auto& subBody : subBodies_){
+            subBody->forwardDynamics()->calcNextState();
+        }
     }
     currentTime_ += timeStep_;
 }
@@ -108,8 +179,18 @@ void DyWorldBase::calcNextState()
 
 void DyWorldBase::refreshState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->refreshState();
+    if(subBodyGroupOffsets.size() > 2){
+        parallelFor(
+            0, subBodyGroupOffsets.size() - 1, 1,
+            [this](int groupBegin, int groupEnd){
+                for(int i = subBodyGroupOffsets[groupBegin]; i < subBodyGroupOffsets[groupEnd]; ++i){
+                    subBodies_[i]->forwardDynamics()->refreshState();
+                }
+            });
+    } else {
+        for(auto& subBody : subBodies_){
+            subBody->forwardDynamics()->refreshState();
+        }
     }
 }
 
@@ -132,6 +213,12 @@ int DyWorldBase::addBody(DyBody* body)
         }
     }
 
+    for(auto& link : body->links()){
+        if(link->actuationMode() == Link::AllStateHighGainActuationMode){
+            allStateHighGainLinks.push_back(static_cast<DyLink*>(link));
+        }
+    }
+
     if(!body->name().empty()){
         nameToBodyMap[body->name()] = body;
     }
@@ -145,11 +232,33 @@ void DyWorldBase::clearBodies()
     bodies_.clear();
     bodiesWithVirtualJointForces_.clear();
     subBodies_.clear();
+    subBodyGroupOffsets.clear();
     nameToBodyMap.clear();
+    allStateHighGainLinks.clear();
     hasHighGainDynamics_ = false;
 }
 
 
+void DyWorldBase::updateAllStateHighGainLinks()
+{
+    bool doRefresh = false;
+    for(auto& link : allStateHighGainLinks){
+        // The actuation mode may be changed by a controller during the simulation
+        if(link->actuationMode() == Link::AllStateHighGainActuationMode){
+            if(link->hasJoint()){
+                link->q() = link->q_target();
+                link->dq() = link->dq_target();
+            }
+            link->vo() = link->v() - link->w().cross(link->p());
+            doRefresh = true;
+        }
+    }
+    if(doRefresh){
+        refreshState();
+    }
+}
+
+
 void DyWorldBase::clearCollisionPairs()
 {
     linkPairKeyToIndexMap.clear();
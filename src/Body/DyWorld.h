@@ -87,6 +87,25 @@ public:
     virtual void calcNextState();
 
     void refreshState();
+
+    /**
+       \brief Set the states of the links in the all-state high-gain actuation mode to their target states
+       \note This is called before calcNextState() in each step of the forward dynamics simulation.
+    */
+    void updateAllStateHighGainLinks();
+
+    /**
+       \brief Set the number of threads used to compute the forward dynamics of the bodies
+       \note The bodies are divided into the given number of groups balanced by the number of links,
+       and the groups are processed in parallel. The sub bodies of a body are always processed in the
+       same group because the sensor simulation of a body refers to the states of all its links.
+       The state change signals of the sensors are emitted in the thread calling calcNextState()
+       after the parallel computation of all the bodies is finished.
+       The default value is one, which means the sequential computation.
+       This must be called before initialize() is called.
+    */
+    void setNumThreads(int n);
+    int numThreads() const { return numThreads_; }
         
     /**
        \brief get index of link pairs
@@ -107,6 +126,11 @@ private:
     std::vector<DyBodyPtr> bodies_;
     std::vector<DySubBodyPtr> subBodies_;
     std::vector<DyBodyPtr> bodiesWithVirtualJointForces_;
+    std::vector<DyLink*> allStateHighGainLinks;
+
+    // The ranges of subBodies_ processed in parallel
+    std::vector<int> subBodyGroupOffsets;
+    int numThreads_;
     std::map<std::string, DyBodyPtr> nameToBodyMap;
 
     Vector3 g;
@@ -127,6 +151,7 @@ private:
     std::vector<ExtraJoint> extraJoints_;
 
     void extractInternalBodies(Link* link);    
+    void updateSubBodyGroups();
 };
 
 template <class TConstraintForceSolver> class DyWorld : public DyWorldBase
@@ -17,6 +17,8 @@ ForwardDynamics::ForwardDynamics(DySubBody* subBody)
 
     integrationMode = RUNGEKUTTA_METHOD;
     sensorsEnabled = false;
+    isSensorStateChangeNotificationDeferred = false;
+    hasPendingForceSensorStateChanges = false;
 }
 
 
@@ -62,6 +64,38 @@ void ForwardDynamics::setOldAccelSensorCalcMode(bool on)
 }
 
 
+void ForwardDynamics::setSensorStateChangeNotificationDeferred(bool on)
+{
+    isSensorStateChangeNotificationDeferred = on;
+    sensorHelper.setStateChangeNotificationDeferred(on);
+}
+
+
+void ForwardDynamics::notifySensorStateChanges()
+{
+    if(hasPendingForceSensorStateChanges){
+        for(auto& sensor : subBody->forceSensors()){
+            sensor->notifyStateChange();
+        }
+        hasPendingForceSensorStateChanges = false;
+    }
+    sensorHelper.notifyStateChanges();
+}
+
+
+//! This function is called by the force sensor update functions of the sub classes
+void ForwardDynamics::notifyForceSensorStateChanges()
+{
+    if(isSensorStateChangeNotificationDeferred){
+        hasPendingForceSensorStateChanges = true;
+    } else {
+        for(auto& sensor : subBody->forceSensors()){
+            sensor->notifyStateChange();
+        }
+    }
+}
+
+
 /// function from Murray, Li and Sastry p.42
 void ForwardDynamics::SE3exp
 (Isometry3& out_T, const Isometry3& T0, const Vector3& w, const Vector3& vo, double dt)
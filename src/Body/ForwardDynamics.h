@@ -34,12 +34,22 @@ public:
     void enableSensors(bool on);
     void setOldAccelSensorCalcMode(bool on);
 
+    /**
+       When this is enabled, calcNextState does not notify the state changes of the sensors,
+       and notifySensorStateChanges must be called after it to notify the updated sensors.
+       This is used to emit the signals in the simulation thread when the forward dynamics of
+       the bodies are calculated in parallel.
+    */
+    void setSensorStateChangeNotificationDeferred(bool on);
+    void notifySensorStateChanges();
+
     virtual void initialize() = 0;
     virtual void calcNextState() = 0;
     virtual void refreshState() = 0;
 
 protected:
     virtual void initializeSensors();
+    void notifyForceSensorStateChanges();
 
     /**
        @brief update position/orientation using spatial velocity
@@ -57,6 +67,8 @@ protected:
     Vector3 g;
     double timeStep;
     bool sensorsEnabled;
+    bool isSensorStateChangeNotificationDeferred;
+    bool hasPendingForceSensorStateChanges;
     BasicSensorSimulationHelper sensorHelper;
 
     enum { EULER_METHOD, RUNGEKUTTA_METHOD } integrationMode;
@@ -513,6 +513,6 @@ void ForwardDynamicsABM::updateForceSensors()
         const Vector3 p = link->p() + link->R() * sensor->p_local();
         sensor->f().noalias()   = R.transpose() * f;
         sensor->tau().noalias() = R.transpose() * (tau - p.cross(f));
-        sensor->notifyStateChange();
     }
+    notifyForceSensorStateChanges();
 }
@@ -822,6 +822,6 @@ void ForwardDynamicsCBM::updateForceSensors()
         const Vector3 p = link->p() + link->R() * sensor->p_local();
         sensor->f()   = R.transpose() * link->cbm->f;
         sensor->tau() = R.transpose() * (link->cbm->tau - p.cross(link->cbm->f));
-        sensor->notifyStateChange();
     }
+    notifyForceSensorStateChanges();
 }
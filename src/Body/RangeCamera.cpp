@@ -23,6 +23,15 @@ RangeCamera::RangeCamera(const RangeCamera& org, bool copyStateOnly)
     : Camera(org, copyStateOnly)
 {
     copyRangeCameraStateFrom(org);
+
+    if(copyStateOnly){
+        encodedPoints_ = org.encodePoints();
+        if(encodedPoints_){
+            points_ = std::make_shared<PointData>();
+        }
+    } else if(org.encodedPoints_){
+        points_ = org.encodedPoints_->decode();
+    }
 }
 
 
@@ -45,7 +54,15 @@ void RangeCamera::copyStateFrom(const RangeCamera& other)
 {
     Camera::copyStateFrom(other);
     copyRangeCameraStateFrom(other);
-    points_ = other.points_;
+
+    encodedPoints_.reset();
+    if(other.encodedPoints_){
+        points_ = other.encodedPoints_->decode();
+        lastEncodedSourcePoints_ = points_;
+        lastEncodedPoints_ = other.encodedPoints_;
+    } else {
+        points_ = other.points_;
+    }
 }
 
 
@@ -64,6 +81,23 @@ void RangeCamera::copyRangeCameraStateFrom(const RangeCamera& other)
 }
 
 
+EncodedPointDataPtr RangeCamera::encodePoints() const
+{
+    if(encodedPoints_){
+        return encodedPoints_;
+    }
+    auto encoder = imageStateEncoder();
+    if(!encoder || !isImageStateClonable() || points_->empty()){
+        return nullptr;
+    }
+    if(!lastEncodedPoints_ || lastEncodedSourcePoints_.lock() != points_){
+        lastEncodedPoints_ = encoder->encodePoints(points_);
+        lastEncodedSourcePoints_ = points_;
+    }
+    return lastEncodedPoints_;
+}
+
+
 Referenced* RangeCamera::doClone(CloneMap*) const
 {
     return new RangeCamera(*this, false);
@@ -86,6 +120,11 @@ void RangeCamera::forEachActualType(std::function<bool(const std::type_info& typ
 
 RangeCamera::PointData& RangeCamera::points()
 {
+    if(encodedPoints_){
+        points_ = encodedPoints_->decode();
+        encodedPoints_.reset();
+    }
+    lastEncodedPoints_.reset();
     if(points_.use_count() > 1){
         points_ = std::make_shared<PointData>(*points_);
     }
@@ -121,6 +160,7 @@ void RangeCamera::clearState()
 
 void RangeCamera::clearPoints()
 {
+    encodedPoints_.reset();
     if(points_.use_count() == 1){
         points_->clear();
     } else {
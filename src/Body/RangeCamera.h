@@ -70,12 +70,16 @@ protected:
 
 private:
     std::shared_ptr<std::vector<Vector3f>> points_;
+    EncodedPointDataPtr encodedPoints_;
+    mutable std::weak_ptr<PointData> lastEncodedSourcePoints_;
+    mutable EncodedPointDataPtr lastEncodedPoints_;
     double minDistance_;
     double maxDistance_;
     bool isOrganized_;
     bool isDense_;
 
     void copyRangeCameraStateFrom(const RangeCamera& other);    
+    EncodedPointDataPtr encodePoints() const;
 };
 
 typedef ref_ptr<RangeCamera> RangeCameraPtr;
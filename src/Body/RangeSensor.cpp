@@ -40,9 +40,19 @@ RangeSensor::RangeSensor(const RangeSensor& org, bool copyStateOnly)
         isRangeDataStateClonable_ = true;
     } else {
         isRangeDataStateClonable_ = org.isRangeDataStateClonable_;
+        rangeDataStateEncoder_ = org.rangeDataStateEncoder_;
     }
 
     copyRangeSensorStateFrom(org);
+
+    if(copyStateOnly){
+        encodedRangeData_ = org.encodeRangeData();
+        if(encodedRangeData_){
+            rangeData_ = std::make_shared<RangeData>();
+        }
+    } else if(org.encodedRangeData_){
+        rangeData_ = org.encodedRangeData_->decode();
+    }
 }
 
 
@@ -58,7 +68,15 @@ void RangeSensor::copyStateFrom(const DeviceState& other)
 void RangeSensor::copyStateFrom(const RangeSensor& other)
 {
     copyRangeSensorStateFrom(other);
-    rangeData_ = other.rangeData_;
+
+    encodedRangeData_.reset();
+    if(other.encodedRangeData_){
+        rangeData_ = other.encodedRangeData_->decode();
+        lastEncodedSourceRangeData_ = rangeData_;
+        lastEncodedRangeData_ = other.encodedRangeData_;
+    } else {
+        rangeData_ = other.rangeData_;
+    }
 }
 
 
@@ -82,6 +100,22 @@ void RangeSensor::copyRangeSensorStateFrom(const RangeSensor& other)
 }
 
 
+EncodedRangeDataPtr RangeSensor::encodeRangeData() const
+{
+    if(encodedRangeData_){
+        return encodedRangeData_;
+    }
+    if(!rangeDataStateEncoder_ || !isRangeDataStateClonable_ || rangeData_->empty()){
+        return nullptr;
+    }
+    if(!lastEncodedRangeData_ || lastEncodedSourceRangeData_.lock() != rangeData_){
+        lastEncodedRangeData_ = rangeDataStateEncoder_->encodeRangeData(rangeData_);
+        lastEncodedSourceRangeData_ = rangeData_;
+    }
+    return lastEncodedRangeData_;
+}
+
+
 Referenced* RangeSensor::doClone(CloneMap*) const
 {
     return new RangeSensor(*this, false);
@@ -124,6 +158,11 @@ int RangeSensor::numPitchSamples() const
 
 RangeSensor::RangeData& RangeSensor::rangeData()
 {
+    if(encodedRangeData_){
+        rangeData_ = encodedRangeData_->decode();
+        encodedRangeData_.reset();
+    }
+    lastEncodedRangeData_.reset();
     if(rangeData_.use_count() > 1){
         rangeData_ = std::make_shared<RangeData>(*rangeData_);
     }
@@ -157,6 +196,7 @@ void RangeSensor::clearState()
 
 void RangeSensor::clearRangeData()
 {
+    encodedRangeData_.reset();
     if(rangeData_.use_count() == 1){
         rangeData_->clear();
     } else {
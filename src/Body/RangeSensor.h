@@ -7,6 +7,7 @@
 #define CNOID_BODY_RANGE_SENSOR_H
 
 #include "Device.h"
+#include "SensorDataEncoder.h"
 #include <vector>
 #include <memory>
 #include "exportdecl.h"
@@ -56,6 +57,13 @@ public:
     void setRangeDataStateClonable(bool on) { isRangeDataStateClonable_ = on; }
     bool isRangeDataStateClonable() const { return isRangeDataStateClonable_; }
 
+    /**
+       The range data of a state cloned by cloneState is encoded by the encoder when it is set.
+       See Camera::setImageStateEncoder.
+    */
+    void setRangeDataStateEncoder(SensorDataEncoder* encoder) { rangeDataStateEncoder_ = encoder; }
+    SensorDataEncoder* rangeDataStateEncoder() const { return rangeDataStateEncoder_; }
+
     /**
        \note You must check if the range data is not empty before accessing the data
     */
@@ -100,8 +108,13 @@ private:
     double scanRate_;
     double delay_;
     std::shared_ptr<RangeData> rangeData_;
+    EncodedRangeDataPtr encodedRangeData_;
+    SensorDataEncoderPtr rangeDataStateEncoder_; // Non state variable
+    mutable std::weak_ptr<RangeData> lastEncodedSourceRangeData_;
+    mutable EncodedRangeDataPtr lastEncodedRangeData_;
 
     void copyRangeSensorStateFrom(const RangeSensor& other);    
+    EncodedRangeDataPtr encodeRangeData() const;
 };
 
 typedef ref_ptr<RangeSensor> RangeSensorPtr;
@@ -0,0 +1,591 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "RaycastVisionSimulator.h"
+#include "Body.h"
+#include "RangeSensor.h"
+#include "RangeCamera.h"
+#include <cnoid/SceneRaycaster>
+#include <cnoid/SceneCameras>
+#include <cnoid/MeshFilter>
+#include <cnoid/CloneMap>
+#include <cnoid/ValueTree>
+#include <cnoid/ParallelScheduler>
+#include <cnoid/SharedObjectPool>
+#include <memory>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int RayChunkSize = 64 * SceneRaycaster::PacketSize;
+
+class SensorInfo
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    DevicePtr device;
+    RangeSensor* rangeSensor;
+    RangeCamera* rangeCamera;
+    DevicePtr deviceForMeasurement;
+    RangeSensor* rangeSensorForMeasurement;
+    RangeCamera* rangeCameraForMeasurement;
+    std::function<void()> notifyDataUpdate;
+
+    SceneRaycaster raycaster;
+    Isometry3 T_sensor;
+    ParallelTaskGroup taskGroup;
+
+    double elapsedTime;
+    double cycleTime;
+    double latency;
+    double onsetTime;
+    bool wasDeviceOn;
+    bool isMeasuring;
+    bool needToClearData;
+
+    // The ray directions in the sensor coordinate and the parameters they are made from
+    vector<Vector3f> localDirections;
+    vector<double> directionParameters;
+
+    vector<Vector3f> directions;
+    vector<float> distances;
+    vector<Vector3f> colors;
+    std::shared_ptr<RangeSensor::RangeData> rangeData;
+    std::shared_ptr<RangeCamera::PointData> points;
+    std::shared_ptr<Image> image;
+    bool isDense;
+
+    // The buffers are recycled when the devices and their copies release them
+    SharedObjectPool<RangeSensor::RangeData> rangeDataPool;
+    SharedObjectPool<RangeCamera::PointData> pointsPool;
+    SharedObjectPool<Image> imagePool;
+
+    SensorInfo(Device* device);
+    void updateDirections();
+    void updateRangeSensorDirections();
+    void updateRangeCameraDirections();
+    void measure(double depthError);
+    void storeRangeData(double depthError);
+    void storeRangeCameraData();
+    void copyData(double currentTime);
+    void clearData();
+};
+
+typedef unique_ptr<SensorInfo> SensorInfoPtr;
+
+/**
+   The simplification of the meshes for the sensors is specified by the "sensor" entry of the
+   "levelOfDetail" mapping in the body file, which is also used by GLVisionSimulatorItem.
+*/
+bool getSensorLevelOfDetail(Body* body, double& out_ratio, double& out_maxError)
+{
+    auto lodNode = body->info()->findMapping("levelOfDetail");
+    if(!lodNode->isValid()){
+        return false;
+    }
+    auto sensorNode = lodNode->findMapping("sensor");
+    if(!sensorNode->isValid()){
+        return false;
+    }
+    out_ratio = sensorNode->get("ratio", 1.0);
+    out_maxError = sensorNode->get("maxError", 0.0);
+    return out_ratio < 1.0 || out_maxError > 0.0;
+}
+
+}
+
+namespace cnoid {
+
+class RaycastVisionSimulator::Impl
+{
+public:
+    SceneRaycaster raycaster;
+    vector<Link*> groupLinks;
+    vector<SensorInfoPtr> sensors;
+    double maxFrameRate;
+    double maxLatency;
+    double depthError;
+    bool isBestEffortMode;
+    double timeStep;
+    double currentTime;
+
+    Impl();
+    void addBody(Body* body);
+    void startMeasurement(SensorInfo* sensor, double currentTime);
+    bool waitForMeasurementToFinish(SensorInfo* sensor);
+};
+
+}
+
+
+RaycastVisionSimulator::RaycastVisionSimulator()
+{
+    impl = new Impl;
+}
+
+
+RaycastVisionSimulator::Impl::Impl()
+{
+    maxFrameRate = 1000.0;
+    maxLatency = 1.0;
+    depthError = 0.0;
+    isBestEffortMode = false;
+    timeStep = 0.001;
+    currentTime = 0.0;
+}
+
+
+RaycastVisionSimulator::~RaycastVisionSimulator()
+{
+    finalize();
+    delete impl;
+}
+
+
+bool RaycastVisionSimulator::isSupportedDevice(Device* device)
+{
+    if(dynamic_cast<RangeSensor*>(device)){
+        return true;
+    }
+    if(auto camera = dynamic_cast<RangeCamera*>(device)){
+        return camera->lensType() == Camera::NORMAL_LENS;
+    }
+    return false;
+}
+
+
+void RaycastVisionSimulator::setMaxFrameRate(double rate)
+{
+    impl->maxFrameRate = rate;
+}
+
+
+void RaycastVisionSimulator::setMaxLatency(double latency)
+{
+    impl->maxLatency = latency;
+}
+
+
+void RaycastVisionSimulator::setBestEffortMode(bool on)
+{
+    impl->isBestEffortMode = on;
+}
+
+
+void RaycastVisionSimulator::setDepthError(double error)
+{
+    impl->depthError = error;
+}
+
+
+void RaycastVisionSimulator::clear()
+{
+    finalize();
+    impl->sensors.clear();
+    impl->raycaster.clear();
+    impl->groupLinks.clear();
+}
+
+
+void RaycastVisionSimulator::addBody(Body* body)
+{
+    impl->addBody(body);
+}
+
+
+void RaycastVisionSimulator::Impl::addBody(Body* body)
+{
+    double ratio, maxError;
+    const bool doSimplify = getSensorLevelOfDetail(body, ratio, maxError);
+    MeshFilter meshFilter;
+
+    for(auto& link : body->links()){
+        SgNodePtr shape = link->visualShape();
+        if(!shape){
+            continue;
+        }
+        if(doSimplify){
+            // The meshes are cloned because they may be shared with the other bodies
+            CloneMap cloneMap;
+            shape = shape->cloneNode(cloneMap);
+            meshFilter.simplify(shape, ratio, maxError);
+        }
+        raycaster.addGroup(shape);
+        groupLinks.push_back(link);
+    }
+}
+
+
+void RaycastVisionSimulator::addScene(SgNode* scene)
+{
+    impl->raycaster.addGroup(scene);
+    impl->groupLinks.push_back(nullptr);
+}
+
+
+bool RaycastVisionSimulator::addSensor(Device* device, std::function<void()> notifyDataUpdate)
+{
+    if(!isSupportedDevice(device)){
+        return false;
+    }
+    auto sensor = new SensorInfo(device);
+    if(notifyDataUpdate){
+        sensor->notifyDataUpdate = notifyDataUpdate;
+    } else {
+        sensor->notifyDataUpdate = [device](){ device->notifyStateChange(); };
+    }
+    impl->sensors.emplace_back(sensor);
+    return true;
+}
+
+
+SensorInfo::SensorInfo(Device* device)
+    : device(device)
+{
+    rangeSensor = dynamic_cast<RangeSensor*>(device);
+    rangeCamera = dynamic_cast<RangeCamera*>(device);
+    deviceForMeasurement = device->clone();
+    rangeSensorForMeasurement = dynamic_cast<RangeSensor*>(deviceForMeasurement.get());
+    rangeCameraForMeasurement = dynamic_cast<RangeCamera*>(deviceForMeasurement.get());
+}
+
+
+int RaycastVisionSimulator::numSensors() const
+{
+    return impl->sensors.size();
+}
+
+
+void RaycastVisionSimulator::initialize(double timeStep)
+{
+    impl->timeStep = timeStep;
+
+    for(auto& sensor : impl->sensors){
+        // The copy shares the hierarchies of the meshes
+        sensor->raycaster = impl->raycaster;
+
+        double frameRate = sensor->rangeSensor ? sensor->rangeSensor->scanRate() : sensor->rangeCamera->frameRate();
+        frameRate = std::max(0.1, std::min(frameRate, impl->maxFrameRate));
+        sensor->cycleTime = 1.0 / frameRate;
+        sensor->latency = std::min(sensor->cycleTime, impl->maxLatency);
+        sensor->elapsedTime = 0.0;
+        sensor->onsetTime = 0.0;
+        sensor->wasDeviceOn = false;
+        sensor->isMeasuring = false;
+        sensor->needToClearData = false;
+    }
+}
+
+
+void RaycastVisionSimulator::onPreDynamics(double currentTime)
+{
+    impl->currentTime = currentTime;
+
+    for(auto& sensor : impl->sensors){
+        bool isOn = sensor->device->on();
+        if(isOn){
+            if(!sensor->wasDeviceOn){
+                sensor->needToClearData = false;
+                sensor->elapsedTime = sensor->cycleTime;
+            }
+            if(sensor->elapsedTime >= sensor->cycleTime && !sensor->isMeasuring){
+                impl->startMeasurement(sensor.get(), currentTime);
+                sensor->elapsedTime -= sensor->cycleTime;
+            }
+        } else if(sensor->wasDeviceOn){
+            sensor->needToClearData = true;
+        }
+        sensor->elapsedTime += impl->timeStep;
+        sensor->wasDeviceOn = isOn;
+    }
+}
+
+
+void RaycastVisionSimulator::Impl::startMeasurement(SensorInfo* sensor, double currentTime)
+{
+    sensor->onsetTime = currentTime;
+    sensor->isMeasuring = true;
+
+    // The states used in the measurement are taken here because the task runs concurrently with the simulation
+    sensor->deviceForMeasurement->copyStateFrom(*sensor->device);
+    sensor->T_sensor = sensor->device->link()->T() * sensor->device->T_local();
+    auto& raycaster = sensor->raycaster;
+    for(size_t i=0; i < groupLinks.size(); ++i){
+        if(auto link = groupLinks[i]){
+            raycaster.setGroupPosition(i, link->T());
+        }
+    }
+    raycaster.update();
+
+    const double depthError_ = depthError;
+    sensor->taskGroup.run([sensor, depthError_](){ sensor->measure(depthError_); });
+}
+
+
+void SensorInfo::measure(double depthError)
+{
+    updateDirections();
+
+    float minDistance, maxDistance;
+    if(rangeSensor){
+        minDistance = rangeSensorForMeasurement->minDistance();
+        maxDistance = rangeSensorForMeasurement->maxDistance();
+    } else {
+        minDistance = rangeCameraForMeasurement->nearClipDistance();
+        maxDistance = rangeCameraForMeasurement->farClipDistance();
+    }
+    const bool extractColors = rangeCamera && (rangeCameraForMeasurement->imageType() == Camera::COLOR_IMAGE);
+
+    const int numRays = localDirections.size();
+    directions.resize(numRays);
+    distances.resize(numRays);
+    colors.resize(extractColors ? numRays : 0);
+
+    const Matrix3f R = T_sensor.linear().cast<float>();
+    const Vector3f origin = T_sensor.translation().cast<float>();
+    parallelFor(
+        0, numRays, RayChunkSize,
+        [&](int begin, int end){
+            for(int i = begin; i < end; ++i){
+                directions[i] = R * localDirections[i];
+            }
+            raycaster.castRays(
+                origin, &directions[begin], end - begin, minDistance, maxDistance,
+                &distances[begin], extractColors ? &colors[begin] : nullptr);
+        });
+
+    if(rangeSensor){
+        storeRangeData(depthError);
+    } else {
+        storeRangeCameraData();
+    }
+}
+
+
+void SensorInfo::updateDirections()
+{
+    vector<double> parameters;
+    if(rangeSensor){
+        auto s = rangeSensorForMeasurement;
+        parameters = { s->yawRange(), s->yawStep(), s->pitchRange(), s->pitchStep() };
+    } else {
+        auto c = rangeCameraForMeasurement;
+        parameters = { static_cast<double>(c->resolutionX()), static_cast<double>(c->resolutionY()), c->fieldOfView() };
+    }
+    if(parameters != directionParameters){
+        if(rangeSensor){
+            updateRangeSensorDirections();
+        } else {
+            updateRangeCameraDirections();
+        }
+        directionParameters = parameters;
+    }
+}
+
+
+/**
+   The sampling order is the same as the range data, where the yaw angle changes first. The samples
+   are arranged symmetrically about the front direction, which is the negative z axis, and the
+   positive yaw angle turns to the left.
+*/
+void SensorInfo::updateRangeSensorDirections()
+{
+    auto s = rangeSensorForMeasurement;
+    const int numYawSamples = s->numYawSamples();
+    const int numPitchSamples = s->numPitchSamples();
+    localDirections.resize(numYawSamples * numPitchSamples);
+
+    int index = 0;
+    for(int pitch=0; pitch < numPitchSamples; ++pitch){
+        const double pitchAngle = (pitch - (numPitchSamples - 1) / 2.0) * s->pitchStep();
+        const double cosPitch = cos(pitchAngle);
+        const double sinPitch = sin(pitchAngle);
+        for(int yaw=0; yaw < numYawSamples; ++yaw){
+            const double yawAngle = (yaw - (numYawSamples - 1) / 2.0) * s->yawStep();
+            localDirections[index++] =
+                Vector3(-cosPitch * sin(yawAngle), sinPitch, -cosPitch * cos(yawAngle)).cast<float>();
+        }
+    }
+}
+
+
+/**
+   The rays pass through the pixel centers in the order from the top row. The z element of each
+   direction is -1 so that the hit distance is the depth of the point.
+*/
+void SensorInfo::updateRangeCameraDirections()
+{
+    auto c = rangeCameraForMeasurement;
+    const int width = c->resolutionX();
+    const int height = c->resolutionY();
+    localDirections.resize(width * height);
+    if(localDirections.empty()){
+        return;
+    }
+    const double aspectRatio = static_cast<double>(width) / height;
+    const double tanHalfFovy = tan(SgPerspectiveCamera::fovy(aspectRatio, c->fieldOfView()) / 2.0);
+    const double tanHalfFovx = tanHalfFovy * aspectRatio;
+
+    int index = 0;
+    for(int row=0; row < height; ++row){
+        const double y = (1.0 - 2.0 * (row + 0.5) / height) * tanHalfFovy;
+        for(int col=0; col < width; ++col){
+            const double x = (2.0 * (col + 0.5) / width - 1.0) * tanHalfFovx;
+            localDirections[index++] = Vector3f(x, y, -1.0f);
+        }
+    }
+}
+
+
+void SensorInfo::storeRangeData(double depthError)
+{
+    rangeData = rangeDataPool.acquire();
+    auto& data = *rangeData;
+    data.resize(distances.size());
+    for(size_t i=0; i < distances.size(); ++i){
+        const float d = distances[i];
+        data[i] = std::isinf(d) ? std::numeric_limits<double>::infinity() : (d + depthError);
+    }
+}
+
+
+/**
+   The invalid points of an organized point cloud are given in the same way as GLVisionSimulatorItem.
+*/
+void SensorInfo::storeRangeCameraData()
+{
+    auto c = rangeCameraForMeasurement;
+    const int width = c->resolutionX();
+    const int height = c->resolutionY();
+    const float minDepth = c->minDistance();
+    const float maxDepth = c->maxDistance();
+    const bool isOrganized = c->isOrganized();
+    const bool extractColors = !colors.empty();
+    const int cx = width / 2;
+    const int cy = height / 2;
+    constexpr float inf = std::numeric_limits<float>::infinity();
+
+    points = pointsPool.acquire();
+    points->clear();
+    points->reserve(distances.size());
+    unsigned char* pixels = nullptr;
+    if(extractColors){
+        image = imagePool.acquire();
+        if(isOrganized){
+            image->setSize(width, height, 3);
+        } else {
+            image->setSize(width * height, 1, 3);
+        }
+        pixels = image->pixels();
+    } else {
+        image.reset();
+    }
+    isDense = true;
+
+    int index = 0;
+    for(int row=0; row < height; ++row){
+        const int y = height - 1 - row;
+        for(int col=0; col < width; ++col){
+            const float depth = distances[index];
+            const bool isValid = (depth >= minDepth && depth <= maxDepth);
+            if(isValid){
+                points->push_back(localDirections[index] * depth);
+            } else if(isOrganized){
+                points->emplace_back(
+                    (col == cx) ? 0.0f : (col - cx) * inf,
+                    (y == cy) ? 0.0f : (y - cy) * inf,
+                    -inf);
+                isDense = false;
+            }
+            if(pixels && (isValid || isOrganized)){
+                const Vector3f& color = colors[index];
+                for(int i=0; i < 3; ++i){
+                    pixels[i] = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, color[i] * 255.0f + 0.5f)));
+                }
+                pixels += 3;
+            }
+            ++index;
+        }
+    }
+
+    if(extractColors && !isOrganized){
+        image->setSize((pixels - image->pixels()) / 3, 1, 3);
+    }
+}
+
+
+void RaycastVisionSimulator::onPostDynamics()
+{
+    for(auto& sensor : impl->sensors){
+        if(sensor->isMeasuring && sensor->elapsedTime >= sensor->latency){
+            if(impl->waitForMeasurementToFinish(sensor.get())){
+                if(!sensor->needToClearData){
+                    sensor->copyData(impl->currentTime);
+                }
+                sensor->isMeasuring = false;
+            }
+        }
+        if(sensor->needToClearData && !sensor->isMeasuring){
+            sensor->clearData();
+        }
+    }
+}
+
+
+bool RaycastVisionSimulator::Impl::waitForMeasurementToFinish(SensorInfo* sensor)
+{
+    if(sensor->taskGroup.isRunning() && isBestEffortMode){
+        if(sensor->elapsedTime > sensor->cycleTime){
+            sensor->elapsedTime = sensor->cycleTime;
+        }
+        return false;
+    }
+    sensor->taskGroup.wait();
+    return true;
+}
+
+
+void SensorInfo::copyData(double currentTime)
+{
+    const double delay = currentTime - onsetTime;
+    if(rangeSensor){
+        rangeSensor->setRangeData(rangeData);
+        rangeSensor->setDelay(delay);
+    } else {
+        if(image && !image->empty()){
+            rangeCamera->setImage(image);
+        }
+        rangeCamera->setPoints(points);
+        rangeCamera->setDense(isDense);
+        rangeCamera->setDelay(delay);
+    }
+    notifyDataUpdate();
+}
+
+
+void SensorInfo::clearData()
+{
+    if(rangeSensor){
+        rangeSensor->clearRangeData();
+    } else {
+        rangeCamera->clearImage();
+        rangeCamera->clearPoints();
+    }
+    notifyDataUpdate();
+    needToClearData = false;
+}
+
+
+void RaycastVisionSimulator::finalize()
+{
+    for(auto& sensor : impl->sensors){
+        sensor->taskGroup.wait();
+        sensor->isMeasuring = false;
+    }
+}
@@ -0,0 +1,77 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_RAYCAST_VISION_SIMULATOR_H
+#define CNOID_BODY_RAYCAST_VISION_SIMULATOR_H
+
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class Device;
+class SgNode;
+
+/**
+   This class simulates RangeSensor and RangeCamera devices by casting rays to the visual shapes
+   of the bodies on the CPU, so that it works without the GPU. The devices are measured with the
+   same sampling, frame rate and latency as GLVisionSimulatorItem. A measurement is processed by
+   the tasks of ParallelScheduler concurrently with the dynamics computation, and the result is
+   set to the device in onPostDynamics when the latency has elapsed.
+*/
+class CNOID_EXPORT RaycastVisionSimulator
+{
+public:
+    RaycastVisionSimulator();
+    ~RaycastVisionSimulator();
+    RaycastVisionSimulator(const RaycastVisionSimulator&) = delete;
+    RaycastVisionSimulator& operator=(const RaycastVisionSimulator&) = delete;
+
+    //! RangeSensor and RangeCamera with the normal lens are supported.
+    static bool isSupportedDevice(Device* device);
+
+    void setMaxFrameRate(double rate);
+    void setMaxLatency(double latency);
+    void setBestEffortMode(bool on);
+
+    //! The offset added to the distances measured by the range sensors
+    void setDepthError(double error);
+
+    void clear();
+
+    /**
+       The visual shapes of the links are the targets of the measurement.
+       The link positions are read in onPreDynamics.
+    */
+    void addBody(Body* body);
+
+    //! The scene which does not move
+    void addScene(SgNode* scene);
+
+    /**
+       \param notifyDataUpdate The function called when the data of the sensor is updated or cleared.
+       Device::notifyStateChange is called if it is not given.
+       \return False if the device is not supported.
+    */
+    bool addSensor(Device* device, std::function<void()> notifyDataUpdate = nullptr);
+
+    int numSensors() const;
+
+    void initialize(double timeStep);
+    void onPreDynamics(double currentTime);
+    void onPostDynamics();
+
+    //! This function waits for the measurements in progress to finish.
+    void finalize();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
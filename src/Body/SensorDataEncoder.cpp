@@ -0,0 +1,372 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SensorDataEncoder.h"
+#include <cnoid/ImageIO>
+#include <zlib.h>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/**
+   The values are converted into the differences of the bit patterns from the previous values
+   of the same components, and the bytes of the differences are rearranged into the byte planes.
+   The planes of the upper bytes of the smooth data consist of almost zeros, which zlib compresses
+   well even with the fastest level.
+*/
+template<class Word>
+bool encodeDeltaPlanes(const void* data, size_t numWords, int stride, vector<unsigned char>& out_data)
+{
+    const size_t dataSize = numWords * sizeof(Word);
+    vector<unsigned char> planes(dataSize);
+    const Word* words = static_cast<const Word*>(data);
+    Word prev[4] = { 0, 0, 0, 0 };
+    for(size_t i=0; i < numWords; ++i){
+        Word word = words[i];
+        Word& p = prev[i % stride];
+        Word delta = word - p;
+        p = word;
+        for(size_t j=0; j < sizeof(Word); ++j){
+            planes[j * numWords + i] = static_cast<unsigned char>(delta >> (j * 8));
+        }
+    }
+    uLongf compressedSize = compressBound(dataSize);
+    out_data.resize(compressedSize);
+    if(compress2(out_data.data(), &compressedSize, planes.data(), dataSize, Z_BEST_SPEED) != Z_OK){
+        return false;
+    }
+    out_data.resize(compressedSize);
+    return true;
+}
+
+
+template<class Word>
+bool decodeDeltaPlanes(const vector<unsigned char>& data, size_t numWords, int stride, void* out_data)
+{
+    uLongf dataSize = numWords * sizeof(Word);
+    vector<unsigned char> planes(dataSize);
+    if(uncompress(planes.data(), &dataSize, data.data(), data.size()) != Z_OK ||
+       dataSize != numWords * sizeof(Word)){
+        return false;
+    }
+    Word* words = static_cast<Word*>(out_data);
+    Word prev[4] = { 0, 0, 0, 0 };
+    for(size_t i=0; i < numWords; ++i){
+        Word delta = 0;
+        for(size_t j=0; j < sizeof(Word); ++j){
+            delta |= static_cast<Word>(planes[j * numWords + i]) << (j * 8);
+        }
+        Word& p = prev[i % stride];
+        p += delta;
+        words[i] = p;
+    }
+    return true;
+}
+
+}
+
+namespace cnoid {
+
+class SensorDataEncoder::Impl
+{
+public:
+    DataBlockStorePtr store;
+    ImageFormat imageFormat;
+    int jpegQuality;
+    int maxNumPendingData;
+
+    /*
+      The data is encoded by a dedicated thread instead of the tasks of ParallelScheduler
+      so that a waiting parallel task group of the simulation never runs the encoding.
+    */
+    std::thread encodingThread;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    deque<std::function<void()>> encodingQueue;
+    int numPendingData;
+    bool isExitingEncodingThreadRequested;
+
+    Impl(DataBlockStore* store);
+    ~Impl();
+    template<class EncodedData, class Encode>
+    void encode(EncodedData* encoded, Encode encodeFunc);
+    void encodeQueuedData();
+    void waitForEncoding();
+};
+
+}
+
+
+bool EncodedSensorData::isEncoding() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return isEncoding_;
+}
+
+
+size_t EncodedSensorData::encodedSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return block ? block->size() : 0;
+}
+
+
+bool EncodedSensorData::readBlock(std::vector<unsigned char>& out_data) const
+{
+    return block && block->read(out_data);
+}
+
+
+std::shared_ptr<Image> EncodedImage::decode() const
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(source){
+            return source;
+        }
+    }
+    auto image = std::make_shared<Image>();
+    vector<unsigned char> data;
+    if(readBlock(data)){
+        ImageIO imageIO;
+        if(!imageIO.decode(*image, data.data(), data.size())){
+            image->clear();
+        }
+    }
+    return image;
+}
+
+
+std::shared_ptr<EncodedPointData::PointData> EncodedPointData::decode() const
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(source){
+            return source;
+        }
+    }
+    auto points = std::make_shared<PointData>(numPoints);
+    vector<unsigned char> data;
+    if(!readBlock(data) || !decodeDeltaPlanes<uint32_t>(data, numPoints * 3, 3, points->data())){
+        points->clear();
+    }
+    return points;
+}
+
+
+std::shared_ptr<EncodedRangeData::RangeData> EncodedRangeData::decode() const
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(source){
+            return source;
+        }
+    }
+    auto rangeData = std::make_shared<RangeData>(numValues);
+    vector<unsigned char> data;
+    if(!readBlock(data) || !decodeDeltaPlanes<uint64_t>(data, numValues, 1, rangeData->data())){
+        rangeData->clear();
+    }
+    return rangeData;
+}
+
+
+SensorDataEncoder::SensorDataEncoder(DataBlockStore* store)
+{
+    impl = new Impl(store);
+}
+
+
+SensorDataEncoder::Impl::Impl(DataBlockStore* store)
+    : store(store)
+{
+    if(!store){
+        this->store = new DataBlockStore;
+    }
+    imageFormat = PNG_FORMAT;
+    jpegQuality = 90;
+    maxNumPendingData = 16;
+    numPendingData = 0;
+    isExitingEncodingThreadRequested = false;
+}
+
+
+SensorDataEncoder::~SensorDataEncoder()
+{
+    delete impl;
+}
+
+
+SensorDataEncoder::Impl::~Impl()
+{
+    if(encodingThread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            isExitingEncodingThreadRequested = true;
+        }
+        queueCondition.notify_all();
+        encodingThread.join();
+    }
+}
+
+
+void SensorDataEncoder::setImageFormat(ImageFormat format)
+{
+    impl->imageFormat = format;
+}
+
+
+SensorDataEncoder::ImageFormat SensorDataEncoder::imageFormat() const
+{
+    return impl->imageFormat;
+}
+
+
+void SensorDataEncoder::setJpegQuality(int quality)
+{
+    impl->jpegQuality = quality;
+}
+
+
+DataBlockStore* SensorDataEncoder::store()
+{
+    return impl->store;
+}
+
+
+void SensorDataEncoder::setMaxNumPendingData(int n)
+{
+    impl->maxNumPendingData = n;
+}
+
+
+/**
+   The encoded data is stored and the source data is released when the encoding succeeds.
+   Otherwise the source data is kept as it is.
+*/
+template<class EncodedData, class Encode>
+void SensorDataEncoder::Impl::encode(EncodedData* encoded, Encode encodeFunc)
+{
+    EncodedSensorDataPtr holder = encoded;
+    auto task = [this, encoded, holder, encodeFunc](){
+        vector<unsigned char> data;
+        bool encodedOk = encodeFunc(*encoded->source, data);
+        DataBlockStore::BlockPtr block;
+        if(encodedOk){
+            block = store->store(std::move(data));
+        }
+        std::lock_guard<std::mutex> lock(encoded->mutex);
+        if(block){
+            encoded->block = block;
+            encoded->source.reset();
+        }
+        encoded->isEncoding_ = false;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if(numPendingData < maxNumPendingData){
+            encodingQueue.push_back(task);
+            ++numPendingData;
+            if(!encodingThread.joinable()){
+                encodingThread = std::thread([this](){ encodeQueuedData(); });
+            }
+            queueCondition.notify_all();
+            return;
+        }
+    }
+    task();
+}
+
+
+void SensorDataEncoder::Impl::encodeQueuedData()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while(true){
+        while(encodingQueue.empty() && !isExitingEncodingThreadRequested){
+            queueCondition.wait(lock);
+        }
+        if(encodingQueue.empty()){
+            break;
+        }
+        auto task = std::move(encodingQueue.front());
+        encodingQueue.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+        --numPendingData;
+        queueCondition.notify_all();
+    }
+}
+
+
+void SensorDataEncoder::Impl::waitForEncoding()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while(numPendingData > 0){
+        queueCondition.wait(lock);
+    }
+}
+
+
+EncodedImagePtr SensorDataEncoder::encodeImage(std::shared_ptr<Image> image)
+{
+    EncodedImagePtr encoded = new EncodedImage;
+    encoded->source = image;
+    auto format = (impl->imageFormat == JPEG_FORMAT) ? ImageIO::JPEG_FORMAT : ImageIO::PNG_FORMAT;
+    int quality = impl->jpegQuality;
+    impl->encode(
+        encoded.get(),
+        [format, quality](const Image& image, vector<unsigned char>& out_data){
+            ImageIO imageIO;
+            if(imageIO.encode(image, format, out_data, quality)){
+                return true;
+            }
+            // The images with the alpha component are encoded by PNG
+            return format != ImageIO::PNG_FORMAT && imageIO.encode(image, ImageIO::PNG_FORMAT, out_data);
+        });
+    return encoded;
+}
+
+
+EncodedPointDataPtr SensorDataEncoder::encodePoints(std::shared_ptr<std::vector<Vector3f>> points)
+{
+    EncodedPointDataPtr encoded = new EncodedPointData;
+    encoded->source = points;
+    encoded->numPoints = points->size();
+    impl->encode(
+        encoded.get(),
+        [](const std::vector<Vector3f>& points, vector<unsigned char>& out_data){
+            return encodeDeltaPlanes<uint32_t>(points.data(), points.size() * 3, 3, out_data);
+        });
+    return encoded;
+}
+
+
+EncodedRangeDataPtr SensorDataEncoder::encodeRangeData(std::shared_ptr<std::vector<double>> rangeData)
+{
+    EncodedRangeDataPtr encoded = new EncodedRangeData;
+    encoded->source = rangeData;
+    encoded->numValues = rangeData->size();
+    impl->encode(
+        encoded.get(),
+        [](const std::vector<double>& rangeData, vector<unsigned char>& out_data){
+            return encodeDeltaPlanes<uint64_t>(rangeData.data(), rangeData.size(), 1, out_data);
+        });
+    return encoded;
+}
+
+
+void SensorDataEncoder::waitForEncoding()
+{
+    impl->waitForEncoding();
+}
@@ -0,0 +1,133 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_SENSOR_DATA_ENCODER_H
+#define CNOID_BODY_SENSOR_DATA_ENCODER_H
+
+#include <cnoid/DataBlockStore>
+#include <cnoid/Image>
+#include <cnoid/EigenTypes>
+#include <memory>
+#include <mutex>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SensorDataEncoder;
+
+/**
+   The sensor data encoded by SensorDataEncoder.
+   The data is encoded in the background, and the original data is kept until the encoding is finished.
+*/
+class CNOID_EXPORT EncodedSensorData : public Referenced
+{
+public:
+    bool isEncoding() const;
+
+    //! The size of the encoded data. Zero is returned while encoding.
+    size_t encodedSize() const;
+
+protected:
+    EncodedSensorData() : isEncoding_(true) { }
+    bool readBlock(std::vector<unsigned char>& out_data) const;
+
+    mutable std::mutex mutex;
+    DataBlockStore::BlockPtr block;
+    bool isEncoding_;
+
+    friend class SensorDataEncoder;
+};
+typedef ref_ptr<EncodedSensorData> EncodedSensorDataPtr;
+
+
+class CNOID_EXPORT EncodedImage : public EncodedSensorData
+{
+public:
+    //! The original image is returned while encoding. An empty image is returned if decoding fails.
+    std::shared_ptr<Image> decode() const;
+
+private:
+    std::shared_ptr<Image> source;
+    friend class SensorDataEncoder;
+};
+typedef ref_ptr<EncodedImage> EncodedImagePtr;
+
+
+class CNOID_EXPORT EncodedPointData : public EncodedSensorData
+{
+public:
+    typedef std::vector<Vector3f> PointData;
+    std::shared_ptr<PointData> decode() const;
+
+private:
+    std::shared_ptr<PointData> source;
+    size_t numPoints;
+    friend class SensorDataEncoder;
+};
+typedef ref_ptr<EncodedPointData> EncodedPointDataPtr;
+
+
+class CNOID_EXPORT EncodedRangeData : public EncodedSensorData
+{
+public:
+    typedef std::vector<double> RangeData;
+    std::shared_ptr<RangeData> decode() const;
+
+private:
+    std::shared_ptr<RangeData> source;
+    size_t numValues;
+    friend class SensorDataEncoder;
+};
+typedef ref_ptr<EncodedRangeData> EncodedRangeDataPtr;
+
+
+/**
+   This class encodes the images, the point clouds and the range data of the vision sensors into
+   compact data blocks so that a long simulation with the vision sensors can be recorded.
+   The images are encoded by PNG or JPEG, and the point clouds and the range data are encoded
+   losslessly by the delta of the bit patterns and zlib. The encoding is done by a dedicated
+   thread of the encoder, and the encoded data is kept in a DataBlockStore, which moves old data
+   to the temporary files when the memory usage exceeds the limit.
+*/
+class CNOID_EXPORT SensorDataEncoder : public Referenced
+{
+public:
+    //! A new store is created if the store is not given.
+    SensorDataEncoder(DataBlockStore* store = nullptr);
+    ~SensorDataEncoder();
+
+    enum ImageFormat { PNG_FORMAT, JPEG_FORMAT };
+    void setImageFormat(ImageFormat format);
+    ImageFormat imageFormat() const;
+    void setJpegQuality(int quality);
+
+    DataBlockStore* store();
+
+    /**
+       The encoding is done in the calling thread when the number of the data waiting for the
+       encoding thread reaches this number. The default number is 16.
+    */
+    void setMaxNumPendingData(int n);
+
+    /**
+       The given data must not be modified after calling the following functions.
+       The data shared with the devices satisfies this condition because the devices
+       copy the data shared with other objects before modifying it.
+    */
+    EncodedImagePtr encodeImage(std::shared_ptr<Image> image);
+    EncodedPointDataPtr encodePoints(std::shared_ptr<std::vector<Vector3f>> points);
+    EncodedRangeDataPtr encodeRangeData(std::shared_ptr<std::vector<double>> rangeData);
+
+    void waitForEncoding();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+typedef ref_ptr<SensorDataEncoder> SensorDataEncoderPtr;
+
+}
+
+#endif
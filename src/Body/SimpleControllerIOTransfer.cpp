@@ -0,0 +1,217 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SimpleControllerIOTransfer.h"
+#include "Body.h"
+#include <bitset>
+
+using namespace std;
+using namespace cnoid;
+
+
+SimpleControllerIOTransfer::SimpleControllerIOTransfer()
+{
+    simulationBody = nullptr;
+    ioBody = nullptr;
+}
+
+
+void SimpleControllerIOTransfer::enableInput(Link* link)
+{
+    int defaultInputStateTypes = Link::StateNone;
+    int actuationMode = link->actuationMode();
+    if(actuationMode & (Link::JointEffort | Link::JointDisplacement | Link::JointVelocity)){
+        if(link->jointType() != Link::PseudoContinuousTrackJoint){
+            defaultInputStateTypes = Link::JointDisplacement;
+        }
+    }
+    if(actuationMode & Link::LinkExtWrench){
+        // Global link position is needed to calculate the correct external force value
+        defaultInputStateTypes |= Link::LinkPosition;
+    }
+    enableInput(link, defaultInputStateTypes);
+}
+
+
+void SimpleControllerIOTransfer::enableInput(Link* link, int stateFlags)
+{
+    if(link->index() >= static_cast<int>(linkIndexToInputStateTypeMap.size())){
+        linkIndexToInputStateTypeMap.resize(link->index() + 1, 0);
+    }
+    linkIndexToInputStateTypeMap[link->index()] |= stateFlags;
+    link->mergeSensingMode(stateFlags);
+}
+
+
+void SimpleControllerIOTransfer::enableOutput(Link* link)
+{
+    int index = link->index();
+    if(static_cast<int>(outputLinkFlags.size()) <= index){
+        outputLinkFlags.resize(index + 1, false);
+    }
+    outputLinkFlags[index] = true;
+}
+
+
+void SimpleControllerIOTransfer::enableOutput(Link* link, int stateFlags)
+{
+    link->setActuationMode(stateFlags);
+    if(stateFlags){
+        enableOutput(link);
+    }
+}
+
+
+void SimpleControllerIOTransfer::clearIoTargets()
+{
+    inputLinkIndices.clear();
+    inputStateTypes.clear();
+    outputLinkFlags.clear();
+    linkOutputStateInfos.clear();
+}
+
+
+void SimpleControllerIOTransfer::updateIOStateTypes(Body* simulationBody, Body* ioBody)
+{
+    this->simulationBody = simulationBody;
+    this->ioBody = ioBody;
+    
+    // Input
+    inputLinkIndices.clear();
+    inputStateTypes.clear();
+    for(size_t i=0; i < linkIndexToInputStateTypeMap.size(); ++i){
+        bitset<Link::NumStateTypes> types(linkIndexToInputStateTypeMap[i]);
+        if(types.any()){
+            simulationBody->link(i)->mergeSensingMode(ioBody->link(i)->sensingMode());
+            const int n = types.count();
+            inputLinkIndices.push_back(i);
+            inputStateTypes.push_back(n);
+            for(int j=0; j < Link::NumStateTypes; ++j){
+                if(types.test(j)){
+                    inputStateTypes.push_back(1 << j);
+                }
+            }
+        }
+    }
+
+    // Output
+    linkOutputStateInfos.clear();
+    for(size_t i=0; i < outputLinkFlags.size(); ++i){
+        if(outputLinkFlags[i]){
+            LinkOutputStateInfo info;
+            info.linkIndex = i;
+            int actuationMode = ioBody->link(i)->actuationMode();
+            simulationBody->link(i)->setActuationMode(actuationMode);
+            for(int j=0; j < Link::NumStateTypes; ++j){
+                int stateBit = 1 << j;
+                if(actuationMode & stateBit){
+                    info.stateTypes.push_back(stateBit);
+                }
+            }
+            linkOutputStateInfos.push_back(info);
+        }
+    }
+}
+
+
+void SimpleControllerIOTransfer::inputLinkStates()
+{
+    int typeArrayIndex = 0;
+    for(size_t i=0; i < inputLinkIndices.size(); ++i){
+        const int linkIndex = inputLinkIndices[i];
+        const Link* simLink = simulationBody->link(linkIndex);
+        Link* ioLink = ioBody->link(linkIndex);
+        const int n = inputStateTypes[typeArrayIndex++];
+        for(int j=0; j < n; ++j){
+            switch(inputStateTypes[typeArrayIndex++]){
+            case Link::JointDisplacement:
+                ioLink->q() = simLink->q();
+                break;
+            case Link::JointVelocity:
+                ioLink->dq() = simLink->dq();
+                break;
+            case Link::JointAcceleration:
+                ioLink->ddq() = simLink->ddq();
+                break;
+            case Link::JointEffort:
+                ioLink->u() = simLink->u();
+                break;
+            case Link::LinkPosition:
+                ioLink->T() = simLink->T();
+                break;
+            case Link::LinkTwist:
+                ioLink->v() = simLink->v();
+                ioLink->w() = simLink->w();
+                break;
+            case Link::LinkExtWrench:
+                ioLink->F_ext() = simLink->F_ext();
+                break;
+            case Link::LinkContactState:
+                ioLink->contactPoints() = simLink->contactPoints();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+
+void SimpleControllerIOTransfer::outputLinkStates(bool isOldTargetVariableMode)
+{
+    for(size_t i=0; i < linkOutputStateInfos.size(); ++i){
+
+        const auto& info = linkOutputStateInfos[i];
+        const int index = info.linkIndex;
+        const Link* ioLink = ioBody->link(index);
+        Link* simLink = simulationBody->link(index);
+
+        const auto& stateTypes = info.stateTypes;
+        for(size_t j=0; j < stateTypes.size(); ++j){
+            switch(stateTypes[j]){
+
+            case Link::JointDisplacement:
+                if(isOldTargetVariableMode){
+                    simLink->q_target() = ioLink->q();
+                } else {
+                    simLink->q_target() = ioLink->q_target();
+                }
+                break;
+
+            case Link::JointVelocity:
+            case Link::DeprecatedJointSurfaceVelocity:
+                if(isOldTargetVariableMode){
+                    simLink->dq_target() = ioLink->dq();
+                } else {
+                    simLink->dq_target() = ioLink->dq_target();
+                }
+                break;
+
+            case Link::JointAcceleration:
+                simLink->ddq() = ioLink->ddq();
+                break;
+
+            case Link::JointEffort:
+                simLink->u() = ioLink->u();
+                break;
+
+            case Link::LinkPosition:
+                simLink->T() = ioLink->T();
+                break;
+
+            case Link::LinkTwist:
+                simLink->v() = ioLink->v();
+                simLink->w() = ioLink->w();
+                break;
+
+            case Link::LinkExtWrench:
+                simLink->F_ext() += ioLink->F_ext();
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_SIMPLE_CONTROLLER_IO_TRANSFER_H
+#define CNOID_BODY_SIMPLE_CONTROLLER_IO_TRANSFER_H
+
+#include "Device.h"
+#include "DeviceList.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class Link;
+
+/**
+   This class transfers the states enabled by a simple controller between the simulation body and
+   the I/O body accessed by the controller. It is used by SimpleControllerItem and BatchSimulator
+   to implement the input and output functions of SimpleControllerIO in the same way.
+*/
+class CNOID_EXPORT SimpleControllerIOTransfer
+{
+public:
+    SimpleControllerIOTransfer();
+
+    //! The input state types of the link are decided from the actuation mode of it
+    void enableInput(Link* link);
+    void enableInput(Link* link, int stateFlags);
+    void enableOutput(Link* link);
+    void enableOutput(Link* link, int stateFlags);
+
+    //! This function clears the links to transfer. The enabled input state types are kept.
+    void clearIoTargets();
+
+    /**
+       This function must be called after the controller enables the inputs and the outputs.
+       The sensing mode and the actuation mode of the simulation body are updated.
+    */
+    void updateIOStateTypes(Body* simulationBody, Body* ioBody);
+
+    void inputLinkStates();
+
+    /**
+       \param isOldTargetVariableMode The joint displacements and velocities of the I/O body are
+       output as the target values in the old mode.
+    */
+    void outputLinkStates(bool isOldTargetVariableMode = false);
+
+    /**
+       The states of the devices whose change flags are set are copied to the destination devices
+       and the flags are cleared. The connections of the destination devices are blocked while
+       the state changes are notified so that the copied states are not sent back.
+       ConnectionSet or ScopedConnectionSet can be given as the connections.
+    */
+    template<class ConnectionSetType>
+    static void transferDeviceStates(
+        const DeviceList<>& srcDevices, const DeviceList<>& destDevices,
+        std::vector<bool>& changeFlags, ConnectionSetType& destConnections) {
+        for(size_t i=0; i < changeFlags.size(); ++i){
+            if(changeFlags[i]){
+                Device* device = destDevices[i];
+                device->copyStateFrom(*srcDevices[i]);
+                destConnections.block(i);
+                device->notifyStateChange();
+                destConnections.unblock(i);
+                changeFlags[i] = false;
+            }
+        }
+    }
+
+private:
+    Body* simulationBody;
+    Body* ioBody;
+    std::vector<int> inputLinkIndices;
+    std::vector<int> linkIndexToInputStateTypeMap;
+
+    // This vector contains input state types of all the links.
+    // The elements are the sequence of [number of input state types of the i-th link] [state type 1] [state type 2] ...
+    std::vector<int> inputStateTypes;
+
+    std::vector<bool> outputLinkFlags;
+
+    struct LinkOutputStateInfo
+    {
+        int linkIndex;
+        std::vector<int> stateTypes;
+    };
+    std::vector<LinkOutputStateInfo> linkOutputStateInfos;
+};
+
+}
+
+#endif
@@ -0,0 +1,160 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SimulationStepSequence.h"
+#include <cnoid/PhaseProfiler>
+
+using namespace std;
+using namespace cnoid;
+
+
+SimulationStepSequence::Controller::Controller()
+{
+    inputPhase = -1;
+    controlPhase = -1;
+    outputPhase = -1;
+}
+
+
+SimulationStepSequence::Controller::~Controller()
+{
+
+}
+
+
+void SimulationStepSequence::Controller::requestControl()
+{
+
+}
+
+
+bool SimulationStepSequence::Controller::waitForControl()
+{
+    return false;
+}
+
+
+SimulationStepSequence::SimulationStepSequence()
+{
+    isControllerThreadMode = false;
+    doStopWhenNoActiveControllers = false;
+    profiler = nullptr;
+    controllerWaitPhase = -1;
+}
+
+
+void SimulationStepSequence::clearControllers()
+{
+    controllers.clear();
+}
+
+
+void SimulationStepSequence::addController(Controller* controller)
+{
+    controllers.push_back(controller);
+}
+
+
+void SimulationStepSequence::setProfiler(PhaseProfiler* profiler, int controllerWaitPhase)
+{
+    this->profiler = profiler;
+    this->controllerWaitPhase = controllerWaitPhase;
+}
+
+
+void SimulationStepSequence::output(Controller* controller)
+{
+    PhaseProfiler::Scope scope(profilerOf(controller->outputPhase), controller->outputPhase);
+    controller->output();
+}
+
+
+bool SimulationStepSequence::step()
+{
+    bool doContinue = !doStopWhenNoActiveControllers;
+
+    if(preDynamicsFunction){
+        preDynamicsFunction();
+    }
+
+    if(!isControllerThreadMode){
+        for(auto& controller : controllers){
+            {
+                PhaseProfiler::Scope scope(profilerOf(controller->inputPhase), controller->inputPhase);
+                controller->input();
+            }
+            {
+                PhaseProfiler::Scope scope(profilerOf(controller->controlPhase), controller->controlPhase);
+                if(controller->control()){
+                    doContinue = true;
+                }
+            }
+            if(controller->isNoDelayMode()){
+                output(controller);
+            }
+        }
+    } else {
+        bool hasNoDelayModeControllers = false;
+        for(auto& controller : controllers){
+            if(controller->isNoDelayMode()){
+                hasNoDelayModeControllers = true;
+            }
+            {
+                PhaseProfiler::Scope scope(profilerOf(controller->inputPhase), controller->inputPhase);
+                controller->input();
+            }
+            controller->requestControl();
+        }
+        if(hasNoDelayModeControllers){
+            // Todo: Process the controller that finishes control earlier first to
+            // reduce the total elapsed time before finishing all the output functions.
+            for(auto& controller : controllers){
+                if(controller->isNoDelayMode()){
+                    {
+                        PhaseProfiler::Scope scope(profilerOf(controllerWaitPhase), controllerWaitPhase);
+                        if(controller->waitForControl()){
+                            doContinue = true;
+                        }
+                    }
+                    output(controller);
+                }
+            }
+        }
+    }
+
+    if(midDynamicsFunction){
+        midDynamicsFunction();
+    }
+
+    if(dynamicsFunction){
+        dynamicsFunction();
+    }
+
+    if(isControllerThreadMode){
+        PhaseProfiler::Scope scope(profilerOf(controllerWaitPhase), controllerWaitPhase);
+        for(auto& controller : controllers){
+            if(!controller->isNoDelayMode()){
+                if(controller->waitForControl()){
+                    doContinue = true;
+                }
+            }
+        }
+    }
+
+    if(postDynamicsFunction){
+        postDynamicsFunction();
+    }
+
+    if(recordingFunction){
+        recordingFunction();
+    }
+
+    for(auto& controller : controllers){
+        if(!controller->isNoDelayMode()){
+            output(controller);
+        }
+    }
+
+    return doContinue;
+}
@@ -0,0 +1,104 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_SIMULATION_STEP_SEQUENCE_H
+#define CNOID_BODY_SIMULATION_STEP_SEQUENCE_H
+
+#include <vector>
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class PhaseProfiler;
+
+/**
+   This class executes a simulation step in the common order used by SimulatorItem and
+   BatchSimulator. The inputs and the control of the controllers are processed first, and the
+   outputs of the no-delay mode controllers are given to the dynamics of the step. The dynamics
+   is followed by the post-dynamics processing and the recording, and then the outputs of the
+   other controllers are given to the dynamics of the next step.
+
+   The functions of each stage are given by the owner, and each function records its own phase
+   in the profiler if it is necessary. The phases of the controllers are recorded by this class.
+*/
+class CNOID_EXPORT SimulationStepSequence
+{
+public:
+    class CNOID_EXPORT Controller
+    {
+    public:
+        Controller();
+        virtual ~Controller();
+
+        virtual void input() = 0;
+        virtual bool control() = 0;
+        virtual void output() = 0;
+        virtual bool isNoDelayMode() const = 0;
+
+        /**
+           The following functions are used instead of control() in the controller thread mode.
+           requestControl starts the control in the thread of the controller, and waitForControl
+           waits for the control to finish and returns the result of it.
+        */
+        virtual void requestControl();
+        virtual bool waitForControl();
+
+        //! The phase ids of the profiler. The phase is not recorded if the id is -1.
+        int inputPhase;
+        int controlPhase;
+        int outputPhase;
+    };
+
+    SimulationStepSequence();
+    SimulationStepSequence(const SimulationStepSequence&) = delete;
+    SimulationStepSequence& operator=(const SimulationStepSequence&) = delete;
+
+    void clearControllers();
+    void addController(Controller* controller);
+    int numControllers() const { return static_cast<int>(controllers.size()); }
+
+    void setControllerThreadMode(bool on) { isControllerThreadMode = on; }
+    bool controllerThreadMode() const { return isControllerThreadMode; }
+
+    //! The step returns false when no controller continues the control if this is enabled
+    void setStopWhenNoActiveControllers(bool on) { doStopWhenNoActiveControllers = on; }
+
+    /**
+       \param controllerWaitPhase The phase id of waiting for the controller threads
+       \note The frame of the profiler is not begun or ended by this class.
+    */
+    void setProfiler(PhaseProfiler* profiler, int controllerWaitPhase = -1);
+
+    void setPreDynamicsFunction(std::function<void()> func) { preDynamicsFunction = func; }
+    void setMidDynamicsFunction(std::function<void()> func) { midDynamicsFunction = func; }
+    void setDynamicsFunction(std::function<void()> func) { dynamicsFunction = func; }
+    void setPostDynamicsFunction(std::function<void()> func) { postDynamicsFunction = func; }
+    void setRecordingFunction(std::function<void()> func) { recordingFunction = func; }
+
+    /**
+       \return False if the simulation should be stopped because no controller is active
+    */
+    bool step();
+
+private:
+    std::vector<Controller*> controllers;
+    bool isControllerThreadMode;
+    bool doStopWhenNoActiveControllers;
+    PhaseProfiler* profiler;
+    int controllerWaitPhase;
+    std::function<void()> preDynamicsFunction;
+    std::function<void()> midDynamicsFunction;
+    std::function<void()> dynamicsFunction;
+    std::function<void()> postDynamicsFunction;
+    std::function<void()> recordingFunction;
+
+    // The phase is not recorded if the id is -1
+    PhaseProfiler* profilerOf(int phaseId) const { return (phaseId >= 0) ? profiler : nullptr; }
+    void output(Controller* controller);
+};
+
+}
+
+#endif
@@ -284,6 +284,7 @@ VRMLBodyLoader::VRMLBodyLoader()
 VRMLBodyLoaderImpl::VRMLBodyLoaderImpl()
 {
     divisionNumber = sgConverter.divisionNumber();
+    sgConverter.setParallelMeshGenerationEnabled(true);
     isVerbose = false;
     body = nullptr;
     os_ = &nullout();
@@ -399,6 +400,7 @@ bool VRMLBodyLoaderImpl::load(Body* body, const std::string& filename)
         sgConverter.setDivisionNumber(divisionNumber);
         vrmlParser.load(filename);
         readTopNodes();
+        sgConverter.finishConversion();
         if(body->modelName().empty()){
             body->setModelName(toUTF8(filesystem::path(fromUTF8(filename)).stem().string()));
         }
@@ -0,0 +1,124 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "WorldLogFileIndex.h"
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char indexFileMagic[] = { 'C', 'W', 'L', 'I' };
+const int32_t indexFileVersion = 2;
+
+template<class T> void writeValue(ofstream& ofs, T value)
+{
+    ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T> bool readValue(ifstream& ifs, T& out_value)
+{
+    ifs.read(reinterpret_cast<char*>(&out_value), sizeof(T));
+    return !ifs.fail();
+}
+
+bool getFileTime(const filesystem::path& path, int64_t& out_time)
+{
+    if(!filesystem::exists(path)){
+        return false;
+    }
+    out_time = filesystem::last_write_time_to_time_t(path);
+    return true;
+}
+
+}
+
+
+std::string WorldLogFileIndex::indexFilename(const std::string& logFilename)
+{
+    return logFilename + ".index";
+}
+
+
+int WorldLogFileIndex::findFrame(double time) const
+{
+    auto p = std::upper_bound(
+        entries.begin(), entries.end(), time,
+        [](double time, const Entry& entry){ return time < entry.time; });
+    return static_cast<int>(p - entries.begin()) - 1;
+}
+
+
+bool WorldLogFileIndex::save(const std::string& logFilename, int64_t logFileSize) const
+{
+    int64_t logFileTime;
+    if(!getFileTime(fromUTF8(logFilename), logFileTime)){
+        return false;
+    }
+    ofstream ofs(fromUTF8(indexFilename(logFilename)).c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs.is_open()){
+        return false;
+    }
+    ofs.write(indexFileMagic, sizeof(indexFileMagic));
+    writeValue(ofs, indexFileVersion);
+    writeValue(ofs, logFileSize);
+    writeValue(ofs, logFileTime);
+    writeValue(ofs, static_cast<int32_t>(entries.size()));
+    for(auto& entry : entries){
+        // The time is stored with the same precision as the log file
+        writeValue(ofs, static_cast<float>(entry.time));
+        writeValue(ofs, entry.pos);
+    }
+    ofs.close();
+    return !ofs.fail();
+}
+
+
+bool WorldLogFileIndex::load(const std::string& logFilename)
+{
+    entries.clear();
+
+    const filesystem::path logFilePath(fromUTF8(logFilename));
+    int64_t logFileTime;
+    if(!getFileTime(logFilePath, logFileTime)){
+        return false;
+    }
+    ifstream ifs(fromUTF8(indexFilename(logFilename)).c_str(), ios::in | ios::binary);
+    if(!ifs.is_open()){
+        return false;
+    }
+    char magic[sizeof(indexFileMagic)];
+    int32_t version;
+    int64_t indexedFileSize;
+    int64_t indexedFileTime;
+    int32_t numFrames;
+    ifs.read(magic, sizeof(magic));
+    if(ifs.fail() || memcmp(magic, indexFileMagic, sizeof(magic)) != 0 ||
+       !readValue(ifs, version) || version != indexFileVersion ||
+       !readValue(ifs, indexedFileSize) || !readValue(ifs, indexedFileTime) ||
+       !readValue(ifs, numFrames) || numFrames < 0){
+        return false;
+    }
+    if(indexedFileTime != logFileTime ||
+       indexedFileSize != static_cast<int64_t>(filesystem::file_size(logFilePath))){
+        return false;
+    }
+    entries.resize(numFrames);
+    for(auto& entry : entries){
+        float time;
+        if(!readValue(ifs, time) || !readValue(ifs, entry.pos)){
+            entries.clear();
+            return false;
+        }
+        entry.time = time;
+    }
+    return true;
+}
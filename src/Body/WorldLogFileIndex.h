@@ -0,0 +1,65 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_WORLD_LOG_FILE_INDEX_H
+#define CNOID_BODY_WORLD_LOG_FILE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class holds the time and the file position of each frame of a world log file.
+   The index is stored in the sidecar file of the log file so that a frame can be found by
+   the binary search without scanning the frame headers of the log file.
+*/
+class CNOID_EXPORT WorldLogFileIndex
+{
+public:
+    struct Entry
+    {
+        double time;
+        int64_t pos;
+    };
+
+    //! The name of the sidecar file, which is the log filename with the ".index" suffix
+    static std::string indexFilename(const std::string& logFilename);
+
+    void clear() { entries.clear(); }
+    bool empty() const { return entries.empty(); }
+    int numFrames() const { return entries.size(); }
+    const Entry& entry(int index) const { return entries[index]; }
+    const Entry& back() const { return entries.back(); }
+    void append(double time, int64_t pos) { entries.push_back({ time, pos }); }
+
+    /**
+       \return The index of the last frame whose time is not greater than the given time.
+       -1 is returned if the time is before the first frame.
+    */
+    int findFrame(double time) const;
+
+    /**
+       The index is saved to the sidecar file of the log file with the size and the modification
+       time of the log file, which are used to check whether the index is consistent with the log file.
+       \param logFileSize The size of the log file covered by the index.
+    */
+    bool save(const std::string& logFilename, int64_t logFileSize) const;
+
+    /**
+       \return False if the sidecar file cannot be read or the size or the modification time of the
+       log file differs from the one at the time the index was saved.
+    */
+    bool load(const std::string& logFilename);
+
+private:
+    std::vector<Entry> entries;
+};
+
+}
+
+#endif
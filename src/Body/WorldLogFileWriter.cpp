@@ -0,0 +1,720 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "WorldLogFileWriter.h"
+#include "WorldLogFileIndex.h"
+#include "Body.h"
+#include "Device.h"
+#include <cnoid/EigenTypes>
+#include <cnoid/UTF8>
+#include <fstream>
+#include <stack>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <zlib.h>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+enum DataTypeID {
+    BODY_STATE,
+    LINK_POSITIONS,
+    JOINT_POSITIONS,
+    DEVICE_STATES,
+    // The following IDs are only used in the frame blocks of format version 2
+    END_OF_BODY_STATE,
+    END_OF_FRAME
+};
+
+//! The first int value of a file of format version 2. A file of version 1 begins with the header size.
+const int Version2Marker = -2;
+
+/**
+   The frame data of format version 2 is written to this buffer, which is compressed as a block.
+   The link and joint values are written as the differences from the values of the previous frame
+   with the variable length encoding, so that the slowly changing values are encoded into a few bytes.
+*/
+class BlockBuf
+{
+public:
+    vector<unsigned char> data;
+
+    void writeID(DataTypeID id){
+        data.push_back(id);
+    }
+
+    void writeVarint(uint64_t value){
+        while(value >= 0x80){
+            data.push_back((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        data.push_back(value);
+    }
+
+    void writeFloat(float value){
+        unsigned char bytes[sizeof(float)];
+        memcpy(bytes, &value, sizeof(float));
+        data.insert(data.end(), bytes, bytes + sizeof(float));
+    }
+
+    /**
+       \param io_code The code of the value in the previous frame, which is updated with the current one.
+       \param precision The value is quantized with this precision if it is positive. Otherwise the bits
+       of the float value are written without the loss of the float precision.
+    */
+    void writeValue(int64_t& io_code, double value, double precision){
+        if(precision > 0.0){
+            int64_t code = llround(value / precision);
+            int64_t delta = code - io_code;
+            writeVarint((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63)); // zigzag
+            io_code = code;
+        } else {
+            float f = value;
+            uint32_t bits;
+            memcpy(&bits, &f, sizeof(bits));
+            writeVarint(bits ^ static_cast<uint32_t>(io_code));
+            io_code = bits;
+        }
+    }
+};
+
+struct BodyDeltaState
+{
+    // The flags of the joints quantized with the position precision
+    vector<bool> linearJointFlags;
+    vector<int64_t> linkCodes;
+    vector<int64_t> jointCodes;
+    vector<DeviceStatePtr> deviceStates;
+};
+
+class WriteBuf
+{
+public:
+    vector<char> data;
+    ofstream& ofs;
+    size_t seekOffset;
+
+    WriteBuf(ofstream& ofs)
+        : ofs(ofs) {
+        seekOffset = 0;
+    }
+
+    size_t seekPos() {
+        return seekOffset + data.size();
+    }
+
+    void clear(){
+        data.clear();
+        seekOffset = ofs.tellp();
+    }
+
+    int size() const {
+        return data.size();
+    }
+
+    void flush(){
+        if(!data.empty()){
+            ofs.write(&data.front(), data.size());
+        }
+        ofs.flush();
+        clear();
+    }
+
+    void writeID(DataTypeID id){
+        writeOctet((char)id);
+    }
+
+    void writeOctet(char value){
+        data.push_back(value);
+    }
+
+    void writeShort(short value){
+        data.push_back(value & 0xff);
+        data.push_back(value >> 8);
+    }
+
+    void writeInt(int value){
+        data.push_back(value & 0xff);
+        data.push_back((value >> 8) & 0xff);
+        data.push_back((value >> 16) & 0xff);
+        data.push_back((value >> 24) & 0xff);
+    }
+
+    void writeInt(int pos, int value){
+        data[pos++] = value & 0xff;
+        data[pos++] = (value >> 8) & 0xff;
+        data[pos++] = (value >> 16) & 0xff;
+        data[pos++] = (value >> 24) & 0xff;
+    }
+
+    void writeSeekOffset(int offset){
+        writeInt(offset);
+    }
+
+    void writeSeekOffset(int pos, int offset){
+        writeInt(pos, offset);
+    }
+
+    void writeFloat(float value){
+        char* p = (char*)&value;
+        const int n = sizeof(float);
+        for(int i=0; i < n; ++i){
+            data.push_back(p[i]);
+        }
+    }
+
+    void writeSE3(const SE3& position){
+        const Vector3& p = position.translation();
+        writeFloat(p.x());
+        writeFloat(p.y());
+        writeFloat(p.z());
+        const Quaternion& q = position.rotation();
+        writeFloat(q.w());
+        writeFloat(q.x());
+        writeFloat(q.y());
+        writeFloat(q.z());
+    }
+
+    void writeString(const std::string& str){
+        const int size = str.size();
+        data.reserve(data.size() + size + 1);
+        writeShort((unsigned char)size);
+        for(int i=0; i < size; ++i){
+            writeOctet(str[i]);
+        }
+    }
+};
+
+}
+
+namespace cnoid {
+
+class WorldLogFileWriter::Impl
+{
+public:
+    ofstream ofs;
+    string filename;
+    WriteBuf writeBuf;
+    WorldLogFileIndex frameIndex;
+    int lastOutputFramePos;
+    stack<int> sizeHeaderStack;
+
+    struct DeviceStateCache : public Referenced {
+        DeviceStatePtr state;
+        int seekPos;
+    };
+    typedef ref_ptr<DeviceStateCache> DeviceStateCachePtr;
+
+    vector<DeviceStateCachePtr> deviceStateCacheArrays[2];
+    vector<DeviceStateCachePtr>* pLastDeviceStateCacheArray;
+    vector<DeviceStateCachePtr>* pCurrentDeviceStateCacheArray;
+    int deviceIndex;
+    int numDeviceStateCaches;
+    int currentDeviceStateCacheArrayIndex;
+    vector<double> doubleWriteBuf;
+
+    int formatVersion;
+    int keyframeInterval;
+    double positionPrecision;
+    double anglePrecision;
+    int compressionLevel;
+    BlockBuf blockBuf;
+    vector<float> blockTimes;
+    vector<BodyDeltaState> bodyDeltaStates;
+    int bodyIndex;
+    bool isKeyframe;
+    vector<unsigned char> compressedData;
+
+    Impl();
+    BodyDeltaState& currentBodyDeltaState();
+    void writeBlock();
+    void reserveSizeHeader();
+    void fixSizeHeader();
+    void outputDeviceState(DeviceState* state);
+    void exchangeDeviceStateCacheArrays();
+};
+
+}
+
+
+WorldLogFileWriter::WorldLogFileWriter()
+{
+    impl = new Impl;
+}
+
+
+WorldLogFileWriter::Impl::Impl()
+    : writeBuf(ofs)
+{
+    lastOutputFramePos = 0;
+    deviceIndex = 0;
+    currentDeviceStateCacheArrayIndex = 0;
+    exchangeDeviceStateCacheArrays();
+    formatVersion = 1;
+    keyframeInterval = 100;
+    positionPrecision = 0.0;
+    anglePrecision = 0.0;
+    compressionLevel = Z_DEFAULT_COMPRESSION;
+    bodyIndex = 0;
+    isKeyframe = true;
+}
+
+
+void WorldLogFileWriter::setFormatVersion(int version)
+{
+    impl->formatVersion = (version >= 2) ? 2 : 1;
+}
+
+
+int WorldLogFileWriter::formatVersion() const
+{
+    return impl->formatVersion;
+}
+
+
+void WorldLogFileWriter::setKeyframeInterval(int n)
+{
+    impl->keyframeInterval = std::max(1, std::min(n, 65535));
+}
+
+
+int WorldLogFileWriter::keyframeInterval() const
+{
+    return impl->keyframeInterval;
+}
+
+
+void WorldLogFileWriter::setQuantizationPrecision(double positionPrecision, double anglePrecision)
+{
+    // The precisions are stored as float values in the header
+    impl->positionPrecision = static_cast<float>(std::max(0.0, positionPrecision));
+    impl->anglePrecision = static_cast<float>(std::max(0.0, anglePrecision));
+}
+
+
+double WorldLogFileWriter::positionPrecision() const
+{
+    return impl->positionPrecision;
+}
+
+
+double WorldLogFileWriter::anglePrecision() const
+{
+    return impl->anglePrecision;
+}
+
+
+void WorldLogFileWriter::setCompressionLevel(int level)
+{
+    impl->compressionLevel = std::max(-1, std::min(level, 9));
+}
+
+
+WorldLogFileWriter::~WorldLogFileWriter()
+{
+    close();
+    delete impl;
+}
+
+
+bool WorldLogFileWriter::open(const std::string& filename)
+{
+    close();
+    impl->filename = filename;
+    // The index of the previous log is invalid
+    std::remove(fromUTF8(WorldLogFileIndex::indexFilename(filename)).c_str());
+    impl->ofs.open(fromUTF8(filename).c_str(), ios::out | ios::binary | ios::trunc);
+    impl->writeBuf.clear();
+    impl->lastOutputFramePos = 0;
+    return impl->ofs.is_open();
+}
+
+
+void WorldLogFileWriter::close()
+{
+    if(impl->ofs.is_open()){
+        if(!impl->blockTimes.empty()){
+            impl->writeBlock();
+        }
+        impl->writeBuf.flush();
+        int64_t fileSize = impl->ofs.tellp();
+        impl->ofs.close();
+        if(!impl->ofs.fail() && !impl->frameIndex.empty()){
+            impl->frameIndex.save(impl->filename, fileSize);
+        }
+    }
+    impl->frameIndex.clear();
+    impl->blockBuf.data.clear();
+    impl->blockTimes.clear();
+    impl->bodyDeltaStates.clear();
+    impl->isKeyframe = true;
+    impl->ofs.clear();
+    impl->writeBuf.data.clear();
+    impl->writeBuf.seekOffset = 0;
+    impl->sizeHeaderStack = stack<int>();
+    for(auto& caches : impl->deviceStateCacheArrays){
+        caches.clear();
+    }
+    impl->currentDeviceStateCacheArrayIndex = 0;
+    impl->exchangeDeviceStateCacheArrays();
+}
+
+
+bool WorldLogFileWriter::isOpen() const
+{
+    return impl->ofs.is_open();
+}
+
+
+void WorldLogFileWriter::Impl::reserveSizeHeader()
+{
+    sizeHeaderStack.push(writeBuf.size());
+    writeBuf.writeSeekOffset(0);
+}
+
+
+void WorldLogFileWriter::Impl::fixSizeHeader()
+{
+    if(!sizeHeaderStack.empty()){
+        writeBuf.writeSeekOffset(sizeHeaderStack.top(), writeBuf.size() - (sizeHeaderStack.top() + sizeof(int)));
+        sizeHeaderStack.pop();
+    }
+}
+
+
+void WorldLogFileWriter::beginHeaderOutput()
+{
+    impl->writeBuf.clear();
+    impl->bodyDeltaStates.clear();
+    if(impl->formatVersion == 2){
+        impl->writeBuf.writeInt(Version2Marker);
+        impl->reserveSizeHeader();
+        impl->writeBuf.writeFloat(impl->positionPrecision);
+        impl->writeBuf.writeFloat(impl->anglePrecision);
+        impl->writeBuf.writeInt(impl->keyframeInterval);
+    } else {
+        impl->reserveSizeHeader();
+    }
+}
+
+
+void WorldLogFileWriter::outputBodyHeader(const std::string& name)
+{
+    impl->writeBuf.writeString(name);
+    if(impl->formatVersion == 2){
+        impl->writeBuf.writeInt(0);
+        impl->bodyDeltaStates.emplace_back();
+    }
+}
+
+
+/**
+   The body header of format version 2 has the number of the prismatic joints and their indices
+   after the body name.
+*/
+void WorldLogFileWriter::outputBodyHeader(const Body* body)
+{
+    impl->writeBuf.writeString(body->name());
+    if(impl->formatVersion == 2){
+        const int numJoints = body->numAllJoints();
+        impl->bodyDeltaStates.emplace_back();
+        auto& flags = impl->bodyDeltaStates.back().linearJointFlags;
+        flags.resize(numJoints, false);
+        vector<int> indices;
+        for(int i=0; i < numJoints; ++i){
+            if(body->joint(i)->isPrismaticJoint()){
+                flags[i] = true;
+                indices.push_back(i);
+            }
+        }
+        impl->writeBuf.writeInt(indices.size());
+        for(auto& index : indices){
+            impl->writeBuf.writeInt(index);
+        }
+    }
+}
+
+
+void WorldLogFileWriter::endHeaderOutput()
+{
+    impl->fixSizeHeader();
+    impl->writeBuf.flush();
+}
+
+
+void WorldLogFileWriter::beginFrameOutput(double time)
+{
+    size_t pos = impl->writeBuf.seekPos();
+
+    if(impl->formatVersion == 2){
+        // The frames in a block share the position of the block in the index
+        impl->frameIndex.append(static_cast<float>(time), pos);
+        impl->isKeyframe = impl->blockTimes.empty();
+        impl->blockTimes.push_back(time);
+        impl->bodyIndex = 0;
+        return;
+    }
+
+    if(impl->lastOutputFramePos){
+        impl->writeBuf.writeSeekOffset(pos - impl->lastOutputFramePos);
+    } else {
+        impl->writeBuf.writeSeekOffset(0);
+    }
+    impl->lastOutputFramePos = pos;
+    impl->frameIndex.append(static_cast<float>(time), pos);
+
+    impl->deviceIndex = 0;
+    impl->writeBuf.writeFloat(time);
+    impl->reserveSizeHeader(); // area for the frame data size
+}
+
+
+void WorldLogFileWriter::beginBodyStateOutput()
+{
+    if(impl->formatVersion == 2){
+        impl->blockBuf.writeID(BODY_STATE);
+        return;
+    }
+    impl->writeBuf.writeID(BODY_STATE);
+    impl->reserveSizeHeader();
+}
+
+
+BodyDeltaState& WorldLogFileWriter::Impl::currentBodyDeltaState()
+{
+    if(bodyIndex >= static_cast<int>(bodyDeltaStates.size())){
+        bodyDeltaStates.resize(bodyIndex + 1);
+    }
+    return bodyDeltaStates[bodyIndex];
+}
+
+
+void WorldLogFileWriter::outputLinkPositions(SE3* positions, int size)
+{
+    if(impl->formatVersion == 2){
+        auto& buf = impl->blockBuf;
+        auto& codes = impl->currentBodyDeltaState().linkCodes;
+        if(impl->isKeyframe){
+            codes.clear();
+        }
+        codes.resize(size * 7, 0);
+        const double pp = impl->positionPrecision;
+        const double ap = impl->anglePrecision;
+        buf.writeID(LINK_POSITIONS);
+        buf.writeVarint(size);
+        int64_t* c = codes.data();
+        for(int i=0; i < size; ++i){
+            const Vector3& p = positions[i].translation();
+            const Quaternion& q = positions[i].rotation();
+            buf.writeValue(c[0], p.x(), pp);
+            buf.writeValue(c[1], p.y(), pp);
+            buf.writeValue(c[2], p.z(), pp);
+            buf.writeValue(c[3], q.w(), ap);
+            buf.writeValue(c[4], q.x(), ap);
+            buf.writeValue(c[5], q.y(), ap);
+            buf.writeValue(c[6], q.z(), ap);
+            c += 7;
+        }
+        return;
+    }
+    impl->writeBuf.writeID(LINK_POSITIONS);
+    impl->reserveSizeHeader();
+    impl->writeBuf.writeShort(size);
+    for(int i=0; i < size; ++i){
+        impl->writeBuf.writeSE3(positions[i]);
+    }
+    impl->fixSizeHeader();
+}
+
+
+void WorldLogFileWriter::outputJointPositions(double* values, int size)
+{
+    if(impl->formatVersion == 2){
+        auto& buf = impl->blockBuf;
+        auto& state = impl->currentBodyDeltaState();
+        auto& codes = state.jointCodes;
+        if(impl->isKeyframe){
+            codes.clear();
+        }
+        codes.resize(size, 0);
+        buf.writeID(JOINT_POSITIONS);
+        buf.writeVarint(size);
+        const auto& linearFlags = state.linearJointFlags;
+        for(int i=0; i < size; ++i){
+            bool isLinear = (i < static_cast<int>(linearFlags.size())) && linearFlags[i];
+            buf.writeValue(codes[i], values[i], isLinear ? impl->positionPrecision : impl->anglePrecision);
+        }
+        return;
+    }
+    impl->writeBuf.writeID(JOINT_POSITIONS);
+    impl->reserveSizeHeader();
+    impl->writeBuf.writeShort(size);
+    for(int i=0; i < size; ++i){
+        impl->writeBuf.writeFloat(values[i]);
+    }
+    impl->fixSizeHeader();
+}
+
+
+void WorldLogFileWriter::beginDeviceStateOutput()
+{
+    if(impl->formatVersion == 2){
+        impl->blockBuf.writeID(DEVICE_STATES);
+        impl->deviceIndex = 0;
+        return;
+    }
+    impl->writeBuf.writeID(DEVICE_STATES);
+    impl->reserveSizeHeader();
+}
+
+
+void WorldLogFileWriter::outputDeviceState(DeviceState* state)
+{
+    impl->outputDeviceState(state);
+}
+
+
+void WorldLogFileWriter::Impl::outputDeviceState(DeviceState* state)
+{
+    if(formatVersion == 2){
+        /*
+          The header is one if the state is the same instance as the previous frame in the block.
+          Otherwise it is the state size plus two, and the state values follow it.
+          Zero is used as the terminator of the device states.
+        */
+        auto& states = currentBodyDeltaState().deviceStates;
+        if(deviceIndex >= static_cast<int>(states.size())){
+            states.resize(deviceIndex + 1);
+        }
+        auto& prevState = states[deviceIndex++];
+        if(!isKeyframe && state == prevState){
+            blockBuf.writeVarint(1);
+        } else {
+            prevState = state;
+            int size = state ? state->stateSize() : 0;
+            blockBuf.writeVarint(size + 2);
+            if(size > 0){
+                doubleWriteBuf.resize(size);
+                state->writeState(&doubleWriteBuf.front());
+                for(int i=0; i < size; ++i){
+                    blockBuf.writeFloat(doubleWriteBuf[i]);
+                }
+            }
+        }
+        return;
+    }
+    
+    DeviceStateCache* cache = nullptr;
+
+    if(deviceIndex >= numDeviceStateCaches){
+        cache = new DeviceStateCache;
+    } else {
+        cache = (*pLastDeviceStateCacheArray)[deviceIndex];
+        if(state == cache->state){
+            writeBuf.writeShort(-1);
+            writeBuf.writeSeekOffset(cache->seekPos);
+            goto endOutputDeviceState;
+        }
+    }
+    cache->state = state;
+    cache->seekPos = writeBuf.seekPos();
+    if(!state){
+        writeBuf.writeShort(0);
+    } else {
+        int size = state->stateSize();
+        writeBuf.writeShort(size);
+        doubleWriteBuf.resize(size);
+        state->writeState(&doubleWriteBuf.front());
+        for(int i=0; i < size; ++i){
+            writeBuf.writeFloat(doubleWriteBuf[i]);
+        }
+    }
+endOutputDeviceState:
+
+    pCurrentDeviceStateCacheArray->push_back(cache);
+    ++deviceIndex;
+}
+
+
+void WorldLogFileWriter::endDeviceStateOutput()
+{
+    if(impl->formatVersion == 2){
+        impl->blockBuf.writeVarint(0);
+        return;
+    }
+    impl->fixSizeHeader();
+}
+
+
+void WorldLogFileWriter::endBodyStateOutput()
+{
+    if(impl->formatVersion == 2){
+        impl->blockBuf.writeID(END_OF_BODY_STATE);
+        ++impl->bodyIndex;
+        return;
+    }
+    impl->fixSizeHeader();
+}
+
+
+void WorldLogFileWriter::endFrameOutput()
+{
+    if(impl->formatVersion == 2){
+        impl->blockBuf.writeID(END_OF_FRAME);
+        if(static_cast<int>(impl->blockTimes.size()) >= impl->keyframeInterval){
+            impl->writeBlock();
+        }
+        return;
+    }
+    impl->fixSizeHeader();
+    impl->writeBuf.flush();
+    impl->exchangeDeviceStateCacheArrays();
+}
+
+
+void WorldLogFileWriter::Impl::exchangeDeviceStateCacheArrays()
+{
+    int i = 1 - currentDeviceStateCacheArrayIndex;
+    pCurrentDeviceStateCacheArray = &deviceStateCacheArrays[i];
+    pLastDeviceStateCacheArray = &deviceStateCacheArrays[1-i];
+    pCurrentDeviceStateCacheArray->clear();
+    numDeviceStateCaches = pLastDeviceStateCacheArray->size();
+    currentDeviceStateCacheArrayIndex = i;
+}
+
+
+/**
+   A block of format version 2 consists of the number of the frames, the size of the stored data,
+   the uncompressed data size, the times of the frames and the compressed frame data.
+   The uncompressed data size is zero if the data is stored without the compression.
+   The first frame of a block is a keyframe, which does not depend on the previous blocks.
+*/
+void WorldLogFileWriter::Impl::writeBlock()
+{
+    auto& data = blockBuf.data;
+    uLongf compressedSize = compressBound(data.size());
+    compressedData.resize(compressedSize);
+    bool isCompressed =
+        (compress2(compressedData.data(), &compressedSize, data.data(), data.size(), compressionLevel) == Z_OK);
+    auto& storedData = isCompressed ? compressedData : data;
+    const size_t storedSize = isCompressed ? compressedSize : data.size();
+
+    writeBuf.writeInt(blockTimes.size());
+    writeBuf.writeInt(storedSize);
+    writeBuf.writeInt(isCompressed ? data.size() : 0);
+    for(auto& time : blockTimes){
+        writeBuf.writeFloat(time);
+    }
+    writeBuf.data.insert(writeBuf.data.end(), storedData.begin(), storedData.begin() + storedSize);
+    writeBuf.flush();
+
+    data.clear();
+    blockTimes.clear();
+}
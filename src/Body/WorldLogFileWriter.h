@@ -0,0 +1,91 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_WORLD_LOG_FILE_WRITER_H
+#define CNOID_BODY_WORLD_LOG_FILE_WRITER_H
+
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SE3;
+class Body;
+class DeviceState;
+
+/**
+   This class writes the simulation result in the world log format, which can be played back
+   with WorldLogFileItem.
+*/
+class CNOID_EXPORT WorldLogFileWriter
+{
+public:
+    WorldLogFileWriter();
+    ~WorldLogFileWriter();
+    WorldLogFileWriter(const WorldLogFileWriter&) = delete;
+    WorldLogFileWriter& operator=(const WorldLogFileWriter&) = delete;
+
+    /**
+       Version 1 is the default format, which writes the raw values of each frame.
+       Version 2 writes the frames in the blocks compressed with zlib. Each block begins with a
+       keyframe and the following frames are encoded as the differences from the previous frames.
+       The format must be set before the header is output.
+    */
+    void setFormatVersion(int version);
+    int formatVersion() const;
+
+    //! The number of the frames in a block of format version 2. The default value is 100.
+    void setKeyframeInterval(int n);
+    int keyframeInterval() const;
+
+    /**
+       The link positions are quantized with the position precision, and the link rotations and the
+       joint displacements are quantized with the angle precision in format version 2. The displacements
+       of the prismatic joints are quantized with the position precision if the body header is output
+       with the body. The values are not quantized when the precision is zero, which is the default.
+    */
+    void setQuantizationPrecision(double positionPrecision, double anglePrecision);
+    double positionPrecision() const;
+    double anglePrecision() const;
+
+    //! The zlib compression level from 0 to 9. -1 specifies the default level.
+    void setCompressionLevel(int level);
+
+    //! The existing file is truncated.
+    bool open(const std::string& filename);
+
+    //! The frame index of the log is written to the sidecar file when the file is closed.
+    void close();
+    bool isOpen() const;
+
+    void beginHeaderOutput();
+    void outputBodyHeader(const std::string& name);
+    //! The joint types of the body are also recorded in format version 2.
+    void outputBodyHeader(const Body* body);
+    void endHeaderOutput();
+    void beginFrameOutput(double time);
+    void beginBodyStateOutput();
+    void outputLinkPositions(SE3* positions, int size);
+    void outputJointPositions(double* values, int size);
+    void beginDeviceStateOutput();
+
+    /**
+       The state which is the same instance as the state output in the previous frame for the same
+       device is not written again but is recorded as a reference to the previous data.
+    */
+    void outputDeviceState(DeviceState* state);
+
+    void endDeviceStateOutput();
+    void endBodyStateOutput();
+    void endFrameOutput();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -16,6 +16,8 @@
 #include "PointLight.h"
 #include "SpotLight.h"
 #include <cnoid/YAMLSceneReader>
+#include <cnoid/MeshFilter>
+#include <cnoid/CloneMap>
 #include <cnoid/EigenArchive>
 #include <cnoid/Exception>
 #include <cnoid/YAMLReader>
@@ -282,6 +284,17 @@ public:
 
     BodyHandlerManager bodyHandlerManager;
 
+    struct LevelOfDetail
+    {
+        double ratio;
+        double maxError;
+        LevelOfDetail() : ratio(1.0), maxError(0.0) { }
+        bool isEnabled() const { return ratio < 1.0 || maxError > 0.0; }
+    };
+    LevelOfDetail visualLevelOfDetail;
+    LevelOfDetail collisionLevelOfDetail;
+    unique_ptr<MeshFilter> meshFilter;
+
     YAMLBodyLoaderImpl(YAMLBodyLoader* self);
     ~YAMLBodyLoaderImpl();
     void updateCustomNodeFunctions();
@@ -303,6 +316,9 @@ public:
     void readAxis(ValueNode* node, Vector3& out_axis);
     void setJointParameters(Link* link, string jointType, ValueNode* node);
     void setMassParameters(Link* link);
+    void readLevelOfDetail(Mapping* topNode);
+    void readLevelOfDetail(Mapping* node, const char* key, LevelOfDetail& out_lod);
+    SgNode* simplifyShape(SgNode* node, const LevelOfDetail& lod, CloneMap& cloneMap);
 
     /*
       The following functions return true if any scene nodes other than Group and Transform
@@ -633,6 +649,8 @@ bool YAMLBodyLoaderImpl::clear()
     numValidJointIds = 0;
     subBodyMap.clear();
     subBodies.clear();
+    visualLevelOfDetail = LevelOfDetail();
+    collisionLevelOfDetail = LevelOfDetail();
     return true;
 }    
 
@@ -815,6 +833,7 @@ bool YAMLBodyLoaderImpl::readBody(Mapping* topNode)
     sceneReader.setBaseDirectory(toUTF8(mainFilePath.parent_path().string()));
     sceneReader.setDefaultDivisionNumber(defaultDivisionNumber);
     sceneReader.readHeader(*topNode);
+    readLevelOfDetail(topNode);
 
     if(extract(topNode, "name", symbol)){
         body->setModelName(symbol);
@@ -915,6 +934,50 @@ bool YAMLBodyLoaderImpl::readBody(Mapping* topNode)
 }
 
 
+/**
+   The level of detail is specified as follows:
+   levelOfDetail:
+     visual: { ratio: 0.5 }
+     collision: { ratio: 0.2, maxError: 0.001 }
+   The "sensor" entry is also available for the simulators of the vision sensors.
+*/
+void YAMLBodyLoaderImpl::readLevelOfDetail(Mapping* topNode)
+{
+    auto lodNode = topNode->findMapping("levelOfDetail");
+    if(lodNode->isValid()){
+        readLevelOfDetail(lodNode, "visual", visualLevelOfDetail);
+        readLevelOfDetail(lodNode, "collision", collisionLevelOfDetail);
+    }
+}
+
+
+void YAMLBodyLoaderImpl::readLevelOfDetail(Mapping* node, const char* key, LevelOfDetail& out_lod)
+{
+    auto lodNode = node->findMapping(key);
+    if(lodNode->isValid()){
+        lodNode->read("ratio", out_lod.ratio);
+        lodNode->read("maxError", out_lod.maxError);
+        if(out_lod.ratio <= 0.0 || out_lod.ratio > 1.0){
+            lodNode->throwException(_("The ratio of the level of detail must be in (0, 1]"));
+        }
+    }
+}
+
+
+SgNode* YAMLBodyLoaderImpl::simplifyShape(SgNode* node, const LevelOfDetail& lod, CloneMap& cloneMap)
+{
+    if(!lod.isEnabled()){
+        return node;
+    }
+    if(!meshFilter){
+        meshFilter.reset(new MeshFilter);
+    }
+    auto simplified = node->cloneNode(cloneMap);
+    meshFilter->simplify(simplified, lod.ratio, lod.maxError);
+    return simplified;
+}
+
+
 void YAMLBodyLoaderImpl::readNodeInLinks(Mapping* node, const string& nodeType)
 {
     string type;
@@ -1017,12 +1080,16 @@ LinkPtr YAMLBodyLoaderImpl::readLinkContents(Mapping* node, LinkPtr link)
         if(readElementContents(*elements) && !isSubBodyNode){
             SceneGroupSet& sgs = currentSceneGroupSet();
             sgs.setName(link->name());
-            if(hasVisualOrCollisionNodes){
+            if(hasVisualOrCollisionNodes ||
+               visualLevelOfDetail.isEnabled() || collisionLevelOfDetail.isEnabled()){
+                // The clone maps are separated because the visual and collision groups may share nodes
+                CloneMap visualCloneMap;
                 for(auto& node : *sgs.visual){
-                    link->addVisualShapeNode(node);
+                    link->addVisualShapeNode(simplifyShape(node, visualLevelOfDetail, visualCloneMap));
                 }
+                CloneMap collisionCloneMap;
                 for(auto& node : *sgs.collision){
-                    link->addCollisionShapeNode(node);
+                    link->addCollisionShapeNode(simplifyShape(node, collisionLevelOfDetail, collisionCloneMap));
                 }
             } else {
                 for(auto& node : *sgs.visual){
@@ -79,7 +79,6 @@ public:
     AISTSimulatorItem* self;
 
     DyWorld<ConstraintForceSolver> world;
-    vector<DyLink*> internalStateUpdateLinks;
         
     Selection dynamicsMode;
     Selection integrationMode;
@@ -90,6 +89,7 @@ public:
     FloatingNumberString contactCullingDepth;
     FloatingNumberString errorCriterion;
     int maxNumIterations;
+    double relaxationFactor;
     FloatingNumberString contactCorrectionDepth;
     FloatingNumberString contactCorrectionVelocityRatio;
     double epsilon;
@@ -97,6 +97,7 @@ public:
     bool isKinematicWalkingEnabled;
     bool isOldAccelSensorMode;
     bool hasNonRootFreeJoints;
+    int numDynamicsThreads;
 
     stdx::optional<int> forcedBodyPositionFunctionId;
     std::mutex forcedBodyPositionMutex;
@@ -105,12 +106,22 @@ public:
 
     MessageView* mv;
 
+    // The statistics of the island solves, which are collected when the step profiling is enabled
+    bool isIslandStatisticsEnabled;
+    int numIslandSolves;
+    long long numTotalIslandIterations;
+    int maxNumIslandIterations;
+    int numUnconvergedIslandSolves;
+    double maxIslandSolutionError;
+
     Impl(AISTSimulatorItem* self);
     Impl(AISTSimulatorItem* self, const Impl& org);
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
     void addBody(AISTSimBody* simBody);
     void clearExternalForces();
     void stepKinematicsSimulation(const std::vector<SimulationBody*>& activeSimBodies);
+    void updateIslandStatistics();
+    void putIslandStatistics();
     void setForcedPosition(BodyItem* bodyItem, const Isometry3& T);
     void doSetForcedPosition();
     void doPutProperties(PutPropertyFunction& putProperty);
@@ -162,6 +173,7 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     
     errorCriterion = cfs.gaussSeidelErrorCriterion();
     maxNumIterations = cfs.gaussSeidelMaxNumIterations();
+    relaxationFactor = cfs.gaussSeidelRelaxationFactor();
     contactCorrectionDepth = cfs.contactCorrectionDepth();
     contactCorrectionVelocityRatio = cfs.contactCorrectionVelocityRatio();
 
@@ -169,8 +181,10 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     is2Dmode = false;
     isOldAccelSensorMode = false;
     hasNonRootFreeJoints = false;
+    numDynamicsThreads = 1;
 
     mv = MessageView::instance();
+    isIslandStatisticsEnabled = false;
 }
 
 
@@ -194,14 +208,17 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self, const Impl& org)
     contactCullingDepth = org.contactCullingDepth;
     errorCriterion = org.errorCriterion;
     maxNumIterations = org.maxNumIterations;
+    relaxationFactor = org.relaxationFactor;
     contactCorrectionDepth = org.contactCorrectionDepth;
     contactCorrectionVelocityRatio = org.contactCorrectionVelocityRatio;
     epsilon = org.epsilon;
     isKinematicWalkingEnabled = org.isKinematicWalkingEnabled;
     is2Dmode = org.is2Dmode;
     isOldAccelSensorMode = org.isOldAccelSensorMode;
+    numDynamicsThreads = org.numDynamicsThreads;
 
     mv = MessageView::instance();
+    isIslandStatisticsEnabled = false;
 }
 
 
@@ -300,6 +317,12 @@ void AISTSimulatorItem::setMaxNumIterations(int value)
 }
 
 
+void AISTSimulatorItem::setRelaxationFactor(double value)
+{
+    impl->relaxationFactor = value;
+}
+
+
 void AISTSimulatorItem::setContactCorrectionDepth(double value)
 {
     impl->contactCorrectionDepth = value;
@@ -330,6 +353,12 @@ void AISTSimulatorItem::setKinematicWalkingEnabled(bool on)
 }
 
 
+void AISTSimulatorItem::setNumDynamicsThreads(int n)
+{
+    impl->numDynamicsThreads = std::max(1, n);
+}
+
+
 void AISTSimulatorItem::setConstraintForceOutputEnabled(bool /* on */)
 {
 
@@ -401,6 +430,7 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     world.setGravityAcceleration(gravity);
     world.enableSensors(true);
     world.setOldAccelSensorCalcMode(isOldAccelSensorMode);
+    world.setNumThreads(numDynamicsThreads);
     world.setTimeStep(self->worldTimeStep());
     world.setCurrentTime(0.0);
 
@@ -408,12 +438,20 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     cfs.setMaterialTable(self->worldItem()->materialTable());
     cfs.setGaussSeidelErrorCriterion(errorCriterion.value());
     cfs.setGaussSeidelMaxNumIterations(maxNumIterations);
+    cfs.setGaussSeidelRelaxationFactor(relaxationFactor);
     cfs.setContactDepthCorrection(contactCorrectionDepth.value(), contactCorrectionVelocityRatio.value());
+    cfs.setProfiler(self->stepProfiler());
+
+    isIslandStatisticsEnabled = (self->stepProfiler() != nullptr);
+    numIslandSolves = 0;
+    numTotalIslandIterations = 0;
+    maxNumIslandIterations = 0;
+    numUnconvergedIslandSolves = 0;
+    maxIslandSolutionError = 0.0;
     
     self->addPostDynamicsFunction([&](){ clearExternalForces(); });
 
     world.clearBodies();
-    internalStateUpdateLinks.clear();
 
     hasNonRootFreeJoints = false;
     for(size_t i=0; i < simBodies.size(); ++i){
@@ -478,7 +516,7 @@ void AISTSimulatorItem::Impl::addBody(AISTSimBody* simBody)
                 continue;
 
             } else if(link->actuationMode() == Link::AllStateHighGainActuationMode){
-                internalStateUpdateLinks.push_back(link);
+                continue; // The states are updated by the world
 
             } else if(mode == Link::DeprecatedJointSurfaceVelocity){
                 if(link->isFixedJoint()){
@@ -518,25 +556,13 @@ bool AISTSimulatorItem::stepSimulation(const std::vector<SimulationBody*>& activ
 {
     switch(impl->dynamicsMode.which()){
 
-    case FORWARD_DYNAMICS: {
-        // Update the internal states for a special actuation mode
-        bool doRefresh = false;
-        for(auto& dyLink : impl->internalStateUpdateLinks){
-            if(dyLink->actuationMode() == Link::AllStateHighGainActuationMode){
-                if(dyLink->hasJoint()){
-                    dyLink->q() = dyLink->q_target();
-                    dyLink->dq() = dyLink->dq_target();
-                }
-                dyLink->vo() = dyLink->v() - dyLink->w().cross(dyLink->p());
-                doRefresh = true;
-            }
-        }
-        if(doRefresh){
-            impl->world.refreshState();
-        }
+    case FORWARD_DYNAMICS:
+        impl->world.updateAllStateHighGainLinks();
         impl->world.calcNextState();
+        if(impl->isIslandStatisticsEnabled){
+            impl->updateIslandStatistics();
+        }
         break;
-    }
         
     case KINEMATICS:
         impl->stepKinematicsSimulation(activeSimBodies);
@@ -599,8 +625,49 @@ void AISTSimulatorItem::Impl::stepKinematicsSimulation(const std::vector<Simulat
 }
 
 
+void AISTSimulatorItem::Impl::updateIslandStatistics()
+{
+    auto& cfs = world.constraintForceSolver;
+    const double criterion = cfs.gaussSeidelErrorCriterion();
+    const int n = cfs.numIslands();
+    for(int i=0; i < n; ++i){
+        auto& info = cfs.islandInfo(i);
+        ++numIslandSolves;
+        numTotalIslandIterations += info.numIterations;
+        if(info.numIterations > maxNumIslandIterations){
+            maxNumIslandIterations = info.numIterations;
+        }
+        if(!info.iterationErrors.empty()){
+            double error = info.iterationErrors.back();
+            if(error >= criterion){
+                ++numUnconvergedIslandSolves;
+            }
+            if(error > maxIslandSolutionError){
+                maxIslandSolutionError = error;
+            }
+        }
+    }
+}
+
+
+void AISTSimulatorItem::Impl::putIslandStatistics()
+{
+    if(numIslandSolves == 0){
+        return;
+    }
+    mv->putln(
+        format(_("Constraint force solver: {0} island solves, {1:.1f} iterations on average, "
+                 "{2} iterations at most, {3} solves without convergence, the maximum error {4:.3g}"),
+               numIslandSolves, static_cast<double>(numTotalIslandIterations) / numIslandSolves,
+               maxNumIslandIterations, numUnconvergedIslandSolves, maxIslandSolutionError));
+}
+
+
 void AISTSimulatorItem::finalizeSimulation()
 {
+    if(impl->isIslandStatisticsEnabled){
+        impl->putIslandStatistics();
+    }
     if(ENABLE_DEBUG_OUTPUT){
         impl->os.close();
     }
@@ -714,6 +781,8 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("Error criterion"), errorCriterion,
                 [&](const string& v){ return errorCriterion.setPositiveValue(v); });
     putProperty.min(1.0)(_("Max iterations"), maxNumIterations, changeProperty(maxNumIterations));
+    putProperty.decimals(2).min(0.1).max(1.9)(_("Relaxation factor"), relaxationFactor, changeProperty(relaxationFactor));
+    putProperty.reset();
     putProperty(_("CC depth"), contactCorrectionDepth,
                 [&](const string& v){ return contactCorrectionDepth.setNonNegativeValue(v); });
     putProperty(_("CC v-ratio"), contactCorrectionVelocityRatio,
@@ -722,6 +791,7 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(isKinematicWalkingEnabled));
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
     putProperty(_("Old accel sensor mode"), isOldAccelSensorMode, changeProperty(isOldAccelSensorMode));
+    putProperty.min(1)(_("Dynamics threads"), numDynamicsThreads, changeProperty(numDynamicsThreads));
 }
 
 
@@ -743,11 +813,13 @@ bool AISTSimulatorItem::Impl::store(Archive& archive)
     archive.write("contactCullingDepth", contactCullingDepth);
     archive.write("errorCriterion", errorCriterion);
     archive.write("maxNumIterations", maxNumIterations);
+    archive.write("relaxationFactor", relaxationFactor);
     archive.write("contactCorrectionDepth", contactCorrectionDepth);
     archive.write("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio);
     archive.write("kinematicWalking", isKinematicWalkingEnabled);
     archive.write("2Dmode", is2Dmode);
     archive.write("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.write("dynamicsThreads", numDynamicsThreads);
     return true;
 }
 
@@ -775,10 +847,12 @@ bool AISTSimulatorItem::Impl::restore(const Archive& archive)
     contactCullingDepth = archive.get("contactCullingDepth", contactCullingDepth.string());
     errorCriterion = archive.get("errorCriterion", errorCriterion.string());
     archive.read("maxNumIterations", maxNumIterations);
+    archive.read("relaxationFactor", relaxationFactor);
     contactCorrectionDepth = archive.get("contactCorrectionDepth", contactCorrectionDepth.string());
     contactCorrectionVelocityRatio = archive.get("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio.string());
     archive.read("kinematicWalking", isKinematicWalkingEnabled);
     archive.read("2Dmode", is2Dmode);
     archive.read("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.read("dynamicsThreads", numDynamicsThreads);
     return true;
 }
@@ -38,12 +38,19 @@ public:
     void setContactCullingDepth(double value);        
     void setErrorCriterion(double value);        
     void setMaxNumIterations(int value);
+    void setRelaxationFactor(double value);
     void setContactCorrectionDepth(double value);
     void setContactCorrectionVelocityRatio(double value);
     void setEpsilon(double epsilon);
     void set2Dmode(bool on);
     void setKinematicWalkingEnabled(bool on);
 
+    /**
+       Set the number of threads used to compute the forward dynamics of the bodies.
+       The default value is one. Multiple threads are effective for the worlds with many bodies.
+    */
+    void setNumDynamicsThreads(int n);
+
     [[deprecated("This function does nothing. Set Link::LinkContactState to Link::sensingMode from a controller.")]]
     void setConstraintForceOutputEnabled(bool on);
 
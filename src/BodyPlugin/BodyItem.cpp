@@ -41,6 +41,7 @@
 #include <bitset>
 #include <deque>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 #include "gettext.h"
 
@@ -202,6 +203,13 @@ public:
 
 namespace {
 
+class PreloadedBody : public Referenced
+{
+public:
+    BodyPtr body;
+    string messages;
+};
+
 class BodyFileIO : public ItemFileIOBase<BodyItem>
 {
     BodyLoader bodyLoader;
@@ -209,7 +217,7 @@ class BodyFileIO : public ItemFileIOBase<BodyItem>
     
 public:
     BodyFileIO()
-        : ItemFileIOBase<BodyItem>("CHOREONOID-BODY", Load | Save)
+        : ItemFileIOBase<BodyItem>("CHOREONOID-BODY", Load | Save | Preload)
     {
         setCaption(_("Body"));
         setExtensions({ "body", "yaml", "yml", "wrl" });
@@ -218,11 +226,35 @@ public:
         bodyLoader.setMessageSink(os());
     }
 
+    virtual Referenced* preload(const std::string& filename) override
+    {
+        // A loader is created for each call because this function is executed concurrently
+        BodyLoader loader;
+        ostringstream os;
+        loader.setMessageSink(os);
+        BodyPtr body = new Body;
+        if(!loader.load(body, filename)){
+            return nullptr;
+        }
+        auto preloaded = new PreloadedBody;
+        preloaded->body = body;
+        preloaded->messages = os.str();
+        return preloaded;
+    }
+
     virtual bool load(BodyItem* item, const std::string& filename) override
     {
-        BodyPtr newBody = new Body;
-        if(!bodyLoader.load(newBody, filename)){
-            return false;
+        BodyPtr newBody;
+        bool isShared;
+        if(auto preloaded = dynamic_pointer_cast<PreloadedBody>(takePreloadedData(filename, &isShared))){
+            os() << preloaded->messages;
+            // The body is copied for each item when multiple items load the same file
+            newBody = isShared ? preloaded->body->clone() : preloaded->body.get();
+        } else {
+            newBody = new Body;
+            if(!bodyLoader.load(newBody, filename)){
+                return false;
+            }
         }
         item->setBody(newBody);
 
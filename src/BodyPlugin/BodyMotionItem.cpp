@@ -138,6 +138,21 @@ void BodyMotionItem::initializeClass(ExtensionManager* ext)
             return item->motion()->save(filename, 1.0, os);
         });
 
+    im.addLoaderAndSaver<BodyMotionItem>(
+        _("Body Motion (binary)"), "BODY-MOTION-BINARY", "bseq",
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->loadBinary(filename, os);
+        },
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->saveBinary(filename, false, os);
+        });
+
+    im.addSaver<BodyMotionItem>(
+        _("Body Motion (binary, single precision)"), "BODY-MOTION-BINARY", "bseq",
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->saveBinary(filename, true, os);
+        });
+
     initialized = true;
 }
 
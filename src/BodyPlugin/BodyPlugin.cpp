@@ -14,6 +14,7 @@
 #include "ControllerLogItem.h"
 #include "SubSimulatorItem.h"
 #include "GLVisionSimulatorItem.h"
+#include "RaycastVisionSimulatorItem.h"
 #include "SimulationScriptItem.h"
 #include "BodyMotionItem.h"
 #include "ZMPSeqItem.h"
@@ -98,6 +99,7 @@ public:
         ControllerLogItem::initializeClass(this);
         SubSimulatorItem::initializeClass(this);
         GLVisionSimulatorItem::initializeClass(this);
+        RaycastVisionSimulatorItem::initializeClass(this);
         SimulationScriptItem::initializeClass(this);
         BodyMotionItem::initializeClass(this);
         WorldLogFileItem::initializeClass(this);
@@ -4,6 +4,7 @@
 */
 
 #include "FisheyeLensConverter.h"
+#include <cnoid/ParallelScheduler>
 #include <cmath>
 #include <iostream>
 
@@ -197,6 +198,18 @@ void FisheyeLensConverter::setHorizontalBorder(int id0, int id1, double sx)
 }
 
 
+/**
+   The pixel arrays of the screen images are obtained in advance so that the rows of the image
+   can be converted in parallel with the maps.
+*/
+void FisheyeLensConverter::getScreenPixels(const unsigned char** out_pixels) const
+{
+    for(size_t i=0; i < 6; ++i){
+        out_pixels[i] = (i < screenImages.size()) ? screenImages[i]->pixels() : nullptr;
+    }
+}
+
+
 void  FisheyeLensConverter::convertImage(Image* image)
 {
     if(!isAntiAliasingEnabled){
@@ -389,21 +402,29 @@ void FisheyeLensConverter::convertImageWithoutAntiAliasing(Image* image)
             }
         }
     }else{
-        for(int j=0; j<height; j++){
-            for(int i=0; i<width; i++){
-                unsigned char* pix = &pixels[(i+j*width)*3];
-                ScreenIndex& screenIndex = fisheyeLensMap[j][i];
-                if(screenIndex.screenId != NO_SCREEN){
-                    unsigned char* tempPixels = screenImages[screenIndex.screenId]->pixels();
-                    unsigned char* tempPix = &tempPixels[(int)((screenIndex.ix + screenIndex.iy * screenWidth) * 3)];
-                    pix[0] = tempPix[0];
-                    pix[1] = tempPix[1];
-                    pix[2] = tempPix[2];
-                }else{
-                    pix[0] = pix[1] = pix[2] = 0;
+        const unsigned char* screenPixels[6];
+        getScreenPixels(screenPixels);
+        parallelFor(
+            0, height, std::max(1, 16384 / width),
+            [&](int rowBegin, int rowEnd){
+                for(int j=rowBegin; j<rowEnd; j++){
+                    const ScreenIndex* map = &fisheyeLensMap[j][0];
+                    unsigned char* pix = &pixels[j*width*3];
+                    for(int i=0; i<width; i++){
+                        const ScreenIndex& screenIndex = map[i];
+                        if(screenIndex.screenId != NO_SCREEN){
+                            const unsigned char* tempPix =
+                                screenPixels[screenIndex.screenId] + (screenIndex.ix + screenIndex.iy * screenWidth) * 3;
+                            pix[0] = tempPix[0];
+                            pix[1] = tempPix[1];
+                            pix[2] = tempPix[2];
+                        }else{
+                            pix[0] = pix[1] = pix[2] = 0;
+                        }
+                        pix += 3;
+                    }
                 }
-            }
-        }
+            });
     }
 }
 
@@ -886,26 +907,35 @@ void  FisheyeLensConverter::convertImageWithAntiAliasing(Image* image)
             }
         }
     }else{
-        for(int j=0; j<height; j++){
-            for(int i=0; i<width; i++){
-                unsigned char* pix = &pixels[(i+j*width)*3];
-                ScreenIndex4& map = fisheyeLensInterpolationMap[j][i];
-                if(map.screenIndex[0].screenId != NO_SCREEN){
-                    double pixd[3] = {0.0,0.0,0.0};
-                    for(int k=0; k<4; k++){
-                        unsigned char* tempPixels = screenImages[map.screenIndex[k].screenId]->pixels();
-                        unsigned char* tempPix = &tempPixels[(int)((map.screenIndex[k].ix + map.screenIndex[k].iy * screenWidth) * 3)];
-                        for(int kk=0; kk<3; kk++){
-                            pixd[kk] += map.bias[k] * tempPix[kk];
+        const unsigned char* screenPixels[6];
+        getScreenPixels(screenPixels);
+        parallelFor(
+            0, height, std::max(1, 4096 / width),
+            [&](int rowBegin, int rowEnd){
+                for(int j=rowBegin; j<rowEnd; j++){
+                    const ScreenIndex4* maps = &fisheyeLensInterpolationMap[j][0];
+                    unsigned char* pix = &pixels[j*width*3];
+                    for(int i=0; i<width; i++){
+                        const ScreenIndex4& map = maps[i];
+                        if(map.screenIndex[0].screenId != NO_SCREEN){
+                            double pixd[3] = {0.0,0.0,0.0};
+                            for(int k=0; k<4; k++){
+                                const ScreenIndex& screenIndex = map.screenIndex[k];
+                                const unsigned char* tempPix =
+                                    screenPixels[screenIndex.screenId] + (screenIndex.ix + screenIndex.iy * screenWidth) * 3;
+                                for(int kk=0; kk<3; kk++){
+                                    pixd[kk] += map.bias[k] * tempPix[kk];
+                                }
+                            }
+                            for(int kk=0; kk<3; kk++){
+                                pix[kk] = nearbyint(pixd[kk]);
+                            }
+                        }else{
+                            pix[0] = pix[1] = pix[2] = 0;
                         }
+                        pix += 3;
                     }
-                    for(int kk=0; kk<3; kk++){
-                        pix[kk] = nearbyint(pixd[kk]);
-                    }
-                }else{
-                    pix[0] = pix[1] = pix[2] = 0;
                 }
-            }
-        }
+            });
     }
 }
@@ -66,6 +66,7 @@ private:
     void setCenter(int id, double sx, double sy);
     void setVerticalBorder(int id0, int id1, double sy);
     void setHorizontalBorder(int id0, int id1, double sx);
+    void getScreenPixels(const unsigned char** out_pixels) const;
     void convertImageWithoutAntiAliasing(Image* image);
     void convertImageWithAntiAliasing(Image* image);
 };
@@ -24,9 +24,14 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/CloneMap>
+#include <cnoid/MeshFilter>
+#include <cnoid/ValueTree>
 #include <cnoid/EigenUtil>
 #include <cnoid/StringUtil>
 #include <cnoid/Tokenizer>
+#include <cnoid/SharedObjectPool>
+#include <cnoid/SensorDataEncoder>
+#include <cnoid/ParallelScheduler>
 #include <QThread>
 #include <QApplication>
 #include <QOpenGLContext>
@@ -87,6 +92,24 @@ bool updateNames(const string& nameListString, string& out_newNameListString, ve
     return true;
 }
 
+/**
+   The level of detail for the sensors is given by the "sensor" entry of the "levelOfDetail"
+   mapping in the body file.
+*/
+bool getSensorLevelOfDetail(Body* body, double& out_ratio, double& out_maxError)
+{
+    auto lodNode = body->info()->findMapping("levelOfDetail");
+    if(lodNode->isValid()){
+        auto sensorNode = lodNode->findMapping("sensor");
+        if(sensorNode->isValid()){
+            out_ratio = sensorNode->get("ratio", 1.0);
+            out_maxError = sensorNode->get("maxError", 0.0);
+            return out_ratio < 1.0 || out_maxError > 0.0;
+        }
+    }
+    return false;
+}
+
 class QThreadEx : public QThread
 {
     std::function<void()> function;
@@ -157,9 +180,16 @@ public:
     int pixelHeight;
     vector<unsigned char> colorBuf;
     vector<float> depthBuf;
+    vector<int> rowPointOffsets;
+    vector<double> rangeSamplingParameters;
+    vector<int> rangeSamplePixelIndices;
+    vector<double> rangeSampleDistanceRatios;
     std::shared_ptr<Image> tmpImage;
     std::shared_ptr<RangeCamera::PointData> tmpPoints;
     std::shared_ptr<RangeSensor::RangeData> tmpRangeData;
+    SharedObjectPool<Image> imagePool;
+    SharedObjectPool<RangeCamera::PointData> pointsPool;
+    SharedObjectPool<RangeSensor::RangeData> rangeDataPool;
     int screenId;
     bool isDense;
     bool flagToUpdatePreprocessedNodeTree;
@@ -180,6 +210,7 @@ public:
     void storeResultToTmpDataBuffer();
     bool getCameraImage(Image& image);
     bool getRangeCameraData(Image& image, vector<Vector3f>& points);
+    void updateRangeSamplingTable();
     bool getRangeSensorData(vector<double>& rangeData);
 };
 typedef ref_ptr<SensorScreenRenderer> SensorScreenRendererPtr;
@@ -206,6 +237,8 @@ public:
     bool isRendering;  // only updated and referred to in the simulation thread
     bool needToClearVisionDataByTurningOff;
     std::shared_ptr<RangeSensor::RangeData> rangeData;
+    SharedObjectPool<Image> imagePool;
+    SharedObjectPool<RangeSensor::RangeData> rangeDataPool;
     FisheyeLensConverter fisheyeLensConverter;
 
     SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* sensor, SimulationBody* simBody, int bodyIndex);
@@ -245,6 +278,7 @@ public:
     bool useThreadsForSensors;
     bool useThreadsForScreens;
     bool isVisionDataRecordingEnabled;
+    SensorDataEncoderPtr sensorDataEncoder;
     bool isBestEffortMode;
     bool isQueueRenderingTerminationRequested;
 
@@ -262,6 +296,7 @@ public:
     vector<string> sensorNames;
     string sensorNameListString;
     Selection threadMode;
+    Selection visionDataCompression;
     bool isBestEffortModeProperty;
     bool shootAllSceneObjects;
     bool isHeadLightEnabled;
@@ -313,7 +348,8 @@ GLVisionSimulatorItem::GLVisionSimulatorItem()
 GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self)
     : self(self),
       os(MessageView::instance()->cout()),
-      threadMode(GLVisionSimulatorItem::N_THREAD_MODES, CNOID_GETTEXT_DOMAIN_NAME)
+      threadMode(GLVisionSimulatorItem::N_THREAD_MODES, CNOID_GETTEXT_DOMAIN_NAME),
+      visionDataCompression(GLVisionSimulatorItem::N_VISION_DATA_COMPRESSION_TYPES, CNOID_GETTEXT_DOMAIN_NAME)
 {
     simulatorItem = nullptr;
     maxFrameRate = 1000.0;
@@ -332,6 +368,11 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     threadMode.setSymbol(GLVisionSimulatorItem::SCREEN_THREAD_MODE, N_("Screen"));
     threadMode.select(GLVisionSimulatorItem::SENSOR_THREAD_MODE);
 
+    visionDataCompression.setSymbol(GLVisionSimulatorItem::NO_COMPRESSION, N_("None"));
+    visionDataCompression.setSymbol(GLVisionSimulatorItem::LOSSLESS_COMPRESSION, N_("Lossless"));
+    visionDataCompression.setSymbol(GLVisionSimulatorItem::JPEG_COMPRESSION, N_("JPEG"));
+    visionDataCompression.select(GLVisionSimulatorItem::NO_COMPRESSION);
+
     isAntiAliasingEnabled = false;
 }
 
@@ -347,7 +388,8 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     : self(self),
       os(MessageView::instance()->cout()),
       bodyNames(org.bodyNames),
-      sensorNames(org.sensorNames)
+      sensorNames(org.sensorNames),
+      visionDataCompression(org.visionDataCompression)
 {
     simulatorItem = nullptr;
 
@@ -417,6 +459,15 @@ void GLVisionSimulatorItem::setVisionDataRecordingEnabled(bool on)
 }
 
 
+void GLVisionSimulatorItem::setVisionDataCompression(int type)
+{
+    if(type != impl->visionDataCompression.which()){
+        impl->visionDataCompression.select(type);
+        notifyUpdate();
+    }
+}
+
+
 void GLVisionSimulatorItem::setThreadMode(int mode)
 {
     if(mode != impl->threadMode.which()){
@@ -495,6 +546,14 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
     
     isBestEffortMode = isBestEffortModeProperty;
     renderersInRendering.clear();
+
+    sensorDataEncoder.reset();
+    if(isVisionDataRecordingEnabled && !visionDataCompression.is(GLVisionSimulatorItem::NO_COMPRESSION)){
+        sensorDataEncoder = new SensorDataEncoder;
+        if(visionDataCompression.is(GLVisionSimulatorItem::JPEG_COMPRESSION)){
+            sensorDataEncoder->setImageFormat(SensorDataEncoder::JPEG_FORMAT);
+        }
+    }
     renderersToTurnOff.clear();
 
     cloneMap.clear();
@@ -730,12 +789,14 @@ bool SensorRenderer::initialize(const vector<SimulationBody*>& simBodies)
         cycleTime = 1.0 / frameRate;
         if(simImpl->isVisionDataRecordingEnabled){
             camera->setImageStateClonable(true);
+            camera->setImageStateEncoder(simImpl->sensorDataEncoder);
         }
     } else if(rangeSensor){
         double frameRate = std::max(0.1, std::min(rangeSensor->scanRate(), simImpl->maxFrameRate));
         cycleTime = 1.0 / frameRate;
         if(simImpl->isVisionDataRecordingEnabled){
             rangeSensor->setRangeDataStateClonable(true);
+            rangeSensor->setRangeDataStateEncoder(simImpl->sensorDataEncoder);
         }
     }
 
@@ -767,8 +828,18 @@ SensorScenePtr SensorRenderer::createSensorScene(const vector<SimulationBody*>&
     simImpl->cloneMap.clear();
 
     for(size_t i=0; i < simBodies.size(); ++i){
-        auto sceneBody = new SceneBody(simBodies[i]->body());
-        sceneBody->cloneShapes(simImpl->cloneMap);
+        auto body = simBodies[i]->body();
+        auto sceneBody = new SceneBody(body);
+        double ratio, maxError;
+        if(getSensorLevelOfDetail(body, ratio, maxError)){
+            // The meshes of the body are not shared with the other bodies to simplify them
+            CloneMap lodCloneMap;
+            sceneBody->cloneShapes(lodCloneMap);
+            MeshFilter meshFilter;
+            meshFilter.simplify(sceneBody, ratio, maxError);
+        } else {
+            sceneBody->cloneShapes(simImpl->cloneMap);
+        }
         scene->sceneBodies.push_back(sceneBody);
         scene->root->addChild(sceneBody);
     }
@@ -1267,16 +1338,16 @@ void SensorScreenRenderer::storeResultToTmpDataBuffer()
 {
     if(cameraForRendering){
         if(!tmpImage){
-            tmpImage = std::make_shared<Image>();
+            tmpImage = imagePool.acquire();
         }
         if(rangeCameraForRendering){
-            tmpPoints = std::make_shared<vector<Vector3f>>();
+            tmpPoints = pointsPool.acquire();
             hasUpdatedData = getRangeCameraData(*tmpImage, *tmpPoints);
         } else {
             hasUpdatedData = getCameraImage(*tmpImage);
         }
     } else if(rangeSensorForRendering){
-        tmpRangeData =  std::make_shared<vector<double>>();
+        tmpRangeData = rangeDataPool.acquire();
         hasUpdatedData = getRangeSensorData(*tmpRangeData);
     }
 }
@@ -1439,18 +1510,19 @@ void SensorRenderer::copyVisionData()
                     rangeCamera->setDense(screen->isDense);
                 }
             } else if(lensType == Camera::FISHEYE_LENS || lensType == Camera::DUAL_FISHEYE_LENS){
-                std::shared_ptr<Image> image = std::make_shared<Image>();
+                std::shared_ptr<Image> image = imagePool.acquire();
                 fisheyeLensConverter.convertImage(image.get());
                 camera->setImage(image);
             }
             camera->setDelay(delay);
         } else if(rangeSensor){
             if(screens.empty()){
-                rangeData = std::make_shared<vector<double>>();
+                rangeData = rangeDataPool.acquire();
+                rangeData->clear();
             } else if(screens.size() == 1){
-                rangeData = screens[0]->tmpRangeData;
+                rangeData = std::move(screens[0]->tmpRangeData);
             } else {
-                rangeData = std::make_shared<vector<double>>();
+                rangeData = rangeDataPool.acquire();
                 vector<double>::iterator src[4];
                 int size = 0;
                 for(size_t i=0; i < screens.size(); ++i){
@@ -1503,119 +1575,161 @@ bool SensorScreenRenderer::getCameraImage(Image& image)
 }
 
 
+/**
+   The point of a pixel (x, y) with the normalized depth z is given by o.head<3>() / o[3], where
+   o = Pinv * (2x/w - 1, 2y/h - 1, 2z - 1, 1). o is linear in x and z, so it is calculated with two
+   vector additions per pixel from the vectors precomputed for each row. The rows are processed in
+   parallel. The rows of the depth buffer are stored from the bottom, and the points are stored from
+   the top row.
+*/
 bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& points)
 {
-    unsigned char* pixels = nullptr;
-
     const bool extractColors = (cameraForRendering->imageType() == Camera::COLOR_IMAGE);
     if(extractColors){
         glPixelStorei(GL_PACK_ALIGNMENT, 1);
         colorBuf.resize(pixelWidth * pixelHeight * 3 * sizeof(unsigned char));
         glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, &colorBuf[0]);
-        if(rangeCameraForRendering->isOrganized()){
-            image.setSize(pixelWidth, pixelHeight, 3);
-        } else {
-            image.setSize(pixelWidth * pixelHeight, 1, 3);
-        }
-        pixels = image.pixels();
     }
 
     depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
     glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
 
-    const Matrix4f Pinv = renderer->projectionMatrix().inverse().cast<float>();
-    const float fw = pixelWidth;
-    const float fh = pixelHeight;
-    const int cx = pixelWidth / 2;
-    const int cy = pixelHeight / 2;
+    const int width = pixelWidth;
+    const int height = pixelHeight;
     const bool isOrganized = rangeCameraForRendering->isOrganized();
-    Vector4f n;
-    n[3] = 1.0f;
-    points.clear();
-    points.reserve(pixelWidth * pixelHeight);
-    unsigned char* colorSrc = nullptr;
+    const int grainSize = std::max(1, 16384 / width);
 
-    isDense = true;
-    
-    for(int y = pixelHeight - 1; y >= 0; --y){
-        int srcpos = y * pixelWidth;
-        if(extractColors){
-            colorSrc = &colorBuf[0] + y * pixelWidth * 3;
-        }
-        for(int x=0; x < pixelWidth; ++x){
-            const float z = depthBuf[srcpos + x];
-            if(z > 0.0f && z < 1.0f){
-                n.x() = 2.0f * x / fw - 1.0f;
-                n.y() = 2.0f * y / fh - 1.0f;
-                n.z() = 2.0f * z - 1.0f;
-                const Vector4f o = Pinv * n;
-                const float& w = o[3];
-                points.push_back(Vector3f(o[0] / w, o[1] / w, o[2] / w));
-                if(pixels){
-                    pixels[0] = colorSrc[0];
-                    pixels[1] = colorSrc[1];
-                    pixels[2] = colorSrc[2];
-                    pixels += 3;
-                }
-            } else if(isOrganized){
-                points.push_back(Vector3f());
-                Vector3f& p = points.back();
-                if(z <= 0.0f){
-                    p.z() = numeric_limits<float>::infinity();
-                } else {
-                    p.z() = -numeric_limits<float>::infinity();
-                }
-                if(x == cx){
-                    p.x() = 0.0;
-                } else {
-                    p.x() = (x - cx) * numeric_limits<float>::infinity();
+    /*
+      The number of the valid points of each row is stored to rowPointOffsets[row + 1].
+      For the unorganized point cloud, they are counted in advance to determine where the points
+      of each row are stored.
+    */
+    rowPointOffsets.resize(height + 1);
+    rowPointOffsets[0] = 0;
+    if(!isOrganized){
+        parallelFor(
+            0, height, grainSize,
+            [&](int rowBegin, int rowEnd){
+                for(int row = rowBegin; row < rowEnd; ++row){
+                    const float* depths = &depthBuf[(height - 1 - row) * width];
+                    int n = 0;
+                    for(int x=0; x < width; ++x){
+                        n += (depths[x] > 0.0f && depths[x] < 1.0f);
+                    }
+                    rowPointOffsets[row + 1] = n;
                 }
-                if(y == cy){
-                    p.y() = 0.0;
-                } else {
-                    p.y() = (y - cy) * numeric_limits<float>::infinity();
+            });
+        for(int row=0; row < height; ++row){
+            rowPointOffsets[row + 1] += rowPointOffsets[row];
+        }
+        points.resize(rowPointOffsets[height]);
+    } else {
+        points.resize(width * height);
+    }
+
+    unsigned char* pixels = nullptr;
+    if(extractColors){
+        if(isOrganized){
+            image.setSize(width, height, 3);
+        } else {
+            image.setSize(points.size(), 1, 3);
+        }
+        pixels = image.pixels();
+    }
+
+    const Matrix4f Pinv = renderer->projectionMatrix().inverse().cast<float>();
+    const Vector4f dx = Pinv.col(0) * (2.0f / width);
+    const Vector4f dz = Pinv.col(2) * 2.0f;
+    const int cx = width / 2;
+    const int cy = height / 2;
+    constexpr float inf = numeric_limits<float>::infinity();
+
+    parallelFor(
+        0, height, grainSize,
+        [&](int rowBegin, int rowEnd){
+            for(int row = rowBegin; row < rowEnd; ++row){
+                const int y = height - 1 - row;
+                const float* depths = &depthBuf[y * width];
+                const unsigned char* colorSrc = extractColors ? &colorBuf[y * width * 3] : nullptr;
+                const Vector4f o0 =
+                    Pinv.col(1) * (2.0f * y / height - 1.0f) + Pinv.col(3) - Pinv.col(0) - Pinv.col(2);
+                const int rowTop = isOrganized ? (row * width) : rowPointOffsets[row];
+                int index = rowTop;
+                int numValidPoints = 0;
+                for(int x=0; x < width; ++x){
+                    const float z = depths[x];
+                    if(z > 0.0f && z < 1.0f){
+                        const Vector4f o = o0 + static_cast<float>(x) * dx + z * dz;
+                        points[index] = o.head<3>() / o[3];
+                        ++numValidPoints;
+                    } else if(isOrganized){
+                        points[index] <<
+                            ((x == cx) ? 0.0f : (x - cx) * inf),
+                            ((y == cy) ? 0.0f : (y - cy) * inf),
+                            ((z <= 0.0f) ? inf : -inf);
+                    } else {
+                        continue;
+                    }
+                    if(pixels){
+                        unsigned char* pixel = pixels + index * 3;
+                        const unsigned char* src = colorSrc + x * 3;
+                        pixel[0] = src[0];
+                        pixel[1] = src[1];
+                        pixel[2] = src[2];
+                    }
+                    ++index;
                 }
-                if(pixels){
-                    pixels[0] = colorSrc[0];
-                    pixels[1] = colorSrc[1];
-                    pixels[2] = colorSrc[2];
-                    pixels += 3;
+                if(isOrganized){
+                    rowPointOffsets[row + 1] = numValidPoints;
                 }
+            }
+        });
+
+    isDense = true;
+    if(isOrganized){
+        for(int row=0; row < height; ++row){
+            if(rowPointOffsets[row + 1] < width){
                 isDense = false;
+                break;
             }
-            colorSrc += 3;
         }
     }
 
-    if(extractColors && !rangeCameraForRendering->isOrganized()){
-        image.setSize((pixels - image.pixels()) / 3, 1, 3);
-    }
-
     return true;
 }
 
 
-bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
+/**
+   The pixel and the ratio of the distance to the depth of each sample only depend on the sampling
+   parameters, so they are calculated in advance and reused while the parameters are not changed.
+*/
+void SensorScreenRenderer::updateRangeSamplingTable()
 {
     const double yawRange = rangeSensorForRendering->yawRange();
     const double yawStep = rangeSensorForRendering->yawStep();
-    const double maxTanYawAngle = tan(yawRange / 2.0);
-
     const double pitchRange = rangeSensorForRendering->pitchRange();
     const int numPitchSamples = rangeSensorForRendering->numPitchSamples();
     const double pitchStep = rangeSensorForRendering->pitchStep();
-    const double maxTanPitchAngle = tan(pitchRange / 2.0) / cos(yawRange / 2.0);
 
-    const Matrix4 Pinv = renderer->projectionMatrix().inverse();
-    const double Pinv_32 = Pinv(3, 2);
-    const double Pinv_33 = Pinv(3, 3);
+    vector<double> parameters = {
+        yawRange, yawStep, pitchRange, pitchStep,
+        static_cast<double>(numPitchSamples), static_cast<double>(numUniqueYawSamples),
+        static_cast<double>(pixelWidth), static_cast<double>(pixelHeight) };
+
+    if(parameters == rangeSamplingParameters){
+        return;
+    }
+    rangeSamplingParameters = parameters;
+
+    const double maxTanYawAngle = tan(yawRange / 2.0);
+    const double maxTanPitchAngle = tan(pitchRange / 2.0) / cos(yawRange / 2.0);
     const double fw = pixelWidth;
     const double fh = pixelHeight;
 
-    depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
-
-    rangeData.reserve(numUniqueYawSamples * numPitchSamples);
+    const int numSamples = numUniqueYawSamples * numPitchSamples;
+    rangeSamplePixelIndices.resize(numSamples);
+    rangeSampleDistanceRatios.resize(numSamples);
+    int index = 0;
 
     for(int pitch=0; pitch < numPitchSamples; ++pitch){
         const double pitchAngle = pitch * pitchStep - pitchRange / 2.0;
@@ -1631,8 +1745,6 @@ bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
                 const double r = (tan(pitchAngle)/cos(yawAngle) + maxTanPitchAngle) / (maxTanPitchAngle * 2.0);
                 py = nearbyint(r * (fh - 1.0));
             }
-            const int srcpos = py * pixelWidth;
-
             int px;
             if(yawRange == 0.0){
                 px = 0;
@@ -1641,50 +1753,65 @@ bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
                 px = nearbyint(r * (fw - 1.0));
             }
             //! \todo add the option to do the interpolation between the adjacent two pixel depths
-            const float depth = depthBuf[srcpos + px];
-            if(depth > 0.0f && depth < 1.0f){
-                const double z0 = 2.0 * depth - 1.0;
-                const double w = Pinv_32 * z0 + Pinv_33;
-                const double z = -1.0 / w + depthError;
-                rangeData.push_back(fabs((z / cosPitchAngle) / cos(yawAngle)));
-
-                if(DEBUG_MESSAGE){
-                    const Matrix4 Pinv = renderer->projectionMatrix().inverse();
-                    const float fw = pixelWidth;
-                    const float fh = pixelHeight;
-                    const int cx = pixelWidth / 2;
-                    const int cy = pixelHeight / 2;
-                    Vector4 n;
-                    n[3] = 1.0f;
-                    n.x() = 2.0 * px / fw - 1.0;
-                    n.y() = 2.0 * py / fh - 1.0;
-                    n.z() = 2.0 * depth - 1.0f;
-                    const Vector4 o = Pinv * n;
-                    const double& ww = o[3];
-                    double x_ = o[0] / ww;
-                    double y_ = o[1] / ww;
-                    double z_ = o[2] / ww;
-                    double distance_ = sqrt(x_*x_ + y_*y_ + z_*z_);
-                    double pitchAngle_ = asin( y_ / distance_);
-                    double yawAngle_ = -asin( x_ / sqrt(x_*x_ + z_*z_) );
-
-                    cout << "pixelX= " << px << "  pixelY= " << py << endl;
-                    cout << "pitch= " << degree(pitchAngle_)  << " yaw= " << degree(yawAngle_) << endl;
-                    cout << "pitch= " << degree(pitchAngle)  << " yaw= " << degree(yawAngle) << endl;
-                    cout << "x= " << x_ << " "
-                         << "y= " << y_ << " "
-                         << "z= " << z_ << endl;
-                    double distance = fabs((z / cosPitchAngle) / cos(yawAngle));
-                    double x = distance *  cosPitchAngle * sin(-yawAngle);
-                    double y  = distance * sin(pitchAngle);
-                    cout << "x= " << x << " "
-                         << "y= " << y << " "
-                         << "z= " << z  << endl;
-                    cout << endl;
+            rangeSamplePixelIndices[index] = py * pixelWidth + px;
+            rangeSampleDistanceRatios[index] = 1.0 / (cosPitchAngle * cos(yawAngle));
+            ++index;
+        }
+    }
+}
+
+
+bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
+{
+    depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
+    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
+
+    updateRangeSamplingTable();
+
+    const Matrix4 Pinv = renderer->projectionMatrix().inverse();
+    const double Pinv_32 = Pinv(3, 2);
+    const double Pinv_33 = Pinv(3, 3);
+
+    const int numSamples = rangeSamplePixelIndices.size();
+    rangeData.resize(numSamples);
+
+    parallelFor(
+        0, numSamples, 4096,
+        [&](int begin, int end){
+            for(int i = begin; i < end; ++i){
+                const float depth = depthBuf[rangeSamplePixelIndices[i]];
+                if(depth > 0.0f && depth < 1.0f){
+                    const double z0 = 2.0 * depth - 1.0;
+                    const double w = Pinv_32 * z0 + Pinv_33;
+                    const double z = -1.0 / w + depthError;
+                    rangeData[i] = fabs(z * rangeSampleDistanceRatios[i]);
+                } else {
+                    rangeData[i] = std::numeric_limits<double>::infinity();
                 }
-            } else {
-                rangeData.push_back(std::numeric_limits<double>::infinity());
             }
+        });
+
+    if(DEBUG_MESSAGE){
+        const float fw = pixelWidth;
+        const float fh = pixelHeight;
+        for(int i=0; i < numSamples; ++i){
+            const int px = rangeSamplePixelIndices[i] % pixelWidth;
+            const int py = rangeSamplePixelIndices[i] / pixelWidth;
+            const float depth = depthBuf[rangeSamplePixelIndices[i]];
+            Vector4 n(2.0 * px / fw - 1.0, 2.0 * py / fh - 1.0, 2.0 * depth - 1.0f, 1.0);
+            const Vector4 o = Pinv * n;
+            const double& ww = o[3];
+            double x_ = o[0] / ww;
+            double y_ = o[1] / ww;
+            double z_ = o[2] / ww;
+            double distance_ = sqrt(x_*x_ + y_*y_ + z_*z_);
+            double pitchAngle_ = asin( y_ / distance_);
+            double yawAngle_ = -asin( x_ / sqrt(x_*x_ + z_*z_) );
+            cout << "pixelX= " << px << "  pixelY= " << py << endl;
+            cout << "pitch= " << degree(pitchAngle_)  << " yaw= " << degree(yawAngle_) << endl;
+            cout << "x= " << x_ << " " << "y= " << y_ << " " << "z= " << z_ << endl;
+            cout << "distance= " << rangeData[i] << endl;
+            cout << endl;
         }
     }
 
@@ -1713,6 +1840,11 @@ void GLVisionSimulatorItemImpl::finalizeSimulation()
     }
         
     sensorRenderers.clear();
+
+    if(sensorDataEncoder){
+        sensorDataEncoder->waitForEncoding();
+        sensorDataEncoder.reset();
+    }
 }
 
 
@@ -1769,6 +1901,8 @@ void GLVisionSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty
     putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
     putProperty(_("Max latency [s]"), maxLatency, changeProperty(maxLatency));
     putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty(_("Vision data compression"), visionDataCompression,
+                [&](int index){ return visionDataCompression.select(index); });
     putProperty(_("Thread mode"), threadMode, [&](int index){ return threadMode.select(index); });
     putProperty(_("Best effort"), isBestEffortModeProperty, changeProperty(isBestEffortModeProperty));
     putProperty(_("All scene objects"), shootAllSceneObjects, changeProperty(shootAllSceneObjects));
@@ -1795,6 +1929,7 @@ bool GLVisionSimulatorItemImpl::store(Archive& archive)
     archive.write("maxFrameRate", maxFrameRate);
     archive.write("maxLatency", maxLatency);
     archive.write("recordVisionData", isVisionDataRecordingEnabled);
+    archive.write("visionDataCompression", visionDataCompression.selectedSymbol());
     archive.write("threadMode", threadMode.selectedSymbol());
     archive.write("bestEffort", isBestEffortModeProperty);
     archive.write("allSceneObjects", shootAllSceneObjects);
@@ -1833,6 +1968,9 @@ bool GLVisionSimulatorItemImpl::restore(const Archive& archive)
     archive.read("antiAliasing", isAntiAliasingEnabled);
 
     string symbol;
+    if(archive.read("visionDataCompression", symbol)){
+        visionDataCompression.select(symbol);
+    }
     if(archive.read("threadMode", symbol)){
         threadMode.select(symbol);
     } else {
@@ -24,11 +24,17 @@ public:
 
     enum ThreadMode { SINGLE_THREAD_MODE, SENSOR_THREAD_MODE, SCREEN_THREAD_MODE, N_THREAD_MODES };
 
+    enum VisionDataCompression {
+        NO_COMPRESSION, LOSSLESS_COMPRESSION, JPEG_COMPRESSION, N_VISION_DATA_COMPRESSION_TYPES
+    };
+
     void setTargetBodies(const std::string& bodyNames);
     void setTargetSensors(const std::string& sensorNames);
     void setMaxFrameRate(double rate);
     void setMaxLatency(double latency);
     void setVisionDataRecordingEnabled(bool on);
+    //! The compression of the recorded vision data. The depth data is always compressed losslessly.
+    void setVisionDataCompression(int type);
     void setThreadMode(int mode);
     void setBestEffortMode(bool on);
     void setRangeSensorPrecisionRatio(double r);
@@ -0,0 +1,415 @@
+/*!
+  @file
+  @author Shin'ichiro Nakaoka
+*/
+
+#include "RaycastVisionSimulatorItem.h"
+#include "GLVisionSimulatorItem.h"
+#include "SimulatorItem.h"
+#include "WorldItem.h"
+#include "BodyItem.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <cnoid/ValueTreeUtil>
+#include <cnoid/RenderableItem>
+#include <cnoid/RaycastVisionSimulator>
+#include <cnoid/SensorDataEncoder>
+#include <cnoid/Body>
+#include <cnoid/Camera>
+#include <cnoid/RangeSensor>
+#include <cnoid/StringUtil>
+#include <cnoid/Tokenizer>
+#include <fmt/format.h>
+#include <set>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+string getNameListString(const vector<string>& names)
+{
+    string nameList;
+    if(!names.empty()){
+        size_t n = names.size() - 1;
+        for(size_t i=0; i < n; ++i){
+            nameList += names[i];
+            nameList += ", ";
+        }
+        nameList += names.back();
+    }
+    return nameList;
+}
+
+bool updateNames(const string& nameListString, string& out_newNameListString, vector<string>& out_names)
+{
+    out_names.clear();
+    for(auto& token : Tokenizer<CharSeparator<char>>(nameListString, CharSeparator<char>(","))){
+        auto name = trimmed(token);
+        if(!name.empty()){
+            out_names.push_back(name);
+        }
+    }
+    out_newNameListString = nameListString;
+    return true;
+}
+
+}
+
+namespace cnoid {
+
+class RaycastVisionSimulatorItem::Impl
+{
+public:
+    RaycastVisionSimulatorItem* self;
+    ostream& os;
+    RaycastVisionSimulator simulator;
+    SimulatorItem* simulatorItem;
+    vector<string> bodyNames;
+    string bodyNameListString;
+    vector<string> sensorNames;
+    string sensorNameListString;
+    double maxFrameRate;
+    double maxLatency;
+    double depthError;
+    bool isVisionDataRecordingEnabled;
+    Selection visionDataCompression;
+    SensorDataEncoderPtr sensorDataEncoder;
+    bool isBestEffortMode;
+    bool shootAllSceneObjects;
+
+    Impl(RaycastVisionSimulatorItem* self);
+    Impl(RaycastVisionSimulatorItem* self, const Impl& org);
+    bool initializeSimulation(SimulatorItem* simulatorItem);
+    void finalizeSimulation();
+    void doPutProperties(PutPropertyFunction& putProperty);
+    bool store(Archive& archive);
+    bool restore(const Archive& archive);
+
+    template<typename Type> void setProperty(Type& variable, const Type& value){
+        if(value != variable){
+            variable = value;
+            self->notifyUpdate();
+        }
+    }
+};
+
+}
+
+
+void RaycastVisionSimulatorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager().registerClass<RaycastVisionSimulatorItem, SubSimulatorItem>(N_("RaycastVisionSimulatorItem"));
+    ext->itemManager().addCreationPanel<RaycastVisionSimulatorItem>();
+}
+
+
+RaycastVisionSimulatorItem::RaycastVisionSimulatorItem()
+{
+    impl = new Impl(this);
+    setName("RaycastVisionSimulator");
+}
+
+
+RaycastVisionSimulatorItem::Impl::Impl(RaycastVisionSimulatorItem* self)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      visionDataCompression(GLVisionSimulatorItem::N_VISION_DATA_COMPRESSION_TYPES, CNOID_GETTEXT_DOMAIN_NAME)
+{
+    simulatorItem = nullptr;
+    maxFrameRate = 1000.0;
+    maxLatency = 1.0;
+    depthError = 0.0;
+    isVisionDataRecordingEnabled = false;
+    visionDataCompression.setSymbol(GLVisionSimulatorItem::NO_COMPRESSION, N_("None"));
+    visionDataCompression.setSymbol(GLVisionSimulatorItem::LOSSLESS_COMPRESSION, N_("Lossless"));
+    visionDataCompression.setSymbol(GLVisionSimulatorItem::JPEG_COMPRESSION, N_("JPEG"));
+    visionDataCompression.select(GLVisionSimulatorItem::NO_COMPRESSION);
+    isBestEffortMode = false;
+    shootAllSceneObjects = false;
+}
+
+
+RaycastVisionSimulatorItem::RaycastVisionSimulatorItem(const RaycastVisionSimulatorItem& org)
+    : SubSimulatorItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+RaycastVisionSimulatorItem::Impl::Impl(RaycastVisionSimulatorItem* self, const Impl& org)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      bodyNames(org.bodyNames),
+      bodyNameListString(org.bodyNameListString),
+      sensorNames(org.sensorNames),
+      sensorNameListString(org.sensorNameListString),
+      visionDataCompression(org.visionDataCompression)
+{
+    simulatorItem = nullptr;
+    maxFrameRate = org.maxFrameRate;
+    maxLatency = org.maxLatency;
+    depthError = org.depthError;
+    isVisionDataRecordingEnabled = org.isVisionDataRecordingEnabled;
+    isBestEffortMode = org.isBestEffortMode;
+    shootAllSceneObjects = org.shootAllSceneObjects;
+}
+
+
+Item* RaycastVisionSimulatorItem::doDuplicate() const
+{
+    return new RaycastVisionSimulatorItem(*this);
+}
+
+
+RaycastVisionSimulatorItem::~RaycastVisionSimulatorItem()
+{
+    delete impl;
+}
+
+
+void RaycastVisionSimulatorItem::setTargetBodies(const std::string& names)
+{
+    updateNames(names, impl->bodyNameListString, impl->bodyNames);
+    notifyUpdate();
+}
+
+
+void RaycastVisionSimulatorItem::setTargetSensors(const std::string& names)
+{
+    updateNames(names, impl->sensorNameListString, impl->sensorNames);
+    notifyUpdate();
+}
+
+
+void RaycastVisionSimulatorItem::setMaxFrameRate(double rate)
+{
+    impl->setProperty(impl->maxFrameRate, rate);
+}
+
+
+void RaycastVisionSimulatorItem::setMaxLatency(double latency)
+{
+    impl->setProperty(impl->maxLatency, latency);
+}
+
+
+void RaycastVisionSimulatorItem::setVisionDataRecordingEnabled(bool on)
+{
+    impl->setProperty(impl->isVisionDataRecordingEnabled, on);
+}
+
+
+void RaycastVisionSimulatorItem::setVisionDataCompression(int type)
+{
+    if(type != impl->visionDataCompression.which()){
+        impl->visionDataCompression.select(type);
+        notifyUpdate();
+    }
+}
+
+
+void RaycastVisionSimulatorItem::setBestEffortMode(bool on)
+{
+    impl->setProperty(impl->isBestEffortMode, on);
+}
+
+
+void RaycastVisionSimulatorItem::setAllSceneObjectsEnabled(bool on)
+{
+    impl->setProperty(impl->shootAllSceneObjects, on);
+}
+
+
+void RaycastVisionSimulatorItem::setDepthError(double error)
+{
+    impl->setProperty(impl->depthError, error);
+}
+
+
+bool RaycastVisionSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    return impl->initializeSimulation(simulatorItem);
+}
+
+
+bool RaycastVisionSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    this->simulatorItem = simulatorItem;
+
+    simulator.clear();
+    simulator.setMaxFrameRate(maxFrameRate);
+    simulator.setMaxLatency(maxLatency);
+    simulator.setBestEffortMode(isBestEffortMode);
+    simulator.setDepthError(depthError);
+
+    sensorDataEncoder.reset();
+    if(isVisionDataRecordingEnabled && !visionDataCompression.is(GLVisionSimulatorItem::NO_COMPRESSION)){
+        sensorDataEncoder = new SensorDataEncoder;
+        if(visionDataCompression.is(GLVisionSimulatorItem::JPEG_COMPRESSION)){
+            sensorDataEncoder->setImageFormat(SensorDataEncoder::JPEG_FORMAT);
+        }
+    }
+
+    std::set<string> bodyNameSet(bodyNames.begin(), bodyNames.end());
+    std::set<string> sensorNameSet(sensorNames.begin(), sensorNames.end());
+
+    for(auto& simBody : simulatorItem->simulationBodies()){
+        Body* body = simBody->body();
+        simulator.addBody(body);
+        if(!bodyNameSet.empty() && bodyNameSet.find(body->name()) == bodyNameSet.end()){
+            continue;
+        }
+        for(auto& device : body->devices()){
+            if(!sensorNameSet.empty() && sensorNameSet.find(device->name()) == sensorNameSet.end()){
+                continue;
+            }
+            if(!RaycastVisionSimulator::isSupportedDevice(device)){
+                if(dynamic_cast<Camera*>(device.get())){
+                    os << format(_("{0}: Camera \"{1}\" of {2} is not supported and skipped."),
+                                 self->displayName(), device->name(), body->name()) << endl;
+                }
+                continue;
+            }
+            std::function<void()> notifyDataUpdate;
+            if(isVisionDataRecordingEnabled){
+                if(auto rangeSensor = dynamic_cast<RangeSensor*>(device.get())){
+                    rangeSensor->setRangeDataStateClonable(true);
+                    rangeSensor->setRangeDataStateEncoder(sensorDataEncoder);
+                } else if(auto camera = dynamic_cast<Camera*>(device.get())){
+                    camera->setImageStateClonable(true);
+                    camera->setImageStateEncoder(sensorDataEncoder);
+                }
+            } else {
+                Device* pDevice = device;
+                notifyDataUpdate = [simBody, pDevice](){ simBody->notifyUnrecordedDeviceStateChange(pDevice); };
+            }
+            simulator.addSensor(device, notifyDataUpdate);
+            os << format(_("{0} detected vision sensor \"{1}\" of {2} as a target."),
+                         self->displayName(), device->name(), body->name()) << endl;
+        }
+    }
+
+    if(simulator.numSensors() == 0){
+        os << format(_("{} has no target sensors"), self->displayName()) << endl;
+        return false;
+    }
+
+    if(shootAllSceneObjects){
+        if(auto worldItem = self->findOwnerItem<WorldItem>()){
+            for(auto& item : worldItem->descendantItems()){
+                auto renderable = dynamic_cast<RenderableItem*>(item.get());
+                if(renderable && !dynamic_cast<BodyItem*>(item.get())){
+                    if(auto scene = renderable->getScene()){
+                        simulator.addScene(scene);
+                    }
+                }
+            }
+        }
+    }
+
+    simulator.initialize(simulatorItem->worldTimeStep());
+
+    simulatorItem->addPreDynamicsFunction(
+        [this](){ simulator.onPreDynamics(this->simulatorItem->currentTime()); });
+    simulatorItem->addPostDynamicsFunction(
+        [this](){ simulator.onPostDynamics(); });
+
+    return true;
+}
+
+
+void RaycastVisionSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void RaycastVisionSimulatorItem::Impl::finalizeSimulation()
+{
+    simulator.finalize();
+    simulator.clear();
+
+    if(sensorDataEncoder){
+        sensorDataEncoder->waitForEncoding();
+        sensorDataEncoder.reset();
+    }
+}
+
+
+void RaycastVisionSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    SubSimulatorItem::doPutProperties(putProperty);
+    impl->doPutProperties(putProperty);
+}
+
+
+void RaycastVisionSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty(_("Target bodies"), bodyNameListString,
+                [&](const string& names){ return updateNames(names, bodyNameListString, bodyNames); });
+    putProperty(_("Target sensors"), sensorNameListString,
+                [&](const string& names){ return updateNames(names, sensorNameListString, sensorNames); });
+    putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
+    putProperty(_("Max latency [s]"), maxLatency, changeProperty(maxLatency));
+    putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty(_("Vision data compression"), visionDataCompression,
+                [&](int index){ return visionDataCompression.select(index); });
+    putProperty(_("Best effort"), isBestEffortMode, changeProperty(isBestEffortMode));
+    putProperty(_("All scene objects"), shootAllSceneObjects, changeProperty(shootAllSceneObjects));
+    putProperty(_("Depth error"), depthError, changeProperty(depthError));
+}
+
+
+bool RaycastVisionSimulatorItem::store(Archive& archive)
+{
+    SubSimulatorItem::store(archive);
+    return impl->store(archive);
+}
+
+
+bool RaycastVisionSimulatorItem::Impl::store(Archive& archive)
+{
+    writeElements(archive, "targetBodies", bodyNames, true);
+    writeElements(archive, "targetSensors", sensorNames, true);
+    archive.write("maxFrameRate", maxFrameRate);
+    archive.write("maxLatency", maxLatency);
+    archive.write("recordVisionData", isVisionDataRecordingEnabled);
+    archive.write("visionDataCompression", visionDataCompression.selectedSymbol());
+    archive.write("bestEffort", isBestEffortMode);
+    archive.write("allSceneObjects", shootAllSceneObjects);
+    archive.write("depthError", depthError);
+    return true;
+}
+
+
+bool RaycastVisionSimulatorItem::restore(const Archive& archive)
+{
+    SubSimulatorItem::restore(archive);
+    return impl->restore(archive);
+}
+
+
+bool RaycastVisionSimulatorItem::Impl::restore(const Archive& archive)
+{
+    readElements(archive, "targetBodies", bodyNames);
+    bodyNameListString = getNameListString(bodyNames);
+    readElements(archive, "targetSensors", sensorNames);
+    sensorNameListString = getNameListString(sensorNames);
+    archive.read("maxFrameRate", maxFrameRate);
+    archive.read("maxLatency", maxLatency);
+    archive.read("recordVisionData", isVisionDataRecordingEnabled);
+    archive.read("bestEffort", isBestEffortMode);
+    archive.read("allSceneObjects", shootAllSceneObjects);
+    archive.read("depthError", depthError);
+
+    string symbol;
+    if(archive.read("visionDataCompression", symbol)){
+        visionDataCompression.select(symbol);
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+/*!
+  @file
+  @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_PLUGIN_RAYCAST_VISION_SIMULATOR_ITEM_H
+#define CNOID_BODY_PLUGIN_RAYCAST_VISION_SIMULATOR_ITEM_H
+
+#include "SubSimulatorItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This item simulates range sensors and range cameras by the ray casting on the CPU.
+   It can be used instead of GLVisionSimulatorItem when the GPU is not available.
+*/
+class CNOID_EXPORT RaycastVisionSimulatorItem : public SubSimulatorItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+        
+    RaycastVisionSimulatorItem();
+    RaycastVisionSimulatorItem(const RaycastVisionSimulatorItem& org);
+    ~RaycastVisionSimulatorItem();
+
+    void setTargetBodies(const std::string& bodyNames);
+    void setTargetSensors(const std::string& sensorNames);
+    void setMaxFrameRate(double rate);
+    void setMaxLatency(double latency);
+    void setVisionDataRecordingEnabled(bool on);
+    //! GLVisionSimulatorItem::VisionDataCompression
+    void setVisionDataCompression(int type);
+    void setBestEffortMode(bool on);
+    void setAllSceneObjectsEnabled(bool on);
+    void setDepthError(double error);
+
+    virtual bool initializeSimulation(SimulatorItem* simulatorItem) override;
+    virtual void finalizeSimulation() override;
+
+protected:
+    virtual Item* doDuplicate() const override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<RaycastVisionSimulatorItem> RaycastVisionSimulatorItemPtr;
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "SimpleControllerItem.h"
 #include <cnoid/SimpleController>
+#include <cnoid/SimpleControllerIOTransfer>
 #include <cnoid/BodyItem>
 #include <cnoid/Body>
 #include <cnoid/Link>
@@ -20,7 +21,6 @@
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <set>
-#include <bitset>
 #include "gettext.h"
 
 using namespace std;
@@ -54,22 +54,7 @@ public:
     ControllerIO* io;
     SharedInfoPtr sharedInfo;
 
-    vector<unsigned short> inputLinkIndices;
-    
-    vector<short> linkIndexToInputStateTypeMap;
-
-    // This vector contains input state types of all the links.
-    // The elements are the sequence of [number of input state types of the i-th link] [state type 1] [state type 2] ...
-    vector<short> inputStateTypes;
-
-    vector<bool> outputLinkFlags;
-
-    struct LinkOutputStateInfo
-    {
-        int linkIndex;
-        vector<short> stateTypes;
-    };
-    vector<LinkOutputStateInfo> linkOutputStateInfos;
+    SimpleControllerIOTransfer ioTransfer;
     
     bool isOldTargetVariableMode;
 
@@ -480,10 +465,7 @@ void SimpleControllerItem::Impl::initializeIoBody()
 
 void SimpleControllerItem::Impl::clearIoTargets()
 {
-    inputLinkIndices.clear();
-    inputStateTypes.clear();
-    outputLinkFlags.clear();
-    linkOutputStateInfos.clear();
+    ioTransfer.clearIoTargets();
     childControllerItems.clear();
 }
 
@@ -555,41 +537,7 @@ SimpleController* SimpleControllerItem::Impl::initialize(ControllerIO* io, Share
 
 void SimpleControllerItem::Impl::updateIOStateTypes()
 {
-    // Input
-    inputLinkIndices.clear();
-    inputStateTypes.clear();
-    for(size_t i=0; i < linkIndexToInputStateTypeMap.size(); ++i){
-        bitset<Link::NumStateTypes> types(linkIndexToInputStateTypeMap[i]);
-        if(types.any()){
-            simulationBody->link(i)->mergeSensingMode(ioBody->link(i)->sensingMode());
-            const int n = types.count();
-            inputLinkIndices.push_back(i);
-            inputStateTypes.push_back(n);
-            for(int j=0; j < Link::NumStateTypes; ++j){
-                if(types.test(j)){
-                    inputStateTypes.push_back(1 << j);
-                }
-            }
-        }
-    }
-
-    // Output
-    linkOutputStateInfos.clear();
-    for(size_t i=0; i < outputLinkFlags.size(); ++i){
-        if(outputLinkFlags[i]){
-            LinkOutputStateInfo info;
-            info.linkIndex = i;
-            int actuationMode = ioBody->link(i)->actuationMode();
-            simulationBody->link(i)->setActuationMode(actuationMode);
-            for(int j=0; j < Link::NumStateTypes; ++j){
-                int stateBit = 1 << j;
-                if(actuationMode & stateBit){
-                    info.stateTypes.push_back(stateBit);
-                }
-            }
-            linkOutputStateInfos.push_back(info);
-        }
-    }
+    ioTransfer.updateIOStateTypes(simulationBody, ioBody);
 }
 
 
@@ -666,28 +614,13 @@ void SimpleControllerItem::Impl::enableIO(Link* link)
 
 void SimpleControllerItem::Impl::enableInput(Link* link)
 {
-    int defaultInputStateTypes = Link::StateNone;
-    int actuationMode = link->actuationMode();
-    if(actuationMode & (Link::JointEffort | Link::JointDisplacement | Link::JointVelocity)){
-        if(link->jointType() != Link::PseudoContinuousTrackJoint){
-            defaultInputStateTypes = Link::JointDisplacement;
-        }
-    }
-    if(actuationMode & Link::LinkExtWrench){
-        // Global link position is needed to calculate the correct external force value
-        defaultInputStateTypes |= Link::LinkPosition;
-    }
-    enableInput(link, defaultInputStateTypes);
+    ioTransfer.enableInput(link);
 }        
 
 
 void SimpleControllerItem::Impl::enableInput(Link* link, int stateFlags)
 {
-    if(link->index() >= static_cast<int>(linkIndexToInputStateTypeMap.size())){
-        linkIndexToInputStateTypeMap.resize(link->index() + 1, 0);
-    }
-    linkIndexToInputStateTypeMap[link->index()] |= stateFlags;
-    link->mergeSensingMode(stateFlags);
+    ioTransfer.enableInput(link, stateFlags);
 }        
 
 
@@ -707,20 +640,13 @@ void SimpleControllerItem::Impl::setJointInput(int stateFlags)
 
 void SimpleControllerItem::Impl::enableOutput(Link* link)
 {
-    int index = link->index();
-    if(static_cast<int>(outputLinkFlags.size()) <= index){
-        outputLinkFlags.resize(index + 1, false);
-    }
-    outputLinkFlags[index] = true;
+    ioTransfer.enableOutput(link);
 }
 
 
 void SimpleControllerItem::Impl::enableOutput(Link* link, int stateFlags)
 {
-    link->setActuationMode(stateFlags);
-    if(stateFlags){
-        enableOutput(link);
-    }
+    ioTransfer.enableOutput(link, stateFlags);
 }
 
 
@@ -809,58 +735,11 @@ void SimpleControllerItem::input()
 
 void SimpleControllerItem::Impl::input()
 {
-    int typeArrayIndex = 0;
-    for(size_t i=0; i < inputLinkIndices.size(); ++i){
-        const int linkIndex = inputLinkIndices[i];
-        const Link* simLink = simulationBody->link(linkIndex);
-        Link* ioLink = ioBody->link(linkIndex);
-        const int n = inputStateTypes[typeArrayIndex++];
-        for(int j=0; j < n; ++j){
-            switch(inputStateTypes[typeArrayIndex++]){
-            case Link::JointDisplacement:
-                ioLink->q() = simLink->q();
-                break;
-            case Link::JointVelocity:
-                ioLink->dq() = simLink->dq();
-                break;
-            case Link::JointAcceleration:
-                ioLink->ddq() = simLink->ddq();
-                break;
-            case Link::JointEffort:
-                ioLink->u() = simLink->u();
-                break;
-            case Link::LinkPosition:
-                ioLink->T() = simLink->T();
-                break;
-            case Link::LinkTwist:
-                ioLink->v() = simLink->v();
-                ioLink->w() = simLink->w();
-                break;
-            case Link::LinkExtWrench:
-                ioLink->F_ext() = simLink->F_ext();
-                break;
-            case Link::LinkContactState:
-                ioLink->contactPoints() = simLink->contactPoints();
-                break;
-            default:
-                break;
-            }
-        }
-    }
+    ioTransfer.inputLinkStates();
 
-    auto& flag = sharedInfo->inputDeviceStateChangeFlag;
-    const auto& devices = simulationBody->devices();
-    const auto& ioDevices = ioBody->devices();
-    for(size_t i=0; i < flag.size(); ++i){
-        if(flag[i]){
-            Device* ioDevice = ioDevices[i];
-            ioDevice->copyStateFrom(*devices[i]);
-            outputDeviceStateConnections.block(i);
-            ioDevice->notifyStateChange();
-            outputDeviceStateConnections.unblock(i);
-            flag[i] = false;
-        }
-    }
+    SimpleControllerIOTransfer::transferDeviceStates(
+        simulationBody->devices(), ioBody->devices(),
+        sharedInfo->inputDeviceStateChangeFlag, outputDeviceStateConnections);
 }
 
 
@@ -902,73 +781,11 @@ void SimpleControllerItem::output()
 
 void SimpleControllerItem::Impl::output()
 {
-    for(size_t i=0; i < linkOutputStateInfos.size(); ++i){
-
-        const auto& info = linkOutputStateInfos[i];
-        const int index = info.linkIndex;
-        const Link* ioLink = ioBody->link(index);
-        Link* simLink = simulationBody->link(index);
-
-        const auto& stateTypes = info.stateTypes;
-        for(size_t j=0; j < stateTypes.size(); ++j){
-            switch(stateTypes[j]){
-
-            case Link::JointDisplacement:
-                if(isOldTargetVariableMode){
-                    simLink->q_target() = ioLink->q();
-                } else {
-                    simLink->q_target() = ioLink->q_target();
-                }
-                break;
-
-            case Link::JointVelocity:
-            case Link::DeprecatedJointSurfaceVelocity:
-                if(isOldTargetVariableMode){
-                    simLink->dq_target() = ioLink->dq();
-                } else {
-                    simLink->dq_target() = ioLink->dq_target();
-                }
-                break;
-
-            case Link::JointAcceleration:
-                simLink->ddq() = ioLink->ddq();
-                break;
-
-            case Link::JointEffort:
-                simLink->u() = ioLink->u();
-                break;
+    ioTransfer.outputLinkStates(isOldTargetVariableMode);
 
-            case Link::LinkPosition:
-                simLink->T() = ioLink->T();
-                break;
-
-            case Link::LinkTwist:
-                simLink->v() = ioLink->v();
-                simLink->w() = ioLink->w();
-                break;
-
-            case Link::LinkExtWrench:
-                simLink->F_ext() += ioLink->F_ext();
-                break;
-
-            default:
-                break;
-            }
-        }
-    }
-
-    const DeviceList<>& devices = simulationBody->devices();
-    const DeviceList<>& ioDevices = ioBody->devices();
-    for(size_t i=0; i < outputDeviceStateChangeFlag.size(); ++i){
-        if(outputDeviceStateChangeFlag[i]){
-            Device* device = devices[i];
-            device->copyStateFrom(*ioDevices[i]);
-            sharedInfo->inputDeviceStateConnections.block(i);
-            device->notifyStateChange();
-            sharedInfo->inputDeviceStateConnections.unblock(i);
-            outputDeviceStateChangeFlag[i] = false;
-        }
-    }
+    SimpleControllerIOTransfer::transferDeviceStates(
+        ioBody->devices(), simulationBody->devices(),
+        outputDeviceStateChangeFlag, sharedInfo->inputDeviceStateConnections);
 }
 
 
@@ -19,6 +19,7 @@
 #include <cnoid/ItemTreeView>
 #include <cnoid/MenuManager>
 #include <cnoid/ControllerIO>
+#include <cnoid/SimulationStepSequence>
 #include <cnoid/BodyState>
 #include <cnoid/AppUtil>
 #include <cnoid/TimeBar>
@@ -33,7 +34,11 @@
 #include <cnoid/ConnectionSet>
 #include <cnoid/FloatingNumberString>
 #include <cnoid/SceneGraph>
+#include <cnoid/SceneDrawables>
 #include <cnoid/CloneMap>
+#include <cnoid/MeshPool>
+#include <cnoid/PhaseProfiler>
+#include <cnoid/RealtimePacer>
 #include <QThread>
 #include <QMutex>
 #include <QElapsedTimer>
@@ -42,6 +47,7 @@
 #include <condition_variable>
 #include <set>
 #include <deque>
+#include <sstream>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -99,7 +105,7 @@ struct FunctionSet
     void updateFunctions();
 };
 
-class ControllerInfo : public Referenced, public ControllerIO
+class ControllerInfo : public Referenced, public ControllerIO, public SimulationStepSequence::Controller
 {
 public:
     ControllerItemPtr controller;
@@ -121,6 +127,10 @@ public:
     ControllerLogItemPtr logItem;
     shared_ptr<ReferencedObjectSeq> log;
 
+    int profilerThreadId;
+    PhaseProfiler::Time controlBeginTime;
+    PhaseProfiler::Time controlEndTime;
+
     ControllerInfo(ControllerItem* controller, SimulationBody::Impl* simBodyImpl);
 
     virtual std::string controllerName() const override;
@@ -137,12 +147,54 @@ public:
     virtual bool isNoDelayMode() const override;
     virtual bool setNoDelayMode(bool on) override;
 
-    bool waitForControlInThreadToFinish();
+    // virtual functions of SimulationStepSequence::Controller
+    virtual void input() override;
+    virtual bool control() override;
+    virtual void output() override;
+    virtual void requestControl() override;
+    virtual bool waitForControl() override;
+
     void concurrentControlLoop();    
 };
 
 typedef ref_ptr<ControllerInfo> ControllerInfoPtr;
 
+/**
+   This class writes the frames of the world log file in a dedicated thread so that the encoding
+   and the file output of a long log do not stall the flush of the records.
+*/
+class WorldLogWriter
+{
+public:
+    struct BodyState {
+        vector<SE3, Eigen::aligned_allocator<SE3>> linkPositions;
+        vector<double> jointPositions;
+        vector<DeviceStatePtr> deviceStates;
+    };
+    struct Frame {
+        double time;
+        vector<BodyState> bodyStates;
+    };
+    typedef unique_ptr<Frame> FramePtr;
+
+    WorldLogFileItemPtr logItem;
+    std::thread writerThread;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    deque<FramePtr> frameQueue;
+    vector<FramePtr> freeFrames;
+    bool isFinishing;
+
+    WorldLogWriter() : isFinishing(false) { }
+    ~WorldLogWriter() { finish(); }
+    void start(WorldLogFileItem* item);
+    FramePtr newFrame(int numBodies);
+    void push(FramePtr frame);
+    void finish();
+    void writerLoop();
+    void writeFrame(Frame& frame);
+};
+
 }
 
 namespace cnoid {
@@ -165,9 +217,15 @@ public:
     MultiSE3Deque linkPosBuf;
     vector<Device*> devicesToNotifyRecords;
     ScopedConnectionSet deviceStateConnections;
+    // The flags are stored per simulation body so that the bodies can be computed in parallel
     vector<bool> deviceStateChangeFlag;
     Deque2D<DeviceStatePtr> deviceStateBuf;
 
+    // The buffers exchanged with the above ones to flush the records without blocking the simulation thread
+    Deque2D<double> flushingJointPosBuf;
+    MultiSE3Deque flushingLinkPosBuf;
+    Deque2D<DeviceStatePtr> flushingDeviceStateBuf;
+
     ItemPtr parentOfRecordItems;
     string recordItemPrefix;
     shared_ptr<BodyMotion> motion;
@@ -190,10 +248,11 @@ public:
     void setInitialStateOfBodyMotion(shared_ptr<BodyMotion> bodyMotion);
     void setActive(bool on);
     void bufferRecords();
+    void swapRecordBuffers();
     void flushRecords();
     void flushRecordsToBodyMotionItems();
     void flushRecordsToBody();
-    void flushRecordsToWorldLogFile(int bufferFrame);
+    void storeWorldLogRecords(int bufferFrame, WorldLogWriter::BodyState& state);
     void notifyRecords(double time);
 };
 
@@ -234,6 +293,8 @@ public:
     ItemList<SubSimulatorItem> subSimulatorItems;
 
     vector<ControllerInfoPtr> activeControllerInfos;
+    SimulationStepSequence stepSequence;
+    shared_ptr<CollisionLinkPairList> currentCollisionPairs;
     bool doStopSimulationWhenNoActiveControllers;
     bool hasControllers; // Includes non-active controllers
 
@@ -241,6 +302,9 @@ public:
 
     shared_ptr<CollisionSeq> collisionSeq;
     deque<shared_ptr<CollisionLinkPairList>> collisionPairsBuf;
+    deque<shared_ptr<CollisionLinkPairList>> flushingCollisionPairsBuf;
+    vector<SimulationBody*> flushingSimBodies;
+    int flushingFrame;
 
     Selection recordingMode;
     Selection timeRangeMode;
@@ -257,11 +321,28 @@ public:
     volatile bool stopRequested;
     volatile bool pauseRequested;
     bool isRealtimeSyncMode;
+    bool isHighResolutionRealtimeSyncEnabled;
     bool needToUpdateSimBodyLists;
     bool hasActiveFreeBodies;
     bool recordCollisionData;
+    bool isStepProfilingEnabled;
 
     string controllerOptionString_;
+    string stepProfileTraceFile;
+
+    RealtimePacer realtimePacer;
+    double realtimeSyncSpinTime; // in microseconds
+    bool isRealtimePacerUsed;
+
+    PhaseProfiler stepProfilerInstance;
+    PhaseProfiler* stepProfiler; // nullptr when the profiling is disabled
+    int preDynamicsPhase;
+    int midDynamicsPhase;
+    int dynamicsPhase;
+    int collisionExtractionPhase;
+    int controllerWaitPhase;
+    int postDynamicsPhase;
+    int recordBufferingPhase;
 
     TimeBar* timeBar;
     int fillLevelId;
@@ -279,6 +360,7 @@ public:
     Signal<void(bool isForced)> sigSimulationFinished;
 
     WorldLogFileItemPtr worldLogFileItem;
+    WorldLogWriter worldLogWriter;
     int nextLogFrame;
     double nextLogTime;
     double logTimeStep;
@@ -316,8 +398,11 @@ public:
     void clearSimulation();
     bool startSimulation(bool doReset);
     virtual void run() override;
+    bool checkPause(bool& isOnPause, double& elapsedTime, QElapsedTimer& timer);
     void onSimulationLoopStarted();
     void updateSimBodyLists();
+    void initializeStepSequence();
+    void bufferRecords();
     bool stepSimulationMain();
     void flushRecords();
     int flushMainRecords();
@@ -325,6 +410,8 @@ public:
     void pauseSimulation();
     void restartSimulation();
     void onSimulationLoopStopped(bool isForced);
+    void initializeStepProfiler();
+    void putStepProfile();
     void setExternalForce(BodyItem* bodyItem, Link* link, const Vector3& point, const Vector3& f, double time);
     void doSetExternalForce();
     void setVirtualElasticString(
@@ -525,7 +612,9 @@ ControllerInfo::ControllerInfo(ControllerItem* controller, SimulationBody::Impl*
       body_(simBodyImpl->body_),
       simImpl(simBodyImpl->simImpl)
 {
-
+    profilerThreadId = 0;
+    controlBeginTime = 0;
+    controlEndTime = 0;
 }
 
 
@@ -828,13 +917,38 @@ void SimulationBody::Impl::copyStateToBodyItem()
 }
 
 
+/*
+  The meshes shared by MeshPool are immutable, so the simulation body refers to them instead of
+  their copies. The other meshes are cloned because they may be modified in the original body.
+*/
+static void registerMeshesAsOwnClones(SgNode* node, CloneMap& cloneMap)
+{
+    if(auto shape = dynamic_cast<SgShape*>(node)){
+        if(auto mesh = shape->mesh()){
+            if(MeshPool::instance()->contains(mesh)){
+                cloneMap.setClone(mesh, mesh);
+            }
+        }
+    } else if(auto group = dynamic_cast<SgGroup*>(node)){
+        for(auto& child : *group){
+            registerMeshesAsOwnClones(child, cloneMap);
+        }
+    }
+}
+
+
 void SimulationBody::cloneShapesOnce()
 {
     if(!impl->areShapesCloned){
         if(!impl->simImpl){
             // throw exception
         }
-        impl->body_->cloneShapes(impl->simImpl->cloneMap);
+        auto& cloneMap = impl->simImpl->cloneMap;
+        for(auto& link : impl->body_->links()){
+            registerMeshesAsOwnClones(link->visualShape(), cloneMap);
+            registerMeshesAsOwnClones(link->collisionShape(), cloneMap);
+        }
+        impl->body_->cloneShapes(cloneMap);
         impl->areShapesCloned = true;
     }
 }
@@ -849,6 +963,11 @@ const std::string& SimulationBody::recordItemPrefix() const
 void SimulationBody::Impl::initializeRecording()
 {
     self->initializeRecordBuffers();
+
+    flushingJointPosBuf.resize(0, jointPosBuf.colSize());
+    flushingLinkPosBuf.resize(0, linkPosBuf.colSize());
+    flushingDeviceStateBuf.resize(0, deviceStateBuf.colSize());
+    prevFlushedDeviceStateInDirectMode.clear();
     
     if(simImpl->isRecordingEnabled){
         self->initializeRecordItems();
@@ -882,7 +1001,6 @@ void SimulationBody::Impl::initializeRecordBuffers()
     
     if(devices.empty() || !simImpl->isDeviceStateOutputEnabled){
         deviceStateBuf.clear();
-        prevFlushedDeviceStateInDirectMode.clear();
     } else {
         /**
            Temporary code to avoid a bug in storing device states by reserving sufficient buffer size.
@@ -892,13 +1010,14 @@ void SimulationBody::Impl::initializeRecordBuffers()
         
         // This buf always has the first element to keep unchanged states
         deviceStateBuf.resize(1, numDevices); 
-        prevFlushedDeviceStateInDirectMode.resize(numDevices);
         for(size_t i=0; i < devices.size(); ++i){
             deviceStateConnections.add(
                 devices[i]->sigStateChanged().connect(
                     [this, i](){
                         /** \note This must be thread safe
                             if notifyStateChange is called from several threads.
+                            The sensors of a body are updated by a single thread in the parallel
+                            dynamics computation because the body is processed in one group.
                         */
                         deviceStateChangeFlag[i] = true;
                     }));
@@ -930,13 +1049,13 @@ void SimulationBody::Impl::initializeRecordItems()
 
     motion = motionItem->motion();
     motion->setFrameRate(simImpl->worldFrameRate);
-    motion->setDimension(0, jointPosBuf.colSize(), linkPosBuf.colSize());
+    motion->setDimension(0, flushingJointPosBuf.colSize(), flushingLinkPosBuf.colSize());
     motion->setOffsetTime(0.0);
     jointPosRecord = motion->jointPosSeq();
     linkPosRecordItem = motionItem->linkPosSeqItem();
     linkPosRecord = motion->linkPosSeq();
 
-    const int numDevices = deviceStateBuf.colSize();
+    const int numDevices = flushingDeviceStateBuf.colSize();
     if(numDevices == 0 || !simImpl->isDeviceStateOutputEnabled){
         clearMultiDeviceStateSeq(*motion);
     } else {
@@ -1058,6 +1177,43 @@ void SimulationBody::Impl::bufferRecords()
 }
 
 
+/**
+   This function must be called with the record buffer mutex locked.
+   The buffered records are moved to the flushing buffers, and the emptied flushing buffers
+   are reused as the buffers written by the simulation thread. No element is copied except
+   the last device states.
+*/
+void SimulationBody::Impl::swapRecordBuffers()
+{
+    jointPosBuf.swap(flushingJointPosBuf);
+    if(jointPosBuf.colSize() != flushingJointPosBuf.colSize()){
+        jointPosBuf.resize(0, flushingJointPosBuf.colSize());
+    } else {
+        jointPosBuf.pop_front(jointPosBuf.rowSize());
+    }
+    
+    linkPosBuf.swap(flushingLinkPosBuf);
+    if(linkPosBuf.colSize() != flushingLinkPosBuf.colSize()){
+        linkPosBuf.resize(0, flushingLinkPosBuf.colSize());
+    } else {
+        linkPosBuf.pop_front(linkPosBuf.rowSize());
+    }
+
+    deviceStateBuf.swap(flushingDeviceStateBuf);
+    const int numDevices = flushingDeviceStateBuf.colSize();
+    if(deviceStateBuf.colSize() != numDevices){
+        deviceStateBuf.resize(0, numDevices);
+    } else {
+        deviceStateBuf.pop_front(deviceStateBuf.rowSize());
+    }
+    if(numDevices > 0 && flushingDeviceStateBuf.rowSize() > 0){
+        // keep the last state so that unchanged states can be shared
+        auto last = flushingDeviceStateBuf.last();
+        std::copy(last.begin(), last.end(), deviceStateBuf.append().begin());
+    }
+}
+
+
 void SimulationBody::flushRecords()
 {
     impl->flushRecords();
@@ -1072,13 +1228,10 @@ void SimulationBody::Impl::flushRecords()
         flushRecordsToBody();
     }
 
-    // clear buffers
-    linkPosBuf.resizeRow(0);
-    jointPosBuf.resizeRow(0);
-
-    // keep the last state so that unchanged states can be shared
-    const int numPops = (deviceStateBuf.rowSize() >= 2) ? (deviceStateBuf.rowSize() - 1) : 0;
-    deviceStateBuf.pop_front(numPops);
+    // clear buffers without releasing the memory
+    flushingLinkPosBuf.pop_front(flushingLinkPosBuf.rowSize());
+    flushingJointPosBuf.pop_front(flushingJointPosBuf.rowSize());
+    flushingDeviceStateBuf.pop_front(flushingDeviceStateBuf.rowSize());
 }
 
 
@@ -1089,13 +1242,13 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
     }
 
     const int ringBufferSize = simImpl->ringBufferSize;
-    const int numBufFrames = linkPosBuf.rowSize();
-    const int nextFrame = simImpl->currentFrame + 1;
+    const int numBufFrames = flushingLinkPosBuf.rowSize();
+    const int nextFrame = simImpl->flushingFrame + 1;
 
-    if(linkPosBuf.colSize() > 0){
+    if(flushingLinkPosBuf.colSize() > 0){
         bool offsetChanged = false;
         for(int i=0; i < numBufFrames; ++i){
-            auto buf = linkPosBuf.row(i);
+            auto buf = flushingLinkPosBuf.row(i);
             if(linkPosRecord->numFrames() >= ringBufferSize){
                 linkPosRecord->popFrontFrame();
                 offsetChanged = true;
@@ -1106,10 +1259,10 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
             linkPosRecord->setOffsetTimeFrame(nextFrame - linkPosRecord->numFrames());
         }
     }
-    if(jointPosBuf.colSize() > 0){
+    if(flushingJointPosBuf.colSize() > 0){
         bool offsetChanged = false;
         for(int i=0; i < numBufFrames; ++i){
-            auto buf = jointPosBuf.row(i);
+            auto buf = flushingJointPosBuf.row(i);
             if(jointPosRecord->numFrames() >= ringBufferSize){
                 jointPosRecord->popFrontFrame();
                 offsetChanged = true;
@@ -1120,11 +1273,11 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
             jointPosRecord->setOffsetTimeFrame(nextFrame - jointPosRecord->numFrames());
         }
     }
-    if(deviceStateBuf.colSize() > 0){
+    if(flushingDeviceStateBuf.colSize() > 0){
         bool offsetChanged = false;
         // This loop begins with the second element to skip the first element to keep the unchanged states
-        for(int i=1; i < deviceStateBuf.rowSize(); ++i){ 
-            auto buf = deviceStateBuf.row(i);
+        for(int i=1; i < flushingDeviceStateBuf.rowSize(); ++i){ 
+            auto buf = flushingDeviceStateBuf.row(i);
             if(deviceStateRecord->numFrames() >= ringBufferSize){
                 deviceStateRecord->popFrontFrame();
                 offsetChanged = true;
@@ -1141,8 +1294,8 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
 void SimulationBody::Impl::flushRecordsToBody()
 {
     Body* orgBody = bodyItem->body();
-    if(!linkPosBuf.empty()){
-        auto last = linkPosBuf.last();
+    if(!flushingLinkPosBuf.empty()){
+        auto last = flushingLinkPosBuf.last();
         const int n = last.size();
         for(int i=0; i < n; ++i){
             SE3& pos = last[i];
@@ -1151,18 +1304,21 @@ void SimulationBody::Impl::flushRecordsToBody()
             link->R() = pos.rotation().toRotationMatrix();
         }
     }
-    if(!jointPosBuf.empty()){
-        auto last = jointPosBuf.last();
+    if(!flushingJointPosBuf.empty()){
+        auto last = flushingJointPosBuf.last();
         const int n = body_->numJoints();
         for(int i=0; i < n; ++i){
             orgBody->joint(i)->q() = last[i];
         }
     }
-    if(!deviceStateBuf.empty()){
+    if(!flushingDeviceStateBuf.empty()){
         devicesToNotifyRecords.clear();
         const DeviceList<>& devices = orgBody->devices();
-        auto ds = deviceStateBuf.last();
+        auto ds = flushingDeviceStateBuf.last();
         const int ndevices = devices.size();
+        if(static_cast<int>(prevFlushedDeviceStateInDirectMode.size()) != ndevices){
+            prevFlushedDeviceStateInDirectMode.assign(ndevices, nullptr);
+        }
         for(int i=0; i < ndevices; ++i){
             const DeviceStatePtr& s = ds[i];
             if(s != prevFlushedDeviceStateInDirectMode[i]){
@@ -1176,34 +1332,27 @@ void SimulationBody::Impl::flushRecordsToBody()
 }
 
 
-void SimulationBody::Impl::flushRecordsToWorldLogFile(int bufferFrame)
+void SimulationBody::Impl::storeWorldLogRecords(int bufferFrame, WorldLogWriter::BodyState& state)
 {
-    //if(bufferFrame < linkPosBuf.rowSize()){
-    
-    WorldLogFileItem* log = simImpl->worldLogFileItem;
-    log->beginBodyStateOutput();
-
-    if(linkPosBuf.colSize() > 0){
-        auto posbuf = linkPosBuf.row(bufferFrame);
-        log->outputLinkPositions(posbuf.begin(), posbuf.size());
+    if(flushingLinkPosBuf.colSize() > 0){
+        auto posbuf = flushingLinkPosBuf.row(bufferFrame);
+        state.linkPositions.assign(posbuf.begin(), posbuf.end());
+    } else {
+        state.linkPositions.clear();
     }
-    if(jointPosBuf.colSize() > 0){
-        auto jointbuf = jointPosBuf.row(bufferFrame);
-        log->outputJointPositions(jointbuf.begin(), jointbuf.size());
+    if(flushingJointPosBuf.colSize() > 0){
+        auto jointbuf = flushingJointPosBuf.row(bufferFrame);
+        state.jointPositions.assign(jointbuf.begin(), jointbuf.end());
+    } else {
+        state.jointPositions.clear();
     }
-    if(deviceStateBuf.colSize() > 0){
+    if(flushingDeviceStateBuf.colSize() > 0){
         // Skip the first element because it is used for sharing an unchanged state
-        auto states = deviceStateBuf.row(bufferFrame + 1);
-        log->beginDeviceStateOutput();
-        for(int i=0; i < states.size(); ++i){
-            log->outputDeviceState(states[i]);
-        }
-        log->endDeviceStateOutput();
+        auto states = flushingDeviceStateBuf.row(bufferFrame + 1);
+        state.deviceStates.assign(states.begin(), states.end());
+    } else {
+        state.deviceStates.clear();
     }
-
-    log->endBodyStateOutput();
-
-    //}
 }
 
 
@@ -1278,7 +1427,12 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     isDeviceStateOutputEnabled = true;
     isDoingSimulationLoop = false;
     isRealtimeSyncMode = true;
+    isHighResolutionRealtimeSyncEnabled = false;
+    realtimeSyncSpinTime = 0.0;
+    isRealtimePacerUsed = false;
     recordCollisionData = false;
+    isStepProfilingEnabled = false;
+    stepProfiler = nullptr;
 
     timeBar = TimeBar::instance();
 }
@@ -1306,8 +1460,12 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
     isAllLinkPositionOutputMode = org.isAllLinkPositionOutputMode;
     isDeviceStateOutputEnabled = org.isDeviceStateOutputEnabled;
     isRealtimeSyncMode = org.isRealtimeSyncMode;
+    isHighResolutionRealtimeSyncEnabled = org.isHighResolutionRealtimeSyncEnabled;
+    realtimeSyncSpinTime = org.realtimeSyncSpinTime;
     recordCollisionData = org.recordCollisionData;
+    isStepProfilingEnabled = org.isStepProfilingEnabled;
     controllerOptionString_ = org.controllerOptionString_;
+    stepProfileTraceFile = org.stepProfileTraceFile;
 }
     
 
@@ -1396,6 +1554,24 @@ void SimulatorItem::setRealtimeSyncMode(bool on)
 }
 
 
+void SimulatorItem::setHighResolutionRealtimeSyncEnabled(bool on)
+{
+    impl->isHighResolutionRealtimeSyncEnabled = on;
+}
+
+
+bool SimulatorItem::isHighResolutionRealtimeSyncEnabled() const
+{
+    return impl->isHighResolutionRealtimeSyncEnabled;
+}
+
+
+void SimulatorItem::setRealtimeSyncSpinTime(double time)
+{
+    impl->realtimeSyncSpinTime = std::max(0.0, time * 1.0e6);
+}
+
+
 void SimulatorItem::setDeviceStateOutputEnabled(bool on)
 {
     impl->isDeviceStateOutputEnabled = on;
@@ -1707,6 +1883,8 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
     virtualElasticStringFunctionId = stdx::nullopt;
 
     cloneMap.replacePendingObjects();
+
+    initializeStepProfiler();
     
     bool result = self->initializeSimulation(simBodiesWithBody);
 
@@ -1793,9 +1971,11 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         }
 
         numBufferedFrames = 1;
+        flushingFrame = 0;
     
         if(isRecordingEnabled && recordCollisionData){
             collisionPairsBuf.clear();
+            flushingCollisionPairsBuf.clear();
             string collisionSeqName = self->name() + "-collisions";
             auto collisionSeqItem = worldItem->findChildItem<CollisionSeqItem>(collisionSeqName);
             if(!collisionSeqItem){
@@ -1844,6 +2024,8 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
             }
         }
 
+        initializeStepSequence();
+
         aboutToQuitConnection.disconnect();
         aboutToQuitConnection = cnoid::sigAboutToQuit().connect(
             [&](){ stopSimulation(true, true); });
@@ -1867,10 +2049,11 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
                 worldLogFileItem->clearOutput();
                 worldLogFileItem->beginHeaderOutput();
                 for(size_t i=0; i < activeSimBodies.size(); ++i){
-                    worldLogFileItem->outputBodyHeader(activeSimBodies[i]->impl->body_->name());
+                    worldLogFileItem->outputBodyHeader(activeSimBodies[i]->impl->body_);
                 }
                 worldLogFileItem->endHeaderOutput();
                 worldLogFileItem->notifyUpdate();
+                worldLogWriter.start(worldLogFileItem);
                 nextLogFrame = 0;
                 nextLogTime = 0.0;
                 double r = worldLogFileItem->recordingFrameRate();
@@ -1912,6 +2095,7 @@ void SimulatorItem::Impl::updateSimBodyLists()
 {
     activeSimBodies.clear();
     activeControllerInfos.clear();
+    stepSequence.clearControllers();
     hasActiveFreeBodies = false;
     
     for(size_t i=0; i < allSimBodies.size(); ++i){
@@ -1926,6 +2110,7 @@ void SimulatorItem::Impl::updateSimBodyLists()
         }
         for(auto& info : controllerInfos){
             activeControllerInfos.push_back(info);
+            stepSequence.addController(info.get());
        }
     }
 
@@ -1933,6 +2118,50 @@ void SimulatorItem::Impl::updateSimBodyLists()
 }
 
 
+/**
+   The controller processing of a step is done by the step sequence shared with the batch simulator,
+   and the other processing of SimulatorItem is given to it as the functions of the stages.
+*/
+void SimulatorItem::Impl::initializeStepSequence()
+{
+    stepSequence.setControllerThreadMode(useControllerThreads);
+    stepSequence.setStopWhenNoActiveControllers(doStopSimulationWhenNoActiveControllers);
+    stepSequence.setProfiler(stepProfiler, controllerWaitPhase);
+
+    stepSequence.setPreDynamicsFunction(
+        [this](){
+            PhaseProfiler::Scope scope(stepProfiler, preDynamicsPhase);
+            preDynamicsFunctions.call();
+        });
+
+    stepSequence.setMidDynamicsFunction(
+        [this](){
+            PhaseProfiler::Scope scope(stepProfiler, midDynamicsPhase);
+            midDynamicsFunctions.call();
+        });
+
+    stepSequence.setDynamicsFunction(
+        [this](){
+            {
+                PhaseProfiler::Scope scope(stepProfiler, dynamicsPhase);
+                self->stepSimulation(activeSimBodies);
+            }
+            if(isRecordingEnabled && recordCollisionData){
+                PhaseProfiler::Scope scope(stepProfiler, collisionExtractionPhase);
+                currentCollisionPairs = self->getCollisions();
+            }
+        });
+
+    stepSequence.setPostDynamicsFunction(
+        [this](){
+            PhaseProfiler::Scope scope(stepProfiler, postDynamicsPhase);
+            postDynamicsFunctions.call();
+        });
+
+    stepSequence.setRecordingFunction([this](){ bufferRecords(); });
+}
+
+
 CloneMap& SimulatorItem::cloneMap()
 {
     return impl->cloneMap;
@@ -2006,68 +2235,65 @@ void SimulatorItem::Impl::run()
     int frame = 0;
     bool isOnPause = false;
 
-    if(isRealtimeSyncMode){
+    isRealtimePacerUsed = isRealtimeSyncMode && isHighResolutionRealtimeSyncEnabled;
+
+    if(isRealtimePacerUsed){
+        realtimePacer.setPeriod(worldTimeStep_);
+        realtimePacer.setSpinTime(realtimeSyncSpinTime * 1.0e-6);
+        realtimePacer.start();
+        while(true){
+            if(pauseRequested && stopRequested){
+                break;
+            }
+            if(checkPause(isOnPause, elapsedTime, timer)){
+                continue;
+            }
+            if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
+                break;
+            }
+            realtimePacer.wait();
+            ++frame;
+        }
+    } else if(isRealtimeSyncMode){
         const double dt = worldTimeStep_;
         const double compensationRatio = (dt > 0.1) ? 0.1 : dt;
         const double dtms = dt * 1000.0;
         double compensatedSimulationTime = 0.0;
         while(true){
-            if(pauseRequested){
-                if(stopRequested){
-                    break;
-                }
-                if(!isOnPause){
-                    elapsedTime += timer.elapsed();
-                    isOnPause = true;
-                    sigSimulationPaused();
-                }
-                QThread::msleep(50);
-            } else {
-                if(isOnPause){
-                    timer.start();
-                    isOnPause = false;
-                    sigSimulationResumed();
-                }
-                if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
-                    break;
-                }
-                double diff = (double)compensatedSimulationTime - (elapsedTime + timer.elapsed());
-                if(diff >= 1.0){
-                    QThread::msleep(diff);
-                } else if(diff < 0.0){
-                    const double compensationTime = -diff * compensationRatio;
-                    compensatedSimulationTime += compensationTime;
-                    diff += compensationTime;
-                    const double delayOverThresh = -diff - 100.0;
-                    if(delayOverThresh > 0.0){
-                        compensatedSimulationTime += delayOverThresh;
-                    }
+            if(pauseRequested && stopRequested){
+                break;
+            }
+            if(checkPause(isOnPause, elapsedTime, timer)){
+                continue;
+            }
+            if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
+                break;
+            }
+            double diff = (double)compensatedSimulationTime - (elapsedTime + timer.elapsed());
+            if(diff >= 1.0){
+                QThread::msleep(diff);
+            } else if(diff < 0.0){
+                const double compensationTime = -diff * compensationRatio;
+                compensatedSimulationTime += compensationTime;
+                diff += compensationTime;
+                const double delayOverThresh = -diff - 100.0;
+                if(delayOverThresh > 0.0){
+                    compensatedSimulationTime += delayOverThresh;
                 }
-                compensatedSimulationTime += dtms;
-                ++frame;
             }
+            compensatedSimulationTime += dtms;
+            ++frame;
         }
     } else {
         while(true){
-            if(pauseRequested){
-                if(stopRequested){
-                    break;
-                }
-                if(!isOnPause){
-                    elapsedTime += timer.elapsed();
-                    isOnPause = true;
-                    sigSimulationPaused();
-                }
-                QThread::msleep(50);
-            } else {
-                if(isOnPause){
-                    timer.start();
-                    isOnPause = false;
-                    sigSimulationResumed();
-                }
-                if(!stepSimulationMain() || stopRequested || frame++ >= maxFrame){
-                    break;
-                }
+            if(pauseRequested && stopRequested){
+                break;
+            }
+            if(checkPause(isOnPause, elapsedTime, timer)){
+                continue;
+            }
+            if(!stepSimulationMain() || stopRequested || frame++ >= maxFrame){
+                break;
             }
         }
     }
@@ -2099,106 +2325,113 @@ void SimulatorItem::Impl::run()
 }
 
 
+/**
+   This function updates the pause state of the simulation loop.
+   \return true while the simulation is paused, and the loop skips the step in that case.
+*/
+bool SimulatorItem::Impl::checkPause(bool& isOnPause, double& elapsedTime, QElapsedTimer& timer)
+{
+    if(pauseRequested){
+        if(!isOnPause){
+            elapsedTime += timer.elapsed();
+            isOnPause = true;
+            sigSimulationPaused();
+        }
+        QThread::msleep(50);
+        return true;
+    }
+    if(isOnPause){
+        timer.start();
+        if(isRealtimePacerUsed){
+            realtimePacer.resume();
+        }
+        isOnPause = false;
+        sigSimulationResumed();
+    }
+    return false;
+}
+
+
 bool SimulatorItem::Impl::stepSimulationMain()
 {
     currentFrame++;
 
     if(needToUpdateSimBodyLists){
+        // The list is also referred to by the flush of the records
+        recordBufMutex.lock();
         updateSimBodyLists();
+        recordBufMutex.unlock();
     }
     
-    bool doContinue = !doStopSimulationWhenNoActiveControllers;
+    if(stepProfiler){
+        stepProfiler->beginFrame();
+    }
 
-    preDynamicsFunctions.call();
+    bool doContinue = stepSequence.step();
 
-    if(!useControllerThreads){
-        for(auto& info : activeControllerInfos){
-            auto& controller = info->controller;
-            controller->input();
-            doContinue |= controller->control();
-            if(controller->isNoDelayMode()){
-                controller->output();
-            }
-        }
-    } else {
-        bool hasNoDelayModeControllers = false;
-        for(auto& info : activeControllerInfos){
-            auto& controller = info->controller;
-            if(controller->isNoDelayMode()){
-                hasNoDelayModeControllers = true;
-            }
-            info->controller->input();
-            {
-                std::lock_guard<std::mutex> lock(info->controlMutex);                
-                info->isControlRequested = true;
-            }
-            info->controlCondition.notify_all();
-        }
-        if(hasNoDelayModeControllers){
-            // Todo: Process the controller that finishes control earlier first to
-            // reduce the total elapsed time before finishing all the output functions.
-            for(auto& info : activeControllerInfos){
-                if(info->controller->isNoDelayMode()){
-                    if(info->waitForControlInThreadToFinish()){
-                        doContinue = true;
-                    }
-                    info->controller->output();
-                }
-            }
-        }
+    if(stepProfiler){
+        stepProfiler->endFrame();
     }
 
-    midDynamicsFunctions.call();
+    return doContinue;
+}
 
-    self->stepSimulation(activeSimBodies);
 
-    shared_ptr<CollisionLinkPairList> collisionPairs;
-    if(isRecordingEnabled && recordCollisionData){
-        collisionPairs = self->getCollisions();
-    }
+void SimulatorItem::Impl::bufferRecords()
+{
+    PhaseProfiler::Scope scope(stepProfiler, recordBufferingPhase);
+    recordBufMutex.lock();
 
-    if(useControllerThreads){
-        for(auto& info : activeControllerInfos){
-            if(!info->controller->isNoDelayMode()){
-                if(info->waitForControlInThreadToFinish()){
-                    doContinue = true;
-                }
-            }
-        }
+    ++numBufferedFrames;
+    for(size_t i=0; i < activeSimBodies.size(); ++i){
+        activeSimBodies[i]->bufferRecords();
     }
+    collisionPairsBuf.push_back(currentCollisionPairs);
+    currentCollisionPairs.reset();
+    frameAtLastBufferWriting = currentFrame;
 
-    postDynamicsFunctions.call();
+    recordBufMutex.unlock();
+}
 
-    {
-        recordBufMutex.lock();
 
-        ++numBufferedFrames;
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->bufferRecords();
-        }
-        collisionPairsBuf.push_back(collisionPairs);
-        frameAtLastBufferWriting = currentFrame;
+void ControllerInfo::input()
+{
+    controller->input();
+}
 
-        recordBufMutex.unlock();
-    }
 
-    for(auto& info : activeControllerInfos){
-        if(!info->controller->isNoDelayMode()){
-            info->controller->output();
-        }
-    }
+bool ControllerInfo::control()
+{
+    return controller->control();
+}
 
-    return doContinue;
+
+void ControllerInfo::output()
+{
+    controller->output();
+}
+
+
+void ControllerInfo::requestControl()
+{
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        isControlRequested = true;
+    }
+    controlCondition.notify_all();
 }
 
 
-bool ControllerInfo::waitForControlInThreadToFinish()
+bool ControllerInfo::waitForControl()
 {
     std::unique_lock<std::mutex> lock(controlMutex);
     while(!isControlFinished){
         controlCondition.wait(lock);
     }
     isControlFinished = false;
+    if(auto profiler = simImpl->stepProfiler){
+        profiler->addPhaseRecord(controlPhase, controlBeginTime, controlEndTime, profilerThreadId);
+    }
     return isControlToBeContinued;
 }
 
@@ -2221,7 +2454,14 @@ void ControllerInfo::concurrentControlLoop()
             }
         }
 
+        const bool doProfile = (simImpl->stepProfiler != nullptr);
+        if(doProfile){
+            controlBeginTime = PhaseProfiler::now();
+        }
         bool doContinue = controller->control();
+        if(doProfile){
+            controlEndTime = PhaseProfiler::now();
+        }
         
         {
             std::lock_guard<std::mutex> lock(controlMutex);
@@ -2249,8 +2489,8 @@ void SimulatorItem::Impl::flushRecords()
         timeBar->updateFillLevel(fillLevelId, fillLevel);
     } else {
         const double time = frame / worldFrameRate;
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->impl->notifyRecords(time);
+        for(auto& simBody : flushingSimBodies){
+            simBody->impl->notifyRecords(time);
         }
         timeBar->setTime(time);
     }
@@ -2259,56 +2499,166 @@ void SimulatorItem::Impl::flushRecords()
 
 int SimulatorItem::Impl::flushMainRecords()
 {
+    /*
+      The mutex is only locked while the record buffers are exchanged so that the simulation
+      thread does not wait for the records to be flushed.
+    */
     recordBufMutex.lock();
 
+    flushingSimBodies = activeSimBodies;
+    for(auto& simBody : flushingSimBodies){
+        simBody->impl->swapRecordBuffers();
+    }
+    collisionPairsBuf.swap(flushingCollisionPairsBuf);
+    const int numFlushingFrames = numBufferedFrames;
+    flushingFrame = frameAtLastBufferWriting;
+    numBufferedFrames = 0;
+    
+    recordBufMutex.unlock();
+
     if(worldLogFileItem){
-        if(numBufferedFrames > 0){
-            int firstFrame = frameAtLastBufferWriting - (numBufferedFrames - 1);
-            for(int bufFrame = 0; bufFrame < numBufferedFrames; ++bufFrame){
+        if(numFlushingFrames > 0){
+            const int numBodies = flushingSimBodies.size();
+            int firstFrame = flushingFrame - (numFlushingFrames - 1);
+            for(int bufFrame = 0; bufFrame < numFlushingFrames; ++bufFrame){
                 double time = (firstFrame + bufFrame) * worldTimeStep_;
                 while(time >= nextLogTime){
-                    worldLogFileItem->beginFrameOutput(time);
-                    for(size_t i=0; i < activeSimBodies.size(); ++i){
-                        activeSimBodies[i]->impl->flushRecordsToWorldLogFile(bufFrame);
+                    auto logFrame = worldLogWriter.newFrame(numBodies);
+                    logFrame->time = time;
+                    for(int i=0; i < numBodies; ++i){
+                        flushingSimBodies[i]->impl->storeWorldLogRecords(bufFrame, logFrame->bodyStates[i]);
                     }
-                    worldLogFileItem->endFrameOutput();
+                    worldLogWriter.push(std::move(logFrame));
                     nextLogTime = ++nextLogFrame * logTimeStep;
                 }
             }
         }
     }
     
-    for(auto& simBody : activeSimBodies){
+    for(auto& simBody : flushingSimBodies){
         simBody->flushRecords();
     }
 
     bool offsetChanged;
     if(isRecordingEnabled && recordCollisionData){
         offsetChanged = false;
-        for(size_t i=0 ; i < collisionPairsBuf.size(); ++i){
+        for(size_t i=0 ; i < flushingCollisionPairsBuf.size(); ++i){
             if(collisionSeq->numFrames() >= ringBufferSize){
                 collisionSeq->popFrontFrame();
                 offsetChanged = true;
             }
             CollisionSeq::Frame collisionSeq0 = collisionSeq->appendFrame();
-            collisionSeq0[0] = collisionPairsBuf[i];
+            collisionSeq0[0] = flushingCollisionPairsBuf[i];
         }
         if(offsetChanged){
-            collisionSeq->setOffsetTimeFrame(currentFrame + 1 - collisionSeq->numFrames());
+            collisionSeq->setOffsetTimeFrame(flushingFrame + 1 - collisionSeq->numFrames());
         }
     }
-    collisionPairsBuf.clear();
+    flushingCollisionPairsBuf.clear();
 
-    int frame = frameAtLastBufferWriting;
-    
-    numBufferedFrames = 0;
-    
-    recordBufMutex.unlock();
+    return flushingFrame;
+}
 
+
+void WorldLogWriter::start(WorldLogFileItem* item)
+{
+    finish();
+    logItem = item;
+    isFinishing = false;
+    writerThread = std::thread([this](){ writerLoop(); });
+}
+
+
+WorldLogWriter::FramePtr WorldLogWriter::newFrame(int numBodies)
+{
+    FramePtr frame;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if(!freeFrames.empty()){
+            frame = std::move(freeFrames.back());
+            freeFrames.pop_back();
+        }
+    }
+    if(!frame){
+        frame.reset(new Frame);
+    }
+    frame->bodyStates.resize(numBodies);
     return frame;
 }
 
 
+void WorldLogWriter::push(FramePtr frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        frameQueue.push_back(std::move(frame));
+    }
+    queueCondition.notify_one();
+}
+
+
+/**
+   The frames remaining in the queue are written before the writer thread exits.
+*/
+void WorldLogWriter::finish()
+{
+    if(writerThread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            isFinishing = true;
+        }
+        queueCondition.notify_one();
+        writerThread.join();
+    }
+    logItem.reset();
+    freeFrames.clear();
+}
+
+
+void WorldLogWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while(true){
+        queueCondition.wait(lock, [this](){ return !frameQueue.empty() || isFinishing; });
+        if(frameQueue.empty()){
+            break;
+        }
+        FramePtr frame = std::move(frameQueue.front());
+        frameQueue.pop_front();
+        lock.unlock();
+        writeFrame(*frame);
+        lock.lock();
+        freeFrames.push_back(std::move(frame));
+    }
+}
+
+
+void WorldLogWriter::writeFrame(Frame& frame)
+{
+    logItem->beginFrameOutput(frame.time);
+
+    for(auto& state : frame.bodyStates){
+        logItem->beginBodyStateOutput();
+        if(!state.linkPositions.empty()){
+            logItem->outputLinkPositions(&state.linkPositions.front(), state.linkPositions.size());
+        }
+        if(!state.jointPositions.empty()){
+            logItem->outputJointPositions(&state.jointPositions.front(), state.jointPositions.size());
+        }
+        if(!state.deviceStates.empty()){
+            logItem->beginDeviceStateOutput();
+            for(auto& deviceState : state.deviceStates){
+                logItem->outputDeviceState(deviceState);
+            }
+            logItem->endDeviceStateOutput();
+        }
+        logItem->endBodyStateOutput();
+    }
+    
+    logItem->endFrameOutput();
+}
+
+
 void SimulatorItem::pauseSimulation()
 {
     impl->pauseSimulation();
@@ -2382,6 +2732,11 @@ void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
     }
 
     flushRecords();
+    worldLogWriter.finish();
+    if(worldLogFileItem){
+        worldLogFileItem->endOutput();
+        worldLogFileItem = nullptr;
+    }
 
     if(isRecordingEnabled){
         timeBar->stopFillLevelUpdate(fillLevelId);
@@ -2394,12 +2749,90 @@ void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
                          actualSimulationTime, (actualSimulationTime / finishTime)));
     }
 
+    if(isRealtimePacerUsed){
+        auto stat = realtimePacer.statistics();
+        mv->putln(format(_("Realtime sync jitter: mean {0:.1f} [us], max {1:.1f} [us], "
+                           "overruns: {2} / {3} periods (max {4:.3f} [ms], {5} resets)."),
+                         stat.meanJitter * 1.0e6, stat.maxJitter * 1.0e6,
+                         stat.numOverruns, stat.numPeriods, stat.maxOverrun * 1.0e3, stat.numResets));
+    }
+
+    if(stepProfiler){
+        putStepProfile();
+    }
+
     clearSimulation();
 
     sigSimulationFinished(isForced);
 }
 
 
+void SimulatorItem::Impl::initializeStepProfiler()
+{
+    stepProfilerInstance.clear();
+
+    if(!isStepProfilingEnabled){
+        stepProfiler = nullptr;
+        return;
+    }
+    stepProfiler = &stepProfilerInstance;
+
+    preDynamicsPhase = stepProfiler->addPhase("Pre-dynamics functions");
+    midDynamicsPhase = stepProfiler->addPhase("Mid-dynamics functions");
+    dynamicsPhase = stepProfiler->addPhase("Dynamics");
+    collisionExtractionPhase = stepProfiler->addPhase("Collision extraction");
+    controllerWaitPhase = stepProfiler->addPhase("Waiting for controller threads");
+    postDynamicsPhase = stepProfiler->addPhase("Post-dynamics functions");
+    recordBufferingPhase = stepProfiler->addPhase("Record buffering");
+
+    int threadId = 1;
+    for(auto& simBody : allSimBodies){
+        for(auto& info : simBody->impl->controllerInfos){
+            auto name = info->controller->displayName();
+            info->inputPhase = stepProfiler->addPhase(name + ": input");
+            info->controlPhase = stepProfiler->addPhase(name + ": control");
+            info->outputPhase = stepProfiler->addPhase(name + ": output");
+            info->profilerThreadId = threadId++;
+        }
+    }
+}
+
+
+void SimulatorItem::Impl::putStepProfile()
+{
+    std::ostringstream oss;
+    stepProfiler->putSummary(oss);
+    mv->put(oss.str());
+
+    if(!stepProfileTraceFile.empty()){
+        if(stepProfiler->exportChromeTrace(stepProfileTraceFile)){
+            mv->putln(format(_("The step profile has been exported to \"{}\"."), stepProfileTraceFile));
+        } else {
+            mv->putln(format(_("The step profile cannot be exported to \"{}\"."), stepProfileTraceFile),
+                      MessageView::Error);
+        }
+    }
+}
+
+
+void SimulatorItem::setStepProfilingEnabled(bool on)
+{
+    impl->isStepProfilingEnabled = on;
+}
+
+
+bool SimulatorItem::isStepProfilingEnabled() const
+{
+    return impl->isStepProfilingEnabled;
+}
+
+
+PhaseProfiler* SimulatorItem::stepProfiler()
+{
+    return impl->stepProfiler;
+}
+
+
 bool SimulatorItem::isRunning() const
 {
     return impl->isDoingSimulationLoop;
@@ -2682,6 +3115,11 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
 
     putProperty(_("Sync with realtime"), isRealtimeSyncMode,
                 [&](bool on){ onRealtimeSyncChanged(on); return true; });
+    putProperty(_("High-resolution realtime sync"), isHighResolutionRealtimeSyncEnabled,
+                changeProperty(isHighResolutionRealtimeSyncEnabled));
+    putProperty.min(0.0).max(1.0e6)(_("Realtime sync spin time [us]"), realtimeSyncSpinTime,
+                                    changeProperty(realtimeSyncSpinTime));
+    putProperty.reset();
     putProperty(_("Time range"), timeRangeMode,
                 [&](int index){ return timeRangeMode.select(index); });
     putProperty(_("Time length"), specifiedTimeLength,
@@ -2698,6 +3136,10 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(useControllerThreadsProperty));
     putProperty(_("Controller options"), controllerOptionString_,
                 changeProperty(controllerOptionString_));
+    putProperty(_("Step profiling"), isStepProfilingEnabled,
+                changeProperty(isStepProfilingEnabled));
+    putProperty(_("Step profile trace file"), stepProfileTraceFile,
+                changeProperty(stepProfileTraceFile));
 }
 
 
@@ -2715,6 +3157,12 @@ bool SimulatorItem::Impl::store(Archive& archive)
         archive.write("frameRate", frameRateProperty);
     }
     archive.write("realtimeSync", isRealtimeSyncMode);
+    if(isHighResolutionRealtimeSyncEnabled){
+        archive.write("highResolutionRealtimeSync", true);
+    }
+    if(realtimeSyncSpinTime > 0.0){
+        archive.write("realtimeSyncSpinTime", realtimeSyncSpinTime);
+    }
     archive.write("recording", recordingMode.selectedSymbol(), DOUBLE_QUOTED);
     archive.write("timeRangeMode", timeRangeMode.selectedSymbol(), DOUBLE_QUOTED);
     archive.write("timeLength", specifiedTimeLength);
@@ -2723,6 +3171,12 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("controllerThreads", useControllerThreadsProperty);
     archive.write("recordCollisionData", recordCollisionData);
     archive.write("controllerOptions", controllerOptionString_, DOUBLE_QUOTED);
+    if(isStepProfilingEnabled){
+        archive.write("stepProfiling", true);
+    }
+    if(!stepProfileTraceFile.empty()){
+        archive.writeRelocatablePath("stepProfileTraceFile", stepProfileTraceFile);
+    }
 
     ListingPtr idseq = new Listing();
     idseq->setFlowStyle(true);
@@ -2793,12 +3247,18 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
         }
     }
     archive.read("realtimeSync", isRealtimeSyncMode);
+    archive.read("highResolutionRealtimeSync", isHighResolutionRealtimeSyncEnabled);
+    archive.read("realtimeSyncSpinTime", realtimeSyncSpinTime);
     archive.read("timeLength", specifiedTimeLength);
     self->setAllLinkPositionOutputMode(archive.get("allLinkPositionOutputMode", isAllLinkPositionOutputMode));
     archive.read("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.read("recordCollisionData", recordCollisionData);
     archive.read("controllerThreads", useControllerThreadsProperty);
     archive.read("controllerOptions", controllerOptionString_);
+    archive.read("stepProfiling", isStepProfilingEnabled);
+    if(archive.read("stepProfileTraceFile", symbol)){
+        stepProfileTraceFile = archive.resolveRelocatablePath(symbol);
+    }
 
     archive.addPostProcess([&](){ restoreBodyMotionEngines(archive); });
     
@@ -25,6 +25,7 @@ class ControllerItem;
 class SimulatorItem;
 class SimulatedMotionEngineManager;
 class CloneMap;
+class PhaseProfiler;
 
 class CNOID_EXPORT SimulationBody : public Referenced
 {
@@ -62,9 +63,16 @@ public:
     void notifyUnrecordedDeviceStateChange(Device* device);
     
     /**
-       Called from the simulation loop thread.
+       Called from the simulation loop thread while the record buffers are locked.
     */
     virtual void bufferRecords();
+
+    /**
+       Called from the main thread without locking the record buffers, so this function runs
+       concurrently with bufferRecords of the following frames. The default implementation flushes
+       the buffers exchanged with the ones of bufferRecords under the lock. An overriding function
+       that flushes its own buffers filled by bufferRecords must protect them by its own mutex.
+    */
     virtual void flushRecords();
 
     class Impl;
@@ -148,6 +156,20 @@ public:
     int recordingMode() const;
     void setTimeRangeMode(int selection);
     void setRealtimeSyncMode(bool on);
+
+    /**
+       In the high-resolution realtime sync mode, each simulation step is paced to the absolute
+       deadline of its period with the nanosecond resolution sleep, and the jitter statistics are
+       output when the simulation finishes.
+    */
+    void setHighResolutionRealtimeSyncEnabled(bool on);
+    bool isHighResolutionRealtimeSyncEnabled() const;
+
+    /**
+       The final part of each sleep in the high-resolution realtime sync mode is replaced with a spin
+       of this time in seconds. The spin is disabled when it is zero, which is the default.
+    */
+    void setRealtimeSyncSpinTime(double time);
     void setDeviceStateOutputEnabled(bool on);
 
     bool isRecordingEnabled() const;
@@ -183,6 +205,16 @@ public:
 
     CloneMap& cloneMap();
 
+    void setStepProfilingEnabled(bool on);
+    bool isStepProfilingEnabled() const;
+
+    /**
+       \return The profiler recording the phases of the simulation steps, or nullptr if the
+       step profiling is disabled. Simulator implementations can add their own phases to it
+       in initializeSimulation. The records are kept after the simulation is stopped.
+    */
+    PhaseProfiler* stepProfiler();
+
     /**
        \note This signal is emitted in the simulation thread
     */
@@ -8,13 +8,18 @@
 #include <cnoid/WorldItem>
 #include <cnoid/BodyItem>
 #include <cnoid/TimeSyncItemEngine>
+#include <cnoid/WorldLogFileWriter>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
+#include <cnoid/WorldLogFileIndex>
+#include <cnoid/MappedFile>
 #include <QDateTime>
-#include <fstream>
-#include <stack>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <zlib.h>
 #include "gettext.h"
 
 using namespace std;
@@ -28,45 +33,51 @@ static const int frameHeaderSize =
     + sizeof(int)   // data size
     ;
 
+static const int blockHeaderSize =
+      sizeof(int) // number of frames
+    + sizeof(int) // stored data size
+    + sizeof(int) // uncompressed data size
+    ;
+
 enum DataTypeID {
     BODY_STATE,
     LINK_POSITIONS,
     JOINT_POSITIONS,
-    DEVICE_STATES
+    DEVICE_STATES,
+    // The following IDs are only used in the frame blocks of format version 2
+    END_OF_BODY_STATE,
+    END_OF_FRAME
 };
 
+const int Version2Marker = -2;
+
 struct NotEnoughDataException { };
 
+/**
+   The data is directly read from the memory mapped log file.
+*/
 class ReadBuf
 {
 public:
-    vector<char> data;
-    ifstream& ifs;
+    const char* data;
+    int size;
     int pos;
 
-    ReadBuf(ifstream& ifs)
-        : ifs(ifs) {
+    ReadBuf() {
+        data = nullptr;
+        size = 0;
         pos = 0;
     }
 
-    bool checkSize(int size){
-        int left = data.size() - pos;
-        if(left < size){
-            int len = size - left;
-            data.resize(data.size() + len);
-            ifs.read(&data[pos], len);
-            if(!ifs.fail()){
-                return true;
-            } else {
-                ifs.clear();
-                return false;
-            }
-        }
-        return true;
+    ReadBuf(const char* data, size_t size)
+        : data(data) {
+        // The positions in a buffer are represented by int as the seek offsets in the log file
+        this->size = static_cast<int>(std::min(size, static_cast<size_t>(std::numeric_limits<int>::max())));
+        pos = 0;
     }
 
-    void ensureSize(int size){
-        if(!checkSize(size)){
+    void ensureSize(int n){
+        if(size - pos < n){
             throw NotEnoughDataException();
         }
     }
@@ -81,29 +92,8 @@ public:
         return pos + size;
     }
 
-    char* buf() {
-        return &data.front();
-    }
-
-    void clear(){
-        data.clear();
-        pos = 0;
-    }
-
-    int size() const {
-        return data.size();
-    }
-
-    char* current() {
-        return &data[pos];
-    }
-
-    char* end() {
-        return &data.front() + data.size();
-    }
-
     bool isEnd() {
-        return (pos >= static_cast<int>(data.size()));
+        return (pos >= size);
     }
 
     void seek(int pos = 0) { this->pos = pos; }
@@ -113,11 +103,6 @@ public:
         return data[pos++];
     }
 
-    bool readBool(){
-        ensureSize(1);
-        return data[pos++];
-    }
-
     char readOctet(){
         ensureSize(1);
         return data[pos++];
@@ -145,28 +130,71 @@ public:
         return readInt();
     }
 
+    uint64_t readVarint(){
+        uint64_t value = 0;
+        int shift = 0;
+        while(true){
+            ensureSize(1);
+            unsigned char byte = data[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80)){
+                break;
+            }
+            shift += 7;
+            if(shift >= 64){
+                throw NotEnoughDataException();
+            }
+        }
+        return value;
+    }
+
+    //! The number of the following values, each of which takes at least the given number of bytes
+    int readCount(int minValueSize){
+        uint64_t n = readVarint();
+        if(n > static_cast<uint64_t>(size - pos) / minValueSize){
+            throw NotEnoughDataException();
+        }
+        return static_cast<int>(n);
+    }
+
+    /**
+       This function reads a value of format version 2, which is written as the difference from
+       the code of the previous frame.
+    */
+    double readDeltaValue(int64_t& io_code, double precision){
+        uint64_t v = readVarint();
+        if(precision > 0.0){
+            io_code += static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); // zigzag
+            return io_code * precision;
+        } else {
+            uint32_t bits = static_cast<uint32_t>(v) ^ static_cast<uint32_t>(io_code);
+            io_code = bits;
+            float value;
+            memcpy(&value, &bits, sizeof(float));
+            return value;
+        }
+    }
+
     float readFloat(){
         ensureSize(sizeof(float));
         float value;
-        char* p = (char*)&value;
-        const int n = sizeof(float);
-        for(int i=0; i < n; ++i){
-            p[i] = data[pos++];
-        }
+        memcpy(&value, data + pos, sizeof(float));
+        pos += sizeof(float);
         return value;
     }
 
     SE3 readSE3(){
+        ensureSize(sizeof(float) * 7);
+        float v[7];
+        memcpy(v, data + pos, sizeof(v));
+        pos += sizeof(v);
         SE3 position;
-        Vector3& p = position.translation();
-        p.x() = readFloat();
-        p.y() = readFloat();
-        p.z() = readFloat();
+        position.translation() << v[0], v[1], v[2];
         Quaternion& q = position.rotation();
-        q.w() = readFloat();
-        q.x() = readFloat();
-        q.y() = readFloat();
-        q.z() = readFloat();
+        q.w() = v[3];
+        q.x() = v[4];
+        q.y() = v[5];
+        q.z() = v[6];
         return position;
     }
 
@@ -174,129 +202,13 @@ public:
         ensureSize(2);
         const int size = (unsigned int)readShort();
         ensureSize(size);
-        std::string str;
-        str.reserve(size);
-        for(int i=0; i < size; ++i){
-            str.append(1, data[pos++]);
-        }
+        std::string str(data + pos, size);
+        pos += size;
         return str;
     }
 };
 
 
-class WriteBuf
-{
-public:
-    vector<char> data;
-    ofstream& ofs;
-    size_t seekOffset;
-
-    WriteBuf(ofstream& ofs)
-        : ofs(ofs) {
-        seekOffset = 0;
-    }
-    
-    char* buf() {
-        return &data.front();
-    }
-
-    size_t pos() {
-        return data.size();
-    }
-
-    size_t seekPos() {
-        return seekOffset + data.size();
-    }
-
-    void clear(){
-        data.clear();
-        seekOffset = ofs.tellp();
-    }
-
-    int size() const {
-        return data.size();
-    }
-
-    void flush(){
-        ofs.write(&data.front(), data.size());
-        ofs.flush();
-        clear();
-    }
-        
-    void writeID(DataTypeID id){
-        writeOctet((char)id);
-    }
-
-    void writeBool(bool value){
-        data.push_back(value);
-    }
-
-    void writeOctet(char value){
-        data.push_back(value);
-    }
-
-    void writeShort(short value){
-        data.push_back(value & 0xff);
-        data.push_back(value >> 8);
-    }
-
-    void writeInt(int value){
-        data.push_back(value & 0xff);
-        data.push_back((value >> 8) & 0xff);
-        data.push_back((value >> 16) & 0xff);
-        data.push_back((value >> 24) & 0xff);
-    }
-
-    void writeInt(int pos, int value){
-        data[pos++] = value & 0xff;
-        data[pos++] = (value >> 8) & 0xff;
-        data[pos++] = (value >> 16) & 0xff;
-        data[pos++] = (value >> 24) & 0xff;
-    }
-
-    void writeSeekPos(int pos){
-        writeInt(pos);
-    }
-
-    void writeSeekOffset(int offset){
-        writeInt(offset);
-    }
-
-    void writeSeekOffset(int pos, int offset){
-        writeInt(pos, offset);
-    }
-    
-    void writeFloat(float value){
-        char* p = (char*)&value;
-        const int n = sizeof(float);
-        for(int i=0; i < n; ++i){
-            data.push_back(p[i]);
-        }
-    }
-
-    void writeSE3(const SE3& position){
-        const Vector3& p = position.translation();
-        writeFloat(p.x());
-        writeFloat(p.y());
-        writeFloat(p.z());
-        const Quaternion& q = position.rotation();
-        writeFloat(q.w());
-        writeFloat(q.x());
-        writeFloat(q.y());
-        writeFloat(q.z());
-    }
-
-    void writeString(const std::string& str){
-        const int size = str.size();
-        data.reserve(data.size() + size + 1);
-        writeShort((unsigned char)size);
-        for(int i=0; i < size; ++i){
-            writeOctet(str[i]);
-        }
-    }
-};
-
-
 class DeviceInfo {
 public:
     size_t lastStateSeekPos;
@@ -336,6 +248,27 @@ public:
 typedef ref_ptr<BodyInfo> BodyInfoPtr;
 
 
+//! The state of a body decoded from the frames of a block in format version 2
+class DecodedBodyState
+{
+public:
+    // The flags of the joints quantized with the position precision
+    vector<bool> linearJointFlags;
+    vector<int64_t> linkCodes;
+    vector<double> linkValues;
+    vector<int64_t> jointCodes;
+    vector<double> jointValues;
+    int numLinks;
+    int numJoints;
+    struct DecodedDeviceState {
+        vector<double> values;
+        size_t id;
+    };
+    vector<DecodedDeviceState> deviceStates;
+    int numDevices;
+};
+
+
 ItemList<BodyItem>::iterator findItemOfName(ItemList<BodyItem>& items, const std::string& name)
 {
     for(ItemList<BodyItem>::iterator p = items.begin(); p != items.end(); ++p){
@@ -380,36 +313,33 @@ public:
     bool isTimeStampSuffixEnabled;
     vector<string> bodyNames;
     
-    ofstream ofs;
-    WriteBuf writeBuf;
-    int lastOutputFramePos;
+    WorldLogFileWriter writer;
     double recordingFrameRate;
-    stack<int> sizeHeaderStack;
-
-    // for device state recording and playback
-    struct DeviceStateCache : public Referenced {
-        DeviceStatePtr state;
-        int seekPos;
-    };
-    typedef ref_ptr<DeviceStateCache> DeviceStateCachePtr;
-    
-    vector<DeviceStateCachePtr> deviceStateCacheArrays[2];
-    vector<DeviceStateCachePtr>* pLastDeviceStateCacheArray;
-    vector<DeviceStateCachePtr>* pCurrentDeviceStateCacheArray;
-    int deviceIndex;
-    int numDeviceStateCaches;
-    int currentDeviceStateCacheArrayIndex;
-    vector<double> doubleWriteBuf;
-
-    ifstream ifs;
+    bool isCompressedRecordingEnabled;
+    int recordingKeyframeInterval;
+    double recordingPositionPrecision;
+    double recordingAnglePrecision;
+
+    MappedFile mappedFile;
+    WorldLogFileIndex frameIndex;
+    size_t firstFramePos;
+    size_t indexedDataEndPos;
     ReadBuf readBuf;
-    ReadBuf readBuf2;
-    int currentReadFramePos;
-    int currentReadFrameDataSize;
-    int prevReadFrameOffset;
-    double currentReadFrameTime;
-    bool isCurrentFrameDataLoaded;
+    size_t currentFrameDataPos;
     bool isOverRange;
+
+    // Format version 2
+    int formatVersion;
+    double positionPrecision;
+    double anglePrecision;
+    size_t currentBlockPos;
+    int currentFrameInBlock;
+    size_t decodedBlockPos;
+    int decodedFrameInBlock;
+    vector<unsigned char> blockData;
+    ReadBuf blockReadBuf;
+    vector<DecodedBodyState> decodedBodyStates;
+    size_t decodedDeviceStateCounter;
         
     vector<BodyInfoPtr> bodyInfos;
     ScopedConnection worldSubTreeChangedConnection;
@@ -423,24 +353,23 @@ public:
     void updateBodyInfos();
     void onWorldSubTreeChanged();
     bool readTopHeader();
-    bool readFrameHeader(int pos);
+    bool readFrameUnitHeader(size_t pos, size_t& out_nextPos, vector<float>& out_times);
+    void loadFrameIndex(const string& filename);
+    bool updateFrameIndex();
     bool seek(double time);
     bool recallStateAtTime(double time);
-    bool loadCurrentFrameData();
-    void readBodyStatees();
     void readBodyState(BodyInfo* bodyInfo, double time);
     int readLinkPositions(Body* body);
     int readJointPositions(Body* body);
     void readDeviceStates(BodyInfo* bodyInfo, double time);
-    void readDeviceState(DeviceInfo& devInfo, Device* device, ReadBuf& buf, int size);
+    bool readDeviceState(DeviceInfo& devInfo, Device* device, ReadBuf& buf, int size);
     void readLastDeviceState(DeviceInfo& devInfo, Device* device);
+    bool recallStateOfBlockFrame(double time);
+    bool loadBlock(size_t pos);
+    void decodeNextBlockFrame(bool isKeyframe);
+    void decodeBodyState(DecodedBodyState& state, bool isKeyframe);
+    void applyDecodedBodyState(BodyInfo* bodyInfo, DecodedBodyState& state, double time);
     void clearOutput();
-    void reserveSizeHeader();
-    void fixSizeHeader();
-    void endHeaderOutput();
-    void beginFrameOutput(double time);
-    void outputDeviceState(DeviceState* state);
-    void exchangeDeviceStateCacheArrays();
 };
 
 }
@@ -468,13 +397,20 @@ WorldLogFileItem::WorldLogFileItem()
 
 
 WorldLogFileItemImpl::WorldLogFileItemImpl(WorldLogFileItem* self)
-    : self(self),
-      writeBuf(ofs),
-      readBuf(ifs),
-      readBuf2(ifs)
+    : self(self)
 {
     isTimeStampSuffixEnabled = false;
+    firstFramePos = 0;
+    indexedDataEndPos = 0;
+    formatVersion = 1;
+    decodedBlockPos = 0;
+    decodedFrameInBlock = -1;
+    decodedDeviceStateCounter = 0;
     recordingFrameRate = 0.0;
+    isCompressedRecordingEnabled = false;
+    recordingKeyframeInterval = 100;
+    recordingPositionPrecision = 0.0;
+    recordingAnglePrecision = 0.0;
     isBodyInfoUpdateNeeded = true;
 }
 
@@ -487,13 +423,20 @@ WorldLogFileItem::WorldLogFileItem(const WorldLogFileItem& org)
 
 
 WorldLogFileItemImpl::WorldLogFileItemImpl(WorldLogFileItem* self, WorldLogFileItemImpl& org)
-    : self(self),
-      writeBuf(ofs),
-      readBuf(ifs),
-      readBuf2(ifs)
+    : self(self)
 {
     isTimeStampSuffixEnabled = org.isTimeStampSuffixEnabled;
+    firstFramePos = 0;
+    indexedDataEndPos = 0;
+    formatVersion = 1;
+    decodedBlockPos = 0;
+    decodedFrameInBlock = -1;
+    decodedDeviceStateCounter = 0;
     recordingFrameRate = org.recordingFrameRate;
+    isCompressedRecordingEnabled = org.isCompressedRecordingEnabled;
+    recordingKeyframeInterval = org.recordingKeyframeInterval;
+    recordingPositionPrecision = org.recordingPositionPrecision;
+    recordingAnglePrecision = org.recordingAnglePrecision;
     isBodyInfoUpdateNeeded = true;
 }
 
@@ -611,123 +554,231 @@ void WorldLogFileItemImpl::onWorldSubTreeChanged()
 
 bool WorldLogFileItemImpl::readTopHeader()
 {
-    bool result = false;
-    
     bodyNames.clear();
-
-    currentReadFramePos = 0;
-    currentReadFrameDataSize = 0;
-    prevReadFrameOffset = 0;
-    currentReadFrameTime = -1.0;
-    
-    if(ifs.is_open()){
-        ifs.close();
-    }
-    string fname = fromUTF8(getActualFilename());
-    if(stdx::filesystem::exists(fname)){
-        ifs.open(fname.c_str(), ios::in | ios::binary);
-        if(ifs.is_open()){
-            readBuf.clear();
-            try {
-                int headerSize = readBuf.readSeekOffset();
-                if(readBuf.checkSize(headerSize)){
-                    while(!readBuf.isEnd()){
-                        bodyNames.push_back(readBuf.readString());
+    decodedBodyStates.clear();
+    frameIndex.clear();
+    firstFramePos = 0;
+    indexedDataEndPos = 0;
+
+    formatVersion = 1;
+    positionPrecision = 0.0;
+    anglePrecision = 0.0;
+    decodedBlockPos = 0;
+    decodedFrameInBlock = -1;
+
+    string fname = getActualFilename();
+    if(mappedFile.open(fname)){
+        try {
+            ReadBuf buf(mappedFile.data(), mappedFile.size());
+            int headerSize = buf.readSeekOffset();
+            if(headerSize == Version2Marker){
+                formatVersion = 2;
+                headerSize = buf.readSeekOffset();
+            }
+            buf.ensureSize(headerSize);
+            ReadBuf header(buf.data + buf.pos, headerSize);
+            if(formatVersion == 2){
+                positionPrecision = header.readFloat();
+                anglePrecision = header.readFloat();
+                header.readInt(); // keyframe interval
+            }
+            while(!header.isEnd()){
+                bodyNames.push_back(header.readString());
+                if(formatVersion == 2){
+                    // The indices of the prismatic joints follow the body name
+                    decodedBodyStates.emplace_back();
+                    auto& flags = decodedBodyStates.back().linearJointFlags;
+                    const int n = header.readInt();
+                    if(n < 0 || n > (header.size - header.pos) / static_cast<int>(sizeof(int))){
+                        throw NotEnoughDataException();
+                    }
+                    for(int i=0; i < n; ++i){
+                        // The number of the joints is limited to the range of short as in format version 1
+                        const int index = header.readInt();
+                        if(index < 0 || index >= std::numeric_limits<short>::max()){
+                            throw NotEnoughDataException();
+                        }
+                        if(index >= static_cast<int>(flags.size())){
+                            flags.resize(index + 1, false);
+                        }
+                        flags[index] = true;
                     }
-                    currentReadFramePos = readBuf.pos;
-                    result = readFrameHeader(readBuf.pos);
                 }
-            } catch(NotEnoughDataException& ex){
-                bodyNames.clear();
             }
+            firstFramePos = buf.pos + headerSize;
+            loadFrameIndex(fname);
+        } catch(NotEnoughDataException& ex){
+            bodyNames.clear();
+            mappedFile.close();
         }
     }
 
     isBodyInfoUpdateNeeded = true;
 
-    return result;
+    return !frameIndex.empty();
 }
 
 
-bool WorldLogFileItemImpl::readFrameHeader(int pos)
+/**
+   The index in the sidecar file is used if it is consistent with the log file. Otherwise the index
+   is built by scanning the frame headers, which is the case of the log files recorded before the
+   index was introduced, and it is saved to the sidecar file so that it can be used next time.
+*/
+void WorldLogFileItemImpl::loadFrameIndex(const string& filename)
 {
-    isCurrentFrameDataLoaded = false;
+    bool isValid = false;
+    // The size and the modification time of the log file are checked in loading the index
+    if(frameIndex.load(filename) && !frameIndex.empty()){
+        // Check the last frame header to confirm that the index matches the frames
+        const size_t pos = frameIndex.back().pos;
+        size_t nextPos;
+        vector<float> times;
+        if(pos >= firstFramePos && readFrameUnitHeader(pos, nextPos, times)){
+            if(times.back() == static_cast<float>(frameIndex.back().time)){
+                indexedDataEndPos = nextPos;
+                isValid = true;
+            }
+        }
+    }
+    if(!isValid){
+        frameIndex.clear();
+        indexedDataEndPos = firstFramePos;
+    }
+
+    // The frames which are not covered by the index are appended
+    bool updated = updateFrameIndex();
     
-    if(!ifs.is_open()){
-        return false;
+    if(updated && indexedDataEndPos == mappedFile.size()){
+        frameIndex.save(filename, indexedDataEndPos);
     }
+}
 
-    ifs.seekg(pos);
 
-    if(ifs.eof()){
-        ifs.seekg(currentReadFramePos);
+/**
+   This function appends the frames which have been written since the index was updated last time,
+   so that the log file which is being recorded can also be played back.
+   
+   \return True if any frame is appended.
+*/
+bool WorldLogFileItemImpl::updateFrameIndex()
+{
+    if(!mappedFile.isOpen()){
         return false;
     }
-
-    readBuf.clear();
-    if(!readBuf.checkSize(frameHeaderSize)){
-        ifs.seekg(currentReadFramePos);
-        return false;
+    if(indexedDataEndPos >= mappedFile.size()){
+        mappedFile.updateMapping();
+    }
+    const int numFrames = frameIndex.numFrames();
+    size_t pos = indexedDataEndPos;
+    size_t nextPos;
+    vector<float> times;
+    while(readFrameUnitHeader(pos, nextPos, times)){
+        for(auto& time : times){
+            frameIndex.append(time, pos);
+        }
+        pos = nextPos;
     }
+    indexedDataEndPos = pos;
     
-    currentReadFramePos = pos;
-    prevReadFrameOffset = readBuf.readSeekOffset();
-    currentReadFrameTime = readBuf.readFloat();
-    currentReadFrameDataSize = readBuf.readSeekOffset();
+    return frameIndex.numFrames() > numFrames;
+}
+
 
+/**
+   The unit is a frame in format version 1 and a block of frames in format version 2.
+   
+   \return False if the unit is not completely written in the file.
+*/
+bool WorldLogFileItemImpl::readFrameUnitHeader(size_t pos, size_t& out_nextPos, vector<float>& out_times)
+{
+    const char* data = mappedFile.data();
+    const size_t fileSize = mappedFile.size();
+    out_times.clear();
+
+    if(formatVersion == 2){
+        if(pos + blockHeaderSize > fileSize){
+            return false;
+        }
+        ReadBuf header(data + pos, blockHeaderSize);
+        const int numFrames = header.readInt();
+        const int storedSize = header.readInt();
+        if(numFrames <= 0 || storedSize < 0){
+            return false;
+        }
+        const size_t timesPos = pos + blockHeaderSize;
+        out_nextPos = timesPos + sizeof(float) * numFrames + storedSize;
+        if(out_nextPos > fileSize){
+            return false;
+        }
+        ReadBuf timeBuf(data + timesPos, sizeof(float) * numFrames);
+        out_times.resize(numFrames);
+        for(int i=0; i < numFrames; ++i){
+            out_times[i] = timeBuf.readFloat();
+        }
+        return true;
+    }
+
+    if(pos + frameHeaderSize > fileSize){
+        return false;
+    }
+    ReadBuf header(data + pos, frameHeaderSize);
+    header.readSeekOffset();
+    float time = header.readFloat();
+    int dataSize = header.readSeekOffset();
+    out_nextPos = pos + frameHeaderSize + dataSize;
+    if(dataSize < 0 || out_nextPos > fileSize){
+        return false;
+    }
+    out_times.push_back(time);
     return true;
 }
         
-        
+
 bool WorldLogFileItemImpl::seek(double time)
 {
     isOverRange = false;
 
-    if(!readFrameHeader(currentReadFramePos)){
-        readTopHeader();
+    if(!mappedFile.isOpen()){
+        if(!readTopHeader()){
+            return false;
+        }
     }
-    
-    if(currentReadFrameTime == time){
-        return true;
+    if(frameIndex.empty() || time > frameIndex.back().time){
+        updateFrameIndex();
+        if(frameIndex.empty()){
+            return false;
+        }
     }
 
-    if(currentReadFrameTime < time){
-        while(true){
-            int pos = currentReadFramePos;
-            if(!readFrameHeader(currentReadFramePos + frameHeaderSize + currentReadFrameDataSize)){
-                isOverRange = true;
-                return (currentReadFrameTime >= 0.0);
-            }
-            if(currentReadFrameTime == time){
-                return true;
-            } else if(currentReadFrameTime > time){
-                return readFrameHeader(pos);
-            }
-        }
+    int index = frameIndex.findFrame(time);
+    if(index < 0){
+        index = 0;
+        isOverRange = true;
+    } else if(index == frameIndex.numFrames() - 1 && time > frameIndex.back().time){
+        isOverRange = true;
     }
 
-    // currentReadFrameTime > time
-    while(true){
-        if(prevReadFrameOffset <= 0){
-            isOverRange = true;
-            return (currentReadFrameTime >= 0.0);
-        }
-        if(!readFrameHeader(currentReadFramePos - prevReadFrameOffset)){
-            return false;
-        }
-        if(currentReadFrameTime <= time){
-            return true;
+    const size_t pos = frameIndex.entry(index).pos;
+
+    if(formatVersion == 2){
+        // The frames in a block share the same position
+        int firstIndex = index;
+        while(firstIndex > 0 && static_cast<size_t>(frameIndex.entry(firstIndex - 1).pos) == pos){
+            --firstIndex;
         }
+        currentBlockPos = pos;
+        currentFrameInBlock = index - firstIndex;
+        return true;
     }
-}
-
+    
+    ReadBuf header(mappedFile.data() + pos, frameHeaderSize);
+    header.readSeekOffset();
+    header.readFloat();
+    const int dataSize = header.readSeekOffset();
+    currentFrameDataPos = pos + frameHeaderSize;
+    readBuf = ReadBuf(mappedFile.data() + currentFrameDataPos, dataSize);
 
-bool WorldLogFileItemImpl::loadCurrentFrameData()
-{
-    ifs.seekg(currentReadFramePos + frameHeaderSize);
-    readBuf.clear();
-    isCurrentFrameDataLoaded = readBuf.checkSize(currentReadFrameDataSize);
-    return isCurrentFrameDataLoaded;
+    return true;
 }
 
 
@@ -747,39 +798,40 @@ bool WorldLogFileItemImpl::recallStateAtTime(double time)
         return false;
     }
 
-    if(!isCurrentFrameDataLoaded){
-        if(!loadCurrentFrameData()){
-            return false;
-        }
-    }
-    readBuf.seek(0);
-
     if(isBodyInfoUpdateNeeded){
         updateBodyInfos();
     }
-    
-    int bodyIndex = 0;
-    while(!readBuf.isEnd()){
-        int dataTypeID = readBuf.readID();
-        switch(dataTypeID){
-        case BODY_STATE:
-        {
-            BodyInfo* bodyInfo = nullptr;
-            if(bodyIndex < static_cast<int>(bodyInfos.size())){
-                bodyInfo = bodyInfos[bodyIndex];
+
+    if(formatVersion == 2){
+        return recallStateOfBlockFrame(time) && !isOverRange;
+    }
+
+    try {
+        int bodyIndex = 0;
+        while(!readBuf.isEnd()){
+            int dataTypeID = readBuf.readID();
+            switch(dataTypeID){
+            case BODY_STATE:
+            {
+                BodyInfo* bodyInfo = nullptr;
+                if(bodyIndex < static_cast<int>(bodyInfos.size())){
+                    bodyInfo = bodyInfos[bodyIndex];
+                }
+                if(bodyInfo){
+                    readBodyState(bodyInfo, time);
+                } else {
+                    readBuf.seekToNextBlock();
+                }
+                ++bodyIndex;
+                break;
             }
-            if(bodyInfo){
-                readBodyState(bodyInfo, time);
-            } else {
+
+            default:
                 readBuf.seekToNextBlock();
             }
-            ++bodyIndex;
-            break;
-        }
-
-        default:
-            readBuf.seekToNextBlock();
         }
+    } catch(NotEnoughDataException& ex){
+        return false;
     }
 
     return !isOverRange;
@@ -866,13 +918,16 @@ void WorldLogFileItemImpl::readDeviceStates(BodyInfo* bodyInfo, double time)
     while(readBuf.pos < endPos && deviceIndex < numDevices){
         DeviceInfo& devInfo = bodyInfo->deviceInfo(deviceIndex);
         Device* device = bodyInfo->body->device(deviceIndex);
+        const size_t statePos = currentFrameDataPos + readBuf.pos;
         const int header = readBuf.readShort();
         if(header < 0){
             readLastDeviceState(devInfo, device);
         } else {
             const int size = header;
             int nextPos = readBuf.pos + sizeof(float) * size;
-            readDeviceState(devInfo, device, readBuf, size);
+            if(readDeviceState(devInfo, device, readBuf, size)){
+                devInfo.lastStateSeekPos = statePos;
+            }
             readBuf.seek(nextPos);
         }
         device->notifyTimeChange(time);
@@ -882,7 +937,7 @@ void WorldLogFileItemImpl::readDeviceStates(BodyInfo* bodyInfo, double time)
 }
 
 
-void WorldLogFileItemImpl::readDeviceState(DeviceInfo& devInfo, Device* device, ReadBuf& buf, int size)
+bool WorldLogFileItemImpl::readDeviceState(DeviceInfo& devInfo, Device* device, ReadBuf& buf, int size)
 {
     const int stateSize = device->stateSize();
     if(stateSize <= size){
@@ -894,31 +949,255 @@ void WorldLogFileItemImpl::readDeviceState(DeviceInfo& devInfo, Device* device,
         device->readState(&state.front());
         device->notifyStateChange();
         devInfo.isConsistent = true;
+        return true;
     }
+    return false;
 }
 
 
 void WorldLogFileItemImpl::readLastDeviceState(DeviceInfo& devInfo, Device* device)
 {
-    size_t pos = readBuf.readSeekOffset();
+    // The position is read as an unsigned value to refer to the data beyond 2GB
+    size_t pos = static_cast<uint32_t>(readBuf.readSeekOffset());
     if(pos == devInfo.lastStateSeekPos){
         if(!devInfo.isConsistent){
             device->readState(&devInfo.lastState.front());
             device->notifyStateChange();
             devInfo.isConsistent = true;
         }
-    } else {
-        ifs.seekg(pos);
+    } else if(pos < mappedFile.size()){
         devInfo.lastStateSeekPos = pos;
-        readBuf2.clear();
-        int size = readBuf2.readShort();
+        ReadBuf buf(mappedFile.data() + pos, mappedFile.size() - pos);
+        int size = buf.readShort();
         if(size > 0){
-            readDeviceState(devInfo, device, readBuf2, size);
+            readDeviceState(devInfo, device, buf, size);
+        }
+    }
+}
+
+
+/**
+   The frames of a block are decoded in order from the keyframe. The decoded state is kept so that
+   the following frames in the same block can be decoded incrementally in the forward playback.
+*/
+bool WorldLogFileItemImpl::recallStateOfBlockFrame(double time)
+{
+    try {
+        if(decodedBlockPos != currentBlockPos || decodedFrameInBlock > currentFrameInBlock){
+            if(decodedBlockPos != currentBlockPos){
+                decodedBlockPos = 0;
+                if(!loadBlock(currentBlockPos)){
+                    return false;
+                }
+            }
+            blockReadBuf.seek(0);
+            decodedFrameInBlock = -1;
+            decodedBlockPos = currentBlockPos;
+        }
+        while(decodedFrameInBlock < currentFrameInBlock){
+            decodeNextBlockFrame(decodedFrameInBlock < 0);
+            ++decodedFrameInBlock;
+        }
+    } catch(NotEnoughDataException& ex){
+        decodedBlockPos = 0;
+        return false;
+    }
+
+    const int n = std::min(bodyInfos.size(), decodedBodyStates.size());
+    for(int i=0; i < n; ++i){
+        if(auto bodyInfo = bodyInfos[i]){
+            applyDecodedBodyState(bodyInfo, decodedBodyStates[i], time);
+        }
+    }
+    
+    return true;
+}
+
+
+bool WorldLogFileItemImpl::loadBlock(size_t pos)
+{
+    const size_t fileSize = mappedFile.size();
+    if(pos < firstFramePos || pos + blockHeaderSize > fileSize){
+        return false;
+    }
+    ReadBuf header(mappedFile.data() + pos, blockHeaderSize);
+    const int numFrames = header.readInt();
+    const int storedSize = header.readInt();
+    const int uncompressedSize = header.readInt();
+    if(numFrames <= 0 || storedSize < 0 || uncompressedSize < 0){
+        return false;
+    }
+    const size_t storedDataPos = pos + blockHeaderSize + sizeof(float) * numFrames;
+    if(storedDataPos + storedSize > fileSize){
+        return false;
+    }
+    const char* storedData = mappedFile.data() + storedDataPos;
+
+    // The data is copied even if it is not compressed because the file may be remapped
+    if(uncompressedSize == 0){
+        blockData.assign(storedData, storedData + storedSize);
+    } else {
+        blockData.resize(uncompressedSize);
+        uLongf size = uncompressedSize;
+        if(uncompress(blockData.data(), &size, reinterpret_cast<const Bytef*>(storedData), storedSize) != Z_OK ||
+           static_cast<int>(size) != uncompressedSize){
+            return false;
+        }
+    }
+    blockReadBuf = ReadBuf(reinterpret_cast<const char*>(blockData.data()), blockData.size());
+    return true;
+}
+
+
+void WorldLogFileItemImpl::decodeNextBlockFrame(bool isKeyframe)
+{
+    int bodyIndex = 0;
+    while(true){
+        int id = blockReadBuf.readID();
+        if(id == END_OF_FRAME){
+            break;
+        } else if(id != BODY_STATE){
+            throw NotEnoughDataException();
+        }
+        if(bodyIndex >= static_cast<int>(decodedBodyStates.size())){
+            decodedBodyStates.resize(bodyIndex + 1);
+        }
+        decodeBodyState(decodedBodyStates[bodyIndex++], isKeyframe);
+    }
+}
+
+
+void WorldLogFileItemImpl::decodeBodyState(DecodedBodyState& state, bool isKeyframe)
+{
+    auto& buf = blockReadBuf;
+    
+    if(isKeyframe){
+        state.linkCodes.clear();
+        state.jointCodes.clear();
+    }
+    state.numLinks = 0;
+    state.numJoints = 0;
+    state.numDevices = 0;
+    
+    while(true){
+        int id = buf.readID();
+        switch(id){
+        case LINK_POSITIONS:
+        {
+            const int n = buf.readCount(7);
+            state.linkCodes.resize(n * 7, 0);
+            state.linkValues.resize(n * 7);
+            int64_t* codes = state.linkCodes.data();
+            double* values = state.linkValues.data();
+            for(int i=0; i < n * 7; i += 7){
+                for(int j=0; j < 3; ++j){
+                    values[i + j] = buf.readDeltaValue(codes[i + j], positionPrecision);
+                }
+                for(int j=3; j < 7; ++j){
+                    values[i + j] = buf.readDeltaValue(codes[i + j], anglePrecision);
+                }
+            }
+            state.numLinks = n;
+            break;
+        }
+        case JOINT_POSITIONS:
+        {
+            const int n = buf.readCount(1);
+            state.jointCodes.resize(n, 0);
+            state.jointValues.resize(n);
+            const auto& linearFlags = state.linearJointFlags;
+            for(int i=0; i < n; ++i){
+                bool isLinear = (i < static_cast<int>(linearFlags.size())) && linearFlags[i];
+                state.jointValues[i] =
+                    buf.readDeltaValue(state.jointCodes[i], isLinear ? positionPrecision : anglePrecision);
+            }
+            state.numJoints = n;
+            break;
+        }
+        case DEVICE_STATES:
+        {
+            int deviceIndex = 0;
+            while(int header = buf.readVarint()){
+                if(deviceIndex >= static_cast<int>(state.deviceStates.size())){
+                    state.deviceStates.resize(deviceIndex + 1);
+                }
+                auto& deviceState = state.deviceStates[deviceIndex++];
+                if(header >= 2){
+                    const int size = header - 2;
+                    if(size > (buf.size - buf.pos) / static_cast<int>(sizeof(float))){
+                        throw NotEnoughDataException();
+                    }
+                    deviceState.values.resize(size);
+                    for(int i=0; i < size; ++i){
+                        deviceState.values[i] = buf.readFloat();
+                    }
+                    // The ID is used to check if the device has already been updated with the state
+                    deviceState.id = ++decodedDeviceStateCounter;
+                }
+            }
+            state.numDevices = deviceIndex;
+            break;
+        }
+        case END_OF_BODY_STATE:
+            return;
+        default:
+            throw NotEnoughDataException();
         }
     }
 }
 
 
+void WorldLogFileItemImpl::applyDecodedBodyState(BodyInfo* bodyInfo, DecodedBodyState& state, double time)
+{
+    Body* body = bodyInfo->body;
+    bool updated = false;
+    bool doForwardKinematics = true;
+
+    if(state.numLinks > 0){
+        const int n = std::min(state.numLinks, body->numLinks());
+        const double* v = state.linkValues.data();
+        for(int i=0; i < n; ++i){
+            Link* link = body->link(i);
+            link->p() << v[0], v[1], v[2];
+            link->R() = Quaternion(v[3], v[4], v[5], v[6]).normalized().toRotationMatrix();
+            v += 7;
+        }
+        updated = true;
+        if(n > 1){
+            doForwardKinematics = false;
+        }
+    }
+    if(state.numJoints > 0){
+        const int n = std::min(state.numJoints, body->numAllJoints());
+        for(int i=0; i < n; ++i){
+            body->joint(i)->q() = state.jointValues[i];
+        }
+        updated = true;
+    }
+    if(updated){
+        bodyInfo->bodyItem->notifyKinematicStateChange(doForwardKinematics);
+    }
+
+    const int numDevices = std::min(state.numDevices, body->numDevices());
+    for(int i=0; i < numDevices; ++i){
+        auto& deviceState = state.deviceStates[i];
+        DeviceInfo& devInfo = bodyInfo->deviceInfo(i);
+        Device* device = body->device(i);
+        if(deviceState.id != devInfo.lastStateSeekPos || !devInfo.isConsistent){
+            const int stateSize = device->stateSize();
+            if(stateSize <= static_cast<int>(deviceState.values.size())){
+                devInfo.lastState.assign(deviceState.values.begin(), deviceState.values.begin() + stateSize);
+                device->readState(&devInfo.lastState.front());
+                device->notifyStateChange();
+                devInfo.isConsistent = true;
+            }
+            devInfo.lastStateSeekPos = deviceState.id;
+        }
+        device->notifyTimeChange(time);
+    }
+}
+
+
 void WorldLogFileItem::invalidateLastStateConsistency()
 {
     vector<BodyInfoPtr>& bodyInfos = impl->bodyInfos;
@@ -941,43 +1220,27 @@ void WorldLogFileItemImpl::clearOutput()
 {
     bodyNames.clear();
 
-    if(ifs.is_open()){
-        ifs.close();
-    }
-    if(ofs.is_open()){
-        ofs.close();
-    }
-    recordingStartTime = QDateTime::currentDateTime();
-    
-    ofs.open(fromUTF8(getActualFilename()).c_str(), ios::out | ios::binary | ios::trunc);
-    writeBuf.clear();
-    lastOutputFramePos = 0;
-
-    currentDeviceStateCacheArrayIndex = 0;
-    exchangeDeviceStateCacheArrays();
-}
-
-
-void WorldLogFileItemImpl::reserveSizeHeader()
-{
-    sizeHeaderStack.push(writeBuf.size());
-    writeBuf.writeSeekOffset(0);
-}
+    // The mapping must be released before the file is truncated
+    mappedFile.close();
+    frameIndex.clear();
 
+    // The index of the previous log must not be used for the new log
+    string filename = getActualFilename();
+    std::remove(fromUTF8(WorldLogFileIndex::indexFilename(filename)).c_str());
+    
+    recordingStartTime = QDateTime::currentDateTime();
 
-void WorldLogFileItemImpl::fixSizeHeader()
-{
-    if(!sizeHeaderStack.empty()){
-        writeBuf.writeSeekOffset(sizeHeaderStack.top(), writeBuf.size() - (sizeHeaderStack.top() + sizeof(int)));
-        sizeHeaderStack.pop();
-    }
+    writer.setFormatVersion(isCompressedRecordingEnabled ? 2 : 1);
+    writer.setKeyframeInterval(recordingKeyframeInterval);
+    writer.setQuantizationPrecision(recordingPositionPrecision, recordingAnglePrecision);
+    
+    writer.open(filename);
 }
 
 
 void WorldLogFileItem::beginHeaderOutput()
 {
-    impl->writeBuf.clear();
-    impl->reserveSizeHeader();
+    impl->writer.beginHeaderOutput();
 }
 
 
@@ -985,21 +1248,23 @@ int WorldLogFileItem::outputBodyHeader(const std::string& name)
 {
     int index = impl->bodyNames.size();
     impl->bodyNames.push_back(name);
-    impl->writeBuf.writeString(name);
+    impl->writer.outputBodyHeader(name);
     return index;
 }
 
 
-void WorldLogFileItem::endHeaderOutput()
+int WorldLogFileItem::outputBodyHeader(const Body* body)
 {
-    impl->endHeaderOutput();
+    int index = impl->bodyNames.size();
+    impl->bodyNames.push_back(body->name());
+    impl->writer.outputBodyHeader(body);
+    return index;
 }
 
 
-void WorldLogFileItemImpl::endHeaderOutput()
+void WorldLogFileItem::endHeaderOutput()
 {
-    fixSizeHeader();
-    writeBuf.flush();
+    impl->writer.endHeaderOutput();
 }
 
 
@@ -1017,132 +1282,61 @@ const std::string& WorldLogFileItem::bodyName(int bodyIndex) const
 
 void WorldLogFileItem::beginFrameOutput(double time)
 {
-    impl->beginFrameOutput(time);
-}
-
-
-void WorldLogFileItemImpl::beginFrameOutput(double time)
-{
-    size_t pos = writeBuf.seekPos();
-    
-    if(lastOutputFramePos){
-        writeBuf.writeSeekOffset(pos - lastOutputFramePos);
-    } else {
-        writeBuf.writeSeekOffset(0);
-    }
-    lastOutputFramePos = pos;
-    
-    deviceIndex = 0;
-    writeBuf.writeFloat(time);
-    reserveSizeHeader(); // area for the frame data size
+    impl->writer.beginFrameOutput(time);
 }
 
 
 void WorldLogFileItem::beginBodyStateOutput()
 {
-    impl->writeBuf.writeID(BODY_STATE);
-    impl->reserveSizeHeader();
+    impl->writer.beginBodyStateOutput();
 }
 
 
 void WorldLogFileItem::outputLinkPositions(SE3* positions, int size)
 {
-    impl->writeBuf.writeID(LINK_POSITIONS);
-    impl->reserveSizeHeader();
-    impl->writeBuf.writeShort(size);
-    for(int i=0; i < size; ++i){
-        impl->writeBuf.writeSE3(positions[i]);
-    }
-    impl->fixSizeHeader();
+    impl->writer.outputLinkPositions(positions, size);
 }
 
 
 void WorldLogFileItem::outputJointPositions(double* values, int size)
 {
-    impl->writeBuf.writeID(JOINT_POSITIONS);
-    impl->reserveSizeHeader();
-    impl->writeBuf.writeShort(size);
-    for(int i=0; i < size; ++i){
-        impl->writeBuf.writeFloat(values[i]);
-    }
-    impl->fixSizeHeader();
+    impl->writer.outputJointPositions(values, size);
 }
 
 
 void WorldLogFileItem::beginDeviceStateOutput()
 {
-    impl->writeBuf.writeID(DEVICE_STATES);
-    impl->reserveSizeHeader();
+    impl->writer.beginDeviceStateOutput();
 }
 
 
 void WorldLogFileItem::outputDeviceState(DeviceState* state)
 {
-    impl->outputDeviceState(state);
-}
-
-
-void WorldLogFileItemImpl::outputDeviceState(DeviceState* state)
-{
-    DeviceStateCache* cache = nullptr;
-        
-    if(deviceIndex >= numDeviceStateCaches){
-        cache = new DeviceStateCache;
-    } else {
-        cache = (*pLastDeviceStateCacheArray)[deviceIndex];
-        if(state == cache->state){
-            writeBuf.writeShort(-1);
-            writeBuf.writeSeekOffset(cache->seekPos);
-            goto endOutputDeviceState;
-        }
-    }
-    cache->state = state;
-    cache->seekPos = writeBuf.seekPos();
-    if(!state){
-        writeBuf.writeShort(0);
-    } else {
-        int size = state->stateSize();
-        writeBuf.writeShort(size);
-        doubleWriteBuf.resize(size);
-        state->writeState(&doubleWriteBuf.front());
-        for(int i=0; i < size; ++i){
-            writeBuf.writeFloat(doubleWriteBuf[i]);
-        }
-    }
-endOutputDeviceState:
-
-    pCurrentDeviceStateCacheArray->push_back(cache);
-    ++deviceIndex;
+    impl->writer.outputDeviceState(state);
 }
 
 
 void WorldLogFileItem::endDeviceStateOutput()
 {
-    impl->fixSizeHeader();
+    impl->writer.endDeviceStateOutput();
 }
 
 
 void WorldLogFileItem::endBodyStateOutput()
 {
-    impl->fixSizeHeader();
+    impl->writer.endBodyStateOutput();
 }
 
 
 void WorldLogFileItem::endFrameOutput()
 {
-    impl->fixSizeHeader();
-    impl->writeBuf.flush();
-    impl->exchangeDeviceStateCacheArrays();
+    impl->writer.endFrameOutput();
 }
 
 
-void WorldLogFileItemImpl::exchangeDeviceStateCacheArrays()
+void WorldLogFileItem::endOutput()
 {
-    int i = 1 - currentDeviceStateCacheArrayIndex;
-    pCurrentDeviceStateCacheArray = &deviceStateCacheArrays[i];
-    pLastDeviceStateCacheArray = &deviceStateCacheArrays[1-i];
-    numDeviceStateCaches = pLastDeviceStateCacheArray->size();
-    currentDeviceStateCacheArrayIndex = i;
+    impl->writer.close();
 }
     
 
@@ -1157,6 +1351,14 @@ void WorldLogFileItem::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(impl->isTimeStampSuffixEnabled));
     putProperty(_("Recording frame rate"), impl->recordingFrameRate,
                 changeProperty(impl->recordingFrameRate));
+    putProperty(_("Compressed format"), impl->isCompressedRecordingEnabled,
+                changeProperty(impl->isCompressedRecordingEnabled));
+    putProperty.min(1).max(65535)(_("Keyframe interval"), impl->recordingKeyframeInterval,
+                                  changeProperty(impl->recordingKeyframeInterval));
+    putProperty.min(0.0).decimals(6)(_("Position precision"), impl->recordingPositionPrecision,
+                                     changeProperty(impl->recordingPositionPrecision));
+    putProperty.min(0.0).decimals(6)(_("Angle precision"), impl->recordingAnglePrecision,
+                                     changeProperty(impl->recordingAnglePrecision));
 }
 
 
@@ -1166,6 +1368,10 @@ bool WorldLogFileItem::store(Archive& archive)
     archive.write("format", fileFormat());
     archive.write("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.write("recordingFrameRate", impl->recordingFrameRate);
+    archive.write("compressedFormat", impl->isCompressedRecordingEnabled);
+    archive.write("keyframeInterval", impl->recordingKeyframeInterval);
+    archive.write("positionPrecision", impl->recordingPositionPrecision);
+    archive.write("anglePrecision", impl->recordingAnglePrecision);
     return true;
 }
 
@@ -1174,6 +1380,10 @@ bool WorldLogFileItem::restore(const Archive& archive)
 {
     archive.read("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.read("recordingFrameRate", impl->recordingFrameRate);
+    archive.read("compressedFormat", impl->isCompressedRecordingEnabled);
+    archive.read("keyframeInterval", impl->recordingKeyframeInterval);
+    archive.read("positionPrecision", impl->recordingPositionPrecision);
+    archive.read("anglePrecision", impl->recordingAnglePrecision);
     
     std::string filename, formatId;
     if(archive.readRelocatablePath("filename", filename)){
@@ -12,6 +12,7 @@
 namespace cnoid {
 
 class SE3;
+class Body;
 class DeviceState;
 class WorldLogFileItemImpl;
 
@@ -32,6 +33,8 @@ public:
     void clearOutput();
     void beginHeaderOutput();
     int outputBodyHeader(const std::string& name);
+    //! The joint types of the body are also recorded so that the joints are quantized properly.
+    int outputBodyHeader(const Body* body);
     void endHeaderOutput();
     void beginFrameOutput(double time);
     void beginBodyStateOutput();
@@ -43,6 +46,9 @@ public:
     void endBodyStateOutput();
     void endFrameOutput();
 
+    //! This function closes the output file and writes the frame index of the log.
+    void endOutput();
+
     int numBodies() const;
     const std::string& bodyName(int bodyIndex) const;
 
@@ -201,7 +201,8 @@ AbstractMultiSeq::AbstractMultiSeq(const char* seqType)
 
 
 AbstractMultiSeq::AbstractMultiSeq(const AbstractMultiSeq& org)
-    : AbstractSeq(org)
+    : AbstractSeq(org),
+      partLabels_(org.partLabels_)
 {
 
 }
@@ -210,6 +211,7 @@ AbstractMultiSeq::AbstractMultiSeq(const AbstractMultiSeq& org)
 AbstractMultiSeq& AbstractMultiSeq::operator=(const AbstractMultiSeq& rhs)
 {
     AbstractSeq::operator=(rhs);
+    partLabels_ = rhs.partLabels_;
     return *this;
 }
 
@@ -217,6 +219,7 @@ AbstractMultiSeq& AbstractMultiSeq::operator=(const AbstractMultiSeq& rhs)
 void AbstractMultiSeq::copySeqProperties(const AbstractMultiSeq& source)
 {
     AbstractSeq::copySeqProperties(source);
+    partLabels_ = source.partLabels_;
 }
 
 
@@ -226,14 +229,24 @@ AbstractMultiSeq::~AbstractMultiSeq()
 }
 
 
-int AbstractMultiSeq::partIndex(const std::string& /* partLabel*/) const
+int AbstractMultiSeq::partIndex(const std::string& partLabel) const
 {
+    if(!partLabel.empty()){
+        for(size_t i=0; i < partLabels_.size(); ++i){
+            if(partLabels_[i] == partLabel){
+                return i;
+            }
+        }
+    }
     return -1;
 }
 
 
-const std::string& AbstractMultiSeq::partLabel(int /* partIndex */) const
+const std::string& AbstractMultiSeq::partLabel(int partIndex) const
 {
+    if(partIndex >= 0 && partIndex < static_cast<int>(partLabels_.size())){
+        return partLabels_[partIndex];
+    }
     static const std::string nolabel;
     return nolabel;
 }
@@ -118,10 +118,21 @@ public:
     virtual int partIndex(const std::string& partLabel) const;
     virtual const std::string& partLabel(int partIndex) const;
 
+    /**
+       The labels set by this function are returned by the default implementation of partLabel.
+       An empty vector clears the labels. The labels are also cleared when the number of parts is
+       changed by setDimension and when the frames are read from a YAML archive.
+    */
+    void setPartLabels(const std::vector<std::string>& labels) { partLabels_ = labels; }
+    void clearPartLabels() { partLabels_.clear(); }
+
 protected:
     virtual bool doWriteSeq(YAMLWriter& writer, std::function<void()> additionalPartCallback);
     std::vector<std::string> readSeqPartLabels(const Mapping& archive);
     bool writeSeqPartLabels(YAMLWriter& writer);
+
+private:
+    std::vector<std::string> partLabels_;
 };
 
 #ifdef CNOID_BACKWARD_COMPATIBILITY
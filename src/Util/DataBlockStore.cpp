@@ -0,0 +1,226 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "DataBlockStore.h"
+#include <mutex>
+#include <cstdio>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct Chunk
+{
+    FILE* file;
+    size_t size;
+    int numBlocks;
+};
+
+}
+
+namespace cnoid {
+
+class DataBlockStore::Impl
+{
+public:
+    mutable std::mutex mutex;
+    std::list<Block*> memoryBlocks;
+    size_t memorySize;
+    size_t maxMemorySize;
+    size_t chunkSize;
+    size_t fileSize;
+    vector<Chunk> chunks;
+    int currentChunkIndex;
+    bool isFileUnavailable;
+
+    Impl();
+    ~Impl();
+    void reduceMemoryBlocks();
+    bool moveToChunk(Block* block);
+    void releaseBlock(Block* block);
+    bool readBlock(const Block* block, vector<unsigned char>& out_data);
+};
+
+}
+
+
+DataBlockStore::Block::Block(DataBlockStore* store, std::vector<unsigned char>&& data)
+    : store(store),
+      data(std::move(data)),
+      chunkIndex(-1),
+      offset(0)
+{
+    size_ = this->data.size();
+}
+
+
+DataBlockStore::Block::~Block()
+{
+    store->impl->releaseBlock(this);
+}
+
+
+bool DataBlockStore::Block::isInMemory() const
+{
+    std::lock_guard<std::mutex> lock(store->impl->mutex);
+    return chunkIndex < 0;
+}
+
+
+bool DataBlockStore::Block::read(std::vector<unsigned char>& out_data) const
+{
+    return store->impl->readBlock(this, out_data);
+}
+
+
+DataBlockStore::DataBlockStore()
+{
+    impl = new Impl;
+}
+
+
+DataBlockStore::Impl::Impl()
+{
+    memorySize = 0;
+    maxMemorySize = 512 * 1024 * 1024;
+    chunkSize = 256 * 1024 * 1024;
+    fileSize = 0;
+    currentChunkIndex = -1;
+    isFileUnavailable = false;
+}
+
+
+DataBlockStore::~DataBlockStore()
+{
+    delete impl;
+}
+
+
+DataBlockStore::Impl::~Impl()
+{
+    for(auto& chunk : chunks){
+        if(chunk.file){
+            fclose(chunk.file);
+        }
+    }
+}
+
+
+void DataBlockStore::setMaxMemorySize(size_t size)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->maxMemorySize = size;
+    impl->reduceMemoryBlocks();
+}
+
+
+void DataBlockStore::setChunkSize(size_t size)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->chunkSize = size;
+}
+
+
+DataBlockStore::BlockPtr DataBlockStore::store(std::vector<unsigned char>&& data)
+{
+    BlockPtr block = new Block(this, std::move(data));
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    block->memoryBlockIter = impl->memoryBlocks.insert(impl->memoryBlocks.end(), block);
+    impl->memorySize += block->size_;
+    impl->reduceMemoryBlocks();
+    return block;
+}
+
+
+void DataBlockStore::Impl::reduceMemoryBlocks()
+{
+    while(memorySize > maxMemorySize && !memoryBlocks.empty() && !isFileUnavailable){
+        Block* block = memoryBlocks.front();
+        if(!moveToChunk(block)){
+            isFileUnavailable = true;
+            break;
+        }
+        memoryBlocks.pop_front();
+        memorySize -= block->size_;
+        vector<unsigned char>().swap(block->data);
+    }
+}
+
+
+bool DataBlockStore::Impl::moveToChunk(Block* block)
+{
+    if(currentChunkIndex < 0 || chunks[currentChunkIndex].size >= chunkSize){
+        FILE* file = tmpfile();
+        if(!file){
+            return false;
+        }
+        if(currentChunkIndex >= 0 && chunks[currentChunkIndex].numBlocks == 0){
+            fclose(chunks[currentChunkIndex].file);
+            chunks[currentChunkIndex].file = nullptr;
+        }
+        currentChunkIndex = chunks.size();
+        chunks.push_back({ file, 0, 0 });
+    }
+    auto& chunk = chunks[currentChunkIndex];
+    if(fseek(chunk.file, chunk.size, SEEK_SET) != 0){
+        return false;
+    }
+    if(fwrite(block->data.data(), 1, block->size_, chunk.file) != block->size_){
+        return false;
+    }
+    block->chunkIndex = currentChunkIndex;
+    block->offset = chunk.size;
+    chunk.size += block->size_;
+    ++chunk.numBlocks;
+    fileSize += block->size_;
+    return true;
+}
+
+
+void DataBlockStore::Impl::releaseBlock(Block* block)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(block->chunkIndex < 0){
+        memoryBlocks.erase(block->memoryBlockIter);
+        memorySize -= block->size_;
+    } else {
+        auto& chunk = chunks[block->chunkIndex];
+        fileSize -= block->size_;
+        if(--chunk.numBlocks == 0 && block->chunkIndex != currentChunkIndex){
+            fclose(chunk.file);
+            chunk.file = nullptr;
+        }
+    }
+}
+
+
+bool DataBlockStore::Impl::readBlock(const Block* block, vector<unsigned char>& out_data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(block->chunkIndex < 0){
+        out_data = block->data;
+        return true;
+    }
+    out_data.resize(block->size_);
+    auto file = chunks[block->chunkIndex].file;
+    if(fseek(file, block->offset, SEEK_SET) != 0){
+        return false;
+    }
+    return fread(out_data.data(), 1, block->size_, file) == block->size_;
+}
+
+
+size_t DataBlockStore::memorySize() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->memorySize;
+}
+
+
+size_t DataBlockStore::fileSize() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->fileSize;
+}
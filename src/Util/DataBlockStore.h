@@ -0,0 +1,74 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_DATA_BLOCK_STORE_H
+#define CNOID_UTIL_DATA_BLOCK_STORE_H
+
+#include "Referenced.h"
+#include <vector>
+#include <list>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class DataBlockStore;
+typedef ref_ptr<DataBlockStore> DataBlockStorePtr;
+
+/**
+   This class stores the blocks of binary data such as the encoded sensor data within a memory limit.
+   When the total size of the blocks in memory exceeds the limit, the oldest blocks are moved to
+   the temporary chunk files, which are deleted when all the blocks in them are released or the
+   store is destroyed. The functions are thread-safe.
+*/
+class CNOID_EXPORT DataBlockStore : public Referenced
+{
+    class Impl;
+    
+public:
+    class CNOID_EXPORT Block : public Referenced
+    {
+    public:
+        ~Block();
+
+        size_t size() const { return size_; }
+        bool isInMemory() const;
+
+        //! \return false if the data cannot be read from the chunk file.
+        bool read(std::vector<unsigned char>& out_data) const;
+
+    private:
+        Block(DataBlockStore* store, std::vector<unsigned char>&& data);
+        
+        DataBlockStorePtr store;
+        std::vector<unsigned char> data;
+        size_t size_;
+        int chunkIndex;
+        long offset;
+        std::list<Block*>::iterator memoryBlockIter;
+
+        friend class DataBlockStore;
+    };
+    typedef ref_ptr<Block> BlockPtr;
+
+    DataBlockStore();
+    ~DataBlockStore();
+
+    //! The default size is 512 MiB.
+    void setMaxMemorySize(size_t size);
+
+    //! The blocks are written to a new chunk file when the current one exceeds this size. The default size is 256 MiB.
+    void setChunkSize(size_t size);
+
+    BlockPtr store(std::vector<unsigned char>&& data);
+
+    size_t memorySize() const;
+    size_t fileSize() const;
+
+private:
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <memory>
 #include <iterator>
+#include <utility>
 
 namespace cnoid {
 
@@ -380,6 +381,19 @@ public:
         return !rowSize_ || !colSize_;
     }
 
+    //! The buffers are exchanged without copying the elements.
+    void swap(Deque2DType& other) {
+        std::swap(allocator, other.allocator);
+        std::swap(buf, other.buf);
+        std::swap(offset, other.offset);
+        std::swap(rowSize_, other.rowSize_);
+        std::swap(colSize_, other.colSize_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        end_ = iterator(*this, buf + ((capacity_ > 0) ? ((offset + size_) % capacity_) : 0));
+        other.end_ = iterator(other, other.buf + ((other.capacity_ > 0) ? ((other.offset + other.size_) % other.capacity_) : 0));
+    }
+
 private:
     void reallocMemory(int newColSize, int newSize, int newCapacity, bool doCopy) {
 
@@ -403,13 +417,14 @@ private:
                         allocator.construct(p++, *q++);
                     }
                 } else {
-                    for(ElementType* r = buf; r != qend && p != pend; ++r){
-                        allocator.construct(p++, *r);
-                    }
+                    // The elements wrapping around the buffer end must be copied in the logical order
                     ElementType* qterm = buf + capacity_;
                     for(ElementType* r = q; r != qterm && p != pend; ++r){
                         allocator.construct(p++, *r);
                     }
+                    for(ElementType* r = buf; r != qend && p != pend; ++r){
+                        allocator.construct(p++, *r);
+                    }
                 }
             }
             // destory the old elements
@@ -5,6 +5,7 @@
 
 #include "EasyScanner.h"
 #include "UTF8.h"
+#include "ParallelScheduler.h"
 #include "strtofloat.h"
 #include <cstdio>
 #include <cctype>
@@ -14,12 +15,117 @@
 #include <iostream>
 #include <fmt/format.h>
 #include <errno.h>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 using fmt::format;
 
+namespace {
+
+/*
+  The following functions return the pointer to the character following the parsed number.
+  The given pointer is returned if the text does not start with a number.
+*/
+
+char* parseNumber(char* text, int& out_value)
+{
+    // The decimal numbers of up to nine digits are parsed here, and the others are given to strtol
+    char* p = text;
+    bool isNegative = false;
+    if(*p == '-'){
+        isNegative = true;
+        ++p;
+    } else if(*p == '+'){
+        ++p;
+    }
+    const char* digits = p;
+    int value = 0;
+    while(*p >= '0' && *p <= '9' && (p - digits) < 9){
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    const int numDigits = p - digits;
+    if(numDigits == 0 || (*p >= '0' && *p <= '9') ||
+       (digits[0] == '0' && numDigits > 1) || (numDigits == 1 && (*p == 'x' || *p == 'X'))){
+        char* tail;
+        out_value = strtol(text, &tail, 0);
+        return tail;
+    }
+    out_value = isNegative ? -value : value;
+    return p;
+}
+
+#ifdef __cpp_lib_to_chars
+
+/*
+  The range given to from_chars is limited to the characters which may be a part of a number
+  because the text is only terminated by the null character.
+  The text which from_chars does not accept, such as a hexadecimal number and an out of range value,
+  is processed by strtod in the same way as the readDouble function.
+*/
+template<class ValueType>
+bool parseFloatingNumberByFromChars(char*& io_text, ValueType& out_value)
+{
+    const char* begin = (*io_text == '+') ? (io_text + 1) : io_text;
+    if(begin != io_text && (*begin == '+' || *begin == '-')){
+        return false;
+    }
+    const char* end = begin;
+    while((*end >= '0' && *end <= '9') || *end == '.' || *end == 'e' || *end == 'E' || *end == '-' || *end == '+'){
+        ++end;
+    }
+    auto result = std::from_chars(begin, end, out_value);
+    if(result.ec == std::errc() && result.ptr != begin){
+        io_text = const_cast<char*>(result.ptr);
+        return true;
+    }
+    return false;
+}
+
+char* parseNumber(char* text, float& out_value)
+{
+    char* tail = text;
+    if(!parseFloatingNumberByFromChars(tail, out_value)){
+        out_value = cnoid::strtof(text, &tail);
+    }
+    return tail;
+}
+
+char* parseNumber(char* text, double& out_value)
+{
+    char* tail = text;
+    if(!parseFloatingNumberByFromChars(tail, out_value)){
+        out_value = cnoid::strtod(text, &tail);
+    }
+    return tail;
+}
+
+#else
+
+char* parseNumber(char* text, float& out_value)
+{
+    char* tail;
+    out_value = cnoid::strtof(text, &tail);
+    return tail;
+}
+
+char* parseNumber(char* text, double& out_value)
+{
+    char* tail;
+    out_value = cnoid::strtod(text, &tail);
+    return tail;
+}
+
+#endif
+
+}
+
 
 std::string EasyScanner::Exception::getFullMessage() const
 {
@@ -463,6 +569,145 @@ bool EasyScanner::readInt()
 }
 
 
+bool EasyScanner::isWhiteSpaceChar(int c) const
+{
+    for(auto& ws : whiteSpaceChars){
+        if(c == ws){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+   This function reads the numbers between begin and end in the same way as readNumbers
+   without modifying the state of the scanner so that it can be called from multiple threads.
+   \return The position where the reading stopped
+*/
+template<class ValueType>
+char* EasyScanner::readNumbersInRange
+(char* begin, char* end, std::vector<ValueType>& out_values, int& out_numLines) const
+{
+    char* p = begin;
+    out_numLines = 0;
+    while(p < end){
+        const int c = *p;
+        if(c == ' ' || isWhiteSpaceChar(c)){
+            ++p;
+        } else if(c == '\n'){
+            ++out_numLines;
+            ++p;
+        } else if(c == '\r'){
+            if(p[1] != '\n'){
+                ++out_numLines;
+            }
+            ++p;
+        } else if(c == commentChar){
+            while(*p != '\r' && *p != '\n' && *p != '\0'){
+                ++p;
+            }
+        } else {
+            ValueType value;
+            char* tail = parseNumber(p, value);
+            if(tail == p){
+                break;
+            }
+            out_values.push_back(value);
+            p = tail;
+        }
+    }
+    return p;
+}
+
+
+/**
+   The text following the current position is divided at line feeds into chunks, and the chunks
+   are parsed in parallel. A chunk is only used when the previous chunks consist of numbers
+   until their ends, so the chunks beyond the end of the number sequence are just discarded.
+   The chunks start at the heads of lines, so a number or a comment is never split.
+*/
+template<class ValueType>
+void EasyScanner::readNumbersInParallel(std::vector<ValueType>& out_values)
+{
+    static const size_t chunkSize = 256 * 1024;
+    const int numChunks = ParallelScheduler::instance()->concurrency();
+
+    vector<char*> boundaries(numChunks + 1);
+    vector<vector<ValueType>> values(numChunks);
+    vector<char*> stops(numChunks);
+    vector<int> numLines(numChunks);
+
+    while(static_cast<size_t>(textBufEnd - text) > chunkSize * numChunks){
+        boundaries[0] = text;
+        for(int i=1; i <= numChunks; ++i){
+            char* p = std::max(text + chunkSize * i, boundaries[i - 1]);
+            auto lf = static_cast<char*>(memchr(p, '\n', textBufEnd - p));
+            boundaries[i] = lf ? (lf + 1) : textBufEnd;
+        }
+        parallelFor(0, numChunks, 1, [&](int begin, int end){
+            for(int i=begin; i < end; ++i){
+                values[i].clear();
+                stops[i] = readNumbersInRange(boundaries[i], boundaries[i + 1], values[i], numLines[i]);
+            }
+        });
+        for(int i=0; i < numChunks; ++i){
+            out_values.insert(out_values.end(), values[i].begin(), values[i].end());
+            lineNumber += numLines[i];
+            text = stops[i];
+            if(stops[i] != boundaries[i + 1]){
+                return;
+            }
+        }
+    }
+}
+
+
+template<class ValueType>
+int EasyScanner::readNumbers(std::vector<ValueType>& out_values)
+{
+    // A long sequence of numbers is read in parallel after this amount of text is read
+    static const ptrdiff_t parallelReadingThreshold = 64 * 1024;
+
+    const size_t orgSize = out_values.size();
+    char* head = text;
+    bool isParallelReadingDone = isLineOriented;
+    while(true){
+        skipSpace();
+        ValueType value;
+        char* tail = parseNumber(text, value);
+        if(tail == text){
+            break;
+        }
+        out_values.push_back(value);
+        text = tail;
+        if(!isParallelReadingDone && (text - head) > parallelReadingThreshold){
+            readNumbersInParallel(out_values);
+            isParallelReadingDone = true;
+        }
+    }
+    return out_values.size() - orgSize;
+}
+
+
+int EasyScanner::readInts(std::vector<int>& out_values)
+{
+    return readNumbers(out_values);
+}
+
+
+int EasyScanner::readFloats(std::vector<float>& out_values)
+{
+    return readNumbers(out_values);
+}
+
+
+int EasyScanner::readDoubles(std::vector<double>& out_values)
+{
+    return readNumbers(out_values);
+}
+
+
 bool EasyScanner::readChar()
 {
     skipSpace();
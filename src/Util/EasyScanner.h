@@ -90,6 +90,16 @@ public:
     bool readFloat();
     bool readDouble();
     bool readInt();
+
+    /**
+       These functions read the numbers until a character which does not start a number appears
+       and append them to the array. They are faster than reading the numbers one by one.
+       \return The number of the values read
+    */
+    int readInts(std::vector<int>& out_values);
+    int readFloats(std::vector<float>& out_values);
+    int readDoubles(std::vector<double>& out_values);
+
     bool readChar();
     bool readChar(int chara);
     int  peekChar();
@@ -258,6 +268,11 @@ private:
     bool readLF0();
     bool readWord0();
     bool readString0(const int delimiterChar);
+    template<class ValueType> int readNumbers(std::vector<ValueType>& out_values);
+    template<class ValueType> void readNumbersInParallel(std::vector<ValueType>& out_values);
+    template<class ValueType> char* readNumbersInRange(
+        char* begin, char* end, std::vector<ValueType>& out_values, int& out_numLines) const;
+    bool isWhiteSpaceChar(int c) const;
     
     char* textBuf;
     size_t size;
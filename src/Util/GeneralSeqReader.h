@@ -10,6 +10,7 @@
 #include "AbstractSeq.h"
 #include <functional>
 #include <type_traits>
+#include <algorithm>
 #include <ostream>
 
 namespace cnoid {
@@ -60,6 +61,19 @@ public:
     }
     
 private:
+    // The numeric values of a listing are directly copied to the frame of a seq of double values
+    template<class ValueType>
+    static bool copyNumericValues(const Listing&, int, int, ValueType*) {
+        return false;
+    }
+    static bool copyNumericValues(const Listing& src, int offset, int n, double* out_values) {
+        if(auto values = src.numericValues()){
+            std::copy(values + offset, values + offset + n, out_values);
+            return true;
+        }
+        return false;
+    }
+    
     const Listing& getFrames(const Mapping* archive)
     {
         auto framesNode = archive->find("frames");
@@ -167,7 +181,7 @@ public:
                 auto& seqValue = (*seq)[i];
                 readValue(srcValue, 0, seqValue);
             } else {
-                double time = srcValue[0].toDouble();
+                double time = srcValue.doubleAt(0);
                 int frameIndex = seq->frameOfTime(time);
                 if(frameIndex >= seq->numFrames()){
                     seq->setNumFrames(frameIndex + 1, true);
@@ -207,6 +221,9 @@ public:
         const Listing& frames = getFrames(archive);
         const int numFrames = frames.size();
 
+        // The labels of the previous data do not correspond to the parts read from the archive
+        seq->clearPartLabels();
+
         if(hasFrameTime_){
             seq->setDimension(0, numParts_);
         } else {
@@ -220,18 +237,22 @@ public:
             }
             if(!hasFrameTime_){
                 auto seqFrame = seq->frame(i);
-                for(int j=0; j < numParts_; ++j){
-                    readValue(srcValues[j], seqFrame[j]);
+                if(!copyNumericValues(srcValues, 0, numParts_, &seqFrame[0])){
+                    for(int j=0; j < numParts_; ++j){
+                        readValue(srcValues[j], seqFrame[j]);
+                    }
                 }
             } else {
-                double time = srcValues[0].toDouble();
+                double time = srcValues.doubleAt(0);
                 int frameIndex = seq->frameOfTime(time);
                 if(frameIndex >= seq->numFrames()){
                     seq->setNumFrames(frameIndex + 1, true);
                 }
                 auto seqFrame = seq->frame(frameIndex);
-                for(int j=0; j < numParts_; ++j){
-                    readValue(srcValues[j+1], seqFrame[j]);
+                if(!copyNumericValues(srcValues, 1, numParts_, &seqFrame[0])){
+                    for(int j=0; j < numParts_; ++j){
+                        readValue(srcValues[j+1], seqFrame[j]);
+                    }
                 }
             }
         }
@@ -10,6 +10,8 @@
 #include <fmt/format.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <png.h>
+#include <csetjmp>
+#include <cstring>
 
 extern "C" {
 #define XMD_H
@@ -348,6 +350,236 @@ void loadTGA(Image& image, const std::string& filename, bool isUpsideDown)
 
 }
 
+
+
+void writePNGData(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto buf = static_cast<vector<unsigned char>*>(png_get_io_ptr(png_ptr));
+    buf->insert(buf->end(), data, data + length);
+}
+
+
+void flushPNGData(png_structp)
+{
+
+}
+
+
+bool encodePNG(const Image& image, vector<unsigned char>& out_data)
+{
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr){
+        return false;
+    }
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr){
+        png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
+        return false;
+    }
+
+    const int height = image.height();
+    const int width = image.width();
+    const int rowSize = width * image.numComponents();
+    vector<png_bytep> row_pointers(height);
+    for(int i=0; i < height; ++i){
+        row_pointers[i] = const_cast<unsigned char*>(image.pixels()) + rowSize * i;
+    }
+    
+    if(setjmp(png_jmpbuf(png_ptr))){
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        return false;
+    }
+
+    png_set_write_fn(png_ptr, &out_data, writePNGData, flushPNGData);
+    png_set_compression_level(png_ptr, 1);
+
+    int color_type;
+    if(image.numComponents() >= 3){
+        color_type = image.hasAlphaComponent() ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB;
+    } else {
+        color_type = image.hasAlphaComponent() ? PNG_COLOR_TYPE_GRAY_ALPHA : PNG_COLOR_TYPE_GRAY;
+    }
+    png_set_IHDR(png_ptr, info_ptr,
+                 width, height, 8, color_type,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    png_write_info(png_ptr, info_ptr);
+    png_write_image(png_ptr, row_pointers.data());
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    return true;
+}
+
+
+struct PNGDataSource
+{
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+};
+
+
+void readPNGData(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto source = static_cast<PNGDataSource*>(png_get_io_ptr(png_ptr));
+    if(source->position + length > source->size){
+        png_error(png_ptr, "Unexpected end of data");
+    }
+    memcpy(data, source->data + source->position, length);
+    source->position += length;
+}
+
+
+bool decodePNG(Image& image, const unsigned char* data, size_t size)
+{
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr){
+        return false;
+    }
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr){
+        png_destroy_read_struct(&png_ptr, NULL, NULL);
+        return false;
+    }
+
+    vector<png_bytep> row_pointers;
+    PNGDataSource source = { data, size, 0 };
+
+    if(setjmp(png_jmpbuf(png_ptr))){
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        return false;
+    }
+
+    png_set_read_fn(png_ptr, &source, readPNGData);
+    png_read_info(png_ptr, info_ptr);
+
+    const int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+    const int color_type = png_get_color_type(png_ptr, info_ptr);
+    if(color_type == PNG_COLOR_TYPE_PALETTE){
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8){
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+    if(bit_depth == 16){
+        png_set_strip_16(png_ptr);
+    }
+    png_read_update_info(png_ptr, info_ptr);
+
+    const int width = png_get_image_width(png_ptr, info_ptr);
+    const int height = png_get_image_height(png_ptr, info_ptr);
+    const int numComponents = png_get_channels(png_ptr, info_ptr);
+    image.setSize(width, height, numComponents);
+
+    row_pointers.resize(height);
+    const int rowSize = width * numComponents;
+    for(int i=0; i < height; ++i){
+        row_pointers[i] = image.pixels() + rowSize * i;
+    }
+    png_read_image(png_ptr, row_pointers.data());
+    png_read_end(png_ptr, NULL);
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+
+    return true;
+}
+
+
+/**
+   The default error handler of libjpeg exits the process, so the errors in the in-memory
+   coding are handled by returning to the coding functions with longjmp.
+*/
+struct JPEGErrorManager
+{
+    jpeg_error_mgr pub;
+    jmp_buf jmpBuffer;
+};
+
+
+void exitJPEGCoding(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<JPEGErrorManager*>(cinfo->err)->jmpBuffer, 1);
+}
+
+
+bool encodeJPEG(const Image& image, vector<unsigned char>& out_data, int quality)
+{
+    const int numComponents = image.numComponents();
+    if(numComponents != 1 && numComponents != 3){
+        return false;
+    }
+    
+    jpeg_compress_struct cinfo;
+    JPEGErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = exitJPEGCoding;
+
+    unsigned char* buffer = nullptr;
+    unsigned long bufferSize = 0;
+
+    if(setjmp(jerr.jmpBuffer)){
+        jpeg_destroy_compress(&cinfo);
+        free(buffer);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &bufferSize);
+
+    cinfo.image_width = image.width();
+    cinfo.image_height = image.height();
+    cinfo.input_components = numComponents;
+    cinfo.in_color_space = (numComponents == 3) ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    const int rowSize = image.width() * numComponents;
+    while(cinfo.next_scanline < cinfo.image_height){
+        JSAMPROW row = const_cast<unsigned char*>(image.pixels()) + rowSize * cinfo.next_scanline;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+
+    out_data.assign(buffer, buffer + bufferSize);
+    jpeg_destroy_compress(&cinfo);
+    free(buffer);
+
+    return true;
+}
+
+
+bool decodeJPEG(Image& image, const unsigned char* data, size_t size)
+{
+    jpeg_decompress_struct cinfo;
+    JPEGErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = exitJPEGCoding;
+
+    if(setjmp(jerr.jmpBuffer)){
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), size);
+    jpeg_read_header(&cinfo, TRUE);
+    jpeg_start_decompress(&cinfo);
+    image.setSize(cinfo.output_width, cinfo.output_height, cinfo.output_components);
+
+    const int rowSize = cinfo.output_width * cinfo.output_components;
+    while(cinfo.output_scanline < cinfo.output_height){
+        JSAMPROW row = image.pixels() + rowSize * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    return true;
+}
+
 }
 
 
@@ -379,3 +611,28 @@ void ImageIO::save(const Image& image, const std::string& filename)
         throwSaveException(filename, "unsupported image format.");
     }
 }
+
+
+bool ImageIO::encode(const Image& image, Format format, std::vector<unsigned char>& out_data, int quality)
+{
+    out_data.clear();
+    if(image.empty()){
+        return false;
+    }
+    if(format == JPEG_FORMAT){
+        return encodeJPEG(image, out_data, quality);
+    }
+    return encodePNG(image, out_data);
+}
+
+
+bool ImageIO::decode(Image& image, const unsigned char* data, size_t size)
+{
+    if(size >= 8 && png_sig_cmp(const_cast<unsigned char*>(data), 0, 8) == 0){
+        return decodePNG(image, data, size);
+    }
+    if(size >= 2 && data[0] == 0xff && data[1] == 0xd8){
+        return decodeJPEG(image, data, size);
+    }
+    return false;
+}
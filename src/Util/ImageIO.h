@@ -7,6 +7,7 @@
 #define CNOID_UTIL_IMAGE_IO_H
 
 #include "Image.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -24,6 +25,20 @@ public:
     void load(Image& image, const std::string& filename);
     void save(const Image& image, const std::string& filename);
 
+    enum Format { PNG_FORMAT, JPEG_FORMAT };
+
+    /**
+       Encodes an image into the data of the specified format in memory.
+       The upside-down mode is not applied to the in-memory data.
+       \param quality The JPEG quality from 0 to 100. The PNG data is encoded with a fast compression level.
+       \return false if the image cannot be encoded. The JPEG format only supports the images of
+       one or three components.
+    */
+    bool encode(const Image& image, Format format, std::vector<unsigned char>& out_data, int quality = 90);
+
+    //! Decodes the PNG or JPEG data encoded by the encode function. The format is detected from the data.
+    bool decode(Image& image, const unsigned char* data, size_t size);
+
 private:
     bool isUpsideDown_;
 };
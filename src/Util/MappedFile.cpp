@@ -0,0 +1,176 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "MappedFile.h"
+#include "UTF8.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class MappedFile::Impl
+{
+public:
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+    Impl() : file(INVALID_HANDLE_VALUE), mapping(NULL) { }
+#else
+    int fd;
+    Impl() : fd(-1) { }
+#endif
+    size_t getFileSize();
+};
+
+}
+
+
+MappedFile::MappedFile()
+{
+    data_ = nullptr;
+    size_ = 0;
+    isOpen_ = false;
+    impl = new Impl;
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+    delete impl;
+}
+
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    
+#ifdef _WIN32
+    impl->file = CreateFileA(
+        fromUTF8(filename).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(impl->file == INVALID_HANDLE_VALUE){
+        return false;
+    }
+#else
+    impl->fd = ::open(fromUTF8(filename).c_str(), O_RDONLY);
+    if(impl->fd < 0){
+        return false;
+    }
+#endif
+
+    isOpen_ = true;
+    
+    if(!map()){
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+size_t MappedFile::Impl::getFileSize()
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)){
+        return 0;
+    }
+    return static_cast<size_t>(size.QuadPart);
+#else
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        return 0;
+    }
+    return static_cast<size_t>(st.st_size);
+#endif
+}
+
+
+bool MappedFile::map()
+{
+    size_t size = impl->getFileSize();
+    if(size == 0){
+        // An empty file cannot be mapped
+        return true;
+    }
+
+#ifdef _WIN32
+    impl->mapping = CreateFileMappingA(impl->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!impl->mapping){
+        return false;
+    }
+    void* p = MapViewOfFile(impl->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!p){
+        CloseHandle(impl->mapping);
+        impl->mapping = NULL;
+        return false;
+    }
+#else
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, impl->fd, 0);
+    if(p == MAP_FAILED){
+        return false;
+    }
+#endif
+
+    data_ = static_cast<const char*>(p);
+    size_ = size;
+    return true;
+}
+
+
+void MappedFile::unmap()
+{
+    if(data_){
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(impl->mapping);
+        impl->mapping = NULL;
+#else
+        munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+
+void MappedFile::close()
+{
+    unmap();
+    
+#ifdef _WIN32
+    if(impl->file != INVALID_HANDLE_VALUE){
+        CloseHandle(impl->file);
+        impl->file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if(impl->fd >= 0){
+        ::close(impl->fd);
+        impl->fd = -1;
+    }
+#endif
+
+    isOpen_ = false;
+}
+
+
+bool MappedFile::updateMapping()
+{
+    if(!isOpen_ || impl->getFileSize() == size_){
+        return false;
+    }
+    unmap();
+    return map();
+}
@@ -0,0 +1,57 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_MAPPED_FILE_H
+#define CNOID_UTIL_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class maps a file into the memory for reading.
+   The file data can be accessed as a byte array without copying it into a buffer, and the pages
+   are loaded on demand by the operating system.
+*/
+class CNOID_EXPORT MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //! \param filename The filename encoded in UTF-8
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return isOpen_; }
+
+    /**
+       This function maps the file again if its size has been changed so that the data appended
+       to the file by another writer can be accessed.
+       \return True if the mapping has been updated.
+    */
+    bool updateMapping();
+
+    //! Null is returned if the file is empty.
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    bool isOpen_;
+    class Impl;
+    Impl* impl;
+
+    bool map();
+    void unmap();
+};
+
+}
+
+#endif
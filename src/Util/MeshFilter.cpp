@@ -11,6 +11,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <array>
+#include <queue>
+#include <algorithm>
 
 using namespace std;
 using namespace cnoid;
@@ -98,6 +100,433 @@ template<> struct hash<EdgeId>
 
 }
 
+namespace {
+
+typedef array<float, 3> Position;
+
+struct PositionHash
+{
+    std::size_t operator()(const Position& p) const {
+        std::hash<float> hasher;
+        std::size_t seed = 0;
+        for(auto& x : p){
+            seed ^= hasher(x) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+        }
+        return seed;
+    }
+};
+
+/**
+   The quadric of the squared distances to the planes.
+   The value for the position v is v^T A v + 2 b^T v + c.
+*/
+struct Quadric
+{
+    Matrix3 A;
+    Vector3 b;
+    double c;
+
+    Quadric() : A(Matrix3::Zero()), b(Vector3::Zero()), c(0.0) { }
+
+    void addPlane(const Vector3& n, double d, double weight = 1.0){
+        A.noalias() += weight * n * n.transpose();
+        b += (weight * d) * n;
+        c += weight * d * d;
+    }
+    Quadric& operator+=(const Quadric& q){
+        A += q.A;
+        b += q.b;
+        c += q.c;
+        return *this;
+    }
+    double evaluate(const Vector3& v) const {
+        return std::max(0.0, v.dot(A * v) + 2.0 * b.dot(v) + c);
+    }
+};
+
+class QuadricSimplifier
+{
+public:
+    struct Collapse
+    {
+        double cost;
+        int v0;
+        int v1;
+        int version0;
+        int version1;
+        Vector3 position;
+        bool operator<(const Collapse& rhs) const { return cost > rhs.cost; }
+    };
+
+    vector<Vector3> positions;
+    vector<Quadric> quadrics;
+    vector<array<int, 3>> faces;
+    vector<bool> faceRemovedFlags;
+    vector<vector<int>> vertexFaces;
+    // The vertices of the edges whose collapse has been rejected and must be retried when the neighborhood changes
+    vector<vector<int>> rejectedNeighbors;
+    vector<int> vertexVersions;
+    int numFaces;
+    priority_queue<Collapse> collapses;
+    vector<int> neighborMarks;
+    int markCounter;
+
+    static constexpr double constraintWeight = 1.0e3;
+
+    bool initialize(SgMesh* mesh, float sharpEdgeAngle);
+    void addEdgeConstraint(int v0, int v1, const Vector3& faceNormal);
+    Vector3 faceNormal(int faceIndex, int replacedVertex = -1, const Vector3* newPosition = nullptr) const;
+    void pushCollapse(int v0, int v1);
+    bool isCollapseValid(int v0, int v1, const Vector3& position);
+    void collapse(int v0, int v1, const Vector3& position);
+    bool isEdge(int v0, int v1) const;
+    void simplify(int targetNumFaces, double maxError);
+    void output(SgMesh* mesh);
+};
+
+constexpr double QuadricSimplifier::constraintWeight;
+
+
+bool QuadricSimplifier::initialize(SgMesh* mesh, float sharpEdgeAngle)
+{
+    // The vertices at the same position are welded so that the faces are connected
+    const auto& orgVertices = *mesh->vertices();
+    vector<int> indexMap(orgVertices.size());
+    unordered_map<Position, int, PositionHash> positionToIndexMap;
+    positionToIndexMap.reserve(orgVertices.size());
+    for(size_t i=0; i < orgVertices.size(); ++i){
+        const auto& v = orgVertices[i];
+        auto inserted = positionToIndexMap.insert(
+            make_pair(Position{ v.x(), v.y(), v.z() }, static_cast<int>(positions.size())));
+        if(inserted.second){
+            positions.push_back(v.cast<double>());
+        }
+        indexMap[i] = inserted.first->second;
+    }
+
+    const int numTriangles = mesh->numTriangles();
+    faces.reserve(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = mesh->triangle(i);
+        array<int, 3> face{ indexMap[triangle[0]], indexMap[triangle[1]], indexMap[triangle[2]] };
+        if(face[0] != face[1] && face[1] != face[2] && face[2] != face[0]){
+            faces.push_back(face);
+        }
+    }
+    numFaces = faces.size();
+    if(numFaces == 0){
+        return false;
+    }
+    faceRemovedFlags.resize(numFaces, false);
+
+    const int numVertices = positions.size();
+    quadrics.resize(numVertices);
+    vertexFaces.resize(numVertices);
+    rejectedNeighbors.resize(numVertices);
+    vertexVersions.resize(numVertices, 0);
+    neighborMarks.resize(numVertices, 0);
+    markCounter = 0;
+
+    vector<Vector3> normals(numFaces);
+    unordered_map<EdgeId, vector<int>> facesOfEdgeMap;
+    facesOfEdgeMap.reserve(numFaces * 3 / 2);
+    for(int i=0; i < numFaces; ++i){
+        auto& face = faces[i];
+        const Vector3& p0 = positions[face[0]];
+        normals[i] = faceNormal(i);
+        double d = -normals[i].dot(p0);
+        Quadric q;
+        q.addPlane(normals[i], d);
+        for(int j=0; j < 3; ++j){
+            quadrics[face[j]] += q;
+            vertexFaces[face[j]].push_back(i);
+            facesOfEdgeMap[EdgeId(SgMesh::TriangleRef(face.data()), j)].push_back(i);
+        }
+    }
+
+    const double cosSharpEdgeAngle = cos(sharpEdgeAngle);
+    for(auto& kv : facesOfEdgeMap){
+        auto& edge = kv.first;
+        auto& edgeFaces = kv.second;
+        if(edgeFaces.size() == 2){
+            const Vector3& n0 = normals[edgeFaces[0]];
+            const Vector3& n1 = normals[edgeFaces[1]];
+            if(n0.dot(n1) < cosSharpEdgeAngle){
+                addEdgeConstraint(edge(0), edge(1), n0);
+                addEdgeConstraint(edge(0), edge(1), n1);
+            }
+        } else {
+            // Boundary or non-manifold edge
+            for(auto& faceIndex : edgeFaces){
+                addEdgeConstraint(edge(0), edge(1), normals[faceIndex]);
+            }
+        }
+    }
+
+    for(auto& kv : facesOfEdgeMap){
+        pushCollapse(kv.first(0), kv.first(1));
+    }
+
+    return true;
+}
+
+
+// The plane that contains the edge and is perpendicular to the face is added to the quadrics of the end vertices
+void QuadricSimplifier::addEdgeConstraint(int v0, int v1, const Vector3& faceNormal)
+{
+    const Vector3& p0 = positions[v0];
+    Vector3 edge = positions[v1] - p0;
+    Vector3 n = edge.cross(faceNormal);
+    const double norm = n.norm();
+    if(norm > 0.0){
+        n /= norm;
+        Quadric q;
+        q.addPlane(n, -n.dot(p0), constraintWeight);
+        quadrics[v0] += q;
+        quadrics[v1] += q;
+    }
+}
+
+
+Vector3 QuadricSimplifier::faceNormal(int faceIndex, int replacedVertex, const Vector3* newPosition) const
+{
+    auto& face = faces[faceIndex];
+    const Vector3* p[3];
+    for(int i=0; i < 3; ++i){
+        p[i] = (face[i] == replacedVertex) ? newPosition : &positions[face[i]];
+    }
+    Vector3 n = (*p[1] - *p[0]).cross(*p[2] - *p[0]);
+    const double norm = n.norm();
+    if(norm > 0.0){
+        n /= norm;
+    }
+    return n;
+}
+
+
+void QuadricSimplifier::pushCollapse(int v0, int v1)
+{
+    Quadric q = quadrics[v0];
+    q += quadrics[v1];
+
+    Collapse c;
+    c.v0 = v0;
+    c.v1 = v1;
+    c.version0 = vertexVersions[v0];
+    c.version1 = vertexVersions[v1];
+
+    const Vector3& p0 = positions[v0];
+    const Vector3& p1 = positions[v1];
+    bool isOptimalPositionFound = false;
+    Eigen::FullPivLU<Matrix3> lu(q.A);
+    if(lu.isInvertible()){
+        c.position = lu.solve(-q.b);
+        // Reject the solution far from the edge, which is given by a nearly singular quadric
+        const Vector3 center = (p0 + p1) / 2.0;
+        if((c.position - center).norm() <= (p1 - p0).norm()){
+            c.cost = q.evaluate(c.position);
+            isOptimalPositionFound = true;
+        }
+    }
+    if(!isOptimalPositionFound){
+        const Vector3 candidates[] = { p0, p1, (p0 + p1) / 2.0 };
+        c.cost = std::numeric_limits<double>::max();
+        for(auto& candidate : candidates){
+            double cost = q.evaluate(candidate);
+            if(cost < c.cost){
+                c.cost = cost;
+                c.position = candidate;
+            }
+        }
+    }
+    collapses.push(c);
+}
+
+
+bool QuadricSimplifier::isCollapseValid(int v0, int v1, const Vector3& position)
+{
+    // The link condition: the vertices adjacent to both of the end vertices must be the ones of the faces sharing the edge
+    ++markCounter;
+    int numOppositeVertices = 0;
+    for(auto& faceIndex : vertexFaces[v0]){
+        for(auto& v : faces[faceIndex]){
+            if(v != v0){
+                neighborMarks[v] = markCounter;
+            }
+        }
+    }
+    for(auto& faceIndex : vertexFaces[v1]){
+        auto& face = faces[faceIndex];
+        if(face[0] == v0 || face[1] == v0 || face[2] == v0){
+            ++numOppositeVertices;
+        }
+    }
+    int numCommonNeighbors = 0;
+    ++markCounter;
+    for(auto& faceIndex : vertexFaces[v1]){
+        for(auto& v : faces[faceIndex]){
+            if(v != v1 && v != v0 && neighborMarks[v] == markCounter - 1){
+                neighborMarks[v] = markCounter;
+                ++numCommonNeighbors;
+            }
+        }
+    }
+    if(numCommonNeighbors != numOppositeVertices){
+        return false;
+    }
+
+    // The faces must not be flipped
+    for(int i=0; i < 2; ++i){
+        const int v = (i == 0) ? v0 : v1;
+        const int other = (i == 0) ? v1 : v0;
+        for(auto& faceIndex : vertexFaces[v]){
+            auto& face = faces[faceIndex];
+            if(face[0] == other || face[1] == other || face[2] == other){
+                continue;
+            }
+            Vector3 n0 = faceNormal(faceIndex);
+            Vector3 n1 = faceNormal(faceIndex, v, &position);
+            if(n1.isZero() || n0.dot(n1) < 0.2){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void QuadricSimplifier::collapse(int v0, int v1, const Vector3& position)
+{
+    positions[v0] = position;
+    quadrics[v0] += quadrics[v1];
+
+    for(auto& faceIndex : vertexFaces[v1]){
+        auto& face = faces[faceIndex];
+        if(face[0] == v0 || face[1] == v0 || face[2] == v0){
+            faceRemovedFlags[faceIndex] = true;
+            --numFaces;
+            for(auto& v : face){
+                if(v != v0 && v != v1){
+                    auto& faces2 = vertexFaces[v];
+                    faces2.erase(std::remove(faces2.begin(), faces2.end(), faceIndex), faces2.end());
+                }
+            }
+        } else {
+            for(auto& v : face){
+                if(v == v1){
+                    v = v0;
+                }
+            }
+            vertexFaces[v0].push_back(faceIndex);
+        }
+    }
+    vertexFaces[v1].clear();
+    rejectedNeighbors[v1].clear();
+    ++vertexVersions[v1];
+
+    auto& faces0 = vertexFaces[v0];
+    faces0.erase(
+        std::remove_if(faces0.begin(), faces0.end(), [&](int faceIndex){ return faceRemovedFlags[faceIndex]; }),
+        faces0.end());
+
+    ++vertexVersions[v0];
+    rejectedNeighbors[v0].clear();
+
+    ++markCounter;
+    vector<int> neighbors;
+    for(auto& faceIndex : faces0){
+        for(auto& v : faces[faceIndex]){
+            if(v != v0 && neighborMarks[v] != markCounter){
+                neighborMarks[v] = markCounter;
+                neighbors.push_back(v);
+                pushCollapse(v0, v);
+            }
+        }
+    }
+
+    // The collapses rejected around the neighbor vertices may be valid in the new neighborhood
+    for(auto& v : neighbors){
+        auto& rejected = rejectedNeighbors[v];
+        for(auto& w : rejected){
+            // An edge between two neighbor vertices is pushed only once
+            bool isPushed = (neighborMarks[w] == markCounter && w < v);
+            if(w != v0 && !isPushed && isEdge(v, w)){
+                pushCollapse(v, w);
+            }
+        }
+        rejected.clear();
+    }
+}
+
+
+bool QuadricSimplifier::isEdge(int v0, int v1) const
+{
+    for(auto& faceIndex : vertexFaces[v0]){
+        auto& face = faces[faceIndex];
+        if(face[0] == v1 || face[1] == v1 || face[2] == v1){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void QuadricSimplifier::simplify(int targetNumFaces, double maxError)
+{
+    const double maxCost = (maxError > 0.0) ? (maxError * maxError) : std::numeric_limits<double>::max();
+
+    while(!collapses.empty()){
+        if(targetNumFaces > 0 && numFaces <= targetNumFaces){
+            break;
+        }
+        Collapse c = collapses.top();
+        collapses.pop();
+        if(c.version0 != vertexVersions[c.v0] || c.version1 != vertexVersions[c.v1]){
+            continue; // outdated
+        }
+        if(c.cost > maxCost){
+            break;
+        }
+        if(isCollapseValid(c.v0, c.v1, c.position)){
+            collapse(c.v0, c.v1, c.position);
+        } else {
+            rejectedNeighbors[c.v0].push_back(c.v1);
+            rejectedNeighbors[c.v1].push_back(c.v0);
+        }
+    }
+}
+
+
+void QuadricSimplifier::output(SgMesh* mesh)
+{
+    // New arrays are created because the original arrays may be shared with other meshes
+    auto vertices = new SgVertexArray;
+    vector<int> indexMap(positions.size(), -1);
+    auto& triangleVertices = mesh->triangleVertices();
+    triangleVertices.clear();
+    triangleVertices.reserve(numFaces * 3);
+    for(size_t i=0; i < faces.size(); ++i){
+        if(!faceRemovedFlags[i]){
+            for(auto& v : faces[i]){
+                int& index = indexMap[v];
+                if(index < 0){
+                    index = vertices->size();
+                    vertices->push_back(positions[v].cast<float>());
+                }
+                triangleVertices.push_back(index);
+            }
+        }
+    }
+    triangleVertices.shrink_to_fit();
+    mesh->setVertices(vertices);
+    mesh->setNormals(nullptr);
+    mesh->normalIndices().clear();
+    mesh->setPrimitive(SgMesh::Mesh());
+    mesh->updateBoundingBox();
+}
+
+}
+
 namespace cnoid {
 
 class MeshFilterImpl
@@ -110,6 +539,7 @@ public:
     vector<vector<int>> normalsOfVertexMap;
     float minCreaseAngle;
     float maxCreaseAngle;
+    float sharpEdgeAngle;
     bool isNormalOverwritingEnabled;
 
     MeshFilterImpl();
@@ -123,6 +553,7 @@ public:
     void makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFaces = false);
     void makeFacesOfEdgeMap(SgMesh* mesh);
     void setVertexNormals(SgMesh* mesh, float creaseAngle);
+    bool simplify(SgMesh* mesh, int targetNumTriangles, float maxError);
 };
 
 }
@@ -139,6 +570,7 @@ MeshFilterImpl::MeshFilterImpl()
     isNormalOverwritingEnabled = false;
     minCreaseAngle = 0.0f;
     maxCreaseAngle = PI;
+    sharpEdgeAngle = PI / 3.0;
 }
 
 
@@ -153,6 +585,7 @@ MeshFilterImpl::MeshFilterImpl(const MeshFilterImpl& org)
     isNormalOverwritingEnabled = org.isNormalOverwritingEnabled;
     minCreaseAngle = org.minCreaseAngle;
     maxCreaseAngle = org.maxCreaseAngle;
+    sharpEdgeAngle = org.sharpEdgeAngle;
 }
 
 
@@ -473,6 +906,69 @@ bool MeshFilter::generateNormals(SgMesh* mesh, float creaseAngle, bool removeRed
 }
 
 
+bool MeshFilter::simplify(SgMesh* mesh, int targetNumTriangles, float maxError)
+{
+    return impl->simplify(mesh, targetNumTriangles, maxError);
+}
+
+
+bool MeshFilterImpl::simplify(SgMesh* mesh, int targetNumTriangles, float maxError)
+{
+    if(!mesh->hasVertices() || mesh->triangleVertices().empty() ||
+       mesh->primitiveType() != SgMesh::MESH || mesh->hasColors() || mesh->hasTexCoords()){
+        return false;
+    }
+    const int numOrgTriangles = mesh->numTriangles();
+    if(targetNumTriangles > 0 && numOrgTriangles <= targetNumTriangles){
+        return false;
+    }
+    if(targetNumTriangles <= 0 && maxError <= 0.0f){
+        return false;
+    }
+
+    QuadricSimplifier simplifier;
+    if(!simplifier.initialize(mesh, sharpEdgeAngle)){
+        return false;
+    }
+    simplifier.simplify(targetNumTriangles, maxError);
+    if(simplifier.numFaces == numOrgTriangles){
+        return false;
+    }
+
+    const bool hadNormals = mesh->hasNormals();
+    simplifier.output(mesh);
+    if(hadNormals){
+        calculateFaceNormals(mesh, false);
+        makeFacesOfVertexMap(mesh, true);
+        setVertexNormals(mesh, mesh->creaseAngle());
+    }
+    return true;
+}
+
+
+void MeshFilter::simplify(SgNode* scene, float ratio, float maxError)
+{
+    unordered_set<SgMesh*> processedMeshes;
+    impl->forAllMeshes(
+        scene,
+        [&](SgMesh* mesh){
+            if(processedMeshes.insert(mesh).second){
+                int target = 0;
+                if(ratio < 1.0f){
+                    target = std::max(1, static_cast<int>(ratio * mesh->numTriangles()));
+                }
+                impl->simplify(mesh, target, maxError);
+            }
+        });
+}
+
+
+void MeshFilter::setSharpEdgeAngle(float angle)
+{
+    impl->sharpEdgeAngle = angle;
+}
+
+
 void MeshFilter::setNormalOverwritingEnabled(bool on)
 {
     impl->isNormalOverwritingEnabled = on;
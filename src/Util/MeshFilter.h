@@ -42,6 +42,28 @@ public:
     void removeRedundantNormals(SgMesh* mesh);
 
     bool generateNormals(SgMesh* mesh, float creaseAngle = 3.14159f, bool removeRedundantVertices = false);
+
+    /**
+       The triangles of the mesh are reduced by collapsing the edges in the order of the quadric error.
+       The simplification stops when the number of the triangles reaches targetNumTriangles or when
+       the error of the next collapse exceeds maxError, which is the approximate distance from the
+       original surface. A non-positive value disables the corresponding condition.
+       The boundary edges and the sharp edges are preserved by the additional error terms.
+       The meshes with colors or texture coordinates and the primitive meshes are not simplified.
+       The normals are generated again if the mesh has normals.
+       \return True if the mesh is simplified
+    */
+    bool simplify(SgMesh* mesh, int targetNumTriangles, float maxError = 0.0f);
+
+    /**
+       \param ratio The target number of the triangles of each mesh in the ratio to the current number
+       A ratio of one or more only applies maxError.
+    */
+    void simplify(SgNode* scene, float ratio, float maxError = 0.0f);
+
+    //! The edges whose dihedral angles are larger than this are preserved in the simplification.
+    void setSharpEdgeAngle(float angle);
+
     void setNormalOverwritingEnabled(bool on);
     void setMinCreaseAngle(float angle);
     void setMaxCreaseAngle(float angle);
@@ -0,0 +1,339 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "MeshPool.h"
+#include "SceneDrawables.h"
+#include <unordered_map>
+#include <mutex>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const uint64_t fnvOffsetBasis = 0xcbf29ce484222325ULL;
+const uint64_t fnvPrime = 0x100000001b3ULL;
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+    auto bytes = static_cast<const char*>(data);
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)){
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * fnvPrime;
+    }
+    for(; i < size; ++i){
+        hash = (hash ^ static_cast<unsigned char>(bytes[i])) * fnvPrime;
+    }
+    return hash;
+}
+
+template<class T>
+uint64_t hashValue(const T& value, uint64_t hash)
+{
+    return hashBytes(&value, sizeof(T), hash);
+}
+
+template<class ArrayType>
+uint64_t hashArray(const ArrayType& array, uint64_t hash)
+{
+    hash = hashValue(static_cast<uint64_t>(array.size()), hash);
+    if(!array.empty()){
+        hash = hashBytes(&array[0], array.size() * sizeof(array[0]), hash);
+    }
+    return hash;
+}
+
+template<class ArrayType>
+bool isSameArray(const ArrayType& array1, const ArrayType& array2)
+{
+    if(array1.size() != array2.size()){
+        return false;
+    }
+    return array1.empty() || memcmp(&array1[0], &array2[0], array1.size() * sizeof(array1[0])) == 0;
+}
+
+bool isSamePrimitive(const SgMesh* mesh1, const SgMesh* mesh2)
+{
+    const int type = mesh1->primitiveType();
+    if(mesh2->primitiveType() != type){
+        return false;
+    }
+    switch(type){
+    case SgMesh::BOX:
+        return mesh1->primitive<SgMesh::Box>().size == mesh2->primitive<SgMesh::Box>().size;
+    case SgMesh::SPHERE:
+        return mesh1->primitive<SgMesh::Sphere>().radius == mesh2->primitive<SgMesh::Sphere>().radius;
+    case SgMesh::CYLINDER:
+    {
+        auto& c1 = mesh1->primitive<SgMesh::Cylinder>();
+        auto& c2 = mesh2->primitive<SgMesh::Cylinder>();
+        return c1.radius == c2.radius && c1.height == c2.height &&
+            c1.bottom == c2.bottom && c1.side == c2.side && c1.top == c2.top;
+    }
+    case SgMesh::CONE:
+    {
+        auto& c1 = mesh1->primitive<SgMesh::Cone>();
+        auto& c2 = mesh2->primitive<SgMesh::Cone>();
+        return c1.radius == c2.radius && c1.height == c2.height &&
+            c1.bottom == c2.bottom && c1.side == c2.side;
+    }
+    case SgMesh::CAPSULE:
+    {
+        auto& c1 = mesh1->primitive<SgMesh::Capsule>();
+        auto& c2 = mesh2->primitive<SgMesh::Capsule>();
+        return c1.radius == c2.radius && c1.height == c2.height;
+    }
+    default:
+        return true;
+    }
+}
+
+/**
+   The hash table of the objects with weak references.
+   The entries of the released objects are removed when the table grows.
+*/
+template<class ObjectType>
+class WeakObjectTable
+{
+public:
+    unordered_multimap<uint64_t, weak_ref_ptr<ObjectType>> entries;
+    size_t purgeThreshold;
+
+    WeakObjectTable() : purgeThreshold(64) { }
+
+    bool contains(uint64_t hash, ObjectType* object) const {
+        auto range = entries.equal_range(hash);
+        for(auto p = range.first; p != range.second; ++p){
+            if(p->second.lock() == object){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<class EqualFunc>
+    ObjectType* find(uint64_t hash, EqualFunc isEqual) {
+        auto range = entries.equal_range(hash);
+        auto p = range.first;
+        while(p != range.second){
+            auto object = p->second.lock();
+            if(!object){
+                p = entries.erase(p);
+            } else {
+                if(isEqual(object)){
+                    return object;
+                }
+                ++p;
+            }
+        }
+        return nullptr;
+    }
+
+    void insert(uint64_t hash, ObjectType* object){
+        if(entries.size() >= purgeThreshold){
+            purge();
+            purgeThreshold = std::max(static_cast<size_t>(64), entries.size() * 2);
+        }
+        entries.emplace(hash, object);
+    }
+
+    void purge(){
+        auto p = entries.begin();
+        while(p != entries.end()){
+            if(p->second.expired()){
+                p = entries.erase(p);
+            } else {
+                ++p;
+            }
+        }
+    }
+};
+
+}
+
+namespace cnoid {
+
+class MeshPool::Impl
+{
+public:
+    WeakObjectTable<SgVertexArray> vector3Arrays;
+    WeakObjectTable<SgTexCoordArray> texCoordArrays;
+    WeakObjectTable<SgMesh> meshes;
+    mutable std::mutex mutex;
+
+    template<class ArrayType>
+    ArrayType* shareArray(ArrayType* array, WeakObjectTable<ArrayType>& table);
+    uint64_t hashMesh(SgMesh* mesh);
+    bool isSameMesh(SgMesh* mesh1, SgMesh* mesh2);
+    SgMesh* share(SgMesh* mesh);
+    void shareMeshes(SgNode* node);
+};
+
+}
+
+
+MeshPool* MeshPool::instance()
+{
+    static MeshPoolPtr pool = new MeshPool;
+    return pool;
+}
+
+
+MeshPool::MeshPool()
+{
+    impl = new Impl;
+}
+
+
+MeshPool::~MeshPool()
+{
+    delete impl;
+}
+
+
+SgMesh* MeshPool::share(SgMesh* mesh)
+{
+    lock_guard<std::mutex> lock(impl->mutex);
+    return impl->share(mesh);
+}
+
+
+template<class ArrayType>
+ArrayType* MeshPool::Impl::shareArray(ArrayType* array, WeakObjectTable<ArrayType>& table)
+{
+    if(!array){
+        return nullptr;
+    }
+    uint64_t hash = hashArray(*array, fnvOffsetBasis);
+    if(auto shared = table.find(hash, [array](ArrayType* a){ return a == array || isSameArray(*a, *array); })){
+        return shared;
+    }
+    table.insert(hash, array);
+    return array;
+}
+
+
+// The arrays are shared before this function is called, so their pointers are used as the keys
+uint64_t MeshPool::Impl::hashMesh(SgMesh* mesh)
+{
+    uint64_t hash = fnvOffsetBasis;
+    hash = hashValue(mesh->vertices(), hash);
+    hash = hashValue(mesh->normals(), hash);
+    hash = hashValue(mesh->colors(), hash);
+    hash = hashValue(mesh->texCoords(), hash);
+    hash = hashArray(mesh->triangleVertices(), hash);
+    hash = hashArray(mesh->normalIndices(), hash);
+    hash = hashArray(mesh->colorIndices(), hash);
+    hash = hashArray(mesh->texCoordIndices(), hash);
+    return hash;
+}
+
+
+bool MeshPool::Impl::isSameMesh(SgMesh* mesh1, SgMesh* mesh2)
+{
+    return (mesh1 == mesh2) ||
+        (mesh1->vertices() == mesh2->vertices() &&
+         mesh1->normals() == mesh2->normals() &&
+         mesh1->colors() == mesh2->colors() &&
+         mesh1->texCoords() == mesh2->texCoords() &&
+         mesh1->creaseAngle() == mesh2->creaseAngle() &&
+         mesh1->isSolid() == mesh2->isSolid() &&
+         mesh1->name() == mesh2->name() &&
+         isSameArray(mesh1->triangleVertices(), mesh2->triangleVertices()) &&
+         isSameArray(mesh1->normalIndices(), mesh2->normalIndices()) &&
+         isSameArray(mesh1->colorIndices(), mesh2->colorIndices()) &&
+         isSameArray(mesh1->texCoordIndices(), mesh2->texCoordIndices()) &&
+         isSamePrimitive(mesh1, mesh2));
+}
+
+
+SgMesh* MeshPool::Impl::share(SgMesh* mesh)
+{
+    if(!mesh){
+        return nullptr;
+    }
+
+    // Vertices, normals and colors have the same array type, so they share the same table
+    if(auto vertices = shareArray(mesh->vertices(), vector3Arrays)){
+        if(vertices != mesh->vertices()){
+            mesh->setVertices(vertices);
+        }
+    }
+    if(auto normals = shareArray(mesh->normals(), vector3Arrays)){
+        if(normals != mesh->normals()){
+            mesh->setNormals(normals);
+        }
+    }
+    if(auto colors = shareArray(mesh->colors(), vector3Arrays)){
+        if(colors != mesh->colors()){
+            mesh->setColors(colors);
+        }
+    }
+    if(auto texCoords = shareArray(mesh->texCoords(), texCoordArrays)){
+        if(texCoords != mesh->texCoords()){
+            mesh->setTexCoords(texCoords);
+        }
+    }
+
+    uint64_t hash = hashMesh(mesh);
+    if(auto shared = meshes.find(hash, [&](SgMesh* m){ return isSameMesh(m, mesh); })){
+        return shared;
+    }
+    meshes.insert(hash, mesh);
+    return mesh;
+}
+
+
+void MeshPool::shareMeshes(SgNode* scene)
+{
+    lock_guard<std::mutex> lock(impl->mutex);
+    impl->shareMeshes(scene);
+}
+
+
+void MeshPool::Impl::shareMeshes(SgNode* node)
+{
+    if(auto shape = dynamic_cast<SgShape*>(node)){
+        if(auto mesh = shape->mesh()){
+            auto shared = share(mesh);
+            if(shared != mesh){
+                shape->setMesh(shared);
+            }
+        }
+    } else if(auto group = dynamic_cast<SgGroup*>(node)){
+        for(auto& child : *group){
+            shareMeshes(child);
+        }
+    }
+}
+
+
+bool MeshPool::contains(SgMesh* mesh) const
+{
+    if(!mesh){
+        return false;
+    }
+    lock_guard<std::mutex> lock(impl->mutex);
+    return impl->meshes.contains(impl->hashMesh(mesh), mesh);
+}
+
+
+void MeshPool::clear()
+{
+    lock_guard<std::mutex> lock(impl->mutex);
+    impl->vector3Arrays.entries.clear();
+    impl->texCoordArrays.entries.clear();
+    impl->meshes.entries.clear();
+}
+
+
+int MeshPool::numMeshes() const
+{
+    lock_guard<std::mutex> lock(impl->mutex);
+    impl->meshes.purge();
+    return impl->meshes.entries.size();
+}
@@ -0,0 +1,64 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_MESH_POOL_H
+#define CNOID_UTIL_MESH_POOL_H
+
+#include "Referenced.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class SgMesh;
+
+/**
+   This class makes the meshes with the same content share the same objects.
+   The vertex, normal, color and texture coordinate arrays with the same values are replaced with
+   a single instance, and the shapes which have the meshes with the same content are made to refer
+   to a single mesh instance so that the index arrays are also shared. The pool only keeps weak
+   references to the objects, so the objects are released when they are no longer used.
+
+   \note The shared meshes and arrays must not be modified in place. Clone a shared object and
+   set the clone to the shape or the mesh to modify it.
+*/
+class CNOID_EXPORT MeshPool : public Referenced
+{
+public:
+    //! The pool shared in the process. The functions of the pool are thread-safe.
+    static MeshPool* instance();
+
+    MeshPool();
+    ~MeshPool();
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    /**
+       The arrays of the mesh are replaced with the shared ones.
+       \return The mesh in the pool with the same content as the given mesh. The given mesh is
+       registered and returned if there is no such mesh.
+    */
+    SgMesh* share(SgMesh* mesh);
+
+    //! The meshes of the shapes in the scene are replaced with the shared ones.
+    void shareMeshes(SgNode* scene);
+
+    //! This function returns true if the mesh is the one shared by the pool.
+    bool contains(SgMesh* mesh) const;
+
+    void clear();
+
+    //! The number of the meshes which are registered in the pool and still alive
+    int numMeshes() const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<MeshPool> MeshPoolPtr;
+
+}
+
+#endif
@@ -94,8 +94,8 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 if(v.size() != 7){
                     v.throwException(illegal_number_of_SE3_elements_message);
                 }
-                value.translation() << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
-                value.rotation() = Quaternion(v[3].toDouble(), v[4].toDouble(), v[5].toDouble(), v[6].toDouble());
+                value.translation() << v.doubleAt(0), v.doubleAt(1), v.doubleAt(2);
+                value.rotation() = Quaternion(v.doubleAt(3), v.doubleAt(4), v.doubleAt(5), v.doubleAt(6));
             });
 
     } else if(se3format == "XYZQXQYQZQW" && reader.formatVersion() < 2.0){
@@ -106,8 +106,8 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 if(v.size() != 7){
                     v.throwException(illegal_number_of_SE3_elements_message);
                 }
-                value.translation() << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
-                value.rotation() = Quaternion(v[6].toDouble(), v[3].toDouble(), v[4].toDouble(), v[5].toDouble());
+                value.translation() << v.doubleAt(0), v.doubleAt(1), v.doubleAt(2);
+                value.rotation() = Quaternion(v.doubleAt(6), v.doubleAt(3), v.doubleAt(4), v.doubleAt(5));
             });
 
     } else if(se3format == "XYZRPY"){
@@ -118,8 +118,8 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 if(v.size() != 6){
                     v.throwException(illegal_number_of_SE3_elements_message);
                 }
-                value.translation() << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
-                value.rotation() = rotFromRpy(v[3].toDouble(), v[4].toDouble(), v[5].toDouble());
+                value.translation() << v.doubleAt(0), v.doubleAt(1), v.doubleAt(2);
+                value.rotation() = rotFromRpy(v.doubleAt(3), v.doubleAt(4), v.doubleAt(5));
             });
 
     } else {
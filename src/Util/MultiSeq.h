@@ -85,6 +85,10 @@ public:
 
         Container::resize(newNumFrames, newNumParts);
 
+        if(newNumParts != prevNumParts){
+            clearPartLabels();
+        }
+
         if(fillNewElements){
             if(newNumParts != prevNumParts){
                 std::fill(Container::begin(), Container::end(), defaultValue());
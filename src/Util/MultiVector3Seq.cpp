@@ -69,7 +69,7 @@ bool MultiVector3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
             if(v.size() != 3){
                 v.throwException(_("The number of elements specified as a 3D vector is invalid."));
             }
-            value << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
+            value << v.doubleAt(0), v.doubleAt(1), v.doubleAt(2);
         });
 }
 
@@ -0,0 +1,300 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "ParallelScheduler.h"
+#include <deque>
+#include <thread>
+#include <memory>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+int maxNumThreads = 0;
+
+struct Task
+{
+    std::function<void()> function;
+    ParallelTaskGroup* group;
+};
+
+struct Worker
+{
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+};
+
+}
+
+namespace cnoid {
+
+class ParallelScheduler::Impl
+{
+public:
+    vector<unique_ptr<Worker>> workers;
+    std::mutex mutex;
+    std::deque<Task> injectedTasks;
+    std::condition_variable condition;
+    std::atomic<int> numQueuedTasks;
+    int numSleepingWorkers;
+    bool isStopping;
+
+    static thread_local Impl* currentScheduler;
+    static thread_local int currentWorkerIndex;
+
+    Impl(int numWorkerThreads);
+    ~Impl();
+    int getCurrentWorkerIndex() const;
+    void push(Task&& task);
+    bool pop(Task& out_task, int workerIndex);
+    bool popFront(std::deque<Task>& tasks, std::mutex& tasksMutex, Task& out_task);
+    bool executeOneTask(int workerIndex);
+    void runWorker(int workerIndex);
+};
+
+thread_local ParallelScheduler::Impl* ParallelScheduler::Impl::currentScheduler = nullptr;
+thread_local int ParallelScheduler::Impl::currentWorkerIndex = -1;
+
+}
+
+
+void ParallelScheduler::setMaxNumThreads(int n)
+{
+    maxNumThreads = n;
+}
+
+
+ParallelScheduler* ParallelScheduler::instance()
+{
+    static ParallelScheduler scheduler(
+        (maxNumThreads > 0 ? maxNumThreads : std::max(1, (int)std::thread::hardware_concurrency())) - 1);
+    return &scheduler;
+}
+
+
+ParallelScheduler::ParallelScheduler(int numWorkerThreads)
+{
+    impl = new Impl(std::max(1, numWorkerThreads));
+}
+
+
+ParallelScheduler::Impl::Impl(int numWorkerThreads)
+    : numQueuedTasks(0)
+{
+    numSleepingWorkers = 0;
+    isStopping = false;
+
+    workers.reserve(numWorkerThreads);
+    for(int i=0; i < numWorkerThreads; ++i){
+        workers.emplace_back(new Worker);
+    }
+    for(int i=0; i < numWorkerThreads; ++i){
+        workers[i]->thread = std::thread([this, i](){ runWorker(i); });
+    }
+}
+
+
+ParallelScheduler::~ParallelScheduler()
+{
+    delete impl;
+}
+
+
+ParallelScheduler::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+        condition.notify_all();
+    }
+    for(auto& worker : workers){
+        if(worker->thread.joinable()){
+            worker->thread.join();
+        }
+    }
+}
+
+
+int ParallelScheduler::concurrency() const
+{
+    return impl->workers.size() + 1;
+}
+
+
+int ParallelScheduler::numWorkerThreads() const
+{
+    return impl->workers.size();
+}
+
+
+bool ParallelScheduler::isWorkerThread() const
+{
+    return impl->getCurrentWorkerIndex() >= 0;
+}
+
+
+int ParallelScheduler::Impl::getCurrentWorkerIndex() const
+{
+    return (currentScheduler == this) ? currentWorkerIndex : -1;
+}
+
+
+void ParallelScheduler::Impl::push(Task&& task)
+{
+    int workerIndex = getCurrentWorkerIndex();
+    if(workerIndex >= 0){
+        auto& worker = workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->tasks.push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(mutex);
+        injectedTasks.push_back(std::move(task));
+    }
+    ++numQueuedTasks;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(numSleepingWorkers > 0){
+        condition.notify_one();
+    }
+}
+
+
+/**
+   A worker takes the newest task of its own deque first to make use of the cache,
+   and the oldest tasks of the other deques are taken when its own deque is empty.
+*/
+bool ParallelScheduler::Impl::pop(Task& out_task, int workerIndex)
+{
+    if(numQueuedTasks.load() == 0){
+        return false;
+    }
+
+    const int numWorkers = workers.size();
+
+    if(workerIndex >= 0){
+        auto& worker = workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if(!worker->tasks.empty()){
+            out_task = std::move(worker->tasks.back());
+            worker->tasks.pop_back();
+            --numQueuedTasks;
+            return true;
+        }
+    }
+
+    if(popFront(injectedTasks, mutex, out_task)){
+        return true;
+    }
+
+    for(int i=1; i <= numWorkers; ++i){
+        int victimIndex = (workerIndex + i) % numWorkers;
+        if(victimIndex < 0){
+            victimIndex += numWorkers;
+        }
+        if(victimIndex != workerIndex){
+            auto& victim = workers[victimIndex];
+            if(popFront(victim->tasks, victim->mutex, out_task)){
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+bool ParallelScheduler::Impl::popFront(std::deque<Task>& tasks, std::mutex& tasksMutex, Task& out_task)
+{
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    if(tasks.empty()){
+        return false;
+    }
+    out_task = std::move(tasks.front());
+    tasks.pop_front();
+    --numQueuedTasks;
+    return true;
+}
+
+
+bool ParallelScheduler::Impl::executeOneTask(int workerIndex)
+{
+    Task task;
+    if(!pop(task, workerIndex)){
+        return false;
+    }
+    task.function();
+    task.function = nullptr;
+    task.group->notifyTaskFinished();
+    return true;
+}
+
+
+void ParallelScheduler::Impl::runWorker(int workerIndex)
+{
+    currentScheduler = this;
+    currentWorkerIndex = workerIndex;
+
+    while(true){
+        if(executeOneTask(workerIndex)){
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if(numQueuedTasks.load() == 0){
+            if(isStopping){
+                break;
+            }
+            ++numSleepingWorkers;
+            condition.wait(lock, [this](){ return numQueuedTasks.load() > 0 || isStopping; });
+            --numSleepingWorkers;
+        }
+    }
+}
+
+
+ParallelTaskGroup::ParallelTaskGroup()
+    : numUnfinishedTasks(0)
+{
+    scheduler = ParallelScheduler::instance()->impl;
+}
+
+
+ParallelTaskGroup::~ParallelTaskGroup()
+{
+    wait();
+}
+
+
+void ParallelTaskGroup::run(std::function<void()> task)
+{
+    ++numUnfinishedTasks;
+    scheduler->push(Task{ std::move(task), this });
+}
+
+
+void ParallelTaskGroup::wait()
+{
+    const int workerIndex = scheduler->getCurrentWorkerIndex();
+
+    while(numUnfinishedTasks.load() > 0){
+        if(!scheduler->executeOneTask(workerIndex)){
+            std::unique_lock<std::mutex> lock(mutex);
+            finishCondition.wait(lock, [this](){ return numUnfinishedTasks.load() == 0; });
+        }
+    }
+
+    // Wait for the thread finishing the last task to release the mutex
+    std::lock_guard<std::mutex> lock(mutex);
+}
+
+
+void ParallelTaskGroup::notifyTaskFinished()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(--numUnfinishedTasks == 0){
+        finishCondition.notify_all();
+    }
+}
@@ -0,0 +1,145 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_PARALLEL_SCHEDULER_H
+#define CNOID_UTIL_PARALLEL_SCHEDULER_H
+
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ParallelTaskGroup;
+
+/**
+   The work-stealing task scheduler shared in the process.
+   Each worker thread has its own task deque, and an idle worker steals tasks from the other workers.
+   The total number of threads used for the parallel processing in the process is governed by this
+   scheduler, so the modules doing CPU intensive work should use this scheduler via ParallelTaskGroup,
+   parallelFor or parallelReduce instead of creating their own threads.
+*/
+class CNOID_EXPORT ParallelScheduler
+{
+public:
+    static ParallelScheduler* instance();
+
+    /**
+       This function sets the maximum number of threads including the thread waiting for the tasks.
+       It must be called before the scheduler instance is created by the first call of instance().
+       The number of hardware threads is used by default.
+    */
+    static void setMaxNumThreads(int n);
+
+    //! The number of threads that can execute tasks concurrently, including the thread waiting for them
+    int concurrency() const;
+    int numWorkerThreads() const;
+    bool isWorkerThread() const;
+
+    class Impl;
+
+private:
+    ParallelScheduler(int numWorkerThreads);
+    ~ParallelScheduler();
+    ParallelScheduler(const ParallelScheduler&) = delete;
+    ParallelScheduler& operator=(const ParallelScheduler&) = delete;
+
+    Impl* impl;
+
+    friend class ParallelTaskGroup;
+};
+
+
+/**
+   A set of tasks executed by ParallelScheduler. The wait function blocks until all the tasks
+   in the group are finished. The waiting thread executes pending tasks while they exist.
+*/
+class CNOID_EXPORT ParallelTaskGroup
+{
+public:
+    ParallelTaskGroup();
+    ~ParallelTaskGroup();
+    ParallelTaskGroup(const ParallelTaskGroup&) = delete;
+    ParallelTaskGroup& operator=(const ParallelTaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+    void wait();
+    bool isRunning() const { return numUnfinishedTasks.load() > 0; }
+
+private:
+    ParallelScheduler::Impl* scheduler;
+    std::atomic<int> numUnfinishedTasks;
+    std::mutex mutex;
+    std::condition_variable finishCondition;
+
+    void notifyTaskFinished();
+
+    friend class ParallelScheduler::Impl;
+};
+
+
+/**
+   The range [begin, end) is divided into the chunks of grainSize elements,
+   and function(chunkBegin, chunkEnd) is called for each chunk in parallel.
+*/
+template<class Function>
+void parallelFor(int begin, int end, int grainSize, Function function)
+{
+    if(grainSize < 1){
+        grainSize = 1;
+    }
+    if(end - begin <= grainSize){
+        if(begin < end){
+            function(begin, end);
+        }
+        return;
+    }
+    ParallelTaskGroup group;
+    for(int chunkBegin = begin + grainSize; chunkBegin < end; chunkBegin += grainSize){
+        const int chunkEnd = std::min(chunkBegin + grainSize, end);
+        group.run([&function, chunkBegin, chunkEnd](){ function(chunkBegin, chunkEnd); });
+    }
+    function(begin, begin + grainSize);
+    group.wait();
+}
+
+
+/**
+   The chunks of the range are processed by map(chunkBegin, chunkEnd) in parallel, and the results
+   are combined by reduce(value1, value2) in the order of the chunks. The chunk division only depends
+   on the grain size, so the result is deterministic regardless of the number of threads and the
+   task execution order even if the reduce operation is not associative like floating point addition.
+*/
+template<class Value, class MapFunction, class ReduceFunction>
+Value parallelReduce(
+    int begin, int end, int grainSize, const Value& identity, MapFunction map, ReduceFunction reduce)
+{
+    if(grainSize < 1){
+        grainSize = 1;
+    }
+    const int numChunks = (end > begin) ? ((end - begin + grainSize - 1) / grainSize) : 0;
+    std::vector<Value> partialValues(numChunks, identity);
+    parallelFor(
+        0, numChunks, 1,
+        [&](int chunkIndexBegin, int chunkIndexEnd){
+            for(int i = chunkIndexBegin; i < chunkIndexEnd; ++i){
+                const int chunkBegin = begin + i * grainSize;
+                partialValues[i] = map(chunkBegin, std::min(chunkBegin + grainSize, end));
+            }
+        });
+    Value value = identity;
+    for(auto& partialValue : partialValues){
+        value = reduce(value, partialValue);
+    }
+    return value;
+}
+
+}
+
+#endif
@@ -0,0 +1,340 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "PhaseProfiler.h"
+#include "UTF8.h"
+#include <fmt/format.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+struct Event
+{
+    int phaseId;
+    int threadId;
+    PhaseProfiler::Time beginTime;
+    PhaseProfiler::Time endTime;
+};
+
+struct Frame
+{
+    PhaseProfiler::Time beginTime;
+    PhaseProfiler::Time endTime;
+    vector<Event> events;
+};
+
+string escapeJsonString(const string& s)
+{
+    string escaped;
+    escaped.reserve(s.size());
+    for(auto c : s){
+        if(c == '"' || c == '\\'){
+            escaped += '\\';
+            escaped += c;
+        } else if(static_cast<unsigned char>(c) < 0x20){
+            escaped += format("\\u{:04x}", static_cast<int>(c));
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+}
+
+namespace cnoid {
+
+class PhaseProfiler::Impl
+{
+public:
+    vector<string> phaseNames;
+    unordered_map<string, int> phaseNameToIdMap;
+    vector<int> openEventIndices;
+    vector<Frame> frames;
+    Frame* currentFrame;
+    int nextFrameIndex;
+    int numRecordedFrames;
+
+    Impl(int numFramesToKeep);
+    int oldestFrameIndex() const {
+        const int n = frames.size();
+        return (nextFrameIndex - numRecordedFrames + n) % n;
+    }
+    const Frame& recordedFrame(int index) const {
+        return frames[(oldestFrameIndex() + index) % frames.size()];
+    }
+    void getFrameTimes(int phaseId, vector<double>& out_times) const;
+};
+
+}
+
+
+PhaseProfiler::PhaseProfiler(int numFramesToKeep)
+{
+    impl = new Impl(numFramesToKeep);
+}
+
+
+PhaseProfiler::Impl::Impl(int numFramesToKeep)
+    : frames(std::max(1, numFramesToKeep))
+{
+    currentFrame = nullptr;
+    nextFrameIndex = 0;
+    numRecordedFrames = 0;
+}
+
+
+PhaseProfiler::~PhaseProfiler()
+{
+    delete impl;
+}
+
+
+PhaseProfiler::Time PhaseProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void PhaseProfiler::clear()
+{
+    clearRecords();
+    impl->phaseNames.clear();
+    impl->phaseNameToIdMap.clear();
+    impl->openEventIndices.clear();
+}
+
+
+void PhaseProfiler::clearRecords()
+{
+    for(auto& frame : impl->frames){
+        frame.events.clear();
+    }
+    impl->currentFrame = nullptr;
+    impl->nextFrameIndex = 0;
+    impl->numRecordedFrames = 0;
+}
+
+
+void PhaseProfiler::setNumFramesToKeep(int n)
+{
+    n = std::max(1, n);
+    if(n != static_cast<int>(impl->frames.size())){
+        clearRecords();
+        impl->frames.resize(n);
+    }
+}
+
+
+int PhaseProfiler::numFramesToKeep() const
+{
+    return impl->frames.size();
+}
+
+
+int PhaseProfiler::numRecordedFrames() const
+{
+    return impl->numRecordedFrames;
+}
+
+
+int PhaseProfiler::addPhase(const std::string& name)
+{
+    auto inserted = impl->phaseNameToIdMap.emplace(name, impl->phaseNames.size());
+    if(inserted.second){
+        impl->phaseNames.push_back(name);
+        impl->openEventIndices.push_back(-1);
+    }
+    return inserted.first->second;
+}
+
+
+int PhaseProfiler::numPhases() const
+{
+    return impl->phaseNames.size();
+}
+
+
+const std::string& PhaseProfiler::phaseName(int phaseId) const
+{
+    return impl->phaseNames[phaseId];
+}
+
+
+void PhaseProfiler::beginFrame()
+{
+    auto& frame = impl->frames[impl->nextFrameIndex];
+    frame.events.clear();
+    frame.beginTime = now();
+    impl->currentFrame = &frame;
+}
+
+
+void PhaseProfiler::endFrame()
+{
+    if(impl->currentFrame){
+        impl->currentFrame->endTime = now();
+        impl->currentFrame = nullptr;
+        impl->nextFrameIndex = (impl->nextFrameIndex + 1) % impl->frames.size();
+        if(impl->numRecordedFrames < static_cast<int>(impl->frames.size())){
+            ++impl->numRecordedFrames;
+        }
+    }
+}
+
+
+void PhaseProfiler::beginPhase(int phaseId)
+{
+    if(auto frame = impl->currentFrame){
+        impl->openEventIndices[phaseId] = frame->events.size();
+        const Time time = now();
+        frame->events.push_back(Event{ phaseId, 0, time, time });
+    }
+}
+
+
+void PhaseProfiler::endPhase(int phaseId)
+{
+    if(auto frame = impl->currentFrame){
+        int& index = impl->openEventIndices[phaseId];
+        if(index >= 0 && index < static_cast<int>(frame->events.size())){
+            frame->events[index].endTime = now();
+        }
+        index = -1;
+    }
+}
+
+
+void PhaseProfiler::addPhaseRecord(int phaseId, Time beginTime, Time endTime, int threadId)
+{
+    if(auto frame = impl->currentFrame){
+        frame->events.push_back(Event{ phaseId, threadId, beginTime, endTime });
+    }
+}
+
+
+/**
+   The times of the phase recorded several times in a frame are summed up,
+   and the frames that do not include the phase are skipped.
+*/
+void PhaseProfiler::Impl::getFrameTimes(int phaseId, vector<double>& out_times) const
+{
+    out_times.clear();
+    out_times.reserve(numRecordedFrames);
+    for(int i=0; i < numRecordedFrames; ++i){
+        auto& frame = recordedFrame(i);
+        if(phaseId < 0){
+            out_times.push_back((frame.endTime - frame.beginTime) * 1.0e-9);
+        } else {
+            Time sum = 0;
+            bool found = false;
+            for(auto& event : frame.events){
+                if(event.phaseId == phaseId){
+                    sum += event.endTime - event.beginTime;
+                    found = true;
+                }
+            }
+            if(found){
+                out_times.push_back(sum * 1.0e-9);
+            }
+        }
+    }
+}
+
+
+PhaseProfiler::Statistics PhaseProfiler::statistics(int phaseId) const
+{
+    Statistics stat{ 0, 0.0, 0.0, 0.0, 0.0 };
+    vector<double> times;
+    impl->getFrameTimes(phaseId, times);
+    const int n = times.size();
+    if(n > 0){
+        std::sort(times.begin(), times.end());
+        double sum = 0.0;
+        for(auto& t : times){
+            sum += t;
+        }
+        stat.numFrames = n;
+        stat.mean = sum / n;
+        stat.median = times[(n - 1) / 2];
+        stat.p99 = times[std::max(0, static_cast<int>(std::ceil(n * 0.99)) - 1)];
+        stat.max = times.back();
+    }
+    return stat;
+}
+
+
+void PhaseProfiler::putSummary(std::ostream& os) const
+{
+    int nameWidth = 5;
+    for(auto& name : impl->phaseNames){
+        nameWidth = std::max(nameWidth, static_cast<int>(name.size()));
+    }
+
+    os << format("Profile of the last {} frames [ms]:\n", impl->numRecordedFrames);
+    os << format("  {:<{}} {:>10} {:>10} {:>10} {:>10} {:>8}\n",
+                 "Phase", nameWidth, "Mean", "P50", "P99", "Max", "Frames");
+
+    auto putStatistics = [&](const string& name, const Statistics& stat){
+        os << format("  {:<{}} {:>10.4f} {:>10.4f} {:>10.4f} {:>10.4f} {:>8}\n",
+                     name, nameWidth, stat.mean * 1.0e3, stat.median * 1.0e3,
+                     stat.p99 * 1.0e3, stat.max * 1.0e3, stat.numFrames);
+    };
+
+    putStatistics("Frame", statistics(-1));
+    for(size_t i=0; i < impl->phaseNames.size(); ++i){
+        auto stat = statistics(i);
+        if(stat.numFrames > 0){
+            putStatistics(impl->phaseNames[i], stat);
+        }
+    }
+}
+
+
+bool PhaseProfiler::exportChromeTrace(const std::string& filename) const
+{
+    ofstream ofs(fromUTF8(filename).c_str());
+    if(!ofs){
+        return false;
+    }
+    writeChromeTrace(ofs);
+    return !ofs.fail();
+}
+
+
+void PhaseProfiler::writeChromeTrace(std::ostream& os) const
+{
+    if(impl->numRecordedFrames == 0){
+        os << "{\"traceEvents\":[]}\n";
+        return;
+    }
+
+    const Time origin = impl->recordedFrame(0).beginTime;
+    auto putEvent = [&](const string& name, int threadId, Time beginTime, Time endTime, bool isFirst){
+        os << format("{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                     isFirst ? "\n" : ",\n", escapeJsonString(name), threadId,
+                     (beginTime - origin) * 1.0e-3, (endTime - beginTime) * 1.0e-3);
+    };
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for(int i=0; i < impl->numRecordedFrames; ++i){
+        auto& frame = impl->recordedFrame(i);
+        putEvent("Frame", 0, frame.beginTime, frame.endTime, i == 0);
+        for(auto& event : frame.events){
+            putEvent(impl->phaseNames[event.phaseId], event.threadId, event.beginTime, event.endTime, false);
+        }
+    }
+    os << "\n]}\n";
+}
@@ -0,0 +1,108 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_PHASE_PROFILER_H
+#define CNOID_UTIL_PHASE_PROFILER_H
+
+#include <string>
+#include <iosfwd>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the elapsed times of the phases processed in each frame of a loop such as
+   the simulation loop. The records of the latest frames are kept in a ring buffer, and the summary
+   of them or the Chrome trace format file of them can be output.
+   The beginFrame, endFrame, beginPhase and endPhase functions must be called from the same thread.
+   The phases processed in the other threads can be recorded with addPhaseRecord after the thread
+   that processes the frame is synchronized with them.
+*/
+class CNOID_EXPORT PhaseProfiler
+{
+public:
+    //! Time stamp in nanoseconds of the steady clock
+    typedef int64_t Time;
+
+    PhaseProfiler(int numFramesToKeep = 10000);
+    ~PhaseProfiler();
+    PhaseProfiler(const PhaseProfiler&) = delete;
+    PhaseProfiler& operator=(const PhaseProfiler&) = delete;
+
+    static Time now();
+
+    //! This function clears both the registered phases and the records
+    void clear();
+    void clearRecords();
+    void setNumFramesToKeep(int n);
+    int numFramesToKeep() const;
+    int numRecordedFrames() const;
+
+    /**
+       \return The phase id given to the other functions.
+       \note The id of the phase with the same name is returned if it has already been registered.
+    */
+    int addPhase(const std::string& name);
+    int numPhases() const;
+    const std::string& phaseName(int phaseId) const;
+
+    void beginFrame();
+    void endFrame();
+    void beginPhase(int phaseId);
+    void endPhase(int phaseId);
+
+    /**
+       \param threadId The id of the thread that processed the phase. Zero corresponds to the thread
+       processing the frame, and the other values can be used to distinguish the other threads.
+    */
+    void addPhaseRecord(int phaseId, Time beginTime, Time endTime, int threadId = 0);
+
+    //! This class records a phase in its scope. The profiler can be a null pointer.
+    class Scope
+    {
+    public:
+        Scope(PhaseProfiler* profiler, int phaseId) : profiler(profiler), phaseId(phaseId) {
+            if(profiler){
+                profiler->beginPhase(phaseId);
+            }
+        }
+        ~Scope(){
+            if(profiler){
+                profiler->endPhase(phaseId);
+            }
+        }
+    private:
+        PhaseProfiler* profiler;
+        int phaseId;
+    };
+
+    //! Statistics of the time in seconds spent in a phase per frame
+    struct Statistics
+    {
+        int numFrames;
+        double mean;
+        double median;
+        double p99;
+        double max;
+    };
+
+    //! The statistics of the whole frame are returned if phaseId is -1.
+    Statistics statistics(int phaseId) const;
+
+    void putSummary(std::ostream& os) const;
+
+    //! The file can be loaded in chrome://tracing or Perfetto UI.
+    bool exportChromeTrace(const std::string& filename) const;
+    void writeChromeTrace(std::ostream& os) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
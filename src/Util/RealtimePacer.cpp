@@ -0,0 +1,142 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "RealtimePacer.h"
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#if defined(__linux__)
+#include <time.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+void sleepUntil(RealtimePacer::Time time)
+{
+#if defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = time / 1000000000;
+    ts.tv_nsec = time % 1000000000;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR){ }
+#else
+    std::this_thread::sleep_until(
+        std::chrono::steady_clock::time_point(std::chrono::nanoseconds(time)));
+#endif
+}
+
+}
+
+
+RealtimePacer::RealtimePacer()
+{
+    period_ = 1000000;
+    spinTime_ = 0;
+    maxCatchUpDelay = 100000000;
+    start();
+}
+
+
+RealtimePacer::Time RealtimePacer::now()
+{
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<Time>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+void RealtimePacer::setPeriod(double period)
+{
+    period_ = std::max(Time(1), static_cast<Time>(period * 1.0e9 + 0.5));
+}
+
+
+void RealtimePacer::setSpinTime(double time)
+{
+    spinTime_ = std::max(Time(0), static_cast<Time>(time * 1.0e9 + 0.5));
+}
+
+
+void RealtimePacer::setMaxCatchUpDelay(double delay)
+{
+    maxCatchUpDelay = std::max(Time(0), static_cast<Time>(delay * 1.0e9 + 0.5));
+}
+
+
+void RealtimePacer::start()
+{
+    numPeriods = 0;
+    numOverruns = 0;
+    numResets = 0;
+    numWaits = 0;
+    jitterSum = 0;
+    maxJitter = 0;
+    maxOverrun = 0;
+    resume();
+}
+
+
+void RealtimePacer::resume()
+{
+    deadline = now() + period_;
+}
+
+
+void RealtimePacer::wait()
+{
+    ++numPeriods;
+
+    Time current = now();
+    const Time delay = current - deadline;
+
+    if(delay >= 0){
+        ++numOverruns;
+        maxOverrun = std::max(maxOverrun, delay);
+        if(delay > maxCatchUpDelay){
+            ++numResets;
+            deadline = current;
+        }
+    } else {
+        if(spinTime_ > 0){
+            const Time wakeUpTime = deadline - spinTime_;
+            if(wakeUpTime > current){
+                sleepUntil(wakeUpTime);
+            }
+            do {
+                current = now();
+            } while(current < deadline);
+        } else {
+            sleepUntil(deadline);
+            current = now();
+        }
+        const Time jitter = current - deadline;
+        jitterSum += jitter;
+        maxJitter = std::max(maxJitter, jitter);
+        ++numWaits;
+    }
+
+    deadline += period_;
+}
+
+
+RealtimePacer::Statistics RealtimePacer::statistics() const
+{
+    Statistics stat;
+    stat.numPeriods = numPeriods;
+    stat.numOverruns = numOverruns;
+    stat.numResets = numResets;
+    stat.meanJitter = (numWaits > 0) ? (jitterSum * 1.0e-9 / numWaits) : 0.0;
+    stat.maxJitter = maxJitter * 1.0e-9;
+    stat.maxOverrun = maxOverrun * 1.0e-9;
+    return stat;
+}
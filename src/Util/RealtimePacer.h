@@ -0,0 +1,85 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_REALTIME_PACER_H
+#define CNOID_UTIL_REALTIME_PACER_H
+
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class paces a loop to the real time with a constant period.
+   The deadlines of the periods are given as the absolute times of the monotonic clock so that the
+   sleep errors are not accumulated, and the thread sleeps with the nanosecond resolution where it
+   is available. The final part of each sleep can be replaced with a spin to reduce the wake-up
+   latency of the system at the cost of the CPU time.
+*/
+class CNOID_EXPORT RealtimePacer
+{
+public:
+    //! Time stamp in nanoseconds of the monotonic clock
+    typedef int64_t Time;
+
+    RealtimePacer();
+
+    static Time now();
+
+    void setPeriod(double period);
+    double period() const { return period_ * 1.0e-9; }
+
+    //! The spin is disabled when the time is zero, which is the default.
+    void setSpinTime(double time);
+    double spinTime() const { return spinTime_ * 1.0e-9; }
+
+    /**
+       When the loop is delayed more than this time, the delayed periods are abandoned and the
+       schedule restarts from the current time. Otherwise the following periods are processed without
+       sleeps until the delay is recovered. The default value is 0.1 seconds.
+    */
+    void setMaxCatchUpDelay(double delay);
+
+    //! This function starts the schedule and clears the statistics.
+    void start();
+
+    //! This function restarts the schedule from the current time, e.g. after a pause.
+    void resume();
+
+    //! This function waits until the end of the current period.
+    void wait();
+
+    struct Statistics
+    {
+        int numPeriods;
+        //! The number of the periods whose processing exceeded the deadline
+        int numOverruns;
+        int numResets;
+        //! Statistics of the differences between the wake-up times and the deadlines in seconds
+        double meanJitter;
+        double maxJitter;
+        //! The largest delay of the overrun periods in seconds
+        double maxOverrun;
+    };
+
+    Statistics statistics() const;
+
+private:
+    Time period_;
+    Time spinTime_;
+    Time maxCatchUpDelay;
+    Time deadline;
+    int numPeriods;
+    int numOverruns;
+    int numResets;
+    int numWaits;
+    Time jitterSum;
+    Time maxJitter;
+    Time maxOverrun;
+};
+
+}
+
+#endif
@@ -8,10 +8,10 @@
 #include "NullOut.h"
 #include "strtofloat.h"
 #include "UTF8.h"
+#include "ParallelScheduler.h"
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <fstream>
-#include <thread>
 #include <stdexcept>
 #include <cstdlib>
 #include "gettext.h"
@@ -254,7 +254,8 @@ public:
     size_t normalIndicesIndex;
     
     BoundingBoxf bbox;
-    thread loaderThread;
+    ParallelTaskGroup concurrentTask;
+    bool isConcurrentTaskStarted;
 
     // For the mesh integration
     int vertexArrayOffset;
@@ -275,6 +276,7 @@ public:
     void addNormal(const Vector3f& normal, AddIndexFunction addIndex);
     template<typename AddIndexFunction>
     void addVertex(const Vector3f& vertex, AddIndexFunction addIndex);
+    void startConcurrentTask(std::function<void()> task);
     bool join();
     int findElement(
         const Vector3f& element, const SgVectorArray<Vector3f>& prevElements, int searchLength);
@@ -375,6 +377,8 @@ MeshLoader::MeshLoader(size_t numTriangles)
     
     sharedMesh->setNumTriangles(numTriangles);
     normalIndices->resize(numTriangles * 3);
+
+    isConcurrentTaskStarted = false;
 }
 
 
@@ -387,6 +391,7 @@ MeshLoader::MeshLoader(const MeshLoader& mainLoader)
     triangleVertices = nullptr;
     normals = new SgNormalArray;
     normalIndices = nullptr;
+    isConcurrentTaskStarted = false;
 }
 
 
@@ -462,10 +467,18 @@ void MeshLoader::addVertex(const Vector3f& vertex, AddIndexFunction addIndex)
 }
 
 
+void MeshLoader::startConcurrentTask(std::function<void()> task)
+{
+    isConcurrentTaskStarted = true;
+    concurrentTask.run(task);
+}
+
+
 bool MeshLoader::join()
 {
-    if(loaderThread.joinable()){
-        loaderThread.join();
+    if(isConcurrentTaskStarted){
+        concurrentTask.wait();
+        isConcurrentTaskStarted = false;
         return true;
     }
     return false;
@@ -608,7 +621,7 @@ void MeshLoader::integrate()
 
 void MeshLoader::integrateConcurrently()
 {
-    loaderThread = thread([this](){ integrate(); });
+    startConcurrentTask([this](){ integrate(); });
 }
  
 
@@ -639,7 +652,7 @@ STLSceneLoader::STLSceneLoader()
 
 STLSceneLoaderImpl::STLSceneLoaderImpl()
 {
-    maxNumThreads = std::max((unsigned)1, thread::hardware_concurrency());
+    maxNumThreads = ParallelScheduler::instance()->concurrency();
 
     os_ = &nullout();
 }
@@ -829,7 +842,7 @@ void BinaryMeshLoader::load(ifstream& ifs, size_t triangleOffset, size_t numTria
 
 void BinaryMeshLoader::loadConcurrently(const string& filename, size_t triangleOffset, size_t numTriangles)
 {
-    loaderThread = thread(
+    startConcurrentTask(
         [this, filename, triangleOffset, numTriangles](){
             ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
             load(ifs, triangleOffset, numTriangles);
@@ -981,7 +994,7 @@ bool AsciiMeshLoader::load()
 
 void AsciiMeshLoader::loadConcurrently()
 {
-    loaderThread = thread([this](){ load(); });
+    startConcurrentTask([this](){ load(); });
 }
 
 
@@ -0,0 +1,664 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SceneCache.h"
+#include "SceneDrawables.h"
+#include "MappedFile.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <unordered_map>
+#include <functional>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <typeinfo>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char cacheFileMagic[] = { 'C', 'S', 'G', 'C' };
+const int32_t cacheFormatVersion = 2;
+
+mutex configMutex;
+string cacheDirectory_;
+bool isCacheDirectoryInitialized = false;
+// The formats which do not refer to other files such as inline scenes and material files
+set<string> cacheableExtensions = { "stl", "dae" };
+
+enum ObjectTag {
+    NullTag = 0,
+    ReferenceTag,
+    GroupTag,
+    PosTransformTag,
+    ScaleTransformTag,
+    ShapeTag,
+    MeshTag,
+    MaterialTag,
+    Vector3fArrayTag,
+    Vector2fArrayTag
+};
+
+uint64_t hashBytes(const char* data, size_t size, uint64_t hash)
+{
+    // FNV-1a applied to 64-bit words for speed
+    const uint64_t prime = 0x100000001b3ULL;
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)){
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for(; i < size; ++i){
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+    }
+    return hash;
+}
+
+
+class CacheWriter
+{
+public:
+    vector<char> buf;
+    unordered_map<const SgObject*, uint32_t> objectIds;
+
+    template<class T> void write(const T& value){
+        const char* p = reinterpret_cast<const char*>(&value);
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+    void writeString(const string& str){
+        write<uint32_t>(str.size());
+        buf.insert(buf.end(), str.begin(), str.end());
+    }
+    void writeIndices(const SgIndexArray& indices){
+        write<uint32_t>(indices.size());
+        const char* p = reinterpret_cast<const char*>(indices.data());
+        buf.insert(buf.end(), p, p + indices.size() * sizeof(int));
+    }
+
+    //! \return False if the object has already been written
+    bool writeHeader(const SgObject* object, ObjectTag tag);
+    bool writeNode(const SgNode* node);
+    bool writeMesh(const SgMesh* mesh);
+    void writeMaterial(const SgMaterial* material);
+    template<class ArrayType> void writeArray(const ArrayType* array, ObjectTag tag);
+};
+
+
+class CacheReader
+{
+public:
+    const char* data;
+    size_t size;
+    size_t pos;
+    vector<SgObjectPtr> objects;
+    vector<SgMesh*> meshesWithSourceUri;
+
+    class Error { };
+
+    CacheReader(const char* data, size_t size) : data(data), size(size), pos(0) { }
+
+    void ensureSize(size_t n){
+        if(size - pos < n){
+            throw Error();
+        }
+    }
+    template<class T> T read(){
+        T value;
+        ensureSize(sizeof(T));
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    Vector3f readVector3f(){
+        Vector3f v;
+        for(int i=0; i < 3; ++i){
+            v[i] = read<float>();
+        }
+        return v;
+    }
+    string readString(){
+        uint32_t length = read<uint32_t>();
+        ensureSize(length);
+        string str(data + pos, length);
+        pos += length;
+        return str;
+    }
+    void readIndices(SgIndexArray& indices){
+        uint32_t n = read<uint32_t>();
+        ensureSize(static_cast<size_t>(n) * sizeof(int));
+        indices.resize(n);
+        memcpy(indices.data(), data + pos, n * sizeof(int));
+        pos += n * sizeof(int);
+    }
+
+    /**
+       \param create The function to create the object for the tag, which returns null for an invalid tag
+       \param readContent The function to read the content of a created object
+       \return Null if the tag is NullTag
+    */
+    template<class ObjectType>
+    ObjectType* readObject(
+        const std::function<ObjectType*(int tag)>& create, const std::function<void(ObjectType* object)>& readContent);
+    SgNode* readNode();
+    void readGroupContent(SgGroup* group);
+    void readShapeContent(SgShape* shape);
+    void readMeshContent(SgMesh* mesh);
+    void readMaterialContent(SgMaterial* material);
+    template<class ArrayType> ArrayType* readArray(ObjectTag tag);
+};
+
+}
+
+
+bool CacheWriter::writeHeader(const SgObject* object, ObjectTag tag)
+{
+    auto inserted = objectIds.insert(make_pair(object, static_cast<uint32_t>(objectIds.size())));
+    if(!inserted.second){
+        write<uint8_t>(ReferenceTag);
+        write<uint32_t>(inserted.first->second);
+        return false;
+    }
+    write<uint8_t>(tag);
+    writeString(object->name());
+    return true;
+}
+
+
+bool CacheWriter::writeNode(const SgNode* node)
+{
+    const type_info& type = typeid(*node);
+
+    ObjectTag tag;
+    if(type == typeid(SgGroup)){
+        tag = GroupTag;
+    } else if(type == typeid(SgPosTransform)){
+        tag = PosTransformTag;
+    } else if(type == typeid(SgScaleTransform)){
+        tag = ScaleTransformTag;
+    } else if(type == typeid(SgShape)){
+        tag = ShapeTag;
+    } else {
+        return false;
+    }
+
+    if(!writeHeader(node, tag)){
+        return true;
+    }
+
+    if(tag == ShapeTag){
+        auto shape = static_cast<const SgShape*>(node);
+        if(shape->texture()){
+            return false;
+        }
+        if(!writeMesh(shape->mesh())){
+            return false;
+        }
+        writeMaterial(shape->material());
+        return true;
+    }
+
+    if(tag == PosTransformTag){
+        auto transform = static_cast<const SgPosTransform*>(node);
+        Eigen::Map<const Eigen::Matrix<double, 3, 4>> T(transform->T().matrix().data());
+        for(int i=0; i < 12; ++i){
+            write<double>(T.data()[i]);
+        }
+    } else if(tag == ScaleTransformTag){
+        auto& scale = static_cast<const SgScaleTransform*>(node)->scale();
+        for(int i=0; i < 3; ++i){
+            write<double>(scale[i]);
+        }
+    }
+
+    auto group = static_cast<const SgGroup*>(node);
+    const int n = group->numChildren();
+    write<uint32_t>(n);
+    for(int i=0; i < n; ++i){
+        if(!writeNode(group->child(i))){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool CacheWriter::writeMesh(const SgMesh* mesh)
+{
+    if(!mesh){
+        write<uint8_t>(NullTag);
+        return true;
+    }
+    if(typeid(*mesh) != typeid(SgMesh)){
+        return false;
+    }
+    if(!writeHeader(mesh, MeshTag)){
+        return true;
+    }
+
+    write<uint8_t>(!mesh->uri().empty());
+    write<float>(mesh->creaseAngle());
+    write<uint8_t>(mesh->isSolid());
+
+    const int primitiveType = mesh->primitiveType();
+    write<int32_t>(primitiveType);
+    switch(primitiveType){
+    case SgMesh::BOX:
+    {
+        auto& box = mesh->primitive<SgMesh::Box>();
+        for(int i=0; i < 3; ++i){
+            write<double>(box.size[i]);
+        }
+        break;
+    }
+    case SgMesh::SPHERE:
+        write<double>(mesh->primitive<SgMesh::Sphere>().radius);
+        break;
+    case SgMesh::CYLINDER:
+    {
+        auto& cylinder = mesh->primitive<SgMesh::Cylinder>();
+        write<double>(cylinder.radius);
+        write<double>(cylinder.height);
+        write<uint8_t>(cylinder.bottom);
+        write<uint8_t>(cylinder.side);
+        write<uint8_t>(cylinder.top);
+        break;
+    }
+    case SgMesh::CONE:
+    {
+        auto& cone = mesh->primitive<SgMesh::Cone>();
+        write<double>(cone.radius);
+        write<double>(cone.height);
+        write<uint8_t>(cone.bottom);
+        write<uint8_t>(cone.side);
+        break;
+    }
+    case SgMesh::CAPSULE:
+    {
+        auto& capsule = mesh->primitive<SgMesh::Capsule>();
+        write<double>(capsule.radius);
+        write<double>(capsule.height);
+        break;
+    }
+    default:
+        break;
+    }
+
+    writeArray(mesh->vertices(), Vector3fArrayTag);
+    writeArray(mesh->normals(), Vector3fArrayTag);
+    writeIndices(mesh->normalIndices());
+    writeArray(mesh->colors(), Vector3fArrayTag);
+    writeIndices(mesh->colorIndices());
+    writeArray(mesh->texCoords(), Vector2fArrayTag);
+    writeIndices(mesh->texCoordIndices());
+    writeIndices(mesh->triangleVertices());
+
+    return true;
+}
+
+
+void CacheWriter::writeMaterial(const SgMaterial* material)
+{
+    if(!material){
+        write<uint8_t>(NullTag);
+    } else if(writeHeader(material, MaterialTag)){
+        write<float>(material->ambientIntensity());
+        write(material->diffuseColor());
+        write(material->emissiveColor());
+        write(material->specularColor());
+        write<float>(material->shininess());
+        write<float>(material->transparency());
+    }
+}
+
+
+template<class ArrayType>
+void CacheWriter::writeArray(const ArrayType* array, ObjectTag tag)
+{
+    if(!array){
+        write<uint8_t>(NullTag);
+    } else if(writeHeader(array, tag)){
+        typedef typename ArrayType::value_type VectorType;
+        write<uint32_t>(array->size());
+        if(!array->empty()){
+            const char* p = reinterpret_cast<const char*>(array->data());
+            buf.insert(buf.end(), p, p + array->size() * sizeof(VectorType));
+        }
+    }
+}
+
+
+template<class ObjectType>
+ObjectType* CacheReader::readObject
+(const std::function<ObjectType*(int tag)>& create, const std::function<void(ObjectType* object)>& readContent)
+{
+    int tag = read<uint8_t>();
+    if(tag == NullTag){
+        return nullptr;
+    }
+    if(tag == ReferenceTag){
+        uint32_t id = read<uint32_t>();
+        if(id >= objects.size()){
+            throw Error();
+        }
+        auto object = dynamic_cast<ObjectType*>(objects[id].get());
+        if(!object){
+            throw Error();
+        }
+        return object;
+    }
+    auto object = create(tag);
+    if(!object){
+        throw Error();
+    }
+    // The object is registered before its content to keep the same id order as the writer
+    objects.push_back(object);
+    object->setName(readString());
+    readContent(object);
+    return object;
+}
+
+
+SgNode* CacheReader::readNode()
+{
+    auto node = readObject<SgNode>(
+        [](int tag) -> SgNode* {
+            switch(tag){
+            case GroupTag: return new SgGroup;
+            case PosTransformTag: return new SgPosTransform;
+            case ScaleTransformTag: return new SgScaleTransform;
+            case ShapeTag: return new SgShape;
+            default: return nullptr;
+            }
+        },
+        [&](SgNode* node){
+            if(auto shape = dynamic_cast<SgShape*>(node)){
+                readShapeContent(shape);
+            } else {
+                readGroupContent(static_cast<SgGroup*>(node));
+            }
+        });
+
+    if(!node){
+        throw Error();
+    }
+    return node;
+}
+
+
+void CacheReader::readGroupContent(SgGroup* group)
+{
+    if(auto transform = dynamic_cast<SgPosTransform*>(group)){
+        Eigen::Matrix<double, 3, 4> T;
+        for(int i=0; i < 12; ++i){
+            T.data()[i] = read<double>();
+        }
+        transform->T().matrix().topRows<3>() = T;
+    } else if(auto transform = dynamic_cast<SgScaleTransform*>(group)){
+        Vector3 scale;
+        for(int i=0; i < 3; ++i){
+            scale[i] = read<double>();
+        }
+        transform->setScale(scale);
+    }
+
+    const uint32_t n = read<uint32_t>();
+    for(uint32_t i=0; i < n; ++i){
+        group->addChild(readNode());
+    }
+}
+
+
+void CacheReader::readShapeContent(SgShape* shape)
+{
+    shape->setMesh(
+        readObject<SgMesh>(
+            [](int tag){ return (tag == MeshTag) ? new SgMesh : nullptr; },
+            [&](SgMesh* mesh){ readMeshContent(mesh); }));
+
+    shape->setMaterial(
+        readObject<SgMaterial>(
+            [](int tag){ return (tag == MaterialTag) ? new SgMaterial : nullptr; },
+            [&](SgMaterial* material){ readMaterialContent(material); }));
+}
+
+
+void CacheReader::readMeshContent(SgMesh* mesh)
+{
+    if(read<uint8_t>()){
+        meshesWithSourceUri.push_back(mesh);
+    }
+    mesh->setCreaseAngle(read<float>());
+    mesh->setSolid(read<uint8_t>());
+
+    switch(read<int32_t>()){
+    case SgMesh::MESH:
+        break;
+    case SgMesh::BOX:
+    {
+        Vector3 size;
+        for(int i=0; i < 3; ++i){
+            size[i] = read<double>();
+        }
+        mesh->setPrimitive(SgMesh::Box(size));
+        break;
+    }
+    case SgMesh::SPHERE:
+        mesh->setPrimitive(SgMesh::Sphere(read<double>()));
+        break;
+    case SgMesh::CYLINDER:
+    {
+        double radius = read<double>();
+        SgMesh::Cylinder cylinder(radius, read<double>());
+        cylinder.bottom = read<uint8_t>();
+        cylinder.side = read<uint8_t>();
+        cylinder.top = read<uint8_t>();
+        mesh->setPrimitive(cylinder);
+        break;
+    }
+    case SgMesh::CONE:
+    {
+        double radius = read<double>();
+        SgMesh::Cone cone(radius, read<double>());
+        cone.bottom = read<uint8_t>();
+        cone.side = read<uint8_t>();
+        mesh->setPrimitive(cone);
+        break;
+    }
+    case SgMesh::CAPSULE:
+    {
+        double radius = read<double>();
+        mesh->setPrimitive(SgMesh::Capsule(radius, read<double>()));
+        break;
+    }
+    default:
+        throw Error();
+    }
+
+    mesh->setVertices(readArray<SgVertexArray>(Vector3fArrayTag));
+    mesh->setNormals(readArray<SgNormalArray>(Vector3fArrayTag));
+    readIndices(mesh->normalIndices());
+    mesh->setColors(readArray<SgColorArray>(Vector3fArrayTag));
+    readIndices(mesh->colorIndices());
+    mesh->setTexCoords(readArray<SgTexCoordArray>(Vector2fArrayTag));
+    readIndices(mesh->texCoordIndices());
+    readIndices(mesh->triangleVertices());
+
+    mesh->updateBoundingBox();
+}
+
+
+void CacheReader::readMaterialContent(SgMaterial* material)
+{
+    material->setAmbientIntensity(read<float>());
+    material->setDiffuseColor(readVector3f());
+    material->setEmissiveColor(readVector3f());
+    material->setSpecularColor(readVector3f());
+    material->setShininess(read<float>());
+    material->setTransparency(read<float>());
+}
+
+
+template<class ArrayType>
+ArrayType* CacheReader::readArray(ObjectTag tag)
+{
+    typedef typename ArrayType::value_type VectorType;
+
+    return readObject<ArrayType>(
+        [tag](int t){ return (t == tag) ? new ArrayType : nullptr; },
+        [&](ArrayType* array){
+            uint32_t n = read<uint32_t>();
+            ensureSize(static_cast<size_t>(n) * sizeof(VectorType));
+            array->resize(n);
+            if(n > 0){
+                memcpy(array->data(), data + pos, n * sizeof(VectorType));
+                pos += n * sizeof(VectorType);
+            }
+        });
+}
+
+
+void SceneCache::setCacheDirectory(const std::string& directory)
+{
+    lock_guard<mutex> lock(configMutex);
+    cacheDirectory_ = directory;
+    isCacheDirectoryInitialized = true;
+}
+
+
+std::string SceneCache::cacheDirectory()
+{
+    lock_guard<mutex> lock(configMutex);
+    if(!isCacheDirectoryInitialized){
+        if(const char* dir = getenv("CNOID_SCENE_CACHE_DIR")){
+            cacheDirectory_ = toUTF8(dir);
+        }
+        isCacheDirectoryInitialized = true;
+    }
+    return cacheDirectory_;
+}
+
+
+void SceneCache::addCacheableExtensions(const char* extensions)
+{
+    lock_guard<mutex> lock(configMutex);
+    const char* str = extensions;
+    do {
+        const char* begin = str;
+        while(*str != ';' && *str) ++str;
+        if(str > begin){
+            cacheableExtensions.insert(string(begin, str));
+        }
+    } while(0 != *str++);
+}
+
+
+bool SceneCache::isCacheableExtension(const std::string& extension)
+{
+    lock_guard<mutex> lock(configMutex);
+    return cacheableExtensions.find(extension) != cacheableExtensions.end();
+}
+
+
+std::string SceneCache::getCacheFilename(const std::string& sourceFilename, uint64_t parameterKey)
+{
+    string directory = cacheDirectory();
+    if(directory.empty()){
+        return string();
+    }
+
+    MappedFile file;
+    if(!file.open(sourceFilename)){
+        return string();
+    }
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hashBytes(reinterpret_cast<const char*>(&cacheFormatVersion), sizeof(cacheFormatVersion), hash);
+    hash = hashBytes(reinterpret_cast<const char*>(&parameterKey), sizeof(parameterKey), hash);
+    if(file.size() > 0){
+        hash = hashBytes(file.data(), file.size(), hash);
+    }
+
+    filesystem::path path(fromUTF8(directory));
+    path /= fmt::format("{:016x}-{}.scene", hash, file.size());
+    return toUTF8(path.string());
+}
+
+
+SgNode* SceneCache::load(const std::string& cacheFilename, const std::string& sourceFilename)
+{
+    MappedFile file;
+    if(!file.open(cacheFilename)){
+        return nullptr;
+    }
+
+    SgNodePtr node;
+    {
+        // The reader must release the objects before the node is returned
+        CacheReader reader(file.data(), file.size());
+        try {
+            char magic[sizeof(cacheFileMagic)];
+            for(auto& c : magic){
+                c = reader.read<char>();
+            }
+            if(memcmp(magic, cacheFileMagic, sizeof(magic)) == 0 &&
+               reader.read<int32_t>() == cacheFormatVersion){
+                node = reader.readNode();
+                for(auto& mesh : reader.meshesWithSourceUri){
+                    mesh->setUri(sourceFilename);
+                }
+            }
+        } catch(const CacheReader::Error&){
+            node.reset();
+        }
+    }
+    return node.retn();
+}
+
+
+bool SceneCache::save(const std::string& cacheFilename, SgNode* scene)
+{
+    CacheWriter writer;
+    writer.buf.insert(writer.buf.end(), cacheFileMagic, cacheFileMagic + sizeof(cacheFileMagic));
+    writer.write(cacheFormatVersion);
+    if(!writer.writeNode(scene)){
+        return false;
+    }
+
+    filesystem::path path(fromUTF8(cacheFilename));
+    try {
+        filesystem::create_directories(path.parent_path());
+    } catch(const std::exception&){
+        return false;
+    }
+
+    // The file is written with a temporary name and renamed so that other processes loading the
+    // same scene do not read an incomplete file
+    auto tmpPath = path;
+    tmpPath += fmt::format(".{}.tmp", reinterpret_cast<uintptr_t>(&writer));
+    {
+        ofstream ofs(tmpPath.string().c_str(), ios::out | ios::binary | ios::trunc);
+        if(!ofs.is_open()){
+            return false;
+        }
+        ofs.write(writer.buf.data(), writer.buf.size());
+        if(ofs.fail()){
+            ofs.close();
+            std::remove(tmpPath.string().c_str());
+            return false;
+        }
+    }
+    std::remove(path.string().c_str());
+    if(std::rename(tmpPath.string().c_str(), path.string().c_str()) != 0){
+        std::remove(tmpPath.string().c_str());
+        return false;
+    }
+    return true;
+}
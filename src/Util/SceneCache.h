@@ -0,0 +1,57 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_SCENE_CACHE_H
+#define CNOID_UTIL_SCENE_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+
+/**
+   This class stores the scenes loaded by SceneLoader in a cache directory in a binary format so
+   that the scenes can be restored without parsing the files and generating the meshes again.
+   A cache file is identified by the hash of the content of the source file and the loading
+   parameters, so a modified file is loaded again without any explicit invalidation.
+
+   The cache is only used for the file formats which do not refer to other files, and the scenes
+   which consist of groups, transforms, shapes, meshes and materials. The cache is disabled when
+   the cache directory is empty. The initial directory is given by the environment variable
+   CNOID_SCENE_CACHE_DIR.
+*/
+class CNOID_EXPORT SceneCache
+{
+public:
+    static void setCacheDirectory(const std::string& directory);
+    static std::string cacheDirectory();
+
+    //! @param extensions semi-colon separated extension list
+    static void addCacheableExtensions(const char* extensions);
+    static bool isCacheableExtension(const std::string& extension);
+
+    /**
+       \param parameterKey The value which identifies the loading parameters affecting the scene
+       \return The cache filename for the source file. An empty string is returned if the cache
+       is disabled or the source file cannot be read.
+    */
+    static std::string getCacheFilename(const std::string& sourceFilename, uint64_t parameterKey);
+
+    /**
+       The cache does not depend on the path of the source file, so the URIs of the meshes which
+       referred to the source file when the cache was saved are set to the given source filename.
+       \return Null if the cache file does not exist or is not valid.
+    */
+    static SgNode* load(const std::string& cacheFilename, const std::string& sourceFilename);
+
+    //! \return False if the scene contains an object which cannot be stored in the cache.
+    static bool save(const std::string& cacheFilename, SgNode* scene);
+};
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 */
 
 #include "SceneLoader.h"
+#include "SceneCache.h"
 #include "NullOut.h"
 #include "UTF8.h"
 #include <cnoid/stdx/filesystem>
@@ -10,6 +11,7 @@
 #include <mutex>
 #include <map>
 #include <algorithm>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -186,7 +188,24 @@ SgNode* SceneLoaderImpl::load(const std::string& filename, bool* out_isSupported
         if(defaultCreaseAngle >= 0.0){
             loader->setDefaultCreaseAngle(defaultCreaseAngle);
         }
-        node = loader->load(filename);
+        string cacheFilename;
+        if(SceneCache::isCacheableExtension(ext)){
+            float creaseAngle = defaultCreaseAngle;
+            uint32_t creaseAngleBits = 0;
+            memcpy(&creaseAngleBits, &creaseAngle, sizeof(creaseAngle));
+            uint64_t parameterKey =
+                (static_cast<uint64_t>(creaseAngleBits) << 32) | static_cast<uint32_t>(defaultDivisionNumber);
+            cacheFilename = SceneCache::getCacheFilename(filename, parameterKey);
+            if(!cacheFilename.empty()){
+                node = SceneCache::load(cacheFilename, filename);
+            }
+        }
+        if(!node){
+            node = loader->load(filename);
+            if(node && !cacheFilename.empty()){
+                SceneCache::save(cacheFilename, node);
+            }
+        }
         os().flush();
     }
 
@@ -0,0 +1,769 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SceneRaycaster.h"
+#include "SceneDrawables.h"
+#include "MeshExtractor.h"
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int N = SceneRaycaster::PacketSize;
+constexpr int MaxLeafSize = 4;
+constexpr int NumBins = 12;
+constexpr int MaxTreeDepth = 60;
+constexpr int StackSize = MaxTreeDepth + 4;
+constexpr float inf = std::numeric_limits<float>::infinity();
+
+struct Bounds
+{
+    Vector3f min;
+    Vector3f max;
+
+    Bounds() : min(inf, inf, inf), max(-inf, -inf, -inf) { }
+    Bounds(const Vector3f& min, const Vector3f& max) : min(min), max(max) { }
+    void extend(const Vector3f& p) {
+        min = min.cwiseMin(p);
+        max = max.cwiseMax(p);
+    }
+    void extend(const Bounds& b) {
+        min = min.cwiseMin(b.min);
+        max = max.cwiseMax(b.max);
+    }
+    float area() const {
+        if(min.x() > max.x()){
+            return 0.0f;
+        }
+        const Vector3f e = max - min;
+        return 2.0f * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+    }
+};
+
+/**
+   The children of an internal node are stored at index and index + 1.
+   A leaf node has the primitives from index to index + count - 1.
+*/
+struct BvhNode
+{
+    float min[3];
+    int index;
+    float max[3];
+    int count;
+
+    bool isLeaf() const { return count > 0; }
+    void setBounds(const Bounds& b) {
+        for(int i=0; i < 3; ++i){
+            min[i] = b.min[i];
+            max[i] = b.max[i];
+        }
+    }
+};
+
+/**
+   The binned SAH builder. The primitives are given by their bounds, and the order of the primitives
+   in the leaves is output to the order array.
+*/
+class BvhBuilder
+{
+public:
+    const vector<Bounds>& primitiveBounds;
+    vector<Vector3f> centers;
+    vector<BvhNode>& nodes;
+    vector<int>& order;
+
+    BvhBuilder(const vector<Bounds>& primitiveBounds, vector<BvhNode>& out_nodes, vector<int>& out_order)
+        : primitiveBounds(primitiveBounds),
+          nodes(out_nodes),
+          order(out_order) { }
+
+    void build() {
+        const int n = primitiveBounds.size();
+        nodes.clear();
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0);
+        if(n == 0){
+            return;
+        }
+        centers.resize(n);
+        for(int i=0; i < n; ++i){
+            centers[i] = (primitiveBounds[i].min + primitiveBounds[i].max) * 0.5f;
+        }
+        nodes.reserve(2 * n);
+        nodes.emplace_back();
+        buildNode(0, 0, n, 0);
+    }
+
+    void buildNode(int nodeIndex, int begin, int end, int depth) {
+        Bounds bounds, centerBounds;
+        for(int i = begin; i < end; ++i){
+            bounds.extend(primitiveBounds[order[i]]);
+            centerBounds.extend(centers[order[i]]);
+        }
+        nodes[nodeIndex].setBounds(bounds);
+
+        int mid = -1;
+        if(depth < MaxTreeDepth){
+            mid = split(begin, end, bounds, centerBounds);
+        }
+        if(mid < 0){
+            nodes[nodeIndex].index = begin;
+            nodes[nodeIndex].count = end - begin;
+            return;
+        }
+        const int childIndex = nodes.size();
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[nodeIndex].index = childIndex;
+        nodes[nodeIndex].count = 0;
+        buildNode(childIndex, begin, mid, depth + 1);
+        buildNode(childIndex + 1, mid, end, depth + 1);
+    }
+
+    //! \return The index of the first primitive of the second child or -1 if the node should be a leaf
+    int split(int begin, int end, const Bounds& bounds, const Bounds& centerBounds) {
+        const int count = end - begin;
+        if(count <= 1){
+            return -1;
+        }
+        float bestCost = inf;
+        int bestAxis = -1;
+        int bestBin = 0;
+        for(int axis=0; axis < 3; ++axis){
+            const float cmin = centerBounds.min[axis];
+            const float extent = centerBounds.max[axis] - cmin;
+            if(!(extent > 0.0f)){
+                continue;
+            }
+            const float scale = NumBins / extent;
+            Bounds binBounds[NumBins];
+            int binCounts[NumBins] = { 0 };
+            for(int i = begin; i < end; ++i){
+                const int prim = order[i];
+                const int bin = std::min(NumBins - 1, static_cast<int>((centers[prim][axis] - cmin) * scale));
+                binBounds[bin].extend(primitiveBounds[prim]);
+                ++binCounts[bin];
+            }
+            float rightAreas[NumBins];
+            int rightCounts[NumBins];
+            Bounds accumulated;
+            int accumulatedCount = 0;
+            for(int i = NumBins - 1; i > 0; --i){
+                accumulated.extend(binBounds[i]);
+                accumulatedCount += binCounts[i];
+                rightAreas[i] = accumulated.area();
+                rightCounts[i] = accumulatedCount;
+            }
+            accumulated = Bounds();
+            accumulatedCount = 0;
+            for(int i=1; i < NumBins; ++i){
+                accumulated.extend(binBounds[i - 1]);
+                accumulatedCount += binCounts[i - 1];
+                if(accumulatedCount == 0 || rightCounts[i] == 0){
+                    continue;
+                }
+                const float cost = accumulatedCount * accumulated.area() + rightCounts[i] * rightAreas[i];
+                if(cost < bestCost){
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = i;
+                }
+            }
+        }
+
+        int mid;
+        if(bestAxis < 0){
+            // The centers of all the primitives are at the same position
+            if(count <= MaxLeafSize){
+                return -1;
+            }
+            mid = begin + count / 2;
+        } else {
+            // The traversal cost is assumed to be equal to the cost of a primitive intersection
+            if(count <= MaxLeafSize && bestCost + bounds.area() >= count * bounds.area()){
+                return -1;
+            }
+            const float cmin = centerBounds.min[bestAxis];
+            const float scale = NumBins / (centerBounds.max[bestAxis] - cmin);
+            auto p = std::partition(
+                order.begin() + begin, order.begin() + end,
+                [&](int prim){
+                    return std::min(NumBins - 1, static_cast<int>((centers[prim][bestAxis] - cmin) * scale)) < bestBin;
+                });
+            mid = p - order.begin();
+            if(mid == begin || mid == end){
+                mid = begin + count / 2;
+            }
+        }
+        return mid;
+    }
+};
+
+struct Triangle
+{
+    Vector3f v0;
+    Vector3f e1;
+    Vector3f e2;
+};
+
+class MeshBvh
+{
+public:
+    vector<BvhNode> nodes;
+    vector<Triangle> triangles;
+    Bounds bounds;
+
+    MeshBvh(SgMesh* mesh) {
+        auto& vertices = *mesh->vertices();
+        const int numVertices = vertices.size();
+        const int numTriangles = mesh->numTriangles();
+        vector<Triangle> orgTriangles;
+        vector<Bounds> triangleBounds;
+        orgTriangles.reserve(numTriangles);
+        triangleBounds.reserve(numTriangles);
+        for(int i=0; i < numTriangles; ++i){
+            auto triangle = mesh->triangle(i);
+            if(triangle[0] < 0 || triangle[0] >= numVertices ||
+               triangle[1] < 0 || triangle[1] >= numVertices ||
+               triangle[2] < 0 || triangle[2] >= numVertices){
+                continue;
+            }
+            const Vector3f& v0 = vertices[triangle[0]];
+            const Vector3f& v1 = vertices[triangle[1]];
+            const Vector3f& v2 = vertices[triangle[2]];
+            orgTriangles.push_back({ v0, v1 - v0, v2 - v0 });
+            Bounds b;
+            b.extend(v0);
+            b.extend(v1);
+            b.extend(v2);
+            triangleBounds.push_back(b);
+            bounds.extend(b);
+        }
+        vector<int> order;
+        BvhBuilder(triangleBounds, nodes, order).build();
+        triangles.resize(order.size());
+        for(size_t i=0; i < order.size(); ++i){
+            triangles[i] = orgTriangles[order[i]];
+        }
+    }
+
+    bool empty() const { return triangles.empty(); }
+};
+
+typedef std::shared_ptr<const MeshBvh> MeshBvhPtr;
+
+struct Instance
+{
+    MeshBvhPtr bvh;
+    int groupIndex;
+    Matrix3 localLinear;
+    Vector3 localTranslation;
+    Vector3f color;
+    float faceOrientation; // 1 or -1 to cull the back faces, or 0 for the double-sided mesh
+
+    // The transform to the world coordinate and its inverse, which are updated by update()
+    Matrix3f R;
+    Vector3f p;
+    Matrix3f Rinv;
+    Vector3f pinv;
+    float cullingSign;
+};
+
+/**
+   The lanes of a packet are processed by the loops of the fixed length so that the compiler can
+   vectorize them. The inactive lanes have an empty range, which never hits anything.
+*/
+struct RayPacket
+{
+    float ox[N], oy[N], oz[N];
+    float dx[N], dy[N], dz[N];
+    float rdx[N], rdy[N], rdz[N];
+    float tmin[N];
+    float t[N];
+    int instance[N];
+    int triangle[N];
+
+    void setInverseDirections() {
+        for(int i=0; i < N; ++i){
+            rdx[i] = 1.0f / (std::fabs(dx[i]) < 1.0e-20f ? std::copysign(1.0e-20f, dx[i]) : dx[i]);
+            rdy[i] = 1.0f / (std::fabs(dy[i]) < 1.0e-20f ? std::copysign(1.0e-20f, dy[i]) : dy[i]);
+            rdz[i] = 1.0f / (std::fabs(dz[i]) < 1.0e-20f ? std::copysign(1.0e-20f, dz[i]) : dz[i]);
+        }
+    }
+};
+
+inline bool intersectBox(const BvhNode& node, const RayPacket& ray)
+{
+    bool hit = false;
+    for(int i=0; i < N; ++i){
+        const float tx1 = (node.min[0] - ray.ox[i]) * ray.rdx[i];
+        const float tx2 = (node.max[0] - ray.ox[i]) * ray.rdx[i];
+        const float ty1 = (node.min[1] - ray.oy[i]) * ray.rdy[i];
+        const float ty2 = (node.max[1] - ray.oy[i]) * ray.rdy[i];
+        const float tz1 = (node.min[2] - ray.oz[i]) * ray.rdz[i];
+        const float tz2 = (node.max[2] - ray.oz[i]) * ray.rdz[i];
+        const float tnear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)),
+                                     std::max(std::min(tz1, tz2), ray.tmin[i]));
+        const float tfar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)),
+                                    std::min(std::max(tz1, tz2), ray.t[i]));
+        hit |= (tnear <= tfar);
+    }
+    return hit;
+}
+
+//! \return The nearest entry distance of the rays hitting the box or infinity
+inline float getBoxEntryDistance(const BvhNode& node, const RayPacket& ray)
+{
+    float nearest = inf;
+    for(int i=0; i < N; ++i){
+        const float tx1 = (node.min[0] - ray.ox[i]) * ray.rdx[i];
+        const float tx2 = (node.max[0] - ray.ox[i]) * ray.rdx[i];
+        const float ty1 = (node.min[1] - ray.oy[i]) * ray.rdy[i];
+        const float ty2 = (node.max[1] - ray.oy[i]) * ray.rdy[i];
+        const float tz1 = (node.min[2] - ray.oz[i]) * ray.rdz[i];
+        const float tz2 = (node.max[2] - ray.oz[i]) * ray.rdz[i];
+        const float tnear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)),
+                                     std::max(std::min(tz1, tz2), ray.tmin[i]));
+        const float tfar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)),
+                                    std::min(std::max(tz1, tz2), ray.t[i]));
+        nearest = std::min(nearest, (tnear <= tfar) ? tnear : inf);
+    }
+    return nearest;
+}
+
+inline void intersectTriangle
+(const Triangle& tri, int triangleIndex, int instanceIndex, float cullingSign, RayPacket& ray)
+{
+    for(int i=0; i < N; ++i){
+        // Moller-Trumbore algorithm
+        const float px = ray.dy[i] * tri.e2.z() - ray.dz[i] * tri.e2.y();
+        const float py = ray.dz[i] * tri.e2.x() - ray.dx[i] * tri.e2.z();
+        const float pz = ray.dx[i] * tri.e2.y() - ray.dy[i] * tri.e2.x();
+        const float det = tri.e1.x() * px + tri.e1.y() * py + tri.e1.z() * pz;
+        const float invDet = 1.0f / det;
+        const float sx = ray.ox[i] - tri.v0.x();
+        const float sy = ray.oy[i] - tri.v0.y();
+        const float sz = ray.oz[i] - tri.v0.z();
+        const float u = (sx * px + sy * py + sz * pz) * invDet;
+        const float qx = sy * tri.e1.z() - sz * tri.e1.y();
+        const float qy = sz * tri.e1.x() - sx * tri.e1.z();
+        const float qz = sx * tri.e1.y() - sy * tri.e1.x();
+        const float v = (ray.dx[i] * qx + ray.dy[i] * qy + ray.dz[i] * qz) * invDet;
+        const float t = (tri.e2.x() * qx + tri.e2.y() * qy + tri.e2.z() * qz) * invDet;
+        const bool hit =
+            (det != 0.0f) && (det * cullingSign >= 0.0f) &&
+            (u >= 0.0f) && (v >= 0.0f) && (u + v <= 1.0f) &&
+            (t >= ray.tmin[i]) && (t < ray.t[i]);
+        ray.t[i] = hit ? t : ray.t[i];
+        ray.triangle[i] = hit ? triangleIndex : ray.triangle[i];
+        ray.instance[i] = hit ? instanceIndex : ray.instance[i];
+    }
+}
+
+/**
+   The nodes are visited in the front-to-back order of the nearest entry distances of the rays.
+   The leaf function is called with the range of the primitives in the leaf.
+*/
+template<class LeafFunction>
+void traverse(const vector<BvhNode>& nodes, RayPacket& ray, LeafFunction processLeaf)
+{
+    if(nodes.empty() || !intersectBox(nodes[0], ray)){
+        return;
+    }
+    int stack[StackSize];
+    int stackSize = 0;
+    int current = 0;
+    while(true){
+        const BvhNode& node = nodes[current];
+        if(node.isLeaf()){
+            processLeaf(node.index, node.index + node.count);
+        } else {
+            const int child1 = node.index;
+            const int child2 = node.index + 1;
+            const float t1 = getBoxEntryDistance(nodes[child1], ray);
+            const float t2 = getBoxEntryDistance(nodes[child2], ray);
+            if(t1 < inf){
+                if(t2 < inf){
+                    if(t1 <= t2){
+                        stack[stackSize++] = child2;
+                        current = child1;
+                    } else {
+                        stack[stackSize++] = child1;
+                        current = child2;
+                    }
+                } else {
+                    current = child1;
+                }
+                continue;
+            } else if(t2 < inf){
+                current = child2;
+                continue;
+            }
+        }
+        // The pushed node is tested again because the hit distances may have been shortened
+        do {
+            if(stackSize == 0){
+                return;
+            }
+            current = stack[--stackSize];
+        } while(!intersectBox(nodes[current], ray));
+    }
+}
+
+}
+
+namespace cnoid {
+
+class SceneRaycaster::Impl
+{
+public:
+    vector<Isometry3, Eigen::aligned_allocator<Isometry3>> groupPositions;
+    vector<Instance> instances;
+    // The meshes are kept so that their addresses are not reused by other meshes
+    unordered_map<SgMesh*, pair<SgMeshPtr, MeshBvhPtr>> meshBvhMap;
+    vector<BvhNode> nodes;
+    vector<int> instanceOrder;
+    float builtNodeArea;
+    bool isHierarchyInvalid;
+
+    Impl();
+    void clear();
+    int addGroup(SgNode* scene);
+    void update();
+    void buildHierarchy();
+    float refitHierarchy();
+    void castPacket(
+        const Vector3f& origin, const Vector3f* directions, int numRays, float minDistance, float maxDistance,
+        float* out_distances, Vector3f* out_colors) const;
+    void traverseInstance(int instanceIndex, RayPacket& ray) const;
+};
+
+}
+
+
+SceneRaycaster::SceneRaycaster()
+{
+    impl = new Impl;
+}
+
+
+SceneRaycaster::Impl::Impl()
+{
+    builtNodeArea = 0.0f;
+    isHierarchyInvalid = true;
+}
+
+
+SceneRaycaster::SceneRaycaster(const SceneRaycaster& org)
+{
+    impl = new Impl(*org.impl);
+}
+
+
+SceneRaycaster& SceneRaycaster::operator=(const SceneRaycaster& org)
+{
+    if(this != &org){
+        *impl = *org.impl;
+    }
+    return *this;
+}
+
+
+SceneRaycaster::~SceneRaycaster()
+{
+    delete impl;
+}
+
+
+void SceneRaycaster::clear()
+{
+    impl->clear();
+}
+
+
+void SceneRaycaster::Impl::clear()
+{
+    groupPositions.clear();
+    instances.clear();
+    meshBvhMap.clear();
+    nodes.clear();
+    instanceOrder.clear();
+    isHierarchyInvalid = true;
+}
+
+
+int SceneRaycaster::addGroup(SgNode* scene)
+{
+    return impl->addGroup(scene);
+}
+
+
+int SceneRaycaster::Impl::addGroup(SgNode* scene)
+{
+    const int groupIndex = groupPositions.size();
+    groupPositions.push_back(Isometry3::Identity());
+
+    MeshExtractor extractor;
+    extractor.extract(
+        scene,
+        [&](){
+            SgMesh* mesh = extractor.currentMesh();
+            if(!mesh->hasVertices() || mesh->numTriangles() == 0){
+                return;
+            }
+            auto& entry = meshBvhMap[mesh];
+            if(!entry.second){
+                entry.first = mesh;
+                entry.second = std::make_shared<MeshBvh>(mesh);
+            }
+            auto& bvh = entry.second;
+            if(bvh->empty()){
+                return;
+            }
+            Instance instance;
+            instance.bvh = bvh;
+            instance.groupIndex = groupIndex;
+            const Affine3& T = extractor.currentTransform();
+            instance.localLinear = T.linear();
+            instance.localTranslation = T.translation();
+            auto material = extractor.currentShape()->material();
+            instance.color = material ? material->diffuseColor() : Vector3f(1.0f, 1.0f, 1.0f);
+            instance.faceOrientation = mesh->isSolid() ? 1.0f : 0.0f;
+            // This is corrected by the orientation of the world transform in update()
+            instance.cullingSign = instance.faceOrientation;
+            // The world transform is set by update()
+            instance.R.setIdentity();
+            instance.p.setZero();
+            instance.Rinv.setIdentity();
+            instance.pinv.setZero();
+            instances.push_back(instance);
+        });
+
+    isHierarchyInvalid = true;
+
+    return groupIndex;
+}
+
+
+int SceneRaycaster::numGroups() const
+{
+    return impl->groupPositions.size();
+}
+
+
+void SceneRaycaster::setGroupPosition(int groupIndex, const Isometry3& T)
+{
+    impl->groupPositions[groupIndex] = T;
+}
+
+
+void SceneRaycaster::update()
+{
+    impl->update();
+}
+
+
+void SceneRaycaster::Impl::update()
+{
+    for(auto& instance : instances){
+        auto& T = groupPositions[instance.groupIndex];
+        const Matrix3 R = T.linear() * instance.localLinear;
+        const Vector3 p = T.linear() * instance.localTranslation + T.translation();
+        const Matrix3 Rinv = R.inverse();
+        instance.R = R.cast<float>();
+        instance.p = p.cast<float>();
+        instance.Rinv = Rinv.cast<float>();
+        instance.pinv = (-Rinv * p).cast<float>();
+        // A mirroring transform flips the front faces
+        instance.cullingSign = (R.determinant() < 0.0) ? -instance.faceOrientation : instance.faceOrientation;
+    }
+
+    if(isHierarchyInvalid){
+        buildHierarchy();
+    } else {
+        // The hierarchy is rebuilt when its quality is degraded too much by the refitting
+        if(refitHierarchy() > 2.0f * builtNodeArea){
+            buildHierarchy();
+        }
+    }
+}
+
+
+void SceneRaycaster::Impl::buildHierarchy()
+{
+    vector<Bounds> instanceBounds(instances.size());
+    for(size_t i=0; i < instances.size(); ++i){
+        auto& instance = instances[i];
+        auto& b = instance.bvh->bounds;
+        const Vector3f center = instance.R * ((b.min + b.max) * 0.5f) + instance.p;
+        const Vector3f extent = instance.R.cwiseAbs() * ((b.max - b.min) * 0.5f);
+        instanceBounds[i].min = center - extent;
+        instanceBounds[i].max = center + extent;
+    }
+    BvhBuilder(instanceBounds, nodes, instanceOrder).build();
+
+    builtNodeArea = 0.0f;
+    for(auto& node : nodes){
+        Bounds b;
+        b.min = Vector3f(node.min[0], node.min[1], node.min[2]);
+        b.max = Vector3f(node.max[0], node.max[1], node.max[2]);
+        builtNodeArea += b.area();
+    }
+    isHierarchyInvalid = false;
+}
+
+
+/**
+   The bounds of the nodes are updated in the reverse order of the node indices, which is valid
+   because the children of a node always have larger indices than the node.
+   \return The total area of the nodes
+*/
+float SceneRaycaster::Impl::refitHierarchy()
+{
+    float totalArea = 0.0f;
+    for(int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i){
+        auto& node = nodes[i];
+        Bounds b;
+        if(node.isLeaf()){
+            for(int j = node.index; j < node.index + node.count; ++j){
+                auto& instance = instances[instanceOrder[j]];
+                auto& lb = instance.bvh->bounds;
+                const Vector3f center = instance.R * ((lb.min + lb.max) * 0.5f) + instance.p;
+                const Vector3f extent = instance.R.cwiseAbs() * ((lb.max - lb.min) * 0.5f);
+                b.extend(Bounds(center - extent, center + extent));
+            }
+        } else {
+            for(int j=0; j < 2; ++j){
+                auto& child = nodes[node.index + j];
+                b.extend(Vector3f(child.min[0], child.min[1], child.min[2]));
+                b.extend(Vector3f(child.max[0], child.max[1], child.max[2]));
+            }
+        }
+        node.setBounds(b);
+        totalArea += b.area();
+    }
+    return totalArea;
+}
+
+
+void SceneRaycaster::castRays
+(const Vector3f& origin, const Vector3f* directions, int numRays, float minDistance, float maxDistance,
+ float* out_distances, Vector3f* out_colors) const
+{
+    for(int i=0; i < numRays; i += N){
+        impl->castPacket(
+            origin, directions + i, std::min(N, numRays - i), minDistance, maxDistance,
+            out_distances + i, out_colors ? (out_colors + i) : nullptr);
+    }
+}
+
+
+float SceneRaycaster::castRay
+(const Vector3f& origin, const Vector3f& direction, float minDistance, float maxDistance) const
+{
+    float distance;
+    impl->castPacket(origin, &direction, 1, minDistance, maxDistance, &distance, nullptr);
+    return distance;
+}
+
+
+void SceneRaycaster::Impl::castPacket
+(const Vector3f& origin, const Vector3f* directions, int numRays, float minDistance, float maxDistance,
+ float* out_distances, Vector3f* out_colors) const
+{
+    RayPacket ray;
+    for(int i=0; i < N; ++i){
+        ray.ox[i] = origin.x();
+        ray.oy[i] = origin.y();
+        ray.oz[i] = origin.z();
+        const Vector3f& d = directions[std::min(i, numRays - 1)];
+        ray.dx[i] = d.x();
+        ray.dy[i] = d.y();
+        ray.dz[i] = d.z();
+        if(i < numRays){
+            ray.tmin[i] = minDistance;
+            ray.t[i] = maxDistance;
+        } else {
+            ray.tmin[i] = inf;
+            ray.t[i] = -inf;
+        }
+        ray.instance[i] = -1;
+        ray.triangle[i] = -1;
+    }
+    ray.setInverseDirections();
+
+    traverse(nodes, ray,
+             [&](int begin, int end){
+                 for(int i = begin; i < end; ++i){
+                     traverseInstance(instanceOrder[i], ray);
+                 }
+             });
+
+    for(int i=0; i < numRays; ++i){
+        const int instanceIndex = ray.instance[i];
+        if(instanceIndex < 0){
+            out_distances[i] = inf;
+            if(out_colors){
+                out_colors[i].setZero();
+            }
+        } else {
+            out_distances[i] = ray.t[i];
+            if(out_colors){
+                auto& instance = instances[instanceIndex];
+                auto& triangle = instance.bvh->triangles[ray.triangle[i]];
+                const Vector3f normal = instance.Rinv.transpose() * triangle.e1.cross(triangle.e2);
+                const Vector3f& d = directions[i];
+                const float norm = normal.norm() * d.norm();
+                const float shading = (norm > 0.0f) ? std::fabs(normal.dot(d)) / norm : 1.0f;
+                out_colors[i] = instance.color * shading;
+            }
+        }
+    }
+}
+
+
+void SceneRaycaster::Impl::traverseInstance(int instanceIndex, RayPacket& ray) const
+{
+    auto& instance = instances[instanceIndex];
+    auto& R = instance.Rinv;
+    auto& p = instance.pinv;
+
+    // The directions are not normalized so that the distances are preserved in the local coordinate
+    RayPacket localRay;
+    for(int i=0; i < N; ++i){
+        localRay.ox[i] = R(0,0) * ray.ox[i] + R(0,1) * ray.oy[i] + R(0,2) * ray.oz[i] + p.x();
+        localRay.oy[i] = R(1,0) * ray.ox[i] + R(1,1) * ray.oy[i] + R(1,2) * ray.oz[i] + p.y();
+        localRay.oz[i] = R(2,0) * ray.ox[i] + R(2,1) * ray.oy[i] + R(2,2) * ray.oz[i] + p.z();
+        localRay.dx[i] = R(0,0) * ray.dx[i] + R(0,1) * ray.dy[i] + R(0,2) * ray.dz[i];
+        localRay.dy[i] = R(1,0) * ray.dx[i] + R(1,1) * ray.dy[i] + R(1,2) * ray.dz[i];
+        localRay.dz[i] = R(2,0) * ray.dx[i] + R(2,1) * ray.dy[i] + R(2,2) * ray.dz[i];
+        localRay.tmin[i] = ray.tmin[i];
+        localRay.t[i] = ray.t[i];
+        localRay.instance[i] = ray.instance[i];
+        localRay.triangle[i] = ray.triangle[i];
+    }
+    localRay.setInverseDirections();
+
+    auto& bvh = *instance.bvh;
+    const float cullingSign = instance.cullingSign;
+    traverse(bvh.nodes, localRay,
+             [&](int begin, int end){
+                 for(int i = begin; i < end; ++i){
+                     intersectTriangle(bvh.triangles[i], i, instanceIndex, cullingSign, localRay);
+                 }
+             });
+
+    for(int i=0; i < N; ++i){
+        ray.t[i] = localRay.t[i];
+        ray.instance[i] = localRay.instance[i];
+        ray.triangle[i] = localRay.triangle[i];
+    }
+}
@@ -0,0 +1,71 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_SCENE_RAYCASTER_H
+#define CNOID_UTIL_SCENE_RAYCASTER_H
+
+#include "EigenTypes.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+
+/**
+   This class casts rays to the meshes of scenes on the CPU.
+   The meshes are added as groups, each of which is moved as a rigid body by setGroupPosition.
+   A bounding volume hierarchy is built once for each mesh in its local coordinate, and the
+   hierarchy of the mesh instances is refitted by update() when the groups move.
+*/
+class CNOID_EXPORT SceneRaycaster
+{
+public:
+    SceneRaycaster();
+
+    //! The copy shares the hierarchies of the meshes, which are never modified after they are built.
+    SceneRaycaster(const SceneRaycaster& org);
+    SceneRaycaster& operator=(const SceneRaycaster& org);
+
+    ~SceneRaycaster();
+
+    void clear();
+
+    /**
+       The meshes in the scene are added as a group. The current transforms of the nodes in the
+       scene are used as the positions of the meshes in the group.
+       \return The index of the group
+    */
+    int addGroup(SgNode* scene);
+
+    int numGroups() const;
+    void setGroupPosition(int groupIndex, const Isometry3& T);
+
+    //! This function must be called after the groups are added or moved and before the rays are cast.
+    void update();
+
+    //! The rays are processed in the packets of this number of rays.
+    static constexpr int PacketSize = 8;
+
+    /**
+       This function can be called by multiple threads concurrently.
+       \param directions The distances are measured in the unit of the lengths of the direction vectors.
+       \param out_distances The distance to the nearest surface or infinity if there is no surface
+       in the range between minDistance and maxDistance.
+       \param out_colors The diffuse colors of the hit surfaces shaded by the incident angles of the
+       rays. The textures are not considered. Zero is set when there is no hit. Null can be given.
+    */
+    void castRays(
+        const Vector3f& origin, const Vector3f* directions, int numRays, float minDistance, float maxDistance,
+        float* out_distances, Vector3f* out_colors = nullptr) const;
+
+    float castRay(const Vector3f& origin, const Vector3f& direction, float minDistance, float maxDistance) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_SHARED_OBJECT_POOL_H
+#define CNOID_UTIL_SHARED_OBJECT_POOL_H
+
+#include <memory>
+#include <vector>
+#include <mutex>
+
+namespace cnoid {
+
+/**
+   This class hands out the objects held by std::shared_ptr and recycles them.
+   An object returns to the pool when the last shared_ptr referring to it is released, so that
+   the buffers such as the images and the point clouds of the sensors can be reused without
+   allocating their memory again. The pool does not keep any reference to the objects in use,
+   so the use count of an acquired object is one as in the case of std::make_shared.
+
+   The objects are returned as they were used, so the content must be initialized by the user.
+   The functions are thread-safe and the objects may be released in any thread. The objects
+   released after the pool is destroyed are deleted.
+*/
+template<class T>
+class SharedObjectPool
+{
+public:
+    SharedObjectPool(int maxNumFreeObjects = 4)
+        : storage(std::make_shared<Storage>(maxNumFreeObjects)) { }
+
+    SharedObjectPool(const SharedObjectPool&) = delete;
+    SharedObjectPool& operator=(const SharedObjectPool&) = delete;
+
+    ~SharedObjectPool(){
+        std::lock_guard<std::mutex> lock(storage->mutex);
+        storage->isClosed = true;
+        storage->freeObjects.clear();
+    }
+
+    std::shared_ptr<T> acquire(){
+        T* object = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(storage->mutex);
+            if(!storage->freeObjects.empty()){
+                object = storage->freeObjects.back().release();
+                storage->freeObjects.pop_back();
+            }
+        }
+        if(!object){
+            object = new T;
+        }
+        return std::shared_ptr<T>(object, Recycler{ storage });
+    }
+
+    //! The objects which are not used are deleted.
+    void clear(){
+        std::lock_guard<std::mutex> lock(storage->mutex);
+        storage->freeObjects.clear();
+    }
+
+    int numFreeObjects() const {
+        std::lock_guard<std::mutex> lock(storage->mutex);
+        return storage->freeObjects.size();
+    }
+
+private:
+    struct Storage
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<T>> freeObjects;
+        size_t maxNumFreeObjects;
+        bool isClosed;
+        Storage(int maxNumFreeObjects) : maxNumFreeObjects(maxNumFreeObjects), isClosed(false) { }
+    };
+
+    struct Recycler
+    {
+        std::shared_ptr<Storage> storage;
+        void operator()(T* object){
+            std::unique_ptr<T> p(object);
+            std::lock_guard<std::mutex> lock(storage->mutex);
+            if(!storage->isClosed && storage->freeObjects.size() < storage->maxNumFreeObjects){
+                storage->freeObjects.push_back(std::move(p));
+            }
+        }
+    };
+
+    std::shared_ptr<Storage> storage;
+};
+
+}
+
+#endif
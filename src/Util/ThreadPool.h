@@ -14,6 +14,11 @@
 
 namespace cnoid {
 
+/**
+   The tasks are executed by the threads owned by each pool, so they can block without affecting
+   the other parallel computations. ParallelTaskGroup of ParallelScheduler should be used for the
+   short computational tasks that do not block.
+*/
 class ThreadPool
 {
 private:
@@ -63,17 +68,9 @@ public:
         }
     }
     
+    [[deprecated("Use ThreadPool::wait. It does not consume the CPU time while waiting.")]]
     void waitLoop(){
-        while(true){
-            {
-                std::unique_lock<std::mutex> lock(mutex, std::try_to_lock_t());
-                if(lock.owns_lock()){
-                    if(queue.empty() && numActiveThreads == 0){
-                        break;
-                    }
-                }
-            }
-        }
+        wait();
     }
 
     bool isRunning() {
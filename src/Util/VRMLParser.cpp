@@ -348,6 +348,10 @@ public:
     TProtoMap protoMap;
     TDefNodeMap defNodeMap;
 
+    // Buffers for reading the elements of the vector listings
+    vector<double> doubleBuffer;
+    vector<float> floatBuffer;
+
     void load(const string& filename, bool doClearAncestorPathsList);
     VRMLNodePtr readSpecificNode(VRMLNodeCategory nodeCategory, int symbol, const std::string& symbolString);
     VRMLNodePtr readInlineNode(VRMLNodeCategory nodeCategory);
@@ -2021,9 +2025,8 @@ void VRMLParserImpl::readMFInt32(MFInt32& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readIntEx("illegal int value"));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(scanner->readIntEx("illegal int value"));
-            }
+            scanner->readInts(out_value);
+            scanner->readCharEx(']', "illegal int value");
         }
     }
 }
@@ -2048,9 +2051,46 @@ void VRMLParserImpl::readMFFloat(MFFloat& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readDoubleEx("illegal float value"));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(scanner->readDoubleEx("illegal float value"));
-            }
+            scanner->readDoubles(out_value);
+            scanner->readCharEx(']', "illegal float value");
+        }
+    }
+}
+
+
+static inline void readNumbers(EasyScanner* scanner, vector<double>& out_values)
+{
+    scanner->readDoubles(out_values);
+}
+
+
+static inline void readNumbers(EasyScanner* scanner, vector<float>& out_values)
+{
+    scanner->readFloats(out_values);
+}
+
+
+/**
+   The elements of a vector listing are read at once, which is much faster than reading the
+   vectors one by one for the large arrays such as the coordinates of a mesh.
+*/
+template<class MFType, class ScalarType>
+static void readVectorListing(EasyScanner* scanner, vector<ScalarType>& buffer, MFType& out_value, const char* message)
+{
+    typedef typename MFType::value_type VectorType;
+    const int n = VectorType::RowsAtCompileTime;
+    buffer.clear();
+    readNumbers(scanner, buffer);
+    if(!scanner->readChar(']') || buffer.size() % n != 0){
+        scanner->throwException(message);
+    }
+    const size_t numVectors = buffer.size() / n;
+    out_value.resize(numVectors);
+    const ScalarType* element = buffer.data();
+    for(size_t i=0; i < numVectors; ++i){
+        auto& v = out_value[i];
+        for(int j=0; j < n; ++j){
+            v[j] = static_cast<typename VectorType::Scalar>(*element++);
         }
     }
 }
@@ -2085,9 +2125,7 @@ void VRMLParserImpl::readMFColor(MFColor& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFColor(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFColor(scanner));
-            }
+            readVectorListing(scanner, doubleBuffer, out_value, "illegal color element");
         }
     }
 }
@@ -2149,9 +2187,7 @@ void VRMLParserImpl::readMFVec2f(MFVec2f& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2f(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec2f(scanner));
-            }
+            readVectorListing(scanner, doubleBuffer, out_value, "illegal vector element");
         }
     }
 }
@@ -2191,9 +2227,7 @@ void VRMLParserImpl::readMFVec2s(MFVec2s& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2s(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec2s(scanner));
-            }
+            readVectorListing(scanner, floatBuffer, out_value, "illegal vector element");
         }
     }
 }
@@ -2228,9 +2262,7 @@ void VRMLParserImpl::readMFVec3f(MFVec3f& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3f(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec3f(scanner));
-            }
+            readVectorListing(scanner, doubleBuffer, out_value, "illegal vector element");
         }
     }
 }
@@ -2270,9 +2302,7 @@ void VRMLParserImpl::readMFVec3s(MFVec3s& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3s(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec3s(scanner));
-            }
+            readVectorListing(scanner, floatBuffer, out_value, "illegal vector element");
         }
     }
 }
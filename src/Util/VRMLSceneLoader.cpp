@@ -53,6 +53,7 @@ VRMLSceneLoader::VRMLSceneLoader()
 VRMLSceneLoaderImpl::VRMLSceneLoaderImpl()
 {
     os_ = &nullout();
+    converter.setParallelMeshGenerationEnabled(true);
 }
 
 
@@ -92,6 +93,7 @@ SgNode* VRMLSceneLoaderImpl::load(const std::string& filename)
             }
         }
         parser.checkEOF();
+        converter.finishConversion();
 
     } catch(EasyScanner::Exception& ex){
         os() << ex.getFullMessage() << endl;
@@ -15,9 +15,11 @@
 #include "Exception.h"
 #include "NullOut.h"
 #include "EigenUtil.h"
+#include "ParallelScheduler.h"
 #include <fmt/format.h>
 #include <boost/algorithm/string.hpp>
 #include <tuple>
+#include <sstream>
 
 using namespace std;
 using namespace cnoid;
@@ -77,13 +79,31 @@ public:
     enum BoxFaceID { NO_FACE, LEFT_FACE, TOP_FACE, FRONT_FACE, BOTTOM_FACE, RIGHT_FACE, BACK_FACE };
 
     unique_ptr<SceneLoader> sceneLoader;
+
+    // The mesh of an IndexedFaceSet node generated in finishConversion()
+    struct DeferredMesh
+    {
+        VRMLIndexedFaceSetPtr faceSet;
+        vector<SgShapePtr> shapes;
+        bool needsTexCoord;
+        SgMeshPtr mesh;
+        string message;
+        DeferredMesh(VRMLIndexedFaceSet* faceSet) : faceSet(faceSet), needsTexCoord(false) { }
+    };
+    vector<DeferredMesh> deferredMeshes;
+    map<VRMLGeometryPtr, int> vrmlGeometryToDeferredMeshIndexMap;
+    bool isParallelMeshGenerationEnabled;
         
     VRMLToSGConverterImpl(VRMLToSGConverter* self);
+    VRMLToSGConverterImpl(const VRMLToSGConverterImpl& org);
     void putMessage(const std::string& message);
     SgNode* convertNode(VRMLNode* vnode);
     SgNode* convertGroupNode(AbstractVRMLGroup* vgroup);
     pair<SgNode*, SgGroup*> createTransformNodeSet(VRMLTransform* vt);
     SgNode* convertShapeNode(VRMLShape* vshape);
+    bool isMeshGenerationDeferrable(VRMLIndexedFaceSet* faceSet);
+    SgMeshPtr convertIndexedFaceSet(VRMLIndexedFaceSet* faceSet);
+    void generateDeferredMeshes();
     SgMeshPtr createMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface);
     bool setIndicesForPerTriangleData(SgIndexArray& indices, int dataSize);
     bool convertIndicesForTriangles(SgIndexArray& indices, const MFInt32& orgIndices, const bool perVertex, const bool ccw);
@@ -124,11 +144,26 @@ VRMLToSGConverterImpl::VRMLToSGConverterImpl(VRMLToSGConverter* self)
     os_ = &nullout();
     isTriangulationEnabled = true;
     isNormalGenerationEnabled = true;
+    isParallelMeshGenerationEnabled = false;
     imageIO.setUpsideDown(true);
     defaultMaterial = new VRMLMaterial();
 }
 
 
+//! This constructor only copies the settings for generating the meshes in a worker thread.
+VRMLToSGConverterImpl::VRMLToSGConverterImpl(const VRMLToSGConverterImpl& org)
+    : self(org.self),
+      meshFilter(org.meshFilter)
+{
+    os_ = &nullout();
+    isTriangulationEnabled = org.isTriangulationEnabled;
+    isNormalGenerationEnabled = org.isNormalGenerationEnabled;
+    isParallelMeshGenerationEnabled = false;
+    imageIO.setUpsideDown(true);
+    defaultMaterial = org.defaultMaterial;
+}
+
+
 VRMLToSGConverter::~VRMLToSGConverter()
 {
     delete impl;
@@ -181,8 +216,16 @@ void VRMLToSGConverter::setMaxCreaseAngle(double angle)
 }
 
 
+void VRMLToSGConverter::setParallelMeshGenerationEnabled(bool on)
+{
+    impl->isParallelMeshGenerationEnabled = on;
+}
+
+
 void VRMLToSGConverter::clearConvertedNodeMap()
 {
+    impl->deferredMeshes.clear();
+    impl->vrmlGeometryToDeferredMeshIndexMap.clear();
     impl->vrmlNodeToSgNodeMap.clear();
     impl->vrmlGeometryToSgMeshMap.clear();
     impl->vrmlGeometryToSgPlotMap.clear();
@@ -202,6 +245,12 @@ SgNodePtr VRMLToSGConverter::convert(VRMLNodePtr vrmlNode)
 }
 
 
+void VRMLToSGConverter::finishConversion()
+{
+    impl->generateDeferredMeshes();
+}
+
+
 void VRMLToSGConverterImpl::putMessage(const std::string& message)
 {
     os() << message << endl;
@@ -319,35 +368,25 @@ SgNode* VRMLToSGConverterImpl::convertShapeNode(VRMLShape* vshape)
     VRMLGeometry* vrmlGeometry = dynamic_node_cast<VRMLGeometry>(vshape->geometry).get();
     if(vrmlGeometry){
         SgMeshPtr mesh;
+        DeferredMesh* deferredMesh = nullptr;
         VRMLGeometryToSgMeshMap::iterator p = vrmlGeometryToSgMeshMap.find(vrmlGeometry);
+        auto q = vrmlGeometryToDeferredMeshIndexMap.find(vrmlGeometry);
         if(p != vrmlGeometryToSgMeshMap.end()){
             mesh = p->second;
+        } else if(q != vrmlGeometryToDeferredMeshIndexMap.end()){
+            deferredMesh = &deferredMeshes[q->second];
         } else {
             bool generateTexCoord = false;
             if(vshape->appearance && vshape->appearance->texture){
                 generateTexCoord = true;
             }
             if(VRMLIndexedFaceSet* faceSet = dynamic_cast<VRMLIndexedFaceSet*>(vrmlGeometry)){
-                if(!isTriangulationEnabled){
-                    mesh = createMeshFromIndexedFaceSet(faceSet);
+                if(isMeshGenerationDeferrable(faceSet)){
+                    vrmlGeometryToDeferredMeshIndexMap[vrmlGeometry] = deferredMeshes.size();
+                    deferredMeshes.emplace_back(faceSet);
+                    deferredMesh = &deferredMeshes.back();
                 } else {
-                    SgPolygonMeshPtr polygonMesh = createPolygonMeshFromIndexedFaceSet(faceSet);
-                    if(polygonMesh){
-                        mesh = polygonMeshTriangulator.triangulate(polygonMesh);
-                        const string& errorMessage = polygonMeshTriangulator.errorMessage();
-                        if(!errorMessage.empty()){
-                            string message;
-                            if(faceSet->defName.empty()){
-                                message = "Error of an IndexedFaceSet node: \n";
-                            } else {
-                                message = format("Error of IndexedFaceSet node \"{}\": \n", faceSet->defName);
-                            }
-                            putMessage(message + errorMessage);
-                        }
-                    }
-                }
-                if(mesh && isNormalGenerationEnabled){
-                    meshFilter.generateNormals(mesh, faceSet->creaseAngle);
+                    mesh = convertIndexedFaceSet(faceSet);
                 }
                     
             } else if(VRMLBox* box = dynamic_cast<VRMLBox*>(vrmlGeometry)){
@@ -386,10 +425,14 @@ SgNode* VRMLToSGConverterImpl::convertShapeNode(VRMLShape* vshape)
                 vrmlGeometryToSgMeshMap[vrmlGeometry] = mesh;
             }
         }
-        if(mesh){
+        if(mesh || deferredMesh){
             SgShape* shape = new SgShape;
             converted = shape;
-            shape->setMesh(mesh);
+            if(mesh){
+                shape->setMesh(mesh);
+            } else {
+                deferredMesh->shapes.push_back(shape);
+            }
 
             if(vshape->appearance && vshape->appearance->material){
                 auto vm = vshape->appearance->material;
@@ -432,7 +475,9 @@ SgNode* VRMLToSGConverterImpl::convertShapeNode(VRMLShape* vshape)
                     texture->setTextureTransform(textureTransform);
                     shape->setTexture(texture);
 
-                    if(!mesh->texCoords()){
+                    if(deferredMesh){
+                        deferredMesh->needsTexCoord = true;
+                    } else if(!mesh->texCoords()){
                         if(dynamic_cast<VRMLIndexedFaceSet*>(vrmlGeometry)){
                             meshGenerator.generateTextureCoordinateForIndexedFaceSet(mesh);
                         } else if(VRMLElevationGrid* elevationGrid = dynamic_cast<VRMLElevationGrid*>(vrmlGeometry)){
@@ -450,6 +495,101 @@ SgNode* VRMLToSGConverterImpl::convertShapeNode(VRMLShape* vshape)
 }
 
 
+/**
+   The mesh of a large IndexedFaceSet node is generated later in parallel with the other meshes
+   when the parallel mesh generation is enabled. The node without coordinates is converted
+   immediately so that the error message is output and the shape node is not created.
+*/
+bool VRMLToSGConverterImpl::isMeshGenerationDeferrable(VRMLIndexedFaceSet* faceSet)
+{
+    static const size_t minNumCoordIndices = 4000;
+
+    return isParallelMeshGenerationEnabled &&
+        faceSet->coordIndex.size() >= minNumCoordIndices &&
+        faceSet->coord && !faceSet->coord->point.empty();
+}
+
+
+SgMeshPtr VRMLToSGConverterImpl::convertIndexedFaceSet(VRMLIndexedFaceSet* faceSet)
+{
+    SgMeshPtr mesh;
+    
+    if(!isTriangulationEnabled){
+        mesh = createMeshFromIndexedFaceSet(faceSet);
+    } else {
+        SgPolygonMeshPtr polygonMesh = createPolygonMeshFromIndexedFaceSet(faceSet);
+        if(polygonMesh){
+            mesh = polygonMeshTriangulator.triangulate(polygonMesh);
+            const string& errorMessage = polygonMeshTriangulator.errorMessage();
+            if(!errorMessage.empty()){
+                string message;
+                if(faceSet->defName.empty()){
+                    message = "Error of an IndexedFaceSet node: \n";
+                } else {
+                    message = format("Error of IndexedFaceSet node \"{}\": \n", faceSet->defName);
+                }
+                putMessage(message + errorMessage);
+            }
+        }
+    }
+    if(mesh && isNormalGenerationEnabled){
+        meshFilter.generateNormals(mesh, faceSet->creaseAngle);
+    }
+
+    return mesh;
+}
+
+
+void VRMLToSGConverterImpl::generateDeferredMeshes()
+{
+    if(deferredMeshes.empty()){
+        return;
+    }
+    
+    parallelFor(0, deferredMeshes.size(), 1, [&](int begin, int end){
+        VRMLToSGConverterImpl worker(*this);
+        ostringstream messages;
+        worker.os_ = &messages;
+        for(int i=begin; i < end; ++i){
+            auto& deferred = deferredMeshes[i];
+            deferred.mesh = worker.convertIndexedFaceSet(deferred.faceSet);
+            if(deferred.mesh && deferred.needsTexCoord && !deferred.mesh->texCoords()){
+                worker.meshGenerator.generateTextureCoordinateForIndexedFaceSet(deferred.mesh);
+            }
+            deferred.message = messages.str();
+            messages.str("");
+        }
+    });
+
+    for(auto& deferred : deferredMeshes){
+        if(!deferred.message.empty()){
+            os() << deferred.message;
+        }
+        auto& mesh = deferred.mesh;
+        if(mesh){
+            mesh->setName(deferred.faceSet->defName);
+            vrmlGeometryToSgMeshMap[deferred.faceSet] = mesh;
+            for(auto& shape : deferred.shapes){
+                shape->setMesh(mesh);
+            }
+        } else {
+            // The shape without a mesh is removed because it is not created by the normal conversion
+            for(auto& shape : deferred.shapes){
+                vector<SgObject*> parents(shape->parentBegin(), shape->parentEnd());
+                for(auto& parent : parents){
+                    if(auto group = dynamic_cast<SgGroup*>(parent)){
+                        group->removeChild(shape);
+                    }
+                }
+            }
+        }
+    }
+
+    deferredMeshes.clear();
+    vrmlGeometryToDeferredMeshIndexMap.clear();
+}
+
+
 SgMeshPtr VRMLToSGConverterImpl::createMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface)
 {
     if(!vface->coord || vface->coord->point.empty() || vface->coordIndex.empty()){
@@ -28,10 +28,20 @@ public:
     void setMinCreaseAngle(double angle);
     void setMaxCreaseAngle(double angle);
 
+    /**
+       When this is enabled, the meshes of the large IndexedFaceSet nodes are not generated by the
+       convert function but generated in parallel by the finishConversion function. The shapes of
+       those meshes do not have their meshes until the finishConversion function is called.
+    */
+    void setParallelMeshGenerationEnabled(bool on);
+
     void clearConvertedNodeMap();
         
     SgNodePtr convert(VRMLNodePtr vrmlNode);
 
+    //! This function must be called after the conversion when the parallel mesh generation is enabled.
+    void finishConversion();
+
 private:
     VRMLToSGConverterImpl* impl;
 };
@@ -5,7 +5,9 @@
 #include "ValueTree.h"
 #include "UTF8.h"
 #include <stack>
+#include <mutex>
 #include <iostream>
+#include <cstring>
 #include <yaml.h>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
@@ -853,6 +855,7 @@ Listing::Listing()
     doubleFormat_ = defaultDoubleFormat;
     isFlowStyle_ = false;
     doInsertLFBeforeNextElement = false;
+    isNodeCreationPending_ = false;
 }
 
 
@@ -865,6 +868,7 @@ Listing::Listing(int size)
     doubleFormat_ = defaultDoubleFormat;
     isFlowStyle_ = false;
     doInsertLFBeforeNextElement = false;
+    isNodeCreationPending_ = false;
 }
 
 
@@ -876,6 +880,7 @@ Listing::Listing(int line, int column)
     doubleFormat_ = defaultDoubleFormat;
     isFlowStyle_ = false;
     doInsertLFBeforeNextElement = false;
+    isNodeCreationPending_ = false;
 }
 
 
@@ -889,12 +894,16 @@ Listing::Listing(int line, int column, int reservedSize)
     doubleFormat_ = defaultDoubleFormat;
     isFlowStyle_ = false;
     doInsertLFBeforeNextElement = false;
+    isNodeCreationPending_ = false;
 }
 
 
 Listing::Listing(const Listing& org)
     : ValueNode(org),
-      values(org.values),
+      values(org.nodes()),
+      numericValues_(org.numericValues_),
+      numericTexts_(org.numericTexts_),
+      isNodeCreationPending_(false),
       doubleFormat_(org.doubleFormat_),
       isFlowStyle_(org.isFlowStyle_),
       doInsertLFBeforeNextElement(org.doInsertLFBeforeNextElement)
@@ -918,15 +927,58 @@ Listing::~Listing()
 void Listing::clear()
 {
     values.clear();
+    numericValues_.clear();
+    numericTexts_.clear();
+    isNodeCreationPending_ = false;
 }
 
 
 void Listing::reserve(int size)
 {
+    clearNumericValues();
     values.reserve(size);
 }
 
 
+void Listing::createNodes() const
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(isNodeCreationPending_.load(std::memory_order_relaxed)){
+        values.clear();
+        values.reserve(numericValues_.size());
+        const char* text = numericTexts_.c_str();
+        for(size_t i=0; i < numericValues_.size(); ++i){
+            const size_t length = strlen(text);
+            auto scalar = new ScalarNode(text, length, PLAIN_STRING);
+            scalar->line_ = line_;
+            scalar->column_ = column_;
+            values.push_back(scalar);
+            text += length + 1;
+        }
+        isNodeCreationPending_.store(false, std::memory_order_release);
+    }
+}
+
+
+void Listing::appendNumericValue(double value, const char* text, size_t length)
+{
+    numericValues_.push_back(value);
+    numericTexts_.append(text, length);
+    numericTexts_.push_back('\0');
+    isNodeCreationPending_ = true;
+}
+
+
+void Listing::clearNumericValuesSub()
+{
+    nodes();
+    numericValues_.clear();
+    numericTexts_.clear();
+}
+
+
 void Listing::setDoubleFormat(const char* format)
 {
     doubleFormat_ = format;
@@ -935,6 +987,7 @@ void Listing::setDoubleFormat(const char* format)
 
 void Listing::insertLF(int maxColumns, int numValues)
 {
+    clearNumericValues();
     if(values.empty()){
         if(numValues > 0 && numValues > maxColumns){
             doInsertLFBeforeNextElement = true;
@@ -947,6 +1000,7 @@ void Listing::insertLF(int maxColumns, int numValues)
 
 void Listing::appendLF()
 {
+    clearNumericValues();
     if(values.empty()){
         doInsertLFBeforeNextElement = true;
     } else {
@@ -966,6 +1020,7 @@ Mapping* Listing::newMapping()
 
 void Listing::append(int value)
 {
+    clearNumericValues();
     char buf[32];
     int n = snprintf(buf, 32, "%d", value);
     ScalarNode* node = new ScalarNode(buf, n, PLAIN_STRING);
@@ -979,6 +1034,7 @@ void Listing::append(int value)
 
 void Listing::write(int i, int value)
 {
+    clearNumericValues();
     char buf[32];
     int n = snprintf(buf, 32, "%d", value);
     values[i] = new ScalarNode(buf, n, PLAIN_STRING);
@@ -997,6 +1053,7 @@ void Listing::write(int i, int value)
 
 void Listing::append(double value)
 {
+    clearNumericValues();
     char buf[32];
     int n = snprintf(buf, 32, doubleFormat_, value);
     ScalarNode* node = new ScalarNode(buf, n, PLAIN_STRING);
@@ -1010,6 +1067,7 @@ void Listing::append(double value)
 
 void Listing::append(const std::string& value, StringStyle stringStyle)
 {
+    clearNumericValues();
     ScalarNode* node = new ScalarNode(value, stringStyle);
     if(doInsertLFBeforeNextElement){
         node->typeBits |= INSERT_LF;
@@ -1021,6 +1079,7 @@ void Listing::append(const std::string& value, StringStyle stringStyle)
 
 void Listing::insert(int index, ValueNode* node)
 {
+    clearNumericValues();
     if(index >= 0){
         if(index > static_cast<int>(values.size())){
             index = values.size();
@@ -1032,5 +1091,6 @@ void Listing::insert(int index, ValueNode* node)
 
 void Listing::write(int i, const std::string& value, StringStyle stringStyle)
 {
+    clearNumericValues();
     values[i] = new ScalarNode(value, stringStyle);
 }
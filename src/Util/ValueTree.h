@@ -9,6 +9,7 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <atomic>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -430,8 +431,10 @@ public:
     typedef Container::iterator iterator;
     typedef Container::const_iterator const_iterator;
 
-    bool empty() const { return values.empty(); }
-    int size() const { return static_cast<int>(values.size()); }
+    bool empty() const { return size() == 0; }
+    int size() const {
+        return static_cast<int>(numericValues_.empty() ? values.size() : numericValues_.size());
+    }
     void clear();
     void reserve(int size);
 
@@ -442,22 +445,36 @@ public:
     const char* doubleFormat() { return doubleFormat_; }
 
     ValueNode* front() const {
-        return values.front();
+        return nodes().front();
     }
 
     ValueNode* back() const {
-        return values.back();
+        return nodes().back();
     }
 
     ValueNode* at(int i) const {
-        return values[i];
+        return nodes()[i];
     }
 
     /**
        deprecated
     */
     ValueNode& get(int i) const {
-        return *values[i];
+        return *nodes()[i];
+    }
+
+    /**
+       A flow-style listing of numbers read by YAMLReader keeps the values in a contiguous array,
+       and the scalar nodes of the elements are not created until they are accessed.
+       This function returns the array in that case, and null otherwise.
+    */
+    const double* numericValues() const {
+        return numericValues_.empty() ? nullptr : numericValues_.data();
+    }
+
+    //! This function is faster than operator[] when the listing has the numeric values.
+    double doubleAt(int i) const {
+        return numericValues_.empty() ? values[i]->toDouble() : numericValues_[i];
     }
 
     void write(int i, int value);
@@ -467,7 +484,7 @@ public:
        \todo This operator should return ValueNode*.
     */
     ValueNode& operator[](int i) const {
-        return *values[i];
+        return *nodes()[i];
     }
 
     /// \todo implement the following funcion (ticket #35)
@@ -476,6 +493,7 @@ public:
     Mapping* newMapping();
 
     void append(ValueNode* node) {
+        clearNumericValues();
         values.push_back(node);
     }
 
@@ -533,10 +551,10 @@ public:
 
     void appendLF();
 
-    iterator begin() { return values.begin(); }
-    iterator end() { return values.end(); }
-    const_iterator begin() const { return values.begin(); }
-    const_iterator end() const { return values.end(); };
+    iterator begin() { clearNumericValues(); return values.begin(); }
+    iterator end() { clearNumericValues(); return values.end(); }
+    const_iterator begin() const { return nodes().begin(); }
+    const_iterator end() const { return nodes().end(); };
 
 private:
 
@@ -547,8 +565,27 @@ private:
     Listing& operator=(const Listing&);
 
     void insertLF(int maxColumns, int numValues);
+
+    const Container& nodes() const {
+        if(isNodeCreationPending_.load(std::memory_order_acquire)){
+            createNodes();
+        }
+        return values;
+    }
+    void createNodes() const;
+    void appendNumericValue(double value, const char* text, size_t length);
+    void clearNumericValues() {
+        if(!numericValues_.empty()){
+            clearNumericValuesSub();
+        }
+    }
+    void clearNumericValuesSub();
         
-    Container values;
+    mutable Container values;
+    std::vector<double> numericValues_;
+    // The texts of the numeric values separated by null characters
+    std::string numericTexts_;
+    mutable std::atomic<bool> isNodeCreationPending_;
     const char* doubleFormat_;
     bool isFlowStyle_;
     bool doInsertLFBeforeNextElement;
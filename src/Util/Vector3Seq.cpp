@@ -60,7 +60,7 @@ bool Vector3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
             if(v.size() != topIndex + 3){
                 v.throwException(_("The number of elements specified as a 3D vector is invalid."));
             }
-            value << v[topIndex].toDouble(), v[topIndex+1].toDouble(), v[topIndex+2].toDouble();
+            value << v.doubleAt(topIndex), v.doubleAt(topIndex+1), v.doubleAt(topIndex+2);
         });
 }
 
@@ -5,6 +5,7 @@
 #include "YAMLReader.h"
 #include "UTF8.h"
 #include <cerrno>
+#include <cstdlib>
 #include <stack>
 #include <iostream>
 #include <yaml.h>
@@ -62,6 +63,9 @@ public:
     struct NodeInfo {
         ValueNodePtr node;
         string key;
+        // The numbers in a flow-style listing are stored as the numeric values of the listing
+        bool isNumericListing;
+        NodeInfo() : isNumericListing(false) { }
     };
 
     stack<NodeInfo> nodeStack;
@@ -325,6 +329,7 @@ void YAMLReaderImpl::addNode(ValueNode* node, yaml_event_t& event)
     if(parent->isListing()){
         Listing* listing = static_cast<Listing*>(parent);
         listing->append(node);
+        info.isNumericListing = false;
 
     } else if(parent->isMapping()){
 
@@ -431,6 +436,9 @@ void YAMLReaderImpl::onListingStart(yaml_event_t& event)
 
     const yaml_mark_t& mark = event.start_mark;
 
+    const bool isFlowStyle = (event.data.sequence_start.style == YAML_FLOW_SEQUENCE_STYLE);
+    info.isNumericListing = isFlowStyle && !event.data.sequence_start.anchor;
+
     if(!isRegularMultiListingExpected){
         listing = new Listing(mark.line, mark.column);
     } else {
@@ -439,10 +447,15 @@ void YAMLReaderImpl::onListingStart(yaml_event_t& event)
             expectedListingSizes.resize(level + 1, 0);
         }
         const int prevSize = expectedListingSizes[level];
-        listing = new Listing(mark.line, mark.column, prevSize);
+        if(info.isNumericListing){
+            listing = new Listing(mark.line, mark.column);
+            listing->numericValues_.reserve(prevSize);
+        } else {
+            listing = new Listing(mark.line, mark.column, prevSize);
+        }
     }
 
-    listing->setFlowStyle(event.data.sequence_start.style == YAML_FLOW_SEQUENCE_STYLE);
+    listing->setFlowStyle(isFlowStyle);
     info.node = listing;
     nodeStack.push(info);
 
@@ -504,6 +517,18 @@ void YAMLReaderImpl::onScalar(yaml_event_t& event)
             scalar = createScalar(event);
         }
     } else if(parent->isListing()){
+        if(info.isNumericListing){
+            if(event.data.scalar.style == YAML_PLAIN_SCALAR_STYLE && !event.data.scalar.anchor && length > 0){
+                const char* text = (char*)value;
+                char* endptr;
+                double number = strtod(text, &endptr);
+                if(endptr == text + length){
+                    static_cast<Listing*>(parent.get())->appendNumericValue(number, text, length);
+                    return;
+                }
+            }
+            info.isNumericListing = false;
+        }
         scalar = createScalar(event);
     }
     if(scalar){